@@ -866,6 +866,7 @@ rm -rf $RPM_BUILD_ROOT
 %{_libdir}/slurm/acct_gather_filesystem_none.so
 %{_libdir}/slurm/acct_gather_interconnect_none.so
 %{_libdir}/slurm/acct_gather_energy_none.so
+%{_libdir}/slurm/acct_gather_profile_columnar.so
 %{_libdir}/slurm/acct_gather_profile_none.so
 %{_libdir}/slurm/burst_buffer_generic.so
 %{_libdir}/slurm/checkpoint_none.so
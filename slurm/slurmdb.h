@@ -274,6 +274,11 @@ typedef struct {
 	List jobname_list;	/* list of char * */
 	uint32_t nodes_max;     /* number of nodes high range */
 	uint32_t nodes_min;     /* number of nodes low range */
+	char *page_cluster;	/* cluster of the job the last page
+				 * ended with */
+	uint32_t page_jobid;	/* job the last page ended with */
+	uint32_t page_size;	/* if set only return about this many
+				 * jobs, see page_cluster/page_jobid */
 	List partition_list;	/* list of char * */
 	List qos_list;  	/* list of char * */
 	List resv_list;		/* list of char * */
@@ -702,6 +707,39 @@ typedef struct {
 	List      cluster_list;	/* List of slurmdb_cluster_rec_t *'s */
 } slurmdb_federation_rec_t;
 
+/* Fields to group the totals of slurmdb_jobs_aggregate() by.  Totals are
+ * always per cluster. */
+#define SLURMDB_JOB_AGGR_USER      0x00000001
+#define SLURMDB_JOB_AGGR_ACCOUNT   0x00000002
+#define SLURMDB_JOB_AGGR_PARTITION 0x00000004
+#define SLURMDB_JOB_AGGR_STATE     0x00000008
+#define SLURMDB_JOB_AGGR_TIME      0x00000010 /* by time_bucket of
+					       * submit time */
+
+typedef struct {
+	uint32_t group_by;	/* SLURMDB_JOB_AGGR_* */
+	slurmdb_job_cond_t *job_cond; /* jobs to total, used_nodes is not
+				       * supported */
+	uint32_t time_bucket;	/* seconds in a bucket when grouping by
+				 * SLURMDB_JOB_AGGR_TIME, default a day */
+} slurmdb_job_aggr_cond_t;
+
+typedef struct {
+	char *account;		/* if grouped by account */
+	char *cluster;
+	uint64_t cpu_alloc_secs; /* allocated cpus * elapsed */
+	uint64_t cpu_used_secs;	/* user + system time of the steps */
+	uint64_t elapsed_secs;
+	uint32_t job_cnt;
+	char *partition;	/* if grouped by partition */
+	uint32_t state;		/* base job state if grouped by state */
+	time_t time_start;	/* start of the bucket if grouped by time */
+	uint64_t timelimit_secs; /* of the jobs that have a limit */
+	uint32_t uid;		/* if grouped by user */
+	char *user;		/* if grouped by user */
+	uint64_t wait_secs;	/* between eligible and start */
+} slurmdb_job_aggr_rec_t;
+
 /* slurmdb_job_cond_t is defined above alphabetical */
 
 
@@ -1224,6 +1262,13 @@ typedef struct {
 	uint32_t *rpc_user_id;		/* User ID issuing RPC */
 	uint32_t *rpc_user_cnt;		/* count of RPCs processed */
 	uint64_t *rpc_user_time;	/* total usecs this user's RPCs */
+
+	uint32_t batch_cnt;		/* count of batched statements */
+	uint64_t batch_rows;		/* rows written by batches */
+	uint64_t batch_time;		/* total usecs in batches */
+	uint32_t commit_cnt;		/* count of job record commits */
+	uint64_t commit_time;		/* total usecs in commits */
+	uint64_t commit_max_time;	/* longest commit in usecs */
 } slurmdb_stats_rec_t;
 
 
@@ -1284,6 +1329,19 @@ extern int slurmdb_archive(void *db_conn, slurmdb_archive_cond_t *arch_cond);
 extern int slurmdb_archive_load(void *db_conn,
 				slurmdb_archive_rec_t *arch_rec);
 
+/*
+ * get jobs from job archive files written by the slurmdbd without loading
+ * them into the database.  Steps are not archived with the jobs, so the
+ * jobs have none.  Files that can not be read are reported and skipped.
+ * Reservations can only be selected by id (resvid_list), not by name.
+ * IN:  file_list List of archive file names (char *)
+ * IN:  slurmdb_job_cond_t *
+ * RET: List of slurmdb_job_rec_t * else NULL on error
+ * note List needs to be freed with slurm_list_destroy() when called
+ */
+extern List slurmdb_archive_get_jobs(List file_list,
+				     slurmdb_job_cond_t *job_cond);
+
 
 /************** association functions **************/
 
@@ -1509,6 +1567,15 @@ extern List slurmdb_events_get(void *db_conn,
  */
 extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond);
 
+/*
+ * get totals of jobs from the storage, grouped in the storage
+ * IN:  slurmdb_job_aggr_cond_t *
+ * RET: List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed with slurm_list_destroy() when called
+ */
+extern List slurmdb_jobs_aggregate(void *db_conn,
+				   slurmdb_job_aggr_cond_t *aggr_cond);
+
 /*
  * get info from the storage
  * IN:  slurmdb_assoc_cond_t *
@@ -1577,6 +1644,7 @@ extern void slurmdb_free_assoc_mgr_state_msg(void *object);
 extern void slurmdb_free_assoc_rec_members(slurmdb_assoc_rec_t *assoc);
 extern void slurmdb_destroy_assoc_rec(void *object);
 extern void slurmdb_destroy_event_rec(void *object);
+extern void slurmdb_destroy_job_aggr_rec(void *object);
 extern void slurmdb_destroy_job_rec(void *object);
 extern void slurmdb_free_qos_rec_members(slurmdb_qos_rec_t *qos);
 extern void slurmdb_destroy_qos_rec(void *object);
@@ -1599,6 +1667,7 @@ extern void slurmdb_destroy_federation_cond(void *object);
 extern void slurmdb_destroy_tres_cond(void *object);
 extern void slurmdb_destroy_assoc_cond(void *object);
 extern void slurmdb_destroy_event_cond(void *object);
+extern void slurmdb_destroy_job_aggr_cond(void *object);
 extern void slurmdb_destroy_job_cond(void *object);
 extern void slurmdb_destroy_job_modify_cond(void *object);
 extern void slurmdb_destroy_qos_cond(void *object);
@@ -1889,6 +1889,31 @@ void slurm_print_slurmd_status (FILE* out,
 
 	fprintf(out, "Slurmd PID               = %u\n",
 		slurmd_status_ptr->pid);
+	fprintf(out, "Slurmstepd Pool Ready    = %u\n",
+		slurmd_status_ptr->stepd_pool_ready);
+	fprintf(out, "Slurmstepd Pool Launches = %u\n",
+		slurmd_status_ptr->launch_pooled);
+	if (slurmd_status_ptr->launch_hist_cnt) {
+		uint32_t i, last = slurmd_status_ptr->launch_hist_cnt - 1;
+
+		fprintf(out, "Slurmstepd Launch Times  =");
+		for (i = 0; i < last; i++) {
+			fprintf(out, " <%ums:%u", (1U << i),
+				slurmd_status_ptr->launch_hist[i]);
+		}
+		fprintf(out, " >=%ums:%u\n", (last ? (1U << (last - 1)) : 0),
+			slurmd_status_ptr->launch_hist[last]);
+	}
+	if (slurmd_status_ptr->rpc_class_cnt >= 3) {
+		fprintf(out, "RPCs Active              = urgent:%u normal:%u "
+			"stats:%u\n", slurmd_status_ptr->rpc_active[0],
+			slurmd_status_ptr->rpc_active[1],
+			slurmd_status_ptr->rpc_active[2]);
+		fprintf(out, "RPCs Queued              = stats:%u\n",
+			slurmd_status_ptr->rpc_stats_queued);
+		fprintf(out, "RPCs Rejected            = %u\n",
+			slurmd_status_ptr->rpc_rejected);
+	}
 	fprintf(out, "Slurmd Debug             = %u\n",
 		slurmd_status_ptr->slurmd_debug);
 	fprintf(out, "Slurmd Logfile           = %s\n",
@@ -44,12 +44,14 @@
 #include "src/common/log.h"
 #include "src/common/macros.h"
 #include "src/common/pack.h"
+#include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
 #include "src/common/slurm_protocol_pack.h"
 #include "src/common/slurm_cred.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xsignal.h"
+#include "src/common/xstring.h"
 #include "src/common/eio.h"
 #include "src/common/io_hdr.h"
 #include "src/common/net.h"
@@ -60,6 +62,7 @@
 
 #define MAX_RETRIES 3
 #define STDIO_MAX_FREE_BUF 1024
+#define STDIO_MAX_THREADS 64
 
 struct io_buf {
 	int ref_count;
@@ -77,10 +80,13 @@ static struct io_buf *_alloc_io_buf(void);
 static void	_init_stdio_eio_objs(slurm_step_io_fds_t fds,
 				     client_io_t *cio);
 static void	_handle_io_init_msg(int fd, client_io_t *cio);
-static int      _read_io_init_msg(int fd, client_io_t *cio, char *host);
+static int      _read_io_init_msg(int fd, client_io_t *cio,
+				  eio_handle_t *eio, char *host);
 static int      _wid(int n);
 static bool     _incoming_buf_free(client_io_t *cio);
 static bool     _outgoing_buf_free(client_io_t *cio);
+static void	_outgoing_buf_put(client_io_t *cio, struct io_buf *buf);
+static void	_wakeup_server_threads(client_io_t *cio);
 
 /**********************************************************************
  * Listening socket declarations
@@ -110,6 +116,7 @@ struct io_operations server_ops = {
 
 struct server_io_info {
 	client_io_t *cio;
+	eio_handle_t *eio;	/* handle of the stdio thread polling us */
 	int node_id;
 	bool testing_connection;
 
@@ -216,14 +223,15 @@ _set_listensocks_nonblocking(client_io_t *cio)
  * IO server socket functions
  **********************************************************************/
 static eio_obj_t *
-_create_server_eio_obj(int fd, client_io_t *cio, int nodeid,
-		       int stdout_objs, int stderr_objs)
+_create_server_eio_obj(int fd, client_io_t *cio, eio_handle_t *handle,
+		       int nodeid, int stdout_objs, int stderr_objs)
 {
 	struct server_io_info *info = NULL;
 	eio_obj_t *eio = NULL;
 
 	info = (struct server_io_info *)xmalloc(sizeof(struct server_io_info));
 	info->cio = cio;
+	info->eio = handle;
 	info->node_id = nodeid;
 	info->testing_connection = false;
 	info->in_msg = NULL;
@@ -245,11 +253,20 @@ static bool
 _server_readable(eio_obj_t *obj)
 {
 	struct server_io_info *s = (struct server_io_info *) obj->arg;
+	bool buf_free;
 
 	debug4("Called _server_readable");
 
-	if (!_outgoing_buf_free(s->cio)) {
+	slurm_mutex_lock(&s->cio->outgoing_lock);
+	buf_free = _outgoing_buf_free(s->cio);
+	slurm_mutex_unlock(&s->cio->outgoing_lock);
+	if (!buf_free) {
 		debug4("  false, free_io_buf is empty");
+		/* Buffers are released by the file writers of the first IO
+		 * thread, which wakes this one up when it does.  Do not let
+		 * this one leave its loop meanwhile. */
+		if (s->eio != s->cio->eio)
+			eio_wait_for_wakeup(s->eio);
 		return false;
 	}
 
@@ -289,9 +306,11 @@ _server_read(eio_obj_t *obj, List objs)
 
 	debug4("Entering _server_read");
 	if (s->in_msg == NULL) {
-		if (_outgoing_buf_free(s->cio)) {
+		slurm_mutex_lock(&s->cio->outgoing_lock);
+		if (_outgoing_buf_free(s->cio))
 			s->in_msg = list_dequeue(s->cio->free_outgoing);
-		} else {
+		slurm_mutex_unlock(&s->cio->outgoing_lock);
+		if (s->in_msg == NULL) {
 			debug("List free_outgoing is empty!");
 			return SLURM_ERROR;
 		}
@@ -318,7 +337,7 @@ _server_read(eio_obj_t *obj, List objs)
 			obj->fd = -1;
 			s->in_eof = true;
 			s->out_eof = true;
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			return SLURM_SUCCESS;
 		}
@@ -326,7 +345,7 @@ _server_read(eio_obj_t *obj, List objs)
 			if (s->cio->sls)
 				step_launch_clear_questionable_state(
 					s->cio->sls, s->node_id);
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			s->testing_connection = false;
 			return SLURM_SUCCESS;
@@ -349,7 +368,7 @@ _server_read(eio_obj_t *obj, List objs)
 				&& s->remote_stderr_objs == 0) {
 				obj->shutdown = true;
 			}
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			return SLURM_SUCCESS;
 		}
@@ -393,7 +412,7 @@ _server_read(eio_obj_t *obj, List objs)
 			obj->fd = -1;
 			s->in_eof = true;
 			s->out_eof = true;
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
+			_outgoing_buf_put(s->cio, s->in_msg);
 			s->in_msg = NULL;
 			return SLURM_SUCCESS;
 		}
@@ -419,11 +438,18 @@ _server_read(eio_obj_t *obj, List objs)
 		else
 			obj = s->cio->stderr_obj;
 		info = (struct file_write_info *) obj->arg;
-		if (info->eof)
+		if (info->eof) {
 			/* this output is closed, discard message */
-			list_enqueue(s->cio->free_outgoing, s->in_msg);
-		else
+			_outgoing_buf_put(s->cio, s->in_msg);
+		} else {
+			/* The output files are written by the first stdio
+			 * thread, wake it up as it may be waiting in poll()
+			 * without this file in its writable set.  Testing the
+			 * queue for emptiness first would race its writer. */
 			list_enqueue(info->msg_queue, s->in_msg);
+			if (s->eio != s->cio->eio)
+				eio_signal_wakeup(s->cio->eio);
+		}
 
 		s->in_msg = NULL;
 	}
@@ -512,14 +538,15 @@ again:
 
 	/*
 	 * Free the message and prepare to send the next one.
+	 * Stdin messages are shared by the servers of all stdio threads.
 	 */
+	slurm_mutex_lock(&s->cio->ioservers_lock);
 	s->out_msg->ref_count--;
-	if (s->out_msg->ref_count == 0) {
-		slurm_mutex_lock(&s->cio->ioservers_lock);
+	if (s->out_msg->ref_count == 0)
 		list_enqueue(s->cio->free_incoming, s->out_msg);
-		slurm_mutex_unlock(&s->cio->ioservers_lock);
-	} else
+	else
 		debug3("  Could not free msg!!");
+	slurm_mutex_unlock(&s->cio->ioservers_lock);
 	s->out_msg = NULL;
 
 	return SLURM_SUCCESS;
@@ -599,7 +626,7 @@ static int _file_write(eio_obj_t *obj, List objs)
 					        info->out_msg->header.gtaskid,
 					        info->cio->label,
 					        info->cio->label_width)) < 0) {
-			list_enqueue(info->cio->free_outgoing, info->out_msg);
+			_outgoing_buf_put(info->cio, info->out_msg);
 			info->eof = true;
 			return SLURM_ERROR;
 		}
@@ -614,7 +641,7 @@ static int _file_write(eio_obj_t *obj, List objs)
 	 */
 	info->out_msg->ref_count--;
 	if (info->out_msg->ref_count == 0)
-		list_enqueue(info->cio->free_outgoing, info->out_msg);
+		_outgoing_buf_put(info->cio, info->out_msg);
 	info->out_msg = NULL;
 	debug2("Leaving  _file_write");
 
@@ -746,6 +773,7 @@ again:
 	/*
 	 * Route the message to the correct IO servers
 	 */
+	slurm_mutex_lock(&info->cio->ioservers_lock);
 	if (header.type == SLURM_IO_ALLSTDIN) {
 		int i;
 		struct server_io_info *server;
@@ -761,6 +789,7 @@ again:
 				list_enqueue(server->msg_queue, msg);
 			}
 		}
+		_wakeup_server_threads(info->cio);
 	} else if (header.type == SLURM_IO_STDIN) {
 		uint32_t nodeid;
 		struct server_io_info *server;
@@ -774,10 +803,13 @@ again:
 		} else {
 			server = info->cio->ioserver[nodeid]->arg;
 			list_enqueue(server->msg_queue, msg);
+			if (server->eio != info->cio->eio)
+				eio_signal_wakeup(server->eio);
 		}
 	} else {
 		fatal("Unsupported header.type");
 	}
+	slurm_mutex_unlock(&info->cio->ioservers_lock);
 	msg = NULL;
 	return SLURM_SUCCESS;
 }
@@ -804,8 +836,6 @@ _io_thr_internal(void *cio_arg)
 	sigaddset(&set, SIGHUP);
  	pthread_sigmask(SIG_BLOCK, &set, NULL);
 
-	_set_listensocks_nonblocking(cio);
-
 	/* start the eio engine */
 	eio_handle_mainloop(cio->eio);
 
@@ -814,6 +844,52 @@ _io_thr_internal(void *cio_arg)
 	return NULL;
 }
 
+/*
+ * Additional stdio thread, polling its share of the listening sockets and
+ * of the IO server connections when LaunchParameters=srun_io_threads is set.
+ * Output is handed to the file writers of the first IO thread. This spreads
+ * the reading, there is still one IO server connection per node.
+ */
+static void *
+_server_io_thr(void *eio_arg)
+{
+	eio_handle_t *eio = (eio_handle_t *) eio_arg;
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	eio_handle_mainloop(eio);
+
+	debug("IO server thread exiting");
+
+	return NULL;
+}
+
+/* Return the handle of the stdio thread polling listening socket fd */
+static eio_handle_t *
+_listen_eio(client_io_t *cio, int fd)
+{
+	int i;
+
+	for (i = 0; i < cio->num_listen; i++) {
+		if (cio->listensock[i] == fd)
+			return cio->server_eio[i % cio->num_io_threads];
+	}
+	return cio->eio;
+}
+
+/* Wake up the additional stdio threads, if any */
+static void
+_wakeup_server_threads(client_io_t *cio)
+{
+	int i;
+
+	for (i = 1; i < cio->num_io_threads; i++)
+		eio_signal_wakeup(cio->server_eio[i]);
+}
+
 static eio_obj_t *
 _create_listensock_eio(int fd, client_io_t *cio)
 {
@@ -825,7 +901,7 @@ _create_listensock_eio(int fd, client_io_t *cio)
 }
 
 static int
-_read_io_init_msg(int fd, client_io_t *cio, char *host)
+_read_io_init_msg(int fd, client_io_t *cio, eio_handle_t *eio, char *host)
 {
 	struct slurm_io_init_msg msg;
 
@@ -853,7 +929,8 @@ _read_io_init_msg(int fd, client_io_t *cio, char *host)
 		error("IO: Hey, you told me node %d was down!", msg.nodeid);
 	}
 
-	cio->ioserver[msg.nodeid] = _create_server_eio_obj(fd, cio, msg.nodeid,
+	cio->ioserver[msg.nodeid] = _create_server_eio_obj(fd, cio, eio,
+							   msg.nodeid,
 							   msg.stdout_objs,
 							   msg.stderr_objs);
 	slurm_mutex_lock(&cio->ioservers_lock);
@@ -862,8 +939,10 @@ _read_io_init_msg(int fd, client_io_t *cio, char *host)
 	/* Normally using eio_new_initial_obj while the eio mainloop
 	 * is running is not safe, but since this code is running
 	 * inside of the eio mainloop there should be no problem.
+	 * The connection is polled by the thread owning the listening
+	 * socket it came from.
 	 */
-	eio_new_initial_obj(cio->eio, cio->ioserver[msg.nodeid]);
+	eio_new_initial_obj(eio, cio->ioserver[msg.nodeid]);
 	slurm_mutex_unlock(&cio->ioservers_lock);
 
 	if (cio->sls)
@@ -895,6 +974,7 @@ _is_fd_ready(int fd)
 static void
 _handle_io_init_msg(int fd, client_io_t *cio)
 {
+	eio_handle_t *eio = _listen_eio(cio, fd);
 	int j;
 	debug2("Activity on IO listening socket %d", fd);
 
@@ -941,7 +1021,7 @@ _handle_io_init_msg(int fd, client_io_t *cio)
 		/*
 		 * Read IO header and update cio structure appropriately
 		 */
-		if (_read_io_init_msg(sd, cio, buf) < 0)
+		if (_read_io_init_msg(sd, cio, eio, buf) < 0)
 			continue;
 
 		fd_set_nonblocking(sd);
@@ -1039,6 +1119,7 @@ _incoming_buf_free(client_io_t *cio)
 	return false;
 }
 
+/* Callers of this function should already have locked cio->outgoing_lock */
 static bool
 _outgoing_buf_free(client_io_t *cio)
 {
@@ -1058,6 +1139,49 @@ _outgoing_buf_free(client_io_t *cio)
 	return false;
 }
 
+static void
+_outgoing_buf_put(client_io_t *cio, struct io_buf *buf)
+{
+	bool wakeup;
+
+	slurm_mutex_lock(&cio->outgoing_lock);
+	/* IO server connections stop being readable when no buffer is left,
+	 * wake up the threads polling them when the first one is released */
+	wakeup = list_is_empty(cio->free_outgoing) &&
+		 (cio->outgoing_count >= STDIO_MAX_FREE_BUF);
+	list_enqueue(cio->free_outgoing, buf);
+	slurm_mutex_unlock(&cio->outgoing_lock);
+
+	if (wakeup)
+		_wakeup_server_threads(cio);
+}
+
+/* Number of srun stdio threads from LaunchParameters=srun_io_threads= */
+static int
+_get_io_threads(int num_nodes)
+{
+	char *launch_params, *tmp;
+	int threads = 1;
+
+	launch_params = slurm_get_launch_params();
+	if ((tmp = xstrcasestr(launch_params, "srun_io_threads="))) {
+		threads = atoi(tmp + 16);
+		if (threads < 1) {
+			error("Invalid LaunchParameters srun_io_threads=%d",
+			      threads);
+			threads = 1;
+		} else if (threads > STDIO_MAX_THREADS) {
+			error("LaunchParameters srun_io_threads=%d over limit, "
+			      "using %d", threads, STDIO_MAX_THREADS);
+			threads = STDIO_MAX_THREADS;
+		}
+	}
+	xfree(launch_params);
+
+	/* No use for more threads than IO server connections */
+	return MAX(MIN(threads, num_nodes), 1);
+}
+
 static inline int
 _estimate_nports(int nclients, int cli_per_port)
 {
@@ -1104,11 +1228,20 @@ client_io_handler_create(slurm_step_io_fds_t fds,
 	eio_timeout = slurm_get_srun_eio_timeout();
 	cio->eio = eio_handle_create(eio_timeout);
 
+	cio->num_io_threads = _get_io_threads(num_nodes);
+	cio->server_eio = xmalloc(cio->num_io_threads * sizeof(eio_handle_t *));
+	cio->server_ioid = xmalloc(cio->num_io_threads * sizeof(pthread_t));
+	cio->server_eio[0] = cio->eio;
+	for (i = 1; i < cio->num_io_threads; i++)
+		cio->server_eio[i] = eio_handle_create(eio_timeout);
+
 	/* Compute number of listening sockets needed to allow
 	 * all of the slurmds to establish IO streams with srun, without
-	 * overstressing the TCP/IP backoff/retry algorithm
+	 * overstressing the TCP/IP backoff/retry algorithm.
+	 * Each stdio thread polls at least one of them.
 	 */
 	cio->num_listen = _estimate_nports(num_nodes, 48);
+	cio->num_listen = MAX(cio->num_listen, cio->num_io_threads);
 	cio->listensock = (int *)xmalloc(cio->num_listen * sizeof(int));
 	cio->listenport = (uint16_t *)xmalloc(cio->num_listen*sizeof(uint16_t));
 
@@ -1116,6 +1249,7 @@ client_io_handler_create(slurm_step_io_fds_t fds,
 	cio->ioservers_ready_bits = bit_alloc(num_nodes);
 	cio->ioservers_ready = 0;
 	slurm_mutex_init(&cio->ioservers_lock);
+	slurm_mutex_init(&cio->outgoing_lock);
 
 	_init_stdio_eio_objs(fds, cio);
 	ports = slurm_get_srun_port_range();
@@ -1138,7 +1272,8 @@ client_io_handler_create(slurm_step_io_fds_t fds,
 		      cio->listenport[i]);
 		/*net_set_low_water(cio->listensock[i], 140);*/
 		obj = _create_listensock_eio(cio->listensock[i], cio);
-		eio_new_initial_obj(cio->eio, obj);
+		eio_new_initial_obj(cio->server_eio[i % cio->num_io_threads],
+				    obj);
 	}
 
 	cio->free_incoming = list_create(NULL); /* FIXME! Needs destructor */
@@ -1162,8 +1297,12 @@ client_io_handler_start(client_io_t *cio)
 	int retries = 0;
 	pthread_attr_t attr;
 
+	int i;
+
 	xsignal(SIGTTIN, SIG_IGN);
 
+	_set_listensocks_nonblocking(cio);
+
 	slurm_attr_init(&attr);
 	while ((errno = pthread_create(&cio->ioid, &attr,
 				      &_io_thr_internal, (void *) cio))) {
@@ -1175,9 +1314,33 @@ client_io_handler_start(client_io_t *cio)
 		}
 		sleep(1);	/* sleep and try again */
 	}
-	slurm_attr_destroy(&attr);
 	debug("Started IO server thread (%lu)", (unsigned long) cio->ioid);
 
+	for (i = 1; i < cio->num_io_threads; i++) {
+		retries = 0;
+		while ((errno = pthread_create(&cio->server_ioid[i], &attr,
+					       &_server_io_thr,
+					       (void *) cio->server_eio[i]))) {
+			if (++retries > MAX_RETRIES) {
+				error ("pthread_create error %m");
+				/* Connections of the remaining handles
+				 * would never be polled, stop now */
+				while (cio->num_io_threads > i) {
+					cio->num_io_threads--;
+					eio_handle_destroy(cio->server_eio[
+						cio->num_io_threads]);
+				}
+				slurm_attr_destroy(&attr);
+				return SLURM_ERROR;
+			}
+			sleep(1);	/* sleep and try again */
+		}
+	}
+	slurm_attr_destroy(&attr);
+	if (cio->num_io_threads > 1)
+		debug("Started %d additional IO server threads",
+		      cio->num_io_threads - 1);
+
 	return SLURM_SUCCESS;
 }
 
@@ -1218,9 +1381,22 @@ static void _delay_kill_thread(pthread_t thread_id, int secs)
 int
 client_io_handler_finish(client_io_t *cio)
 {
+	int i;
+
 	if (cio == NULL)
 		return SLURM_SUCCESS;
 
+	/* The additional threads hand their output to the file writers of
+	 * the first one, which must still be running until they are done */
+	for (i = 1; i < cio->num_io_threads; i++) {
+		eio_signal_shutdown(cio->server_eio[i]);
+		_delay_kill_thread(cio->server_ioid[i], 180);
+	}
+	for (i = 1; i < cio->num_io_threads; i++) {
+		if (pthread_join(cio->server_ioid[i], NULL) < 0)
+			error("Waiting for client io server pthread: %m");
+	}
+
 	eio_signal_shutdown(cio->eio);
 	/* Make the thread timeout consistent with
 	 * EIO_SHUTDOWN_WAIT
@@ -1237,6 +1413,8 @@ client_io_handler_finish(client_io_t *cio)
 void
 client_io_handler_destroy(client_io_t *cio)
 {
+	int i;
+
 	if (cio == NULL)
 		return;
 
@@ -1244,10 +1422,15 @@ client_io_handler_destroy(client_io_t *cio)
 	   (by calling client_io_handler_finish()) before freeing anything */
 
 	slurm_mutex_destroy(&cio->ioservers_lock);
+	slurm_mutex_destroy(&cio->outgoing_lock);
 	FREE_NULL_BITMAP(cio->ioservers_ready_bits);
 	xfree(cio->ioserver); /* need to destroy the obj first? */
 	xfree(cio->listenport);
 	xfree(cio->listensock);
+	for (i = 1; i < cio->num_io_threads; i++)
+		eio_handle_destroy(cio->server_eio[i]);
+	xfree(cio->server_eio);
+	xfree(cio->server_ioid);
 	eio_handle_destroy(cio->eio);
 	xfree(cio->io_key);
 	xfree(cio);
@@ -1287,6 +1470,7 @@ client_io_handler_downnodes(client_io_t *cio,
 	slurm_mutex_unlock(&cio->ioservers_lock);
 
 	eio_signal_wakeup(cio->eio);
+	_wakeup_server_threads(cio);
 }
 
 
@@ -1370,7 +1554,7 @@ int client_io_handler_send_test_message(client_io_t *cio, int node_id,
 
 		list_enqueue( server->msg_queue, msg );
 
-		if (eio_signal_wakeup(cio->eio) != SLURM_SUCCESS) {
+		if (eio_signal_wakeup(server->eio) != SLURM_SUCCESS) {
 			rc = SLURM_ERROR;
 			goto done;
 		}
@@ -54,6 +54,11 @@ struct client_io {
 	uint16_t *listenport;	/* Array of stdio listen port numbers */
 
 	eio_handle_t *eio;      /* Event IO handle for stdio traffic */
+	int num_io_threads;	/* Number of stdio threads, including ioid */
+	eio_handle_t **server_eio; /* Event IO handle of each stdio thread,
+				   server_eio[0] is eio. IO server
+				   connections are spread among them */
+	pthread_t *server_ioid;	/* Thread ids, server_ioid[0] is unused */
 	pthread_mutex_t ioservers_lock; /* This lock protects
 				   ioservers_ready_bits, ioservers_ready,
 				   pointers in ioserver, all the msg_queues
@@ -84,6 +89,9 @@ struct client_io {
 			         * including free_incoming buffers and
 			         * buffers in use.
 			         */
+	pthread_mutex_t outgoing_lock; /* This lock protects free_outgoing
+				   and outgoing_count, which are shared
+				   by all stdio threads. */
 
 	struct step_launch_state *sls; /* Used to notify the main thread of an
 				       I/O problem.  */
@@ -0,0 +1,590 @@
+/*****************************************************************************\
+ *  archive_cols.c - columnar blocks of archived database records.
+ *****************************************************************************
+ *
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/archive_cols.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+/* How the values of a column are encoded in a block */
+enum {
+	ARCHIVE_COL_STR,	/* packed strings */
+	ARCHIVE_COL_DICT,	/* packed distinct strings, varint codes */
+	ARCHIVE_COL_UINT	/* zigzag varint deltas of unsigned numbers */
+};
+
+/* Longest unsigned number stored as ARCHIVE_COL_UINT and its string */
+#define ARCHIVE_COL_UINT_DIGITS 19
+#define ARCHIVE_COL_VARINT_MAX 10
+
+typedef struct {
+	uint32_t data_offset;	/* of the encoded columns in the buffer */
+	uint32_t data_size;
+	char **ids;		/* sorted distinct id_col values, point into
+				 * the buffer */
+	uint32_t id_cnt;
+	time_t max_end;		/* 0 if a row has no end */
+	time_t min_start;
+	uint32_t row_cnt;
+} archive_block_t;
+
+struct archive_cols {
+	archive_block_t *block;	/* index of the blocks, reader only */
+	uint32_t block_cnt;
+	Buf blocks;		/* encoded blocks, writer only */
+	Buf buffer;		/* unpacked from, reader only */
+	int col_cnt;
+	char **col_names;
+	int end_col;
+	int id_col;
+	uint32_t pending_cnt;	/* rows in pending */
+	char ***pending;	/* values of rows not yet encoded by column,
+				 * writer only */
+	uint32_t row_cnt;
+	int start_col;
+};
+
+static int _cmp_str(const void *a, const void *b)
+{
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+/* Sort the cnt pointers of vals and drop the duplicates.
+ * RET the number of distinct values left */
+static uint32_t _sort_uniq(char **vals, uint32_t cnt)
+{
+	uint32_t i, uniq = 0;
+
+	if (!cnt)
+		return 0;
+
+	qsort(vals, cnt, sizeof(char *), _cmp_str);
+	for (i = 1; i < cnt; i++) {
+		if (strcmp(vals[uniq], vals[i]))
+			vals[++uniq] = vals[i];
+	}
+
+	return uniq + 1;
+}
+
+/* True if str is the canonical decimal form of an unsigned number */
+static bool _is_uint(const char *str, uint64_t *val)
+{
+	int len;
+
+	for (len = 0; str[len]; len++) {
+		if ((str[len] < '0') || (str[len] > '9') ||
+		    (len >= ARCHIVE_COL_UINT_DIGITS))
+			return false;
+	}
+	if (!len || ((str[0] == '0') && (len > 1)))
+		return false;
+
+	*val = strtoull(str, NULL, 10);
+	return true;
+}
+
+static inline uint64_t _zigzag(int64_t val)
+{
+	return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+static inline int64_t _unzigzag(uint64_t val)
+{
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static uint32_t _put_varint(char *data, uint64_t val)
+{
+	uint32_t len = 0;
+
+	while (val >= 0x80) {
+		data[len++] = (char)((val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	data[len++] = (char)val;
+
+	return len;
+}
+
+static int _get_varint(char *data, uint32_t size, uint32_t *offset,
+		       uint64_t *val)
+{
+	int shift;
+	uint8_t byte;
+
+	*val = 0;
+	for (shift = 0; shift < 64; shift += 7) {
+		if (*offset >= size)
+			return SLURM_ERROR;
+		byte = (uint8_t)data[(*offset)++];
+		*val |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return SLURM_SUCCESS;
+	}
+
+	return SLURM_ERROR;
+}
+
+/* Encode the values of one column of the pending block */
+static void _encode_col(char **vals, uint32_t cnt, Buf buffer)
+{
+	char **dict, *data;
+	uint32_t dict_cnt, i, size = 0;
+	uint64_t val, last = 0;
+	bool is_uint = true;
+
+	for (i = 0; is_uint && (i < cnt); i++)
+		is_uint = _is_uint(vals[i], &val);
+
+	data = xmalloc(cnt * ARCHIVE_COL_VARINT_MAX);
+	if (is_uint) {
+		pack8(ARCHIVE_COL_UINT, buffer);
+		for (i = 0; i < cnt; i++) {
+			_is_uint(vals[i], &val);
+			size += _put_varint(data + size,
+					    _zigzag((int64_t)(val - last)));
+			last = val;
+		}
+		packmem(data, size, buffer);
+		xfree(data);
+		return;
+	}
+
+	dict = xmalloc(sizeof(char *) * cnt);
+	memcpy(dict, vals, sizeof(char *) * cnt);
+	dict_cnt = _sort_uniq(dict, cnt);
+	if ((dict_cnt * 2) <= cnt) {
+		pack8(ARCHIVE_COL_DICT, buffer);
+		pack32(dict_cnt, buffer);
+		for (i = 0; i < dict_cnt; i++)
+			packstr(dict[i], buffer);
+		for (i = 0; i < cnt; i++) {
+			char **found = bsearch(&vals[i], dict, dict_cnt,
+					       sizeof(char *), _cmp_str);
+			size += _put_varint(data + size, found - dict);
+		}
+		packmem(data, size, buffer);
+	} else {
+		pack8(ARCHIVE_COL_STR, buffer);
+		for (i = 0; i < cnt; i++)
+			packstr(vals[i], buffer);
+	}
+	xfree(dict);
+	xfree(data);
+}
+
+/* Encode the pending rows as a block and append it to arch->blocks */
+static void _encode_block(archive_cols_t *arch)
+{
+	uint32_t cnt = arch->pending_cnt, i, id_cnt = 0, size_offset;
+	time_t min_start = 0, max_end = 0, when;
+	bool no_end = false;
+	char **ids = NULL;
+	int col;
+
+	if (!cnt)
+		return;
+
+	for (i = 0; i < cnt; i++) {
+		if (arch->start_col >= 0) {
+			when = slurm_atoul(arch->pending[arch->start_col][i]);
+			if (!i || (when < min_start))
+				min_start = when;
+		}
+		if (arch->end_col >= 0) {
+			when = slurm_atoul(arch->pending[arch->end_col][i]);
+			if (!when)
+				no_end = true;
+			else if (when > max_end)
+				max_end = when;
+		}
+	}
+	if (no_end || (arch->end_col < 0))
+		max_end = 0;
+
+	if (arch->id_col >= 0) {
+		ids = xmalloc(sizeof(char *) * cnt);
+		memcpy(ids, arch->pending[arch->id_col], sizeof(char *) * cnt);
+		id_cnt = _sort_uniq(ids, cnt);
+	}
+
+	pack32(cnt, arch->blocks);
+	pack_time(min_start, arch->blocks);
+	pack_time(max_end, arch->blocks);
+	pack32(id_cnt, arch->blocks);
+	for (i = 0; i < id_cnt; i++)
+		packstr(ids[i], arch->blocks);
+	xfree(ids);
+
+	/* Size of the columns so readers can skip them */
+	size_offset = get_buf_offset(arch->blocks);
+	pack32(0, arch->blocks);
+	for (col = 0; col < arch->col_cnt; col++)
+		_encode_col(arch->pending[col], cnt, arch->blocks);
+	i = get_buf_offset(arch->blocks);
+	set_buf_offset(arch->blocks, size_offset);
+	pack32(i - size_offset - sizeof(uint32_t), arch->blocks);
+	set_buf_offset(arch->blocks, i);
+
+	for (col = 0; col < arch->col_cnt; col++) {
+		for (i = 0; i < cnt; i++)
+			xfree(arch->pending[col][i]);
+	}
+	arch->block_cnt++;
+	arch->pending_cnt = 0;
+}
+
+/* Decode the values of one column of a block into vals.  Numbers are
+ * written to *nums which the caller frees. */
+static int _decode_col(Buf buffer, uint32_t cnt, char **vals, char **nums)
+{
+	char **dict = NULL, *data;
+	uint32_t dict_cnt = 0, i, len, offset = 0;
+	uint64_t val, last = 0;
+	uint8_t enc;
+
+	safe_unpack8(&enc, buffer);
+	switch (enc) {
+	case ARCHIVE_COL_STR:
+		for (i = 0; i < cnt; i++) {
+			safe_unpackmem_ptr(&vals[i], &len, buffer);
+			if (!vals[i])
+				vals[i] = "";
+		}
+		break;
+	case ARCHIVE_COL_DICT:
+		safe_unpack32(&dict_cnt, buffer);
+		if (dict_cnt > cnt)
+			goto unpack_error;
+		dict = xmalloc(sizeof(char *) * dict_cnt);
+		for (i = 0; i < dict_cnt; i++) {
+			safe_unpackmem_ptr(&dict[i], &len, buffer);
+			if (!dict[i])
+				dict[i] = "";
+		}
+		safe_unpackmem_ptr(&data, &len, buffer);
+		for (i = 0; i < cnt; i++) {
+			if ((_get_varint(data, len, &offset, &val) !=
+			     SLURM_SUCCESS) || (val >= dict_cnt))
+				goto unpack_error;
+			vals[i] = dict[val];
+		}
+		xfree(dict);
+		break;
+	case ARCHIVE_COL_UINT:
+		safe_unpackmem_ptr(&data, &len, buffer);
+		*nums = xmalloc(cnt * (ARCHIVE_COL_UINT_DIGITS + 2));
+		for (i = 0; i < cnt; i++) {
+			if (_get_varint(data, len, &offset, &val) !=
+			    SLURM_SUCCESS)
+				goto unpack_error;
+			last += (uint64_t)_unzigzag(val);
+			vals[i] = *nums + (i * (ARCHIVE_COL_UINT_DIGITS + 2));
+			snprintf(vals[i], ARCHIVE_COL_UINT_DIGITS + 2,
+				 "%"PRIu64, last);
+		}
+		break;
+	default:
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	xfree(dict);
+	return SLURM_ERROR;
+}
+
+/* True if the block may hold rows matching the arguments of
+ * archive_cols_for_each() */
+static bool _block_match(archive_block_t *block, time_t start, time_t end,
+			 List id_list)
+{
+	ListIterator itr;
+	char *id;
+	bool found = false;
+
+	if (start && block->max_end && (block->max_end < start))
+		return false;
+	if (end && (block->min_start > end))
+		return false;
+	if (!id_list || !list_count(id_list) || !block->id_cnt)
+		return true;
+
+	itr = list_iterator_create(id_list);
+	while (!found && (id = list_next(itr)))
+		found = bsearch(&id, block->ids, block->id_cnt,
+				sizeof(char *), _cmp_str) != NULL;
+	list_iterator_destroy(itr);
+
+	return found;
+}
+
+extern archive_cols_t *archive_cols_create(char **col_names, int col_cnt,
+					   int start_col, int end_col,
+					   int id_col)
+{
+	archive_cols_t *arch = xmalloc(sizeof(archive_cols_t));
+	int i;
+
+	arch->blocks = init_buf(BUF_SIZE);
+	arch->col_cnt = col_cnt;
+	arch->col_names = xmalloc(sizeof(char *) * col_cnt);
+	arch->pending = xmalloc(sizeof(char **) * col_cnt);
+	for (i = 0; i < col_cnt; i++) {
+		arch->col_names[i] = xstrdup(col_names[i]);
+		xstrsubstituteall(arch->col_names[i], "`", "");
+		arch->pending[i] = xmalloc(sizeof(char *) *
+					   ARCHIVE_COLS_BLOCK_ROWS);
+	}
+	arch->start_col = start_col;
+	arch->end_col = end_col;
+	arch->id_col = id_col;
+
+	return arch;
+}
+
+extern void archive_cols_add_row(archive_cols_t *arch, char **row)
+{
+	int col;
+
+	for (col = 0; col < arch->col_cnt; col++)
+		arch->pending[col][arch->pending_cnt] =
+			xstrdup(row[col] ? row[col] : "");
+	arch->row_cnt++;
+	if (++arch->pending_cnt == ARCHIVE_COLS_BLOCK_ROWS)
+		_encode_block(arch);
+}
+
+extern void archive_cols_pack(archive_cols_t *arch, Buf buffer)
+{
+	int col;
+
+	_encode_block(arch);
+
+	pack32(ARCHIVE_COLS_MAGIC, buffer);
+	pack32(arch->col_cnt, buffer);
+	for (col = 0; col < arch->col_cnt; col++)
+		packstr(arch->col_names[col], buffer);
+	pack32((uint32_t)arch->start_col, buffer);
+	pack32((uint32_t)arch->end_col, buffer);
+	pack32((uint32_t)arch->id_col, buffer);
+	pack32(arch->row_cnt, buffer);
+	pack32(arch->block_cnt, buffer);
+	packmem(get_buf_data(arch->blocks), get_buf_offset(arch->blocks),
+		buffer);
+}
+
+extern bool archive_cols_packed(Buf buffer)
+{
+	uint32_t magic = 0, offset = get_buf_offset(buffer);
+
+	if (unpack32(&magic, buffer) != SLURM_SUCCESS)
+		return false;
+	set_buf_offset(buffer, offset);
+
+	return (magic == ARCHIVE_COLS_MAGIC);
+}
+
+extern int archive_cols_unpack(archive_cols_t **arch_pptr, Buf buffer)
+{
+	archive_cols_t *arch = xmalloc(sizeof(archive_cols_t));
+	archive_block_t *block;
+	uint32_t block_cnt, tmp32, i, j, end, rows = 0;
+
+	*arch_pptr = arch;
+	arch->buffer = buffer;
+	arch->start_col = arch->end_col = arch->id_col = -1;
+
+	safe_unpack32(&tmp32, buffer);
+	if (tmp32 != ARCHIVE_COLS_MAGIC)
+		goto unpack_error;
+	safe_unpack32(&tmp32, buffer);
+	if (tmp32 > remaining_buf(buffer))
+		goto unpack_error;
+	arch->col_names = xmalloc(sizeof(char *) * tmp32);
+	for (i = 0; i < tmp32; i++) {
+		safe_unpackstr_xmalloc(&arch->col_names[i], &j, buffer);
+		arch->col_cnt++;
+	}
+	safe_unpack32(&tmp32, buffer);
+	arch->start_col = (int32_t)tmp32;
+	safe_unpack32(&tmp32, buffer);
+	arch->end_col = (int32_t)tmp32;
+	safe_unpack32(&tmp32, buffer);
+	arch->id_col = (int32_t)tmp32;
+	safe_unpack32(&arch->row_cnt, buffer);
+	safe_unpack32(&block_cnt, buffer);
+	if (block_cnt > remaining_buf(buffer))
+		goto unpack_error;
+	arch->block = xmalloc(sizeof(archive_block_t) * block_cnt);
+
+	/* Size of all the blocks */
+	safe_unpack32(&end, buffer);
+	if (end > remaining_buf(buffer))
+		goto unpack_error;
+	end += get_buf_offset(buffer);
+
+	for (i = 0; i < block_cnt; i++) {
+		block = &arch->block[i];
+		arch->block_cnt++;
+		safe_unpack32(&block->row_cnt, buffer);
+		safe_unpack_time(&block->min_start, buffer);
+		safe_unpack_time(&block->max_end, buffer);
+		safe_unpack32(&block->id_cnt, buffer);
+		if (block->id_cnt > block->row_cnt)
+			goto unpack_error;
+		block->ids = xmalloc(sizeof(char *) * block->id_cnt);
+		for (j = 0; j < block->id_cnt; j++) {
+			safe_unpackmem_ptr(&block->ids[j], &tmp32, buffer);
+			if (!block->ids[j])
+				block->ids[j] = "";
+		}
+		safe_unpack32(&block->data_size, buffer);
+		block->data_offset = get_buf_offset(buffer);
+		if (block->data_size > (end - block->data_offset))
+			goto unpack_error;
+		set_buf_offset(buffer, block->data_offset + block->data_size);
+		rows += block->row_cnt;
+	}
+	if ((rows != arch->row_cnt) || (get_buf_offset(buffer) != end))
+		goto unpack_error;
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	archive_cols_destroy(arch);
+	*arch_pptr = NULL;
+	return SLURM_ERROR;
+}
+
+extern int archive_cols_find_col(archive_cols_t *arch, char *name)
+{
+	int col;
+
+	for (col = 0; col < arch->col_cnt; col++) {
+		if (!xstrcmp(arch->col_names[col], name))
+			return col;
+	}
+
+	return -1;
+}
+
+extern uint32_t archive_cols_row_cnt(archive_cols_t *arch)
+{
+	return arch->row_cnt;
+}
+
+extern int archive_cols_for_each(archive_cols_t *arch, time_t start,
+				 time_t end, List id_list,
+				 archive_cols_row_f row_func, void *arg)
+{
+	archive_block_t *block;
+	char ***vals, **nums, **row;
+	uint32_t i, r;
+	int col, rc = SLURM_SUCCESS;
+
+	vals = xmalloc(sizeof(char **) * arch->col_cnt);
+	nums = xmalloc(sizeof(char *) * arch->col_cnt);
+	row = xmalloc(sizeof(char *) * arch->col_cnt);
+
+	for (i = 0; (rc == SLURM_SUCCESS) && (i < arch->block_cnt); i++) {
+		block = &arch->block[i];
+		if (!_block_match(block, start, end, id_list))
+			continue;
+
+		set_buf_offset(arch->buffer, block->data_offset);
+		for (col = 0; col < arch->col_cnt; col++) {
+			xrealloc(vals[col], sizeof(char *) * block->row_cnt);
+			if (_decode_col(arch->buffer, block->row_cnt,
+					vals[col], &nums[col]) !=
+			    SLURM_SUCCESS) {
+				error("%s: block %u of the archive is corrupt",
+				      __func__, i);
+				rc = SLURM_ERROR;
+				break;
+			}
+		}
+		for (r = 0; (rc == SLURM_SUCCESS) && (r < block->row_cnt);
+		     r++) {
+			for (col = 0; col < arch->col_cnt; col++)
+				row[col] = vals[col][r];
+			rc = (*row_func)(row, arg);
+		}
+		for (col = 0; col < arch->col_cnt; col++)
+			xfree(nums[col]);
+	}
+
+	for (col = 0; col < arch->col_cnt; col++)
+		xfree(vals[col]);
+	xfree(vals);
+	xfree(nums);
+	xfree(row);
+
+	return rc;
+}
+
+extern void archive_cols_destroy(archive_cols_t *arch)
+{
+	uint32_t i;
+	int col;
+
+	if (!arch)
+		return;
+
+	for (i = 0; arch->block && (i < arch->block_cnt); i++)
+		xfree(arch->block[i].ids);
+	xfree(arch->block);
+	FREE_NULL_BUFFER(arch->blocks);
+	for (col = 0; col < arch->col_cnt; col++) {
+		xfree(arch->col_names[col]);
+		if (arch->pending) {
+			for (i = 0; i < arch->pending_cnt; i++)
+				xfree(arch->pending[col][i]);
+			xfree(arch->pending[col]);
+		}
+	}
+	xfree(arch->col_names);
+	xfree(arch->pending);
+	xfree(arch);
+}
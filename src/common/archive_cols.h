@@ -0,0 +1,117 @@
+/*****************************************************************************\
+ *  archive_cols.h - columnar blocks of archived database records.
+ *****************************************************************************
+ *
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_ARCHIVE_COLS_H
+#define _HAVE_ARCHIVE_COLS_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "src/common/list.h"
+#include "src/common/pack.h"
+
+/* Rows written to a block before it is encoded */
+#define ARCHIVE_COLS_BLOCK_ROWS 4096
+
+/* Packed first by archive_cols_pack().  Older archive files pack their
+ * records one after the other, starting with a string length that can
+ * never be this large. */
+#define ARCHIVE_COLS_MAGIC 0xA5C01A4C
+
+typedef struct archive_cols archive_cols_t;
+
+/*
+ * Function called for every row of the blocks matched by
+ * archive_cols_for_each().  row holds one string per column, they are only
+ * valid during the call.
+ * RET SLURM_SUCCESS or an error code to stop the scan with
+ */
+typedef int (*archive_cols_row_f)(char **row, void *arg);
+
+/*
+ * Create a writer for rows of the col_cnt string columns named col_names.
+ * Rows are stored in blocks, each column of a block on its own as unsigned
+ * deltas, a dictionary of its values or plain strings, whichever fits the
+ * values.  For every block the lowest time in column start_col, the highest
+ * time in column end_col and the values of column id_col are kept so
+ * readers can skip the blocks that cannot match.
+ * Backquotes around column names are dropped.
+ */
+extern archive_cols_t *archive_cols_create(char **col_names, int col_cnt,
+					   int start_col, int end_col,
+					   int id_col);
+
+/* Add a row of col_cnt strings, NULL values are stored as "" */
+extern void archive_cols_add_row(archive_cols_t *arch, char **row);
+
+/* Pack all the rows added to arch */
+extern void archive_cols_pack(archive_cols_t *arch, Buf buffer);
+
+/* True if buffer is at the start of rows packed by archive_cols_pack(),
+ * the buffer offset is left unchanged */
+extern bool archive_cols_packed(Buf buffer);
+
+/*
+ * Unpack the column names and block index packed by archive_cols_pack().
+ * The blocks themselves are only decoded by archive_cols_for_each(), so
+ * buffer must be kept until arch is destroyed.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int archive_cols_unpack(archive_cols_t **arch, Buf buffer);
+
+/* RET the index of the column named name or -1 if there is none */
+extern int archive_cols_find_col(archive_cols_t *arch, char *name);
+
+/* RET the number of rows in arch */
+extern uint32_t archive_cols_row_cnt(archive_cols_t *arch);
+
+/*
+ * Call row_func for every row of the blocks of an unpacked arch that may
+ * hold rows with a start_col time before end and an end_col time after
+ * start, and with an id_col value in id_list (char *'s).  start, end or
+ * id_list of 0 or NULL match any row.  The rows of a matching block are
+ * not checked themselves.
+ * RET SLURM_SUCCESS, SLURM_ERROR if a block is corrupt or the first error
+ *     returned by row_func
+ */
+extern int archive_cols_for_each(archive_cols_t *arch, time_t start,
+				 time_t end, List id_list,
+				 archive_cols_row_f row_func, void *arg);
+
+extern void archive_cols_destroy(archive_cols_t *arch);
+
+#endif
@@ -4285,6 +4285,17 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update, bool locked)
 				break;
 			}
 
+			if (object->description) {
+				/* If we have a blank string that
+				 * means it is cleared.
+				 */
+				xfree(rec->description);
+				if (object->description[0]) {
+					rec->description = object->description;
+					object->description = NULL;
+				}
+			}
+
 			if (!(object->flags & QOS_FLAG_NOTSET)) {
 				if (object->flags & QOS_FLAG_ADD) {
 					rec->flags |= object->flags;
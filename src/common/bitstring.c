@@ -41,6 +41,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -153,6 +154,534 @@ strong_alias(bit_nffs,		slurm_bit_nffs);
 strong_alias(bit_copybits,	slurm_bit_copybits);
 strong_alias(bit_get_bit_num,	slurm_bit_get_bit_num);
 strong_alias(bit_get_pos_num,	slurm_bit_get_pos_num);
+strong_alias(bit_and_into,	slurm_bit_and_into);
+strong_alias(bit_and_not_into,	slurm_bit_and_not_into);
+strong_alias(bit_and_not_count,	slurm_bit_and_not_count);
+strong_alias(bit_scratch_alloc,	slurm_bit_scratch_alloc);
+strong_alias(bit_scratch_free,	slurm_bit_scratch_free);
+
+#ifdef HAVE___BUILTIN_POPCOUNTLL
+#define hweight __builtin_popcountll
+#else
+/*
+ * Returns the hamming weight (i.e. the number of bits set) in a word.
+ * NOTE: This routine borrowed from Linux 4.9 <tools/lib/hweight.c>.
+ */
+static uint64_t
+hweight(uint64_t w)
+{
+        w -= (w >> 1) & 0x5555555555555555ul;
+        w =  (w & 0x3333333333333333ul) + ((w >> 2) & 0x3333333333333333ul);
+        w =  (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0ful;
+        return (w * 0x0101010101010101ul) >> 56;
+}
+#endif
+
+/*
+ * Word kernels
+ *
+ * The loops over whole bitmaps are done by the kernels below, which work
+ * on the words following the bitstring header. Each has a portable version
+ * and, on x86_64, an SSE4.2 (with popcnt) and an AVX2 version. The versions
+ * used are picked when the library is loaded, from the features of the CPU.
+ */
+typedef struct {
+	int64_t (*count)(const bitstr_t *w, int64_t n);
+	int64_t (*count_and)(const bitstr_t *w1, const bitstr_t *w2,
+			     int64_t n);
+	int64_t (*count_and_not)(const bitstr_t *w1, const bitstr_t *w2,
+				 int64_t n);
+	/* d may be w1 or w2 */
+	void (*and)(bitstr_t *d, const bitstr_t *w1, const bitstr_t *w2,
+		    int64_t n);
+	void (*and_not)(bitstr_t *d, const bitstr_t *w1, const bitstr_t *w2,
+			int64_t n);
+	void (*or)(bitstr_t *d, const bitstr_t *w1, const bitstr_t *w2,
+		   int64_t n);
+	void (*not)(bitstr_t *w, int64_t n);
+	int (*subset)(const bitstr_t *w1, const bitstr_t *w2, int64_t n);
+	/* index of the first word from i that is not skip, n if none */
+	int64_t (*find)(const bitstr_t *w, int64_t i, int64_t n,
+			bitstr_t skip);
+} bit_kernels_t;
+
+static int64_t _count_word(const bitstr_t *w, int64_t n)
+{
+	int64_t i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += hweight(w[i]);
+	return count;
+}
+
+static int64_t _count_and_word(const bitstr_t *w1, const bitstr_t *w2,
+			       int64_t n)
+{
+	int64_t i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += hweight(w1[i] & w2[i]);
+	return count;
+}
+
+static int64_t _count_and_not_word(const bitstr_t *w1, const bitstr_t *w2,
+				   int64_t n)
+{
+	int64_t i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += hweight(w1[i] & ~w2[i]);
+	return count;
+}
+
+static void _and_word(bitstr_t *d, const bitstr_t *w1, const bitstr_t *w2,
+		      int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] = w1[i] & w2[i];
+}
+
+static void _and_not_word(bitstr_t *d, const bitstr_t *w1,
+			  const bitstr_t *w2, int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] = w1[i] & ~w2[i];
+}
+
+static void _or_word(bitstr_t *d, const bitstr_t *w1, const bitstr_t *w2,
+		     int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] = w1[i] | w2[i];
+}
+
+static void _not_word(bitstr_t *w, int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; i < n; i++)
+		w[i] = ~w[i];
+}
+
+static int _subset_word(const bitstr_t *w1, const bitstr_t *w2, int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; i < n; i++) {
+		if (w1[i] & ~w2[i])
+			return 0;
+	}
+	return 1;
+}
+
+static int64_t _find_word(const bitstr_t *w, int64_t i, int64_t n,
+			  bitstr_t skip)
+{
+	while ((i < n) && (w[i] == skip))
+		i++;
+	return i;
+}
+
+static const bit_kernels_t bit_kernels_word = {
+	_count_word, _count_and_word, _count_and_not_word, _and_word,
+	_and_not_word, _or_word, _not_word, _subset_word, _find_word
+};
+
+static const bit_kernels_t *bit_kernels = &bit_kernels_word;
+
+#if defined(__x86_64__) && \
+    (defined(__clang__) || (__GNUC__ > 4) || \
+     ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+
+#define BIT_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define BIT_AVX2 __attribute__((target("avx2,popcnt")))
+
+BIT_SSE42 static int64_t _count_sse42(const bitstr_t *w, int64_t n)
+{
+	int64_t i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += _mm_popcnt_u64(w[i]);
+	return count;
+}
+
+BIT_SSE42 static int64_t _count_and_sse42(const bitstr_t *w1,
+					  const bitstr_t *w2, int64_t n)
+{
+	int64_t i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += _mm_popcnt_u64(w1[i] & w2[i]);
+	return count;
+}
+
+BIT_SSE42 static int64_t _count_and_not_sse42(const bitstr_t *w1,
+					      const bitstr_t *w2, int64_t n)
+{
+	int64_t i, count = 0;
+
+	for (i = 0; i < n; i++)
+		count += _mm_popcnt_u64(w1[i] & ~w2[i]);
+	return count;
+}
+
+#define _SSE42_OP(name, op, word_op)					\
+BIT_SSE42 static void name(bitstr_t *d, const bitstr_t *w1,		\
+			   const bitstr_t *w2, int64_t n)		\
+{									\
+	int64_t i;							\
+	__m128i a, b;							\
+									\
+	for (i = 0; (i + 2) <= n; i += 2) {				\
+		a = _mm_loadu_si128((__m128i *)(w1 + i));		\
+		b = _mm_loadu_si128((__m128i *)(w2 + i));		\
+		_mm_storeu_si128((__m128i *)(d + i), op);		\
+	}								\
+	for ( ; i < n; i++)						\
+		d[i] = w1[i] word_op w2[i];				\
+}
+
+_SSE42_OP(_and_sse42, _mm_and_si128(a, b), &)
+_SSE42_OP(_and_not_sse42, _mm_andnot_si128(b, a), & ~)
+_SSE42_OP(_or_sse42, _mm_or_si128(a, b), |)
+
+BIT_SSE42 static void _not_sse42(bitstr_t *w, int64_t n)
+{
+	int64_t i;
+	__m128i ones = _mm_set1_epi64x(-1), v;
+
+	for (i = 0; (i + 2) <= n; i += 2) {
+		v = _mm_loadu_si128((__m128i *)(w + i));
+		_mm_storeu_si128((__m128i *)(w + i), _mm_xor_si128(v, ones));
+	}
+	for ( ; i < n; i++)
+		w[i] = ~w[i];
+}
+
+BIT_SSE42 static int _subset_sse42(const bitstr_t *w1, const bitstr_t *w2,
+				   int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; (i + 2) <= n; i += 2) {
+		/* testc: (~w2 & w1) == 0 */
+		if (!_mm_testc_si128(_mm_loadu_si128((__m128i *)(w2 + i)),
+				     _mm_loadu_si128((__m128i *)(w1 + i))))
+			return 0;
+	}
+	for ( ; i < n; i++) {
+		if (w1[i] & ~w2[i])
+			return 0;
+	}
+	return 1;
+}
+
+BIT_SSE42 static int64_t _find_sse42(const bitstr_t *w, int64_t i, int64_t n,
+				     bitstr_t skip)
+{
+	__m128i s = _mm_set1_epi64x(skip);
+	int mask;
+
+	for ( ; (i + 2) <= n; i += 2) {
+		mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(
+			_mm_loadu_si128((__m128i *)(w + i)), s)));
+		if (mask != 0x3)
+			return i + ((mask & 1) ? 1 : 0);
+	}
+	return _find_word(w, i, n, skip);
+}
+
+/*
+ * Population count of 32 bytes at a time, with a nibble lookup table
+ * (W. Mula, "Faster population counts using AVX2 instructions").
+ */
+BIT_AVX2 static inline __m256i _count_avx2_vec(__m256i v)
+{
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	__m256i lo, hi;
+
+	lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low));
+	hi = _mm256_shuffle_epi8(lookup,
+				 _mm256_and_si256(_mm256_srli_epi16(v, 4),
+						  low));
+	return _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+			       _mm256_setzero_si256());
+}
+
+BIT_AVX2 static int64_t _count_avx2_sum(__m256i acc)
+{
+	return _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) +
+	       _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+}
+
+BIT_AVX2 static int64_t _count_avx2(const bitstr_t *w, int64_t n)
+{
+	int64_t i, count;
+	__m256i acc = _mm256_setzero_si256();
+
+	for (i = 0; (i + 4) <= n; i += 4) {
+		acc = _mm256_add_epi64(acc, _count_avx2_vec(
+			_mm256_loadu_si256((__m256i *)(w + i))));
+	}
+	count = _count_avx2_sum(acc);
+	for ( ; i < n; i++)
+		count += _mm_popcnt_u64(w[i]);
+	return count;
+}
+
+BIT_AVX2 static int64_t _count_and_avx2(const bitstr_t *w1,
+					const bitstr_t *w2, int64_t n)
+{
+	int64_t i, count;
+	__m256i acc = _mm256_setzero_si256();
+
+	for (i = 0; (i + 4) <= n; i += 4) {
+		acc = _mm256_add_epi64(acc, _count_avx2_vec(_mm256_and_si256(
+			_mm256_loadu_si256((__m256i *)(w1 + i)),
+			_mm256_loadu_si256((__m256i *)(w2 + i)))));
+	}
+	count = _count_avx2_sum(acc);
+	for ( ; i < n; i++)
+		count += _mm_popcnt_u64(w1[i] & w2[i]);
+	return count;
+}
+
+BIT_AVX2 static int64_t _count_and_not_avx2(const bitstr_t *w1,
+					    const bitstr_t *w2, int64_t n)
+{
+	int64_t i, count;
+	__m256i acc = _mm256_setzero_si256();
+
+	for (i = 0; (i + 4) <= n; i += 4) {
+		acc = _mm256_add_epi64(acc, _count_avx2_vec(_mm256_andnot_si256(
+			_mm256_loadu_si256((__m256i *)(w2 + i)),
+			_mm256_loadu_si256((__m256i *)(w1 + i)))));
+	}
+	count = _count_avx2_sum(acc);
+	for ( ; i < n; i++)
+		count += _mm_popcnt_u64(w1[i] & ~w2[i]);
+	return count;
+}
+
+#define _AVX2_OP(name, op, word_op)					\
+BIT_AVX2 static void name(bitstr_t *d, const bitstr_t *w1,		\
+			  const bitstr_t *w2, int64_t n)		\
+{									\
+	int64_t i;							\
+	__m256i a, b;							\
+									\
+	for (i = 0; (i + 4) <= n; i += 4) {				\
+		a = _mm256_loadu_si256((__m256i *)(w1 + i));		\
+		b = _mm256_loadu_si256((__m256i *)(w2 + i));		\
+		_mm256_storeu_si256((__m256i *)(d + i), op);		\
+	}								\
+	for ( ; i < n; i++)						\
+		d[i] = w1[i] word_op w2[i];				\
+}
+
+_AVX2_OP(_and_avx2, _mm256_and_si256(a, b), &)
+_AVX2_OP(_and_not_avx2, _mm256_andnot_si256(b, a), & ~)
+_AVX2_OP(_or_avx2, _mm256_or_si256(a, b), |)
+
+BIT_AVX2 static void _not_avx2(bitstr_t *w, int64_t n)
+{
+	int64_t i;
+	__m256i ones = _mm256_set1_epi64x(-1), v;
+
+	for (i = 0; (i + 4) <= n; i += 4) {
+		v = _mm256_loadu_si256((__m256i *)(w + i));
+		_mm256_storeu_si256((__m256i *)(w + i),
+				    _mm256_xor_si256(v, ones));
+	}
+	for ( ; i < n; i++)
+		w[i] = ~w[i];
+}
+
+BIT_AVX2 static int _subset_avx2(const bitstr_t *w1, const bitstr_t *w2,
+				 int64_t n)
+{
+	int64_t i;
+
+	for (i = 0; (i + 4) <= n; i += 4) {
+		/* testc: (~w2 & w1) == 0 */
+		if (!_mm256_testc_si256(
+			    _mm256_loadu_si256((__m256i *)(w2 + i)),
+			    _mm256_loadu_si256((__m256i *)(w1 + i))))
+			return 0;
+	}
+	for ( ; i < n; i++) {
+		if (w1[i] & ~w2[i])
+			return 0;
+	}
+	return 1;
+}
+
+BIT_AVX2 static int64_t _find_avx2(const bitstr_t *w, int64_t i, int64_t n,
+				   bitstr_t skip)
+{
+	__m256i s = _mm256_set1_epi64x(skip);
+	int mask;
+
+	for ( ; (i + 4) <= n; i += 4) {
+		mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+			_mm256_cmpeq_epi64(
+				_mm256_loadu_si256((__m256i *)(w + i)), s)));
+		if (mask != 0xf)
+			return i + __builtin_ctz(~mask);
+	}
+	return _find_word(w, i, n, skip);
+}
+
+static const bit_kernels_t bit_kernels_sse42 = {
+	_count_sse42, _count_and_sse42, _count_and_not_sse42, _and_sse42,
+	_and_not_sse42, _or_sse42, _not_sse42, _subset_sse42, _find_sse42
+};
+
+static const bit_kernels_t bit_kernels_avx2 = {
+	_count_avx2, _count_and_avx2, _count_and_not_avx2, _and_avx2,
+	_and_not_avx2, _or_avx2, _not_avx2, _subset_avx2, _find_avx2
+};
+
+static int _simd_supported(void)
+{
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("popcnt"))
+		return BIT_SIMD_NONE;
+	if (__builtin_cpu_supports("avx2"))
+		return BIT_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return BIT_SIMD_SSE42;
+	return BIT_SIMD_NONE;
+}
+
+__attribute__((constructor)) static void _bit_kernels_init(void)
+{
+	bit_simd_select(BIT_SIMD_AVX2);
+}
+#else
+static int _simd_supported(void)
+{
+	return BIT_SIMD_NONE;
+}
+#endif
+
+/*
+ * Select the word kernels, mostly for tests and benchmarks. The best ones
+ * supported by the CPU are selected when the library is loaded.
+ *   level (IN)		highest BIT_SIMD_* level to use
+ *   RETURN		level now in use
+ */
+int
+bit_simd_select(int level)
+{
+	level = MIN(level, _simd_supported());
+	switch (level) {
+#ifdef BIT_AVX2
+	case BIT_SIMD_AVX2:
+		bit_kernels = &bit_kernels_avx2;
+		break;
+	case BIT_SIMD_SSE42:
+		bit_kernels = &bit_kernels_sse42;
+		break;
+#endif
+	default:
+		level = BIT_SIMD_NONE;
+		bit_kernels = &bit_kernels_word;
+		break;
+	}
+
+	return level;
+}
+
+/* words holding the bits of b, excluding the header */
+#define _bit_words(b)	(_bitstr_words(_bitstr_bits(b)) - BITSTR_OVERHEAD)
+
+/* mask of the bits at positions start and above within a word */
+#ifdef SLURM_BIGENDIAN
+#define _bit_mask_from(start) \
+	((bitstr_t)(BITSTR_MAXVAL >> ((start)&BITSTR_MAXPOS)))
+#else
+#define _bit_mask_from(start) \
+	((bitstr_t)(BITSTR_MAXVAL << ((start)&BITSTR_MAXPOS)))
+#endif
+
+/* position of the first set bit of a non-zero word */
+static inline int _word_ffs(bitstr_t w)
+{
+#if defined(SLURM_BIGENDIAN) && HAVE___BUILTIN_CLZLL
+	return __builtin_clzll(w);
+#elif !defined(SLURM_BIGENDIAN) && HAVE___BUILTIN_CTZLL
+	return __builtin_ctzll(w);
+#else
+	int bit;
+
+	for (bit = 0; !(w & _bit_mask(bit)); bit++)
+		;
+	return bit;
+#endif
+}
+
+/*
+ * Find the first bit set (or clear if set is 0) in b at or after start.
+ *   RETURN	its position, or the size of b if there is none
+ */
+static bitoff_t _bit_find_from(bitstr_t *b, bitoff_t start, int set)
+{
+	const bitstr_t *words = b + BITSTR_OVERHEAD;
+	bitoff_t nbits = _bitstr_bits(b), pos;
+	int64_t i = start >> BITSTR_SHIFT, n = _bit_words(b);
+	bitstr_t w;
+
+	if (start >= nbits)
+		return nbits;
+
+	w = (set ? words[i] : ~words[i]) & _bit_mask_from(start);
+	if (!w) {
+		i = bit_kernels->find(words, i + 1, n, set ? 0 : BITSTR_MAXVAL);
+		if (i >= n)
+			return nbits;
+		w = set ? words[i] : ~words[i];
+	}
+	pos = (i << BITSTR_SHIFT) + _word_ffs(w);
+
+	return MIN(pos, nbits);
+}
+
+/*
+ * Find the first n contiguous bits set (or clear if set is 0) in b.
+ *   RETURN	position of the first bit in the range, -1 if none
+ */
+static bitoff_t _bit_find_run(bitstr_t *b, int32_t n, int set)
+{
+	bitoff_t nbits = _bitstr_bits(b), start, end = 0;
+
+	while (end < nbits) {
+		start = _bit_find_from(b, end, set);
+		if ((nbits - start) < n)
+			break;
+		end = _bit_find_from(b, start, !set);
+		if ((end - start) >= n)
+			return start;
+	}
+
+	return -1;
+}
+
+/* bits in the last, partial word of b (0 if there is none) */
+#define _bit_tail(b)	(_bitstr_bits(b) & BITSTR_MAXPOS)
+
+/* mask of the valid bits in the last, partial word of b */
+#define _bit_tail_mask(b)	(~_bit_mask_from(_bit_tail(b)))
 
 /*
  * Allocate a bitstring.
@@ -204,6 +733,98 @@ bit_free(bitstr_t *b)
 	xfree(b);
 }
 
+/*
+ * Scratch bitmaps: each thread keeps a few released bitmaps for reuse, so
+ * that code testing many candidates does not allocate and free a bitmap
+ * for each test.
+ */
+#define BIT_SCRATCH_CNT	4
+
+typedef struct {
+	bitstr_t *bits[BIT_SCRATCH_CNT];
+} bit_scratch_t;
+
+static pthread_key_t bit_scratch_key;
+static pthread_once_t bit_scratch_once = PTHREAD_ONCE_INIT;
+
+static void _bit_scratch_destroy(void *arg)
+{
+	bit_scratch_t *scratch = (bit_scratch_t *) arg;
+	int i;
+
+	for (i = 0; i < BIT_SCRATCH_CNT; i++)
+		FREE_NULL_BITMAP(scratch->bits[i]);
+	xfree(scratch);
+}
+
+static void _bit_scratch_init(void)
+{
+	if (pthread_key_create(&bit_scratch_key, _bit_scratch_destroy))
+		fatal("%s: pthread_key_create: %m", __func__);
+}
+
+static bit_scratch_t *_bit_scratch(void)
+{
+	bit_scratch_t *scratch;
+
+	pthread_once(&bit_scratch_once, _bit_scratch_init);
+	scratch = pthread_getspecific(bit_scratch_key);
+	if (!scratch) {
+		scratch = xmalloc(sizeof(bit_scratch_t));
+		pthread_setspecific(bit_scratch_key, scratch);
+	}
+	return scratch;
+}
+
+/*
+ * Get a bitstring for temporary use, reusing one released by this thread
+ * if possible. Its bits are NOT cleared, set them all with bit_copybits(),
+ * bit_and_into() or bit_nclear() before use.
+ *   nbits (IN)		valid bits in the bitstring
+ *   RETURN		bitstring, release it with bit_scratch_free()
+ */
+bitstr_t *
+bit_scratch_alloc(bitoff_t nbits)
+{
+	bit_scratch_t *scratch = _bit_scratch();
+	bitstr_t *b;
+	int i;
+
+	for (i = 0; i < BIT_SCRATCH_CNT; i++) {
+		b = scratch->bits[i];
+		if (b && (_bitstr_bits(b) == nbits)) {
+			scratch->bits[i] = NULL;
+			return b;
+		}
+	}
+	return bit_alloc(nbits);
+}
+
+/*
+ * Release a bitstring from bit_scratch_alloc() or bit_alloc(), keeping it
+ * for reuse by this thread.
+ */
+void
+bit_scratch_free(bitstr_t *b)
+{
+	bit_scratch_t *scratch = _bit_scratch();
+	int i;
+
+	_assert_bitstr_valid(b);
+
+	for (i = 0; i < BIT_SCRATCH_CNT; i++) {
+		if (!scratch->bits[i]) {
+			scratch->bits[i] = b;
+			return;
+		}
+	}
+	/* keep the most recent, likely of the size now in use */
+	bit_free(scratch->bits[0]);
+	memmove(scratch->bits, scratch->bits + 1,
+		sizeof(bitstr_t *) * (BIT_SCRATCH_CNT - 1));
+	scratch->bits[BIT_SCRATCH_CNT - 1] = b;
+}
+
 /*
  * Return the number of possible bits in a bitstring.
  *   b (IN)		bitstring to check
@@ -331,26 +952,12 @@ bit_clear_all(bitstr_t *b)
 bitoff_t
 bit_ffc(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
+	bitoff_t bit;
 
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int32_t word = _bit_word(bit);
-
-		if (b[word] == BITSTR_MAXVAL) {
-			bit += sizeof(bitstr_t)*8;
-			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (!bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
-	}
-	return value;
+	bit = _bit_find_from(b, 0, 0);
+	return (bit < _bitstr_bits(b)) ? bit : -1;
 }
 
 /* Find the first n contiguous bits clear in b.
@@ -361,26 +968,10 @@ bit_ffc(bitstr_t *b)
 bitoff_t
 bit_nffc(bitstr_t *b, int32_t n)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int32_t cnt = 0;
-
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n < _bitstr_bits(b));
 
-	for (bit = 0; bit < _bitstr_bits(b); bit++) {
-		if (bit_test(b, bit)) {		/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				break;
-			}
-		}
-	}
-
-	return value;
+	return _bit_find_run(b, n, 0);
 }
 
 /* Find n contiguous bits clear in b starting at some offset.
@@ -440,26 +1031,10 @@ bit_noc(bitstr_t *b, int32_t n, int32_t seed)
 bitoff_t
 bit_nffs(bitstr_t *b, int32_t n)
 {
-	bitoff_t value = -1;
-	bitoff_t bit;
-	int32_t cnt = 0;
-
 	_assert_bitstr_valid(b);
 	assert(n > 0 && n <= _bitstr_bits(b));
 
-	for (bit = 0; bit <= _bitstr_bits(b) - n; bit++) {
-		if (!bit_test(b, bit)) {	/* fail */
-			cnt = 0;
-		} else {
-			cnt++;
-			if (cnt >= n) {
-				value = bit - (cnt - 1);
-				break;
-			}
-		}
-	}
-
-	return value;
+	return _bit_find_run(b, n, 1);
 }
 
 /*
@@ -470,30 +1045,12 @@ bit_nffs(bitstr_t *b, int32_t n)
 bitoff_t
 bit_ffs(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
+	bitoff_t bit;
 
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int32_t word = _bit_word(bit);
-
-		if (b[word] == 0) {
-			bit += sizeof(bitstr_t)*8;
-			continue;
-		}
-#if HAVE___BUILTIN_CTZLL
-		value = bit + __builtin_ctzll(b[word]);
-#else
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
-#endif
-	}
-	return value;
+	bit = _bit_find_from(b, 0, 1);
+	return (bit < _bitstr_bits(b)) ? bit : -1;
 }
 
 /*
@@ -570,17 +1127,20 @@ bit_fill_gaps(bitstr_t *b)
 int
 bit_super_set(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	int64_t words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != (b1[_bit_word(bit)] &
-		                           b2[_bit_word(bit)]))
-			return 0;
-	}
+	words = _bitstr_bits(b1) >> BITSTR_SHIFT;
+	if (!bit_kernels->subset(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD,
+				 words))
+		return 0;
+	if (_bit_tail(b1) && (b1[BITSTR_OVERHEAD + words] &
+			      ~b2[BITSTR_OVERHEAD + words] &
+			      _bit_tail_mask(b1)))
+		return 0;
 
 	return 1;
 }
@@ -617,14 +1177,12 @@ bit_equal(bitstr_t *b1, bitstr_t *b2)
 void
 bit_and(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
-
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= b2[_bit_word(bit)];
+	bit_kernels->and(b1 + BITSTR_OVERHEAD, b1 + BITSTR_OVERHEAD,
+			 b2 + BITSTR_OVERHEAD, _bit_words(b1));
 }
 
 /*
@@ -634,14 +1192,12 @@ bit_and(bitstr_t *b1, bitstr_t *b2)
  */
 void bit_and_not(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
-
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= ~b2[_bit_word(bit)];
+	bit_kernels->and_not(b1 + BITSTR_OVERHEAD, b1 + BITSTR_OVERHEAD,
+			     b2 + BITSTR_OVERHEAD, _bit_words(b1));
 }
 
 /*
@@ -651,12 +1207,9 @@ void bit_and_not(bitstr_t *b1, bitstr_t *b2)
 void
 bit_not(bitstr_t *b)
 {
-	bitoff_t bit;
-
 	_assert_bitstr_valid(b);
 
-	for (bit = 0; bit < _bitstr_bits(b); bit += sizeof(bitstr_t)*8)
-		b[_bit_word(bit)] = ~b[_bit_word(bit)];
+	bit_kernels->not(b + BITSTR_OVERHEAD, _bit_words(b));
 }
 
 /*
@@ -667,14 +1220,50 @@ bit_not(bitstr_t *b)
 void
 bit_or(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	bit_kernels->or(b1 + BITSTR_OVERHEAD, b1 + BITSTR_OVERHEAD,
+			b2 + BITSTR_OVERHEAD, _bit_words(b1));
+}
+
+/*
+ * dst = b1 & b2, in one pass and without allocating a bitstring
+ *   dst (OUT)		bitmap to set, may be b1 or b2
+ *   b1 (IN)		first bitmap
+ *   b2 (IN)		second bitmap
+ */
+void
+bit_and_into(bitstr_t *dst, bitstr_t *b1, bitstr_t *b2)
+{
+	_assert_bitstr_valid(dst);
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(dst) == _bitstr_bits(b1));
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
+	bit_kernels->and(dst + BITSTR_OVERHEAD, b1 + BITSTR_OVERHEAD,
+			 b2 + BITSTR_OVERHEAD, _bit_words(b1));
+}
+
+/*
+ * dst = b1 & ~b2, in one pass and without allocating a bitstring
+ *   dst (OUT)		bitmap to set, may be b1 or b2
+ *   b1 (IN)		first bitmap
+ *   b2 (IN)		second bitmap
+ */
+void
+bit_and_not_into(bitstr_t *dst, bitstr_t *b1, bitstr_t *b2)
+{
+	_assert_bitstr_valid(dst);
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(dst) == _bitstr_bits(b1));
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] |= b2[_bit_word(bit)];
+	bit_kernels->and_not(dst + BITSTR_OVERHEAD, b1 + BITSTR_OVERHEAD,
+			     b2 + BITSTR_OVERHEAD, _bit_words(b1));
 }
 
 
@@ -713,23 +1302,6 @@ bit_copybits(bitstr_t *dest, bitstr_t *src)
 	memcpy(&dest[BITSTR_OVERHEAD], &src[BITSTR_OVERHEAD], len);
 }
 
-#ifdef HAVE___BUILTIN_POPCOUNTLL
-#define hweight __builtin_popcountll
-#else
-/*
- * Returns the hamming weight (i.e. the number of bits set) in a word.
- * NOTE: This routine borrowed from Linux 4.9 <tools/lib/hweight.c>.
- */
-static uint64_t
-hweight(uint64_t w)
-{
-        w -= (w >> 1) & 0x5555555555555555ul;
-        w =  (w & 0x3333333333333333ul) + ((w >> 2) & 0x3333333333333333ul);
-        w =  (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0ful;
-        return (w * 0x0101010101010101ul) >> 56;
-}
-#endif
-
 /*
  * Count the number of bits set in bitstring.
  *   b (IN)		bitstring to check
@@ -738,19 +1310,16 @@ hweight(uint64_t w)
 int32_t
 bit_set_count(bitstr_t *b)
 {
-	int32_t count = 0;
-	bitoff_t bit, bit_cnt;
-	int32_t word_size = sizeof(bitstr_t) * 8;
+	int64_t words;
+	int32_t count;
 
 	_assert_bitstr_valid(b);
 
-	bit_cnt = _bitstr_bits(b);
-	for (bit = 0; (bit + word_size) <= bit_cnt; bit += word_size) {
-		count += hweight(b[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b, bit))
-			count++;
+	words = _bitstr_bits(b) >> BITSTR_SHIFT;
+	count = bit_kernels->count(b + BITSTR_OVERHEAD, words);
+	if (_bit_tail(b)) {
+		count += hweight(b[BITSTR_OVERHEAD + words] &
+				 _bit_tail_mask(b));
 	}
 	return count;
 }
@@ -795,25 +1364,46 @@ bit_set_count_range(bitstr_t *b, int32_t start, int32_t end)
 extern int32_t
 bit_overlap(bitstr_t *b1, bitstr_t *b2)
 {
-	int32_t count = 0;
-	bitoff_t bit, bit_cnt;
-	int32_t word_size = sizeof(bitstr_t) * 8;
+	int64_t words;
+	int32_t count;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	bit_cnt = _bitstr_bits(b1);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		count += hweight(b1[_bit_word(bit)] & b2[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b1, bit) && bit_test(b2, bit))
-			count++;
+	words = _bitstr_bits(b1) >> BITSTR_SHIFT;
+	count = bit_kernels->count_and(b1 + BITSTR_OVERHEAD,
+				       b2 + BITSTR_OVERHEAD, words);
+	if (_bit_tail(b1)) {
+		count += hweight(b1[BITSTR_OVERHEAD + words] &
+				 b2[BITSTR_OVERHEAD + words] &
+				 _bit_tail_mask(b1));
 	}
+	return count;
+}
+
+/*
+ * return number of bits set in b1 that are not set in b2, without
+ * modifying either
+ */
+extern int32_t
+bit_and_not_count(bitstr_t *b1, bitstr_t *b2)
+{
+	int64_t words;
+	int32_t count;
 
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	words = _bitstr_bits(b1) >> BITSTR_SHIFT;
+	count = bit_kernels->count_and_not(b1 + BITSTR_OVERHEAD,
+					   b2 + BITSTR_OVERHEAD, words);
+	if (_bit_tail(b1)) {
+		count += hweight(b1[BITSTR_OVERHEAD + words] &
+				 ~b2[BITSTR_OVERHEAD + words] &
+				 _bit_tail_mask(b1));
+	}
 	return count;
 }
 
@@ -91,6 +91,11 @@ typedef bitstr_t bitoff_t;
 /* max bit position in word */
 #define BITSTR_MAXPOS		(sizeof(bitstr_t)*8 - 1)
 
+/* word kernel levels, see bit_simd_select() */
+#define BIT_SIMD_NONE		0	/* portable code */
+#define BIT_SIMD_SSE42		1	/* x86_64 SSE4.2 and popcnt */
+#define BIT_SIMD_AVX2		2	/* x86_64 AVX2 and popcnt */
+
 /* compat with Vixie macros */
 bitstr_t *bit_alloc(bitoff_t nbits);
 int bit_test(bitstr_t *b, bitoff_t bit);
@@ -110,12 +115,16 @@ bitoff_t bit_nffs(bitstr_t *b, int32_t n);
 bitoff_t bit_nffc(bitstr_t *b, int32_t n);
 bitoff_t bit_noc(bitstr_t *b, int32_t n, int32_t seed);
 void	bit_free(bitstr_t *b);
+bitstr_t *bit_scratch_alloc(bitoff_t nbits);
+void	bit_scratch_free(bitstr_t *b);
 bitstr_t *bit_realloc(bitstr_t *b, bitoff_t nbits);
 bitoff_t bit_size(bitstr_t *b);
 void	bit_and(bitstr_t *b1, bitstr_t *b2);
 void	bit_and_not(bitstr_t *b1, bitstr_t *b2);
 void	bit_not(bitstr_t *b);
 void	bit_or(bitstr_t *b1, bitstr_t *b2);
+void	bit_and_into(bitstr_t *dst, bitstr_t *b1, bitstr_t *b2);
+void	bit_and_not_into(bitstr_t *dst, bitstr_t *b1, bitstr_t *b2);
 int32_t	bit_set_count(bitstr_t *b);
 int32_t	bit_set_count_range(bitstr_t *b, int32_t start, int32_t end);
 int32_t	bit_clear_count(bitstr_t *b);
@@ -139,12 +148,14 @@ bitoff_t bit_fls(bitstr_t *b);
 void	bit_fill_gaps(bitstr_t *b);
 int	bit_super_set(bitstr_t *b1, bitstr_t *b2);
 int     bit_overlap(bitstr_t *b1, bitstr_t *b2);
+int32_t	bit_and_not_count(bitstr_t *b1, bitstr_t *b2);
 int     bit_equal(bitstr_t *b1, bitstr_t *b2);
 void    bit_copybits(bitstr_t *dest, bitstr_t *src);
 bitstr_t *bit_copy(bitstr_t *b);
 bitstr_t *bit_pick_cnt(bitstr_t *b, bitoff_t nbits);
 bitoff_t bit_get_bit_num(bitstr_t *b, int32_t pos);
 int32_t	bit_get_pos_num(bitstr_t *b, bitoff_t pos);
+int	bit_simd_select(int level);
 
 #define FREE_NULL_BITMAP(_X)		\
 	do {				\
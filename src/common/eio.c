@@ -84,6 +84,8 @@ struct eio_handle_components {
 	pthread_mutex_t shutdown_mutex;
 	time_t shutdown_time;
 	uint16_t shutdown_wait;
+	int wakeup_msec;	/* poll timeout asked by callbacks, or -1 */
+	bool wait_wakeup;	/* keep polling until eio_signal_wakeup() */
 	List obj_list;
 	List new_objs;
 };
@@ -93,7 +95,7 @@ struct eio_handle_components {
  */
 
 static int          _poll_internal(struct pollfd *pfds, unsigned int nfds,
-				   time_t shutdown_time);
+				   int wakeup_msec, time_t shutdown_time);
 static unsigned int _poll_setup_pollfds(struct pollfd *, eio_obj_t **, List);
 static void         _poll_dispatch(struct pollfd *, unsigned int, eio_obj_t **,
 		                   List objList);
@@ -111,7 +113,9 @@ eio_handle_t *eio_handle_create(uint16_t shutdown_wait)
 		return (NULL);
 	}
 
+	/* A full pipe already holds a pending wakeup, do not block on it */
 	fd_set_nonblocking(eio->fds[0]);
+	fd_set_nonblocking(eio->fds[1]);
 	fd_set_close_on_exec(eio->fds[0]);
 	fd_set_close_on_exec(eio->fds[1]);
 
@@ -121,6 +125,7 @@ eio_handle_t *eio_handle_create(uint16_t shutdown_wait)
 	eio->new_objs = list_create(eio_obj_destroy);
 
 	slurm_mutex_init(&eio->shutdown_mutex);
+	eio->wakeup_msec = -1;
 	eio->shutdown_wait = DEFAULT_EIO_SHUTDOWN_WAIT;
 	if (shutdown_wait > 0)
 		eio->shutdown_wait = shutdown_wait;
@@ -234,15 +239,35 @@ int eio_signal_shutdown(eio_handle_t *eio)
 	slurm_mutex_lock(&eio->shutdown_mutex);
 	eio->shutdown_time = time(NULL);
 	slurm_mutex_unlock(&eio->shutdown_mutex);
-	if (eio && (write(eio->fds[1], &c, sizeof(char)) != 1))
+	if (eio && (write(eio->fds[1], &c, sizeof(char)) != 1) &&
+	    (errno != EAGAIN))
 		return error("eio_handle_signal_shutdown: write; %m");
 	return 0;
 }
 
+void eio_wakeup_after(eio_handle_t *eio, int msec)
+{
+	xassert(eio != NULL);
+	xassert(eio->magic == EIO_MAGIC);
+
+	if (msec < 0)
+		msec = 0;
+	if ((eio->wakeup_msec < 0) || (msec < eio->wakeup_msec))
+		eio->wakeup_msec = msec;
+}
+
+void eio_wait_for_wakeup(eio_handle_t *eio)
+{
+	xassert(eio != NULL);
+	xassert(eio->magic == EIO_MAGIC);
+
+	eio->wait_wakeup = true;
+}
+
 int eio_signal_wakeup(eio_handle_t *eio)
 {
 	char c = 0;
-	if (write(eio->fds[1], &c, sizeof(char)) != 1)
+	if ((write(eio->fds[1], &c, sizeof(char)) != 1) && (errno != EAGAIN))
 		return error("eio_handle_signal_wake: write; %m");
 	return 0;
 }
@@ -263,11 +288,19 @@ static int _eio_wakeup_handler(eio_handle_t *eio)
 {
 	char c = 0;
 	int rc = 0;
+	bool shutdown = false;
 
 	while ((rc = (read(eio->fds[0], &c, 1)) > 0)) {
 		if (c == 1)
-			_mark_shutdown_true(eio->obj_list);
+			shutdown = true;
 	}
+	/* The shutdown byte is not written when the pipe is already full */
+	slurm_mutex_lock(&eio->shutdown_mutex);
+	if (eio->shutdown_time)
+		shutdown = true;
+	slurm_mutex_unlock(&eio->shutdown_mutex);
+	if (shutdown)
+		_mark_shutdown_true(eio->obj_list);
 
 	/* move new eio objects from the new_objs to the obj_list */
 	list_transfer(eio->obj_list, eio->new_objs);
@@ -306,8 +339,11 @@ int eio_handle_mainloop(eio_handle_t *eio)
 
 		debug4("eio: handling events for %d objects",
 		       list_count(eio->obj_list));
+		eio->wakeup_msec = -1;
+		eio->wait_wakeup = false;
 		nfds = _poll_setup_pollfds(pollfds, map, eio->obj_list);
-		if (nfds <= 0)
+		/* An object holding data back still needs the loop to run */
+		if ((nfds <= 0) && (eio->wakeup_msec < 0) && !eio->wait_wakeup)
 			goto done;
 
 		/*
@@ -323,7 +359,8 @@ int eio_handle_mainloop(eio_handle_t *eio)
 		slurm_mutex_lock(&eio->shutdown_mutex);
 		shutdown_time = eio->shutdown_time;
 		slurm_mutex_unlock(&eio->shutdown_mutex);
-		if (_poll_internal(pollfds, nfds, shutdown_time) < 0)
+		if (_poll_internal(pollfds, nfds, eio->wakeup_msec,
+				   shutdown_time) < 0)
 			goto error;
 
 		/* See if we've been told to shut down by eio_signal_shutdown */
@@ -351,7 +388,8 @@ int eio_handle_mainloop(eio_handle_t *eio)
 }
 
 static int
-_poll_internal(struct pollfd *pfds, unsigned int nfds, time_t shutdown_time)
+_poll_internal(struct pollfd *pfds, unsigned int nfds, int wakeup_msec,
+	       time_t shutdown_time)
 {
 	int n, timeout;
 
@@ -359,6 +397,8 @@ _poll_internal(struct pollfd *pfds, unsigned int nfds, time_t shutdown_time)
 		timeout = 1000;	/* Return every 1000 msec during shutdown */
 	else
 		timeout = -1;
+	if ((wakeup_msec >= 0) && ((timeout < 0) || (wakeup_msec < timeout)))
+		timeout = wakeup_msec;
 	while ((n = poll(pfds, nfds, timeout)) < 0) {
 		switch (errno) {
 		case EINTR:
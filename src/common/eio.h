@@ -110,6 +110,22 @@ bool eio_message_socket_readable(eio_obj_t *obj);
 int eio_message_socket_accept(eio_obj_t *obj, List objs);
 
 int eio_signal_wakeup(eio_handle_t *eio);
+
+/*
+ * Make the next poll of the mainloop return after at most "msec"
+ * milliseconds, so that an object which returned false from its readable()
+ * or writable() callback to hold data back gets checked again. Only valid
+ * when called from those callbacks, for the current loop iteration.
+ */
+void eio_wakeup_after(eio_handle_t *eio, int msec);
+
+/*
+ * Keep the mainloop running, with no poll timeout, even if no object is
+ * readable or writable, for an object waiting on another thread to call
+ * eio_signal_wakeup(). Only valid when called from the readable() or
+ * writable() callbacks, for the current loop iteration.
+ */
+void eio_wait_for_wakeup(eio_handle_t *eio);
 int eio_signal_shutdown(eio_handle_t *eio);
 
 eio_obj_t *eio_obj_create(int fd, struct io_operations *ops, void *arg);
@@ -198,6 +198,8 @@ typedef struct slurm_acct_storage_ops {
 				    struct job_record *job_ptr);
 	List (*get_jobs_cond)      (void *db_conn, uint32_t uid,
 				    slurmdb_job_cond_t *job_cond);
+	List (*get_jobs_aggr)      (void *db_conn, uint32_t uid,
+				    slurmdb_job_aggr_cond_t *aggr_cond);
 	int (*archive_dump)        (void *db_conn,
 				    slurmdb_archive_cond_t *arch_cond);
 	int (*archive_load)        (void *db_conn,
@@ -280,6 +282,7 @@ static const char *syms[] = {
 	"jobacct_storage_p_step_complete",
 	"jobacct_storage_p_suspend",
 	"jobacct_storage_p_get_jobs_cond",
+	"jobacct_storage_p_get_jobs_aggr",
 	"jobacct_storage_p_archive",
 	"jobacct_storage_p_archive_load",
 	"acct_storage_p_update_shares_used",
@@ -1025,6 +1028,19 @@ extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 	return ret_list;
 }
 
+/*
+ * get totals of jobs from the storage
+ * returns List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_g_get_jobs_aggr(void *db_conn, uint32_t uid,
+					    slurmdb_job_aggr_cond_t *aggr_cond)
+{
+	if (slurm_acct_storage_init(NULL) < 0)
+		return NULL;
+	return (*(ops.get_jobs_aggr))(db_conn, uid, aggr_cond);
+}
+
 /*
  * expire old info from the storage
  */
@@ -630,6 +630,14 @@ extern int jobacct_storage_g_job_suspend(void *db_conn,
 extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 					    slurmdb_job_cond_t *job_cond);
 
+/*
+ * get totals of jobs from the storage, grouped by aggr_cond->group_by
+ * returns List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_g_get_jobs_aggr(void *db_conn, uint32_t uid,
+					    slurmdb_job_aggr_cond_t *aggr_cond);
+
 /*
  * expire old info from the storage
  */
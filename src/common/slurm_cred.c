@@ -83,11 +83,46 @@ typedef struct sbcast_cred sbcast_cred_t;		/* opaque data type */
 #define EXTREME_DEBUG   0
 #define MAX_TIME 0x7fffffff
 
+/*
+ * Job and credential states are kept in hash tables. Entries which can
+ * expire are also linked into a timing wheel of CRED_WHEEL_SIZE buckets,
+ * each covering CRED_WHEEL_SECS seconds, so expiring them only looks at the
+ * buckets passed since the last call instead of every entry.
+ */
+#define CRED_HASH_SIZE	4096	/* must be a power of 2 */
+#define CRED_WHEEL_SECS	2
+#define CRED_WHEEL_SIZE	512
+
+typedef struct cred_cache_link {
+	struct cred_cache_link  *hash_next;	/* next entry in hash bucket */
+	struct cred_cache_link  *wheel_next;	/* next entry in wheel bucket */
+	struct cred_cache_link **wheel_pprev;	/* NULL if not in the wheel */
+	uint32_t                 hash;
+} cred_cache_link_t;
+
+typedef struct {
+	cred_cache_link_t *hash[CRED_HASH_SIZE];
+	cred_cache_link_t *wheel[CRED_WHEEL_SIZE];
+	time_t             wheel_time;	/* earlier buckets already expired */
+	uint32_t           count;
+	time_t           (*expiration)(void *ent); /* MAX_TIME if never */
+	void             (*destroy)(void *ent);
+} cred_cache_t;
+
+/*
+ * Magic number starting the compact credential state format written by
+ * slurm_cred_ctx_pack(). The older format started with a job state count.
+ */
+#define CRED_STATE_MAGIC	0xc2ed0001
+#define CRED_STATE_REVOKED	0x01	/* job state: revoked time follows */
+#define CRED_STATE_EXPIRES	0x02	/* job state: expiration follows */
+
 /*
  * slurm job credential state
  *
  */
 typedef struct {
+	cred_cache_link_t link;	/* must be first			*/
 	time_t   ctime;		/* Time that the cred was created	*/
 	time_t   expiration;    /* Time at which cred is no longer good	*/
 	uint32_t jobid;		/* SLURM job id for this credential	*/
@@ -100,6 +135,7 @@ typedef struct {
  *
  */
 typedef struct {
+	cred_cache_link_t link; /* must be first                            */
 	time_t   ctime;         /* Time that this entry was created         */
 	time_t   expiration;    /* Time at which credentials can be purged  */
 	uint32_t jobid;         /* SLURM job id for this credential	*/
@@ -139,8 +175,8 @@ struct slurm_cred_context {
 	pthread_mutex_t mutex;
 	enum ctx_type  type;       /* type of context (creator or verifier) */
 	void          *key;        /* private or public key                 */
-	List           job_list;   /* List of used jobids (for verifier)    */
-	List           state_list; /* List of cred states (for verifier)    */
+	cred_cache_t  *job_cache;  /* used jobids (for verifier)            */
+	cred_cache_t  *cred_cache; /* cred states (for verifier)            */
 
 	int          expiry_window;/* expiration window for cached creds    */
 
@@ -247,12 +283,29 @@ static bool _exkey_is_valid(slurm_cred_ctx_t ctx);
 
 static cred_state_t * _cred_state_create(slurm_cred_ctx_t ctx, slurm_cred_t *c);
 static job_state_t  * _job_state_create(uint32_t jobid);
-static void           _cred_state_destroy(cred_state_t *cs);
-static void           _job_state_destroy(job_state_t   *js);
+static void           _cred_state_destroy(void *x);
+static void           _job_state_destroy(void *x);
+static time_t         _cred_state_expiration(void *x);
+static time_t         _job_state_expiration(void *x);
+
+static cred_cache_t * _cache_create(time_t (*expiration)(void *ent),
+				    void (*destroy)(void *ent));
+static void           _cache_destroy(cred_cache_t *cache);
+static void           _cache_add(cred_cache_t *cache, void *ent,
+				 uint32_t hash);
+static void           _cache_delete(cred_cache_t *cache, void *ent);
+static void           _cache_schedule(cred_cache_t *cache, void *ent);
+static void           _cache_expire(cred_cache_t *cache, time_t now);
 
 static job_state_t  * _find_job_state(slurm_cred_ctx_t ctx, uint32_t jobid);
 static job_state_t  * _insert_job_state(slurm_cred_ctx_t ctx,  uint32_t jobid);
-static int            _find_cred_state(cred_state_t *c, slurm_cred_t *cred);
+static cred_state_t * _find_cred_state(slurm_cred_ctx_t ctx,
+				       slurm_cred_t *cred);
+static cred_state_t * _find_cred_state_by_id(slurm_cred_ctx_t ctx,
+					     uint32_t jobid, uint32_t stepid,
+					     time_t ctime);
+static uint32_t       _cred_hash(uint32_t jobid, uint32_t stepid,
+				 time_t ctime);
 
 static void _insert_cred_state(slurm_cred_ctx_t ctx, slurm_cred_t *cred);
 static void _clear_expired_job_states(slurm_cred_ctx_t ctx);
@@ -270,17 +323,18 @@ static int _slurm_cred_verify_signature(slurm_cred_ctx_t ctx, slurm_cred_t *c,
 static int _slurm_crypto_init(void);
 static int _slurm_crypto_fini(void);
 
-static job_state_t  * _job_state_unpack_one(Buf buffer);
-static cred_state_t * _cred_state_unpack_one(Buf buffer);
+static job_state_t  * _job_state_unpack_one(Buf buffer, time_t base);
+static cred_state_t * _cred_state_unpack_one(Buf buffer, time_t base);
 
 static void _pack_cred(slurm_cred_t *cred, Buf buffer,
 		       uint16_t protocol_version);
-static void _job_state_unpack(slurm_cred_ctx_t ctx, Buf buffer);
-static void _job_state_pack(slurm_cred_ctx_t ctx, Buf buffer);
-static void _cred_state_unpack(slurm_cred_ctx_t ctx, Buf buffer);
-static void _cred_state_pack(slurm_cred_ctx_t ctx, Buf buffer);
-static void _job_state_pack_one(job_state_t *j, Buf buffer);
-static void _cred_state_pack_one(cred_state_t *s, Buf buffer);
+static void _job_state_unpack(slurm_cred_ctx_t ctx, time_t base, Buf buffer);
+static void _job_state_pack(slurm_cred_ctx_t ctx, time_t base, Buf buffer);
+static void _cred_state_unpack(slurm_cred_ctx_t ctx, time_t base,
+			       Buf buffer);
+static void _cred_state_pack(slurm_cred_ctx_t ctx, time_t base, Buf buffer);
+static void _job_state_pack_one(job_state_t *j, time_t base, Buf buffer);
+static void _cred_state_pack_one(cred_state_t *s, time_t base, Buf buffer);
 
 static void _sbast_cache_add(sbcast_cred_t *sbcast_cred);
 static void _sbcast_cache_del(void *x);
@@ -438,8 +492,8 @@ slurm_cred_ctx_destroy(slurm_cred_ctx_t ctx)
 		(*(ops.crypto_destroy_key))(ctx->exkey);
 	if (ctx->key)
 		(*(ops.crypto_destroy_key))(ctx->key);
-	FREE_NULL_LIST(ctx->job_list);
-	FREE_NULL_LIST(ctx->state_list);
+	_cache_destroy(ctx->job_cache);
+	_cache_destroy(ctx->cred_cache);
 
 	xassert(ctx->magic = ~CRED_CTX_MAGIC);
 
@@ -970,7 +1024,8 @@ slurm_cred_insert_jobid(slurm_cred_ctx_t ctx, uint32_t jobid)
 int
 slurm_cred_rewind(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
-	int rc = 0;
+	cred_state_t *s;
+	int rc = SLURM_FAILURE;
 
 	xassert(ctx != NULL);
 
@@ -979,12 +1034,14 @@ slurm_cred_rewind(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 	xassert(ctx->magic == CRED_CTX_MAGIC);
 	xassert(ctx->type  == SLURM_CRED_VERIFIER);
 
-	rc = list_delete_all(ctx->state_list,
-			     (ListFindF) _find_cred_state, cred);
+	if ((s = _find_cred_state(ctx, cred))) {
+		_cache_delete(ctx->cred_cache, s);
+		rc = SLURM_SUCCESS;
+	}
 
 	slurm_mutex_unlock(&ctx->mutex);
 
-	return (rc > 0 ? SLURM_SUCCESS : SLURM_FAILURE);
+	return rc;
 }
 
 int
@@ -1021,6 +1078,7 @@ slurm_cred_revoke(slurm_cred_ctx_t ctx, uint32_t jobid, time_t time,
 	}
 
 	j->revoked = time;
+	_cache_schedule(ctx->job_cache, j);
 
 	slurm_mutex_unlock(&ctx->mutex);
 	return SLURM_SUCCESS;
@@ -1055,6 +1113,7 @@ slurm_cred_begin_expiration(slurm_cred_ctx_t ctx, uint32_t jobid)
 	}
 
 	j->expiration  = time(NULL) + ctx->expiry_window;
+	_cache_schedule(ctx->job_cache, j);
 #if DEBUG_TIME
 	{
 		char buf[64];
@@ -1441,9 +1500,13 @@ unpack_error:
 int
 slurm_cred_ctx_pack(slurm_cred_ctx_t ctx, Buf buffer)
 {
+	time_t base = time(NULL);
+
 	slurm_mutex_lock(&ctx->mutex);
-	_job_state_pack(ctx, buffer);
-	_cred_state_pack(ctx, buffer);
+	pack32(CRED_STATE_MAGIC, buffer);
+	pack_time(base, buffer);
+	_job_state_pack(ctx, base, buffer);
+	_cred_state_pack(ctx, base, buffer);
 	slurm_mutex_unlock(&ctx->mutex);
 
 	return SLURM_SUCCESS;
@@ -1452,6 +1515,9 @@ slurm_cred_ctx_pack(slurm_cred_ctx_t ctx, Buf buffer)
 int
 slurm_cred_ctx_unpack(slurm_cred_ctx_t ctx, Buf buffer)
 {
+	uint32_t magic = 0;
+	time_t base = 0;
+
 	xassert(ctx != NULL);
 	xassert(ctx->magic == CRED_CTX_MAGIC);
 	xassert(ctx->type  == SLURM_CRED_VERIFIER);
@@ -1459,11 +1525,18 @@ slurm_cred_ctx_unpack(slurm_cred_ctx_t ctx, Buf buffer)
 	slurm_mutex_lock(&ctx->mutex);
 
 	/*
-	 * Unpack job state list and cred state list from buffer
-	 * appening them onto ctx->state_list and ctx->job_list.
+	 * Unpack job states and cred states from buffer, adding them to
+	 * ctx->job_cache and ctx->cred_cache. State saved by older versions
+	 * has no header and full times.
 	 */
-	_job_state_unpack(ctx, buffer);
-	_cred_state_unpack(ctx, buffer);
+	if ((unpack32(&magic, buffer) != SLURM_SUCCESS) ||
+	    (magic != CRED_STATE_MAGIC) ||
+	    (unpack_time(&base, buffer) != SLURM_SUCCESS)) {
+		set_buf_offset(buffer, 0);
+		base = 0;
+	}
+	_job_state_unpack(ctx, base, buffer);
+	_cred_state_unpack(ctx, base, buffer);
 
 	slurm_mutex_unlock(&ctx->mutex);
 
@@ -1533,8 +1606,10 @@ _verifier_ctx_init(slurm_cred_ctx_t ctx)
 	xassert(ctx->magic == CRED_CTX_MAGIC);
 	xassert(ctx->type == SLURM_CRED_VERIFIER);
 
-	ctx->job_list   = list_create((ListDelF) _job_state_destroy);
-	ctx->state_list = list_create((ListDelF) _cred_state_destroy);
+	ctx->job_cache  = _cache_create(_job_state_expiration,
+					_job_state_destroy);
+	ctx->cred_cache = _cache_create(_cred_state_expiration,
+					_cred_state_destroy);
 
 	return;
 }
@@ -1815,26 +1890,12 @@ _pack_cred(slurm_cred_t *cred, Buf buffer, uint16_t protocol_version)
 static bool
 _credential_replayed(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
-	ListIterator  i = NULL;
-	cred_state_t *s = NULL;
-
 	_clear_expired_credential_states(ctx);
 
-	i = list_iterator_create(ctx->state_list);
-
-	while ((s = list_next(i))) {
-		if ((s->jobid  == cred->jobid)  &&
-		    (s->stepid == cred->stepid) &&
-		    (s->ctime  == cred->ctime))
-			break;
-	}
-
-	list_iterator_destroy(i);
-
 	/*
 	 * If we found a match, this credential is being replayed.
 	 */
-	if (s)
+	if (_find_cred_state(ctx, cred))
 		return true;
 
 	/*
@@ -1865,12 +1926,7 @@ slurm_cred_handle_reissue(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 		 * old record so that "cred" will look like a new
 		 * credential to any ensuing commands. */
 		info("reissued job credential for job %u", j->jobid);
-
-		/* Setting j->expiration to zero will make
-		 * _clear_expired_job_states() remove this
-		 * job credential from the cred context. */
-		j->expiration = 0;
-		_clear_expired_job_states(ctx);
+		_cache_delete(ctx->job_cache, j);
 	}
 }
 
@@ -1916,33 +1972,56 @@ _credential_revoked(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 }
 
 
+static uint32_t _cred_hash(uint32_t jobid, uint32_t stepid, time_t ctime)
+{
+	return (jobid ^ (stepid * 0x9e3779b1) ^ (uint32_t) ctime);
+}
+
 static job_state_t *
 _find_job_state(slurm_cred_ctx_t ctx, uint32_t jobid)
 {
-	ListIterator  i = NULL;
-	job_state_t  *j = NULL;
+	cred_cache_link_t *link;
+	job_state_t *j;
 
-	i = list_iterator_create(ctx->job_list);
-	while ((j = list_next(i))) {
+	link = ctx->job_cache->hash[jobid & (CRED_HASH_SIZE - 1)];
+	for ( ; link; link = link->hash_next) {
+		j = (job_state_t *) link;
 		if (j->jobid == jobid)
-			break;
+			return j;
 	}
-	list_iterator_destroy(i);
-	return j;
+	return NULL;
 }
 
-static int
-_find_cred_state(cred_state_t *c, slurm_cred_t *cred)
+static cred_state_t *
+_find_cred_state_by_id(slurm_cred_ctx_t ctx, uint32_t jobid, uint32_t stepid,
+		       time_t ctime)
+{
+	cred_cache_link_t *link;
+	cred_state_t *s;
+	uint32_t hash = _cred_hash(jobid, stepid, ctime);
+
+	link = ctx->cred_cache->hash[hash & (CRED_HASH_SIZE - 1)];
+	for ( ; link; link = link->hash_next) {
+		s = (cred_state_t *) link;
+		if ((link->hash == hash) && (s->jobid == jobid) &&
+		    (s->stepid == stepid) && (s->ctime == ctime))
+			return s;
+	}
+	return NULL;
+}
+
+static cred_state_t *
+_find_cred_state(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
-	return ((c->jobid == cred->jobid) && (c->stepid == cred->stepid) &&
-		(c->ctime == cred->ctime));
+	return _find_cred_state_by_id(ctx, cred->jobid, cred->stepid,
+				      cred->ctime);
 }
 
 static job_state_t *
 _insert_job_state(slurm_cred_ctx_t ctx, uint32_t jobid)
 {
 	job_state_t *j = _job_state_create(jobid);
-	list_append(ctx->job_list, j);
+	_cache_add(ctx->job_cache, j, jobid);
 	return j;
 }
 
@@ -1961,76 +2040,35 @@ _job_state_create(uint32_t jobid)
 }
 
 static void
-_job_state_destroy(job_state_t *j)
+_job_state_destroy(void *x)
 {
+	job_state_t *j = (job_state_t *) x;
+
 	debug3 ("destroying job %u state", j->jobid);
 	xfree(j);
 }
 
-
-static void
-_clear_expired_job_states(slurm_cred_ctx_t ctx)
+/* Job states are only purged once revoked */
+static time_t
+_job_state_expiration(void *x)
 {
-	static time_t last_scan = 0;
-	time_t        now = time(NULL);
-	ListIterator  i   = NULL;
-	job_state_t  *j   = NULL;
+	job_state_t *j = (job_state_t *) x;
 
-	if ((now - last_scan) < 2)	/* Reduces slurmd overhead */
-		return;
-	last_scan = now;
+	return (j->revoked ? j->expiration : (time_t) MAX_TIME);
+}
 
-	i = list_iterator_create(ctx->job_list);
-	while ((j = list_next(i))) {
-#if DEBUG_TIME
-		char t1[64], t2[64], t3[64];
-		if (j->revoked) {
-			strcpy(t2, " revoked:");
-			timestr(&j->revoked, (t2+9), (64-9));
-		} else {
-			t2[0] = '\0';
-		}
-		if (j->expiration) {
-			strcpy(t3, " expires:");
-			timestr(&j->expiration, (t3+9), (64-9));
-		} else {
-			t3[0] = '\0';
-		}
-		debug3("state for jobid %u: ctime:%s%s%s",
-		       j->jobid, timestr(&j->ctime, t1, 64), t2, t3);
-#else
-		debug3("state for jobid %u: ctime:%"PRIu64" revoked:%"PRIu64" "
-		       "expires:%"PRIu64"",
-		       j->jobid, (uint64_t)j->ctime, (uint64_t)j->revoked,
-		       (uint64_t)j->revoked);
-#endif
-		if (j->revoked && (now > j->expiration)) {
-			list_delete_item(i);
-		}
-	}
 
-	list_iterator_destroy(i);
+static void
+_clear_expired_job_states(slurm_cred_ctx_t ctx)
+{
+	_cache_expire(ctx->job_cache, time(NULL));
 }
 
 
 static void
 _clear_expired_credential_states(slurm_cred_ctx_t ctx)
 {
-	static time_t last_scan = 0;
-	time_t        now = time(NULL);
-	ListIterator  i   = NULL;
-	cred_state_t *s   = NULL;
-
-	if ((now - last_scan) < 2)	/* Reduces slurmd overhead */
-		return;
-	last_scan = now;
-
-	i = list_iterator_create(ctx->state_list);
-	while ((s = list_next(i))) {
-		if (now > s->expiration)
-			list_delete_item(i);
-	}
-	list_iterator_destroy(i);
+	_cache_expire(ctx->cred_cache, time(NULL));
 }
 
 
@@ -2038,7 +2076,8 @@ static void
 _insert_cred_state(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 {
 	cred_state_t *s = _cred_state_create(ctx, cred);
-	list_append(ctx->state_list, s);
+	_cache_add(ctx->cred_cache, s,
+		   _cred_hash(s->jobid, s->stepid, s->ctime));
 }
 
 
@@ -2056,31 +2095,167 @@ _cred_state_create(slurm_cred_ctx_t ctx, slurm_cred_t *cred)
 }
 
 static void
-_cred_state_destroy(cred_state_t *s)
+_cred_state_destroy(void *x)
+{
+	xfree(x);
+}
+
+static time_t
+_cred_state_expiration(void *x)
 {
-	xfree(s);
+	return ((cred_state_t *) x)->expiration;
+}
+
+
+static cred_cache_t *
+_cache_create(time_t (*expiration)(void *ent), void (*destroy)(void *ent))
+{
+	cred_cache_t *cache = xmalloc(sizeof(cred_cache_t));
+
+	cache->expiration = expiration;
+	cache->destroy    = destroy;
+	cache->wheel_time = time(NULL);
+
+	return cache;
+}
+
+static void
+_cache_destroy(cred_cache_t *cache)
+{
+	cred_cache_link_t *link, *next;
+	int i;
+
+	if (!cache)
+		return;
+	for (i = 0; i < CRED_HASH_SIZE; i++) {
+		for (link = cache->hash[i]; link; link = next) {
+			next = link->hash_next;
+			(cache->destroy)(link);
+		}
+	}
+	xfree(cache);
+}
+
+static void
+_cache_unschedule(cred_cache_link_t *link)
+{
+	if (!link->wheel_pprev)
+		return;
+	*link->wheel_pprev = link->wheel_next;
+	if (link->wheel_next)
+		link->wheel_next->wheel_pprev = link->wheel_pprev;
+	link->wheel_next  = NULL;
+	link->wheel_pprev = NULL;
+}
+
+/* Move an entry to the wheel bucket of its current expiration time */
+static void
+_cache_schedule(cred_cache_t *cache, void *ent)
+{
+	cred_cache_link_t *link = (cred_cache_link_t *) ent;
+	cred_cache_link_t **head;
+	time_t expiration = (cache->expiration)(ent);
+
+	_cache_unschedule(link);
+	if (expiration >= (time_t) MAX_TIME)
+		return;
+	if (expiration < cache->wheel_time)
+		expiration = cache->wheel_time;
+
+	head = &cache->wheel[(expiration / CRED_WHEEL_SECS) % CRED_WHEEL_SIZE];
+	link->wheel_next = *head;
+	if (*head)
+		(*head)->wheel_pprev = &link->wheel_next;
+	link->wheel_pprev = head;
+	*head = link;
+}
+
+static void
+_cache_add(cred_cache_t *cache, void *ent, uint32_t hash)
+{
+	cred_cache_link_t *link = (cred_cache_link_t *) ent;
+	cred_cache_link_t **head = &cache->hash[hash & (CRED_HASH_SIZE - 1)];
+
+	link->hash = hash;
+	link->hash_next = *head;
+	*head = link;
+	cache->count++;
+	_cache_schedule(cache, ent);
+}
+
+static void
+_cache_delete(cred_cache_t *cache, void *ent)
+{
+	cred_cache_link_t *link = (cred_cache_link_t *) ent;
+	cred_cache_link_t **pprev;
+
+	pprev = &cache->hash[link->hash & (CRED_HASH_SIZE - 1)];
+	while (*pprev && (*pprev != link))
+		pprev = &(*pprev)->hash_next;
+	if (*pprev)
+		*pprev = link->hash_next;
+	_cache_unschedule(link);
+	cache->count--;
+	(cache->destroy)(ent);
+}
+
+/*
+ * Purge expired entries from the wheel buckets between the last call and
+ * now. Entries expiring beyond the span of the wheel share a bucket with
+ * earlier ones and are simply skipped until their time comes.
+ */
+static void
+_cache_expire(cred_cache_t *cache, time_t now)
+{
+	cred_cache_link_t *link, *next;
+	time_t t;
+	int n;
+
+	t = cache->wheel_time - (cache->wheel_time % CRED_WHEEL_SECS);
+	for (n = 0; (t <= now) && (n < CRED_WHEEL_SIZE);
+	     t += CRED_WHEEL_SECS, n++) {
+		link = cache->wheel[(t / CRED_WHEEL_SECS) % CRED_WHEEL_SIZE];
+		for ( ; link; link = next) {
+			next = link->wheel_next;
+			if (now > (cache->expiration)(link))
+				_cache_delete(cache, link);
+		}
+	}
+	cache->wheel_time = now - (now % CRED_WHEEL_SECS);
 }
 
 
 static void
-_cred_state_pack_one(cred_state_t *s, Buf buffer)
+_cred_state_pack_one(cred_state_t *s, time_t base, Buf buffer)
 {
 	pack32(s->jobid, buffer);
 	pack32(s->stepid, buffer);
-	pack_time(s->ctime, buffer);
-	pack_time(s->expiration, buffer);
+	pack32((uint32_t) (s->ctime - base), buffer);
+	pack32((uint32_t) (s->expiration - s->ctime), buffer);
 }
 
 
+/*
+ * Unpack one credential state. Times are packed relative to "base" in the
+ * compact format; base of zero means the older format with full times.
+ */
 static cred_state_t *
-_cred_state_unpack_one(Buf buffer)
+_cred_state_unpack_one(Buf buffer, time_t base)
 {
 	cred_state_t *s = xmalloc(sizeof(*s));
+	uint32_t delta;
 
 	safe_unpack32(&s->jobid, buffer);
 	safe_unpack32(&s->stepid, buffer);
-	safe_unpack_time(&s->ctime, buffer);
-	safe_unpack_time(&s->expiration, buffer);
+	if (base) {
+		safe_unpack32(&delta, buffer);
+		s->ctime = base + (int32_t) delta;
+		safe_unpack32(&delta, buffer);
+		s->expiration = s->ctime + delta;
+	} else {
+		safe_unpack_time(&s->ctime, buffer);
+		safe_unpack_time(&s->expiration, buffer);
+	}
 	return s;
 
 unpack_error:
@@ -2090,25 +2265,53 @@ unpack_error:
 
 
 static void
-_job_state_pack_one(job_state_t *j, Buf buffer)
+_job_state_pack_one(job_state_t *j, time_t base, Buf buffer)
 {
+	uint8_t flags = 0;
+
+	if (j->revoked)
+		flags |= CRED_STATE_REVOKED;
+	if (j->expiration != (time_t) MAX_TIME)
+		flags |= CRED_STATE_EXPIRES;
+
 	pack32(j->jobid, buffer);
-	pack_time(j->revoked, buffer);
-	pack_time(j->ctime, buffer);
-	pack_time(j->expiration, buffer);
+	pack8(flags, buffer);
+	pack32((uint32_t) (j->ctime - base), buffer);
+	if (flags & CRED_STATE_REVOKED)
+		pack32((uint32_t) (j->revoked - base), buffer);
+	if (flags & CRED_STATE_EXPIRES)
+		pack32((uint32_t) (j->expiration - base), buffer);
 }
 
 
+/* See _cred_state_unpack_one() for the meaning of base */
 static job_state_t *
-_job_state_unpack_one(Buf buffer)
+_job_state_unpack_one(Buf buffer, time_t base)
 {
 	char         t1[64], t2[64], t3[64];
 	job_state_t *j = xmalloc(sizeof(*j));
+	uint32_t     delta;
+	uint8_t      flags;
 
 	safe_unpack32(    &j->jobid,      buffer);
-	safe_unpack_time( &j->revoked,    buffer);
-	safe_unpack_time( &j->ctime,      buffer);
-	safe_unpack_time( &j->expiration, buffer);
+	if (base) {
+		safe_unpack8(&flags, buffer);
+		safe_unpack32(&delta, buffer);
+		j->ctime = base + (int32_t) delta;
+		if (flags & CRED_STATE_REVOKED) {
+			safe_unpack32(&delta, buffer);
+			j->revoked = base + (int32_t) delta;
+		}
+		j->expiration = (time_t) MAX_TIME;
+		if (flags & CRED_STATE_EXPIRES) {
+			safe_unpack32(&delta, buffer);
+			j->expiration = base + (int32_t) delta;
+		}
+	} else {
+		safe_unpack_time( &j->revoked,    buffer);
+		safe_unpack_time( &j->ctime,      buffer);
+		safe_unpack_time( &j->expiration, buffer);
+	}
 
 	if (j->revoked) {
 		strcpy(t2, " revoked:");
@@ -2140,22 +2343,23 @@ unpack_error:
 
 
 static void
-_cred_state_pack(slurm_cred_ctx_t ctx, Buf buffer)
+_cred_state_pack(slurm_cred_ctx_t ctx, time_t base, Buf buffer)
 {
-	ListIterator  i = NULL;
-	cred_state_t *s = NULL;
-
-	pack32(list_count(ctx->state_list), buffer);
+	cred_cache_link_t *link;
+	int i;
 
-	i = list_iterator_create(ctx->state_list);
-	while ((s = list_next(i)))
-		_cred_state_pack_one(s, buffer);
-	list_iterator_destroy(i);
+	pack32(ctx->cred_cache->count, buffer);
+	for (i = 0; i < CRED_HASH_SIZE; i++) {
+		for (link = ctx->cred_cache->hash[i]; link;
+		     link = link->hash_next)
+			_cred_state_pack_one((cred_state_t *) link, base,
+					     buffer);
+	}
 }
 
 
 static void
-_cred_state_unpack(slurm_cred_ctx_t ctx, Buf buffer)
+_cred_state_unpack(slurm_cred_ctx_t ctx, time_t base, Buf buffer)
 {
 	time_t        now = time(NULL);
 	uint32_t      n;
@@ -2166,12 +2370,14 @@ _cred_state_unpack(slurm_cred_ctx_t ctx, Buf buffer)
 	if (n > NO_VAL32)
 		goto unpack_error;
 	for (i = 0; i < n; i++) {
-		if (!(s = _cred_state_unpack_one(buffer)))
+		if (!(s = _cred_state_unpack_one(buffer, base)))
 			goto unpack_error;
 
-		if (now < s->expiration)
-			list_append(ctx->state_list, s);
-		else
+		if ((now < s->expiration) && !_find_cred_state_by_id(
+			    ctx, s->jobid, s->stepid, s->ctime)) {
+			_cache_add(ctx->cred_cache, s,
+				   _cred_hash(s->jobid, s->stepid, s->ctime));
+		} else
 			_cred_state_destroy(s);
 	}
 
@@ -2184,23 +2390,23 @@ unpack_error:
 
 
 static void
-_job_state_pack(slurm_cred_ctx_t ctx, Buf buffer)
+_job_state_pack(slurm_cred_ctx_t ctx, time_t base, Buf buffer)
 {
-	ListIterator  i = NULL;
-	job_state_t  *j = NULL;
-
-	pack32((uint32_t) list_count(ctx->job_list), buffer);
-
+	cred_cache_link_t *link;
+	int i;
 
-	i = list_iterator_create(ctx->job_list);
-	while ((j = list_next(i)))
-		_job_state_pack_one(j, buffer);
-	list_iterator_destroy(i);
+	pack32(ctx->job_cache->count, buffer);
+	for (i = 0; i < CRED_HASH_SIZE; i++) {
+		for (link = ctx->job_cache->hash[i]; link;
+		     link = link->hash_next)
+			_job_state_pack_one((job_state_t *) link, base,
+					    buffer);
+	}
 }
 
 
 static void
-_job_state_unpack(slurm_cred_ctx_t ctx, Buf buffer)
+_job_state_unpack(slurm_cred_ctx_t ctx, time_t base, Buf buffer)
 {
 	time_t       now = time(NULL);
 	uint32_t     n   = 0;
@@ -2211,11 +2417,15 @@ _job_state_unpack(slurm_cred_ctx_t ctx, Buf buffer)
 	if (n > NO_VAL32)
 		goto unpack_error;
 	for (i = 0; i < n; i++) {
-		if (!(j = _job_state_unpack_one(buffer)))
+		if (!(j = _job_state_unpack_one(buffer, base)))
 			goto unpack_error;
 
-		if (!j->revoked || (j->revoked && (now < j->expiration)))
-			list_append(ctx->job_list, j);
+		if (_find_job_state(ctx, j->jobid)) {
+			debug3("not appending duplicate job %u state",
+			       j->jobid);
+			_job_state_destroy(j);
+		} else if (!j->revoked || (j->revoked && (now < j->expiration)))
+			_cache_add(ctx->job_cache, j, j->jobid);
 		else {
 			debug3 ("not appending expired job %u state",
 			        j->jobid);
@@ -425,9 +425,11 @@ extern int slurm_persist_conn_recv_thread_init(
 	service_conn->conn = persist_conn;
 	service_conn->thread_loc = thread_loc;
 
-	persist_conn->timeout = 0; /* If this isn't zero we won't wait forever
-				      like we want to.
-				   */
+	/* If this isn't zero we won't wait forever like we want to.  Client
+	 * connections keep their idle timeout so abandoned ones are reaped.
+	 */
+	if (!(persist_conn->flags & PERSIST_FLAG_CLIENT))
+		persist_conn->timeout = 0;
 	retry_cnt = 0;
 
 	slurm_attr_init(&attr);
@@ -595,6 +597,8 @@ extern int slurm_persist_conn_open(slurm_persist_conn_t *persist_conn)
 	req.cluster_name = persist_conn->cluster_name;
 	req.port = persist_conn->my_port;
 	req.version = SLURM_PROTOCOL_VERSION;
+	if (persist_conn->flags & PERSIST_FLAG_CLIENT)
+		req.persist_type = PERSIST_TYPE_CLIENT;
 
 	req_msg.data = &req;
 
@@ -1022,6 +1026,8 @@ extern void slurm_persist_pack_init_req_msg(
 	   since this is where the receiver gets the version from. */
 	packstr(msg->cluster_name, buffer);
 	pack16(msg->port, buffer);
+	if (msg->version >= SLURM_17_11_PROTOCOL_VERSION)
+		pack16(msg->persist_type, buffer);
 }
 
 extern int slurm_persist_unpack_init_req_msg(
@@ -1037,6 +1043,8 @@ extern int slurm_persist_unpack_init_req_msg(
 	safe_unpack16(&msg_ptr->version, buffer);
 	safe_unpackstr_xmalloc(&msg_ptr->cluster_name, &tmp32, buffer);
 	safe_unpack16(&msg_ptr->port, buffer);
+	if (msg_ptr->version >= SLURM_17_11_PROTOCOL_VERSION)
+		safe_unpack16(&msg_ptr->persist_type, buffer);
 
 	return SLURM_SUCCESS;
 
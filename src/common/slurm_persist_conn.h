@@ -43,6 +43,11 @@
 #define PERSIST_FLAG_DBD            0x0001
 #define PERSIST_FLAG_RECONNECT      0x0002
 #define PERSIST_FLAG_ALREADY_INITED 0x0004
+#define PERSIST_FLAG_CLIENT         0x0008
+
+/* persist_init_req_msg_t->persist_type */
+#define PERSIST_TYPE_CLUSTER 0x0000 /* slurmctld/slurmdbd to cluster */
+#define PERSIST_TYPE_CLIENT  0x0001 /* user command or API to slurmctld */
 
 typedef struct {
 	uint16_t msg_type;	/* see slurmdbd_msg_type_t or
@@ -74,6 +79,7 @@ typedef struct {
 
 typedef struct {
 	char *cluster_name;     /* cluster this message is coming from */
+	uint16_t persist_type;  /* PERSIST_TYPE_* */
 	uint16_t port;          /* If you want to open a new connection, this is
 				 *  the port to talk to. */
 	uint16_t version;	/* protocol version */
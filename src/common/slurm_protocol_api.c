@@ -93,6 +93,11 @@ static slurm_protocol_config_t proto_conf_default;
 static slurm_protocol_config_t *proto_conf = &proto_conf_default;
 /* static slurm_ctl_conf_t slurmctld_conf; */
 static int message_timeout = -1;
+/* Optional persistent connection to slurmctld, see
+ * slurm_ctld_persist_conn_open() */
+static slurm_persist_conn_t *ctld_persist_conn = NULL;
+static pthread_mutex_t ctld_persist_mutex = PTHREAD_MUTEX_INITIALIZER;
+static time_t ctld_persist_shutdown = 0;
 
 /* STATIC FUNCTIONS */
 static char *_global_auth_key(void);
@@ -4328,6 +4333,129 @@ _send_and_recv_msgs(int fd, slurm_msg_t *req, int timeout)
 }
 
 
+/*
+ * slurm_ctld_persist_conn_open - open a persistent connection to the local
+ *	cluster's slurmctld which slurm_send_recv_controller_msg() will use
+ *	for all following requests until slurm_ctld_persist_conn_close()
+ * RET 0 on success, -1 on failure and sets errno
+ */
+extern int slurm_ctld_persist_conn_open(void)
+{
+	slurm_ctl_conf_t *conf;
+	int rc = SLURM_SUCCESS;
+
+	if (slurm_api_set_default_config() < 0)
+		return SLURM_ERROR;
+
+	slurm_mutex_lock(&ctld_persist_mutex);
+	if (ctld_persist_conn)
+		goto end_it;
+
+	ctld_persist_conn = xmalloc(sizeof(slurm_persist_conn_t));
+	ctld_persist_conn->fd = -1;
+	ctld_persist_conn->flags = PERSIST_FLAG_CLIENT;
+	ctld_persist_conn->shutdown = &ctld_persist_shutdown;
+	ctld_persist_conn->timeout = -1;
+
+	conf = slurm_conf_lock();
+	ctld_persist_conn->cluster_name = xstrdup(conf->cluster_name);
+	ctld_persist_conn->rem_host = xstrdup(conf->control_addr);
+	ctld_persist_conn->rem_port = conf->slurmctld_port;
+	slurm_conf_unlock();
+
+	if (!ctld_persist_conn->cluster_name || !ctld_persist_conn->rem_host ||
+	    (slurm_persist_conn_open(ctld_persist_conn) != SLURM_SUCCESS)) {
+		slurm_persist_conn_destroy(ctld_persist_conn);
+		ctld_persist_conn = NULL;
+		slurm_seterrno(SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR);
+		rc = SLURM_ERROR;
+	}
+end_it:
+	slurm_mutex_unlock(&ctld_persist_mutex);
+
+	return rc;
+}
+
+/*
+ * slurm_ctld_persist_conn_close - close the connection opened by
+ *	slurm_ctld_persist_conn_open()
+ */
+extern void slurm_ctld_persist_conn_close(void)
+{
+	slurm_mutex_lock(&ctld_persist_mutex);
+	slurm_persist_conn_destroy(ctld_persist_conn);
+	ctld_persist_conn = NULL;
+	slurm_mutex_unlock(&ctld_persist_mutex);
+}
+
+/*
+ * Send a request and receive its response over the persistent slurmctld
+ * connection, if one is open. Requests from multiple threads are serialized
+ * on the connection. If the connection was closed by slurmctld (e.g. for
+ * being idle) it is reopened once. Once the request has been sent it may
+ * have been processed, so a failure to receive the response is returned to
+ * the caller rather than having the request sent again.
+ * OUT sent - set if the request was sent over the connection
+ * RET SLURM_SUCCESS or SLURM_ERROR. If !*sent the caller should open a
+ *	normal connection instead.
+ */
+static int _send_recv_ctld_persist_msg(slurm_msg_t *req, slurm_msg_t *resp,
+				       bool *sent)
+{
+	int rc = SLURM_ERROR, retry, save_errno;
+
+	*sent = false;
+	slurm_mutex_lock(&ctld_persist_mutex);
+	if (!ctld_persist_conn)
+		goto end_it;
+
+	for (retry = 0; retry < 2; retry++) {
+		if ((ctld_persist_conn->fd < 0) &&
+		    (slurm_persist_conn_reopen(ctld_persist_conn, true)
+		     != SLURM_SUCCESS))
+			break;
+
+		req->conn = ctld_persist_conn;
+		if (slurm_send_node_msg(ctld_persist_conn->fd, req)
+		    != SLURM_SUCCESS) {
+			req->conn = NULL;
+			slurm_persist_conn_close(ctld_persist_conn);
+			continue;
+		}
+		req->conn = NULL;
+		*sent = true;
+
+		slurm_msg_t_init(resp);
+		resp->conn = ctld_persist_conn;
+		rc = slurm_receive_msg(ctld_persist_conn->fd, resp, 0);
+		resp->conn = NULL;
+		if (rc != SLURM_SUCCESS) {
+			/* The response may still arrive, don't take it for
+			 * the response to the next request */
+			save_errno = errno;
+			slurm_persist_conn_close(ctld_persist_conn);
+			slurm_seterrno(save_errno);
+		}
+		break;
+	}
+
+	if ((rc == SLURM_SUCCESS) && (resp->msg_type == RESPONSE_SLURM_RC) &&
+	    (((return_code_msg_t *)resp->data)->return_code ==
+	     ESLURM_IN_STANDBY_MODE)) {
+		/* Let the normal path handle backup controller failover,
+		 * a controller in standby did not process the request */
+		slurm_free_return_code_msg(resp->data);
+		resp->data = NULL;
+		slurm_persist_conn_close(ctld_persist_conn);
+		*sent = false;
+		rc = SLURM_ERROR;
+	}
+end_it:
+	slurm_mutex_unlock(&ctld_persist_mutex);
+
+	return rc;
+}
+
 /* slurm_send_recv_controller_msg
  * opens a connection to the controller, sends the controller a message,
  * listens for the response, then closes the connection
@@ -4349,6 +4477,7 @@ extern int slurm_send_recv_controller_msg(slurm_msg_t * request_msg,
 	uint16_t slurmctld_timeout;
 	slurm_addr_t ctrl_addr;
 	static bool use_backup = false;
+	bool sent = false;
 
 	/* Just in case the caller didn't initialize his slurm_msg_t, and
 	 * since we KNOW that we are only sending to one node (the controller),
@@ -4360,6 +4489,10 @@ extern int slurm_send_recv_controller_msg(slurm_msg_t * request_msg,
 
 	if (comm_cluster_rec)
 		request_msg->flags |= SLURM_GLOBAL_AUTH_KEY;
+	else if (((rc = _send_recv_ctld_persist_msg(request_msg, response_msg,
+						    &sent)) == SLURM_SUCCESS) ||
+		 sent)
+		return rc;
 
 	if ((fd = slurm_open_controller_conn(&ctrl_addr, &use_backup,
 					     comm_cluster_rec)) < 0) {
@@ -3305,6 +3305,8 @@ extern void slurm_free_slurmd_status(slurmd_status_t* slurmd_status_ptr)
 {
 	if (slurmd_status_ptr) {
 		xfree(slurmd_status_ptr->hostname);
+		xfree(slurmd_status_ptr->launch_hist);
+		xfree(slurmd_status_ptr->rpc_active);
 		xfree(slurmd_status_ptr->slurmd_logfile);
 		xfree(slurmd_status_ptr->step_list);
 		xfree(slurmd_status_ptr->version);
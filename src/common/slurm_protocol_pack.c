@@ -13979,7 +13979,33 @@ static void _pack_slurmd_status(slurmd_status_t *msg, Buf buffer,
 {
 	xassert(msg);
 
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		pack_time(msg->booted, buffer);
+		pack_time(msg->last_slurmctld_msg, buffer);
+
+		pack16(msg->slurmd_debug, buffer);
+		pack16(msg->actual_cpus, buffer);
+		pack16(msg->actual_boards, buffer);
+		pack16(msg->actual_sockets, buffer);
+		pack16(msg->actual_cores, buffer);
+		pack16(msg->actual_threads, buffer);
+
+		pack64(msg->actual_real_mem, buffer);
+		pack32(msg->actual_tmp_disk, buffer);
+		pack32(msg->pid, buffer);
+
+		packstr(msg->hostname, buffer);
+		packstr(msg->slurmd_logfile, buffer);
+		packstr(msg->step_list, buffer);
+		packstr(msg->version, buffer);
+
+		pack32(msg->stepd_pool_ready, buffer);
+		pack32(msg->launch_pooled, buffer);
+		pack32_array(msg->launch_hist, msg->launch_hist_cnt, buffer);
+		pack32_array(msg->rpc_active, msg->rpc_class_cnt, buffer);
+		pack32(msg->rpc_stats_queued, buffer);
+		pack32(msg->rpc_rejected, buffer);
+	} else if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		pack_time(msg->booted, buffer);
 		pack_time(msg->last_slurmctld_msg, buffer);
 
@@ -14033,7 +14059,39 @@ static int _unpack_slurmd_status(slurmd_status_t **msg_ptr, Buf buffer,
 
 	msg = xmalloc(sizeof(slurmd_status_t));
 
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		safe_unpack_time(&msg->booted, buffer);
+		safe_unpack_time(&msg->last_slurmctld_msg, buffer);
+
+		safe_unpack16(&msg->slurmd_debug, buffer);
+		safe_unpack16(&msg->actual_cpus, buffer);
+		safe_unpack16(&msg->actual_boards, buffer);
+		safe_unpack16(&msg->actual_sockets, buffer);
+		safe_unpack16(&msg->actual_cores, buffer);
+		safe_unpack16(&msg->actual_threads, buffer);
+
+		safe_unpack64(&msg->actual_real_mem, buffer);
+		safe_unpack32(&msg->actual_tmp_disk, buffer);
+		safe_unpack32(&msg->pid, buffer);
+
+		safe_unpackstr_xmalloc(&msg->hostname,
+					&uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&msg->slurmd_logfile,
+					&uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&msg->step_list,
+					&uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&msg->version,
+					&uint32_tmp, buffer);
+
+		safe_unpack32(&msg->stepd_pool_ready, buffer);
+		safe_unpack32(&msg->launch_pooled, buffer);
+		safe_unpack32_array(&msg->launch_hist, &msg->launch_hist_cnt,
+				    buffer);
+		safe_unpack32_array(&msg->rpc_active, &msg->rpc_class_cnt,
+				    buffer);
+		safe_unpack32(&msg->rpc_stats_queued, buffer);
+		safe_unpack32(&msg->rpc_rejected, buffer);
+	} else if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		safe_unpack_time(&msg->booted, buffer);
 		safe_unpack_time(&msg->last_slurmctld_msg, buffer);
 
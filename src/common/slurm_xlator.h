@@ -109,6 +109,11 @@
 #define bit_noc			slurm_bit_noc
 #define bit_nffs		slurm_bit_nffs
 #define bit_copybits		slurm_bit_copybits
+#define bit_and_into		slurm_bit_and_into
+#define bit_and_not_into	slurm_bit_and_not_into
+#define bit_and_not_count	slurm_bit_and_not_count
+#define bit_scratch_alloc	slurm_bit_scratch_alloc
+#define bit_scratch_free	slurm_bit_scratch_free
 
 /* fd.[ch] functions */
 #define fd_read_n		slurm_fd_read_n
@@ -832,6 +832,19 @@ extern void slurmdb_destroy_event_rec(void *object)
 	}
 }
 
+extern void slurmdb_destroy_job_aggr_rec(void *object)
+{
+	slurmdb_job_aggr_rec_t *aggr = (slurmdb_job_aggr_rec_t *)object;
+
+	if (aggr) {
+		xfree(aggr->account);
+		xfree(aggr->cluster);
+		xfree(aggr->partition);
+		xfree(aggr->user);
+		xfree(aggr);
+	}
+}
+
 extern void slurmdb_destroy_job_rec(void *object)
 {
 	slurmdb_job_rec_t *job = (slurmdb_job_rec_t *)object;
@@ -1125,6 +1138,17 @@ extern void slurmdb_destroy_event_cond(void *object)
 	}
 }
 
+extern void slurmdb_destroy_job_aggr_cond(void *object)
+{
+	slurmdb_job_aggr_cond_t *aggr_cond =
+		(slurmdb_job_aggr_cond_t *)object;
+
+	if (aggr_cond) {
+		slurmdb_destroy_job_cond(aggr_cond->job_cond);
+		xfree(aggr_cond);
+	}
+}
+
 extern void slurmdb_destroy_job_cond(void *object)
 {
 	slurmdb_job_cond_t *job_cond =
@@ -1136,6 +1160,7 @@ extern void slurmdb_destroy_job_cond(void *object)
 		FREE_NULL_LIST(job_cond->cluster_list);
 		FREE_NULL_LIST(job_cond->groupid_list);
 		FREE_NULL_LIST(job_cond->jobname_list);
+		xfree(job_cond->page_cluster);
 		FREE_NULL_LIST(job_cond->partition_list);
 		FREE_NULL_LIST(job_cond->qos_list);
 		FREE_NULL_LIST(job_cond->resv_list);
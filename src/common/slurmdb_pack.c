@@ -4010,6 +4010,122 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+extern void slurmdb_pack_job_aggr_cond(void *in, uint16_t protocol_version,
+				       Buf buffer)
+{
+	slurmdb_job_aggr_cond_t *object = (slurmdb_job_aggr_cond_t *)in;
+
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		if (!object) {
+			pack32(0, buffer);
+			slurmdb_pack_job_cond(NULL, protocol_version, buffer);
+			pack32(0, buffer);
+			return;
+		}
+		pack32(object->group_by, buffer);
+		slurmdb_pack_job_cond(object->job_cond, protocol_version,
+				      buffer);
+		pack32(object->time_bucket, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+	}
+}
+
+extern int slurmdb_unpack_job_aggr_cond(void **object,
+					uint16_t protocol_version, Buf buffer)
+{
+	slurmdb_job_aggr_cond_t *object_ptr =
+		xmalloc(sizeof(slurmdb_job_aggr_cond_t));
+
+	*object = object_ptr;
+
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		safe_unpack32(&object_ptr->group_by, buffer);
+		if (slurmdb_unpack_job_cond((void **)&object_ptr->job_cond,
+					    protocol_version, buffer)
+		    != SLURM_SUCCESS)
+			goto unpack_error;
+		safe_unpack32(&object_ptr->time_bucket, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurmdb_destroy_job_aggr_cond(object_ptr);
+	*object = NULL;
+	return SLURM_ERROR;
+}
+
+extern void slurmdb_pack_job_aggr_rec(void *in, uint16_t protocol_version,
+				      Buf buffer)
+{
+	slurmdb_job_aggr_rec_t *object = (slurmdb_job_aggr_rec_t *)in;
+
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		packstr(object->account, buffer);
+		packstr(object->cluster, buffer);
+		pack64(object->cpu_alloc_secs, buffer);
+		pack64(object->cpu_used_secs, buffer);
+		pack64(object->elapsed_secs, buffer);
+		pack32(object->job_cnt, buffer);
+		packstr(object->partition, buffer);
+		pack32(object->state, buffer);
+		pack_time(object->time_start, buffer);
+		pack64(object->timelimit_secs, buffer);
+		pack32(object->uid, buffer);
+		packstr(object->user, buffer);
+		pack64(object->wait_secs, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+	}
+}
+
+extern int slurmdb_unpack_job_aggr_rec(void **object,
+				       uint16_t protocol_version, Buf buffer)
+{
+	uint32_t uint32_tmp;
+	slurmdb_job_aggr_rec_t *object_ptr =
+		xmalloc(sizeof(slurmdb_job_aggr_rec_t));
+
+	*object = object_ptr;
+
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		safe_unpackstr_xmalloc(&object_ptr->account,
+				       &uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&object_ptr->cluster,
+				       &uint32_tmp, buffer);
+		safe_unpack64(&object_ptr->cpu_alloc_secs, buffer);
+		safe_unpack64(&object_ptr->cpu_used_secs, buffer);
+		safe_unpack64(&object_ptr->elapsed_secs, buffer);
+		safe_unpack32(&object_ptr->job_cnt, buffer);
+		safe_unpackstr_xmalloc(&object_ptr->partition,
+				       &uint32_tmp, buffer);
+		safe_unpack32(&object_ptr->state, buffer);
+		safe_unpack_time(&object_ptr->time_start, buffer);
+		safe_unpack64(&object_ptr->timelimit_secs, buffer);
+		safe_unpack32(&object_ptr->uid, buffer);
+		safe_unpackstr_xmalloc(&object_ptr->user, &uint32_tmp, buffer);
+		safe_unpack64(&object_ptr->wait_secs, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurmdb_destroy_job_aggr_rec(object_ptr);
+	*object = NULL;
+	return SLURM_ERROR;
+}
+
 extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 				  Buf buffer)
 {
@@ -4020,7 +4136,7 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 	ListIterator itr = NULL;
 	slurmdb_job_cond_t *object = (slurmdb_job_cond_t *)in;
 
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
 		if (!object) {
 			pack32(NO_VAL, buffer);	/* count(acct_list) */
 			pack32(NO_VAL, buffer);	/* count(associd_list) */
@@ -4033,6 +4149,9 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 			pack32(NO_VAL, buffer);	/* count(jobname_list) */
 			pack32(0, buffer);	/* nodes_max */
 			pack32(0, buffer);	/* nodes_min */
+			packnull(buffer);	/* page_cluster */
+			pack32(0, buffer);	/* page_jobid */
+			pack32(0, buffer);	/* page_size */
 			pack32(NO_VAL, buffer);	/* count(partition_list) */
 			pack32(NO_VAL, buffer);	/* count(qos_list) */
 			pack32(NO_VAL, buffer);	/* count(resv_list) */
@@ -4122,6 +4241,9 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 
 		pack32(object->nodes_max, buffer);
 		pack32(object->nodes_min, buffer);
+		packstr(object->page_cluster, buffer);
+		pack32(object->page_jobid, buffer);
+		pack32(object->page_size, buffer);
 
 		if (object->partition_list)
 			count = list_count(object->partition_list);
@@ -4146,113 +4268,536 @@ extern void slurmdb_pack_job_cond(void *in, uint16_t protocol_version,
 			while ((tmp_info = list_next(itr))) {
 				packstr(tmp_info, buffer);
 			}
-			list_iterator_destroy(itr);
+			list_iterator_destroy(itr);
+		}
+
+		if (object->resv_list)
+			count = list_count(object->resv_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->resv_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->resvid_list)
+			count = list_count(object->resvid_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->resvid_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->step_list)
+			count = list_count(object->step_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->step_list);
+			while ((job = list_next(itr))) {
+				slurmdb_pack_selected_step(job, protocol_version,
+							   buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->state_list)
+			count = list_count(object->state_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->state_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		pack32(object->timelimit_max, buffer);
+		pack32(object->timelimit_min, buffer);
+		pack_time(object->usage_end, buffer);
+		pack_time(object->usage_start, buffer);
+
+		packstr(object->used_nodes, buffer);
+
+		if (object->userid_list)
+			count = list_count(object->userid_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->userid_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->wckey_list)
+			count = list_count(object->wckey_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->wckey_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		pack16(object->without_steps, buffer);
+		pack16(object->without_usage_truncation, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		if (!object) {
+			pack32(NO_VAL, buffer);	/* count(acct_list) */
+			pack32(NO_VAL, buffer);	/* count(associd_list) */
+			pack32(NO_VAL, buffer);	/* count(cluster_list) */
+			pack32(0, buffer);	/* cpus_max */
+			pack32(0, buffer);	/* cpus_min */
+			pack16(0, buffer);	/* duplicates */
+			pack32(0, buffer);	/* exitcode */
+			pack32(NO_VAL, buffer);	/* count(groupid_list) */
+			pack32(NO_VAL, buffer);	/* count(jobname_list) */
+			pack32(0, buffer);	/* nodes_max */
+			pack32(0, buffer);	/* nodes_min */
+			pack32(NO_VAL, buffer);	/* count(partition_list) */
+			pack32(NO_VAL, buffer);	/* count(qos_list) */
+			pack32(NO_VAL, buffer);	/* count(resv_list) */
+			pack32(NO_VAL, buffer);	/* count(resvid_list) */
+			pack32(NO_VAL, buffer);	/* count(step_list) */
+			pack32(NO_VAL, buffer);	/* count(state_list) */
+			pack32(0, buffer);	/* timelimit_max */
+			pack32(0, buffer);	/* timelimit_min */
+			pack_time(0, buffer);	/* usage_end */
+			pack_time(0, buffer);	/* usage_start */
+			packnull(buffer);	/* used_nodes */
+			pack32(NO_VAL, buffer);	/* count(userid_list) */
+			pack32(NO_VAL, buffer);	/* count(wckey_list) */
+			pack16(0, buffer);	/* without_steps */
+			pack16(0, buffer);	/* without_usage_truncation */
+			return;
+		}
+
+		if (object->acct_list)
+			count = list_count(object->acct_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->acct_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->associd_list)
+			count = list_count(object->associd_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->associd_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+		}
+
+		if (object->cluster_list)
+			count = list_count(object->cluster_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->cluster_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		pack32(object->cpus_max, buffer);
+		pack32(object->cpus_min, buffer);
+		pack16(object->duplicates, buffer);
+		pack32((uint32_t)object->exitcode, buffer);
+
+		if (object->groupid_list)
+			count = list_count(object->groupid_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->groupid_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->jobname_list)
+			count = list_count(object->jobname_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->jobname_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		pack32(object->nodes_max, buffer);
+		pack32(object->nodes_min, buffer);
+
+		if (object->partition_list)
+			count = list_count(object->partition_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->partition_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->qos_list)
+			count = list_count(object->qos_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->qos_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->resv_list)
+			count = list_count(object->resv_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->resv_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->resvid_list)
+			count = list_count(object->resvid_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->resvid_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->step_list)
+			count = list_count(object->step_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->step_list);
+			while ((job = list_next(itr))) {
+				slurmdb_pack_selected_step(job, protocol_version,
+							   buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->state_list)
+			count = list_count(object->state_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->state_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		pack32(object->timelimit_max, buffer);
+		pack32(object->timelimit_min, buffer);
+		pack_time(object->usage_end, buffer);
+		pack_time(object->usage_start, buffer);
+
+		packstr(object->used_nodes, buffer);
+
+		if (object->userid_list)
+			count = list_count(object->userid_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->userid_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		if (object->wckey_list)
+			count = list_count(object->wckey_list);
+		else
+			count = NO_VAL;
+		pack32(count, buffer);
+		if (count && (count != NO_VAL)) {
+			itr = list_iterator_create(object->wckey_list);
+			while ((tmp_info = list_next(itr))) {
+				packstr(tmp_info, buffer);
+			}
+			list_iterator_destroy(itr);
+		}
+
+		pack16(object->without_steps, buffer);
+		pack16(object->without_usage_truncation, buffer);
+	}
+}
+
+extern int slurmdb_unpack_job_cond(void **object, uint16_t protocol_version,
+				   Buf buffer)
+{
+	uint32_t uint32_tmp;
+	int i;
+	uint32_t count;
+	slurmdb_job_cond_t *object_ptr = xmalloc(sizeof(slurmdb_job_cond_t));
+	char *tmp_info = NULL;
+	slurmdb_selected_step_t *job = NULL;
+
+	*object = object_ptr;
+
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->acct_list = list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->acct_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->associd_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->associd_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->cluster_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->cluster_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&object_ptr->cpus_max, buffer);
+		safe_unpack32(&object_ptr->cpus_min, buffer);
+		safe_unpack16(&object_ptr->duplicates, buffer);
+		safe_unpack32(&uint32_tmp, buffer);
+		object_ptr->exitcode = (int32_t)uint32_tmp;
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->groupid_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->groupid_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->jobname_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->jobname_list, tmp_info);
+			}
+		}
+
+		safe_unpack32(&object_ptr->nodes_max, buffer);
+		safe_unpack32(&object_ptr->nodes_min, buffer);
+		safe_unpackstr_xmalloc(&object_ptr->page_cluster,
+				       &uint32_tmp, buffer);
+		safe_unpack32(&object_ptr->page_jobid, buffer);
+		safe_unpack32(&object_ptr->page_size, buffer);
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->partition_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->partition_list,
+					    tmp_info);
+			}
+		}
+
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->qos_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->qos_list,
+					    tmp_info);
+			}
 		}
 
-		if (object->resv_list)
-			count = list_count(object->resv_list);
-		else
-			count = NO_VAL;
-		pack32(count, buffer);
-		if (count && (count != NO_VAL)) {
-			itr = list_iterator_create(object->resv_list);
-			while ((tmp_info = list_next(itr))) {
-				packstr(tmp_info, buffer);
+		safe_unpack32(&count, buffer);
+		if (count != NO_VAL) {
+			object_ptr->resv_list =
+				list_create(slurm_destroy_char);
+			for (i=0; i<count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->resv_list,
+					    tmp_info);
 			}
-			list_iterator_destroy(itr);
 		}
 
-		if (object->resvid_list)
-			count = list_count(object->resvid_list);
-		else
-			count = NO_VAL;
-		pack32(count, buffer);
-		if (count && (count != NO_VAL)) {
-			itr = list_iterator_create(object->resvid_list);
-			while ((tmp_info = list_next(itr))) {
-				packstr(tmp_info, buffer);
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->resvid_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->resvid_list,
+					    tmp_info);
 			}
-			list_iterator_destroy(itr);
 		}
 
-		if (object->step_list)
-			count = list_count(object->step_list);
-		else
-			count = NO_VAL;
-		pack32(count, buffer);
-		if (count && (count != NO_VAL)) {
-			itr = list_iterator_create(object->step_list);
-			while ((job = list_next(itr))) {
-				slurmdb_pack_selected_step(job, protocol_version,
-							   buffer);
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->step_list =
+				list_create(slurmdb_destroy_selected_step);
+			for (i = 0; i < count; i++) {
+				if (slurmdb_unpack_selected_step(
+					&job, protocol_version, buffer)
+				    != SLURM_SUCCESS) {
+					error("unpacking selected step");
+					goto unpack_error;
+				}
+				/* There is no such thing as jobid 0,
+				 * if we process it the database will
+				 * return all jobs. */
+				if (!job->jobid)
+					slurmdb_destroy_selected_step(job);
+				else
+					list_append(object_ptr->step_list, job);
 			}
-			list_iterator_destroy(itr);
+			if (!list_count(object_ptr->step_list))
+				FREE_NULL_LIST(object_ptr->step_list);
 		}
 
-		if (object->state_list)
-			count = list_count(object->state_list);
-		else
-			count = NO_VAL;
-		pack32(count, buffer);
-		if (count && (count != NO_VAL)) {
-			itr = list_iterator_create(object->state_list);
-			while ((tmp_info = list_next(itr))) {
-				packstr(tmp_info, buffer);
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->state_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info,
+						       &uint32_tmp, buffer);
+				list_append(object_ptr->state_list, tmp_info);
 			}
-			list_iterator_destroy(itr);
 		}
 
-		pack32(object->timelimit_max, buffer);
-		pack32(object->timelimit_min, buffer);
-		pack_time(object->usage_end, buffer);
-		pack_time(object->usage_start, buffer);
+		safe_unpack32(&object_ptr->timelimit_max, buffer);
+		safe_unpack32(&object_ptr->timelimit_min, buffer);
+		safe_unpack_time(&object_ptr->usage_end, buffer);
+		safe_unpack_time(&object_ptr->usage_start, buffer);
 
-		packstr(object->used_nodes, buffer);
+		safe_unpackstr_xmalloc(&object_ptr->used_nodes,
+				       &uint32_tmp, buffer);
 
-		if (object->userid_list)
-			count = list_count(object->userid_list);
-		else
-			count = NO_VAL;
-		pack32(count, buffer);
-		if (count && (count != NO_VAL)) {
-			itr = list_iterator_create(object->userid_list);
-			while ((tmp_info = list_next(itr))) {
-				packstr(tmp_info, buffer);
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->userid_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->userid_list, tmp_info);
 			}
-			list_iterator_destroy(itr);
 		}
 
-		if (object->wckey_list)
-			count = list_count(object->wckey_list);
-		else
-			count = NO_VAL;
-		pack32(count, buffer);
-		if (count && (count != NO_VAL)) {
-			itr = list_iterator_create(object->wckey_list);
-			while ((tmp_info = list_next(itr))) {
-				packstr(tmp_info, buffer);
+		safe_unpack32(&count, buffer);
+		if (count > NO_VAL32)
+			goto unpack_error;
+		if (count != NO_VAL) {
+			object_ptr->wckey_list =
+				list_create(slurm_destroy_char);
+			for (i = 0; i < count; i++) {
+				safe_unpackstr_xmalloc(&tmp_info, &uint32_tmp,
+						       buffer);
+				list_append(object_ptr->wckey_list, tmp_info);
 			}
-			list_iterator_destroy(itr);
 		}
 
-		pack16(object->without_steps, buffer);
-		pack16(object->without_usage_truncation, buffer);
-	}
-}
-
-extern int slurmdb_unpack_job_cond(void **object, uint16_t protocol_version,
-				   Buf buffer)
-{
-	uint32_t uint32_tmp;
-	int i;
-	uint32_t count;
-	slurmdb_job_cond_t *object_ptr = xmalloc(sizeof(slurmdb_job_cond_t));
-	char *tmp_info = NULL;
-	slurmdb_selected_step_t *job = NULL;
-
-	*object = object_ptr;
-
-	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		safe_unpack16(&object_ptr->without_steps, buffer);
+		safe_unpack16(&object_ptr->without_usage_truncation, buffer);
+	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&count, buffer);
 		if (count > NO_VAL32)
 			goto unpack_error;
@@ -6089,7 +6634,42 @@ extern void slurmdb_pack_stats_msg(void *object, uint16_t protocol_version,
 	slurmdb_stats_rec_t *stats_ptr = (slurmdb_stats_rec_t *) object;
 	uint32_t i;
 
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		/* Rollup statistics */
+		i = 3;
+		pack32(i, buffer);
+		pack16_array(stats_ptr->rollup_count,    i, buffer);
+		pack64_array(stats_ptr->rollup_time,     i, buffer);
+		pack64_array(stats_ptr->rollup_max_time, i, buffer);
+
+		/* RPC type statistics */
+		for (i = 0; i < stats_ptr->type_cnt; i++) {
+			if (stats_ptr->rpc_type_id[i] == 0)
+				break;
+		}
+		pack32(i, buffer);
+		pack16_array(stats_ptr->rpc_type_id,   i, buffer);
+		pack32_array(stats_ptr->rpc_type_cnt,  i, buffer);
+		pack64_array(stats_ptr->rpc_type_time, i, buffer);
+
+		/* RPC user statistics */
+		for (i = 1; i < stats_ptr->user_cnt; i++) {
+			if (stats_ptr->rpc_user_id[i] == 0)
+				break;
+		}
+		pack32(i, buffer);
+		pack32_array(stats_ptr->rpc_user_id,   i, buffer);
+		pack32_array(stats_ptr->rpc_user_cnt,  i, buffer);
+		pack64_array(stats_ptr->rpc_user_time, i, buffer);
+
+		/* Storage statistics */
+		pack32(stats_ptr->batch_cnt, buffer);
+		pack64(stats_ptr->batch_rows, buffer);
+		pack64(stats_ptr->batch_time, buffer);
+		pack32(stats_ptr->commit_cnt, buffer);
+		pack64(stats_ptr->commit_time, buffer);
+		pack64(stats_ptr->commit_max_time, buffer);
+	} else if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		/* Rollup statistics */
 		i = 3;
 		pack32(i, buffer);
@@ -6130,7 +6710,62 @@ extern int slurmdb_unpack_stats_msg(void **object, uint16_t protocol_version,
 		xmalloc(sizeof(slurmdb_stats_rec_t));
 
 	*object = stats_ptr;
-	if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_17_11_PROTOCOL_VERSION) {
+		/* Rollup statistics */
+		safe_unpack32(&uint32_tmp, buffer);
+		if (uint32_tmp != 3)
+			goto unpack_error;
+		safe_unpack16_array(&stats_ptr->rollup_count, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != 3)
+			goto unpack_error;
+		safe_unpack64_array(&stats_ptr->rollup_time, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != 3)
+			goto unpack_error;
+		safe_unpack64_array(&stats_ptr->rollup_max_time, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != 3)
+			goto unpack_error;
+
+		/* RPC type statistics */
+		safe_unpack32(&stats_ptr->type_cnt, buffer);
+		safe_unpack16_array(&stats_ptr->rpc_type_id, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != stats_ptr->type_cnt)
+			goto unpack_error;
+		safe_unpack32_array(&stats_ptr->rpc_type_cnt, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != stats_ptr->type_cnt)
+			goto unpack_error;
+		safe_unpack64_array(&stats_ptr->rpc_type_time, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != stats_ptr->type_cnt)
+			goto unpack_error;
+
+		/* RPC user statistics */
+		safe_unpack32(&stats_ptr->user_cnt, buffer);
+		safe_unpack32_array(&stats_ptr->rpc_user_id, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != stats_ptr->user_cnt)
+			goto unpack_error;
+		safe_unpack32_array(&stats_ptr->rpc_user_cnt, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != stats_ptr->user_cnt)
+			goto unpack_error;
+		safe_unpack64_array(&stats_ptr->rpc_user_time, &uint32_tmp,
+				    buffer);
+		if (uint32_tmp != stats_ptr->user_cnt)
+			goto unpack_error;
+
+		/* Storage statistics */
+		safe_unpack32(&stats_ptr->batch_cnt, buffer);
+		safe_unpack64(&stats_ptr->batch_rows, buffer);
+		safe_unpack64(&stats_ptr->batch_time, buffer);
+		safe_unpack32(&stats_ptr->commit_cnt, buffer);
+		safe_unpack64(&stats_ptr->commit_time, buffer);
+		safe_unpack64(&stats_ptr->commit_max_time, buffer);
+	} else if (protocol_version >= SLURM_17_02_PROTOCOL_VERSION) {
 		/* Rollup statistics */
 		safe_unpack32(&uint32_tmp, buffer);
 		if (uint32_tmp != 3)
@@ -174,6 +174,14 @@ extern void slurmdb_pack_event_cond(void *in,
 				    uint16_t protocol_version, Buf buffer);
 extern int slurmdb_unpack_event_cond(void **object, uint16_t protocol_version,
 				     Buf buffer);
+extern void slurmdb_pack_job_aggr_cond(void *in,
+				       uint16_t protocol_version, Buf buffer);
+extern int slurmdb_unpack_job_aggr_cond(void **object,
+					uint16_t protocol_version, Buf buffer);
+extern void slurmdb_pack_job_aggr_rec(void *in,
+				      uint16_t protocol_version, Buf buffer);
+extern int slurmdb_unpack_job_aggr_rec(void **object,
+				       uint16_t protocol_version, Buf buffer);
 extern void slurmdb_pack_job_cond(void *in,
 				  uint16_t protocol_version, Buf buffer);
 extern int slurmdb_unpack_job_cond(void **object, uint16_t protocol_version,
@@ -39,11 +39,13 @@
 #include "config.h"
 
 #include <arpa/inet.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -80,6 +82,37 @@ strong_alias(slurmdbd_free_id_rc_msg,	slurm_slurmdbd_free_id_rc_msg);
 #define MAX_DBD_MSG_LEN		16384
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
 
+/* On-disk spool of the agent queue, see _spool_open() */
+#define DBD_SPOOL_MAGIC		0xDEAD3220
+#define DBD_SPOOL_REC_MAGIC	0xDEAD3221
+#define DBD_SPOOL_SEG_SIZE	(16 * 1024 * 1024)
+#define DBD_SPOOL_DONE		0x0001	/* record acknowledged by SlurmDBD */
+#define DBD_SPOOL_ALIGN(x)	(((x) + 7) & ~((uint32_t) 7))
+
+typedef struct {
+	uint32_t magic;		/* DBD_SPOOL_MAGIC */
+	uint16_t rpc_version;	/* version the records are packed with */
+	uint16_t reserved;
+	uint64_t first_seq;	/* sequence number of the first record */
+} dbd_spool_seg_hdr_t;
+
+typedef struct {
+	uint32_t magic;		/* DBD_SPOOL_REC_MAGIC, written last */
+	uint32_t size;		/* size of the packed message that follows */
+	uint64_t seq;		/* sequence number, one more than the last */
+	uint32_t cksum;		/* checksum of the packed message */
+	uint32_t flags;		/* DBD_SPOOL_DONE */
+} dbd_spool_rec_hdr_t;
+
+typedef struct {
+	uint64_t first_seq;
+	int fd;
+	char *map;		/* NULL if not mapped */
+	char *path;
+	uint16_t rpc_version;
+	uint32_t write_off;	/* end of the last record */
+} dbd_spool_seg_t;
+
 uint16_t running_cache = 0;
 pthread_mutex_t assoc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t assoc_cache_cond = PTHREAD_COND_INITIALIZER;
@@ -88,6 +121,21 @@ static pthread_mutex_t agent_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cond = PTHREAD_COND_INITIALIZER;
 static List      agent_list     = (List) NULL;
 static pthread_t agent_tid      = 0;
+static int       agent_mem_cnt  = 0;	/* records at the head of agent_list
+					 * which are not in the spool */
+
+static List      spool_segs     = NULL;	/* dbd_spool_seg_t, oldest first */
+static bool      spool_enabled  = false;
+static char *    spool_prefix   = NULL;
+static dbd_spool_seg_t *spool_tail = NULL;	/* segment being written */
+static dbd_spool_seg_t *spool_read_seg = NULL;	/* next record to read */
+static uint32_t  spool_read_off = 0;
+static uint32_t  spool_ack_off  = 0;	/* next record to acknowledge in the
+					 * head segment */
+static uint64_t  spool_next_seq = 1;
+static uint64_t  spool_first_seq = 1;	/* first record of this process */
+static uint32_t  spool_unread   = 0;	/* records not yet in agent_list */
+static uint32_t  spool_pending  = 0;	/* records not yet acknowledged */
 
 static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
@@ -100,23 +148,42 @@ static bool      from_ctld           = 0;
 static bool      need_to_register    = 0;
 static time_t    slurmdbd_shutdown   = 0;
 
+/* Second connection used by slurmctld for large read only requests, so they
+ * do not wait behind the agent's writes on slurmdbd_conn. slurmdbd serves
+ * each connection in its own thread with its own database connection.
+ * Nothing changed on the slurmdbd side: it still answers the requests of a
+ * connection one at a time, so other clients such as sacct gain nothing. */
+static pthread_mutex_t slurmdbd_read_lock = PTHREAD_MUTEX_INITIALIZER;
+static slurm_persist_conn_t *slurmdbd_read_conn = NULL;
+
 
 static void * _agent(void *x);
 static void   _create_agent(void);
 static int _unpack_config_name(char **object, uint16_t rpc_version, Buf buffer);
 static int    _get_return_code(void);
+static Buf    _agent_dequeue(void);
+static int    _agent_enqueue(Buf buffer);
 static Buf    _load_dbd_rec(int fd);
 static void   _load_dbd_state(void);
 static void   _open_slurmdbd_conn(bool db_needed);
+static void   _open_slurmdbd_read_conn(void);
 static int    _purge_step_req(void);
+static bool   _read_only_msg(uint16_t msg_type);
 static int    _purge_job_start_req(void);
 static int    _save_dbd_rec(int fd, Buf buffer);
 static void   _save_dbd_state(void);
 static int    _send_fini_msg(void);
+static int    _send_recv_msg(slurm_persist_conn_t *conn, uint16_t rpc_version,
+			     slurmdbd_msg_t *req, slurmdbd_msg_t *resp);
 static void   _sig_handler(int signal);
 static void   _shutdown_agent(void);
 static void   _slurmdbd_packstr(void *str, uint16_t rpc_version, Buf buffer);
 static int    _slurmdbd_unpackstr(void **str, uint16_t rpc_version, Buf buffer);
+static void   _spool_ack(void);
+static int    _spool_append(Buf buffer);
+static void   _spool_close(void);
+static void   _spool_open(void);
+static void   _spool_refill(void);
 
 /****************************************************************************
  * Socket open/close/read/write functions
@@ -182,11 +249,29 @@ extern int slurm_close_slurmdbd_conn(void)
 	slurmdbd_conn = NULL;
 	slurm_mutex_unlock(&slurmdbd_lock);
 
+	slurm_mutex_lock(&slurmdbd_read_lock);
+	slurm_persist_conn_destroy(slurmdbd_read_conn);
+	slurmdbd_read_conn = NULL;
+	slurm_mutex_unlock(&slurmdbd_read_lock);
+
 	slurmdbd_defs_fini();
 
 	return SLURM_SUCCESS;
 }
 
+/* Return the protocol version agreed on with the SlurmDBD */
+extern uint16_t slurm_get_slurmdbd_conn_version(void)
+{
+	uint16_t version = 0;
+
+	slurm_mutex_lock(&slurmdbd_lock);
+	if (slurmdbd_conn && (slurmdbd_conn->fd >= 0))
+		version = slurmdbd_conn->version;
+	slurm_mutex_unlock(&slurmdbd_lock);
+
+	return version;
+}
+
 /* Send an RPC to the SlurmDBD and wait for the return code reply.
  * The RPC will not be queued if an error occurs.
  * Returns SLURM_SUCCESS or an error code */
@@ -253,11 +338,29 @@ extern int slurm_send_recv_slurmdbd_msg(uint16_t rpc_version,
 					slurmdbd_msg_t *resp)
 {
 	int rc = SLURM_SUCCESS;
-	Buf buffer;
 
 	xassert(req);
 	xassert(resp);
 
+	/* While the main connection is down slurmdbd is most likely not
+	 * answering, so don't wait for the read connection to fail to open
+	 * before trying the main one. The agent can hold slurmdbd_lock for a
+	 * long time, so its connection is only peeked at. */
+	if (from_ctld && _read_only_msg(req->msg_type) &&
+	    slurmdbd_conn && (slurmdbd_conn->fd >= 0)) {
+		slurm_mutex_lock(&slurmdbd_read_lock);
+		if (!slurmdbd_read_conn || (slurmdbd_read_conn->fd < 0))
+			_open_slurmdbd_read_conn();
+		if (slurmdbd_read_conn && (slurmdbd_read_conn->fd >= 0)) {
+			rc = _send_recv_msg(slurmdbd_read_conn, rpc_version,
+					    req, resp);
+			slurm_mutex_unlock(&slurmdbd_read_lock);
+			return rc;
+		}
+		slurm_mutex_unlock(&slurmdbd_read_lock);
+		/* fall back to the agent's connection */
+	}
+
 	/* To make sure we can get this to send instead of the agent
 	   sending stuff that can happen anytime we set halt_agent and
 	   then after we get into the mutex we unset.
@@ -278,33 +381,7 @@ extern int slurm_send_recv_slurmdbd_msg(uint16_t rpc_version,
 		}
 	}
 
-	if (!(buffer = pack_slurmdbd_msg(req, rpc_version))) {
-		rc = SLURM_ERROR;
-		goto end_it;
-	}
-
-	rc = slurm_persist_send_msg(slurmdbd_conn, buffer);
-	free_buf(buffer);
-	if (rc != SLURM_SUCCESS) {
-		error("slurmdbd: Sending message type %s: %d: %m",
-		      rpc_num2string(req->msg_type), rc);
-		goto end_it;
-	}
-
-	buffer = slurm_persist_recv_msg(slurmdbd_conn);
-	if (buffer == NULL) {
-		error("slurmdbd: Getting response to message type %u",
-		      req->msg_type);
-		rc = SLURM_ERROR;
-		goto end_it;
-	}
-
-	rc = unpack_slurmdbd_msg(resp, rpc_version, buffer);
-	/* check for the rc of the start job message */
-	if (rc == SLURM_SUCCESS && resp->msg_type == DBD_ID_RC)
-		rc = ((dbd_id_rc_msg_t *)resp->data)->return_code;
-
-	free_buf(buffer);
+	rc = _send_recv_msg(slurmdbd_conn, rpc_version, req, resp);
 end_it:
 	slurm_cond_signal(&slurmdbd_cond);
 	slurm_mutex_unlock(&slurmdbd_lock);
@@ -346,7 +423,7 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 			return SLURM_ERROR;
 		}
 	}
-	cnt = list_count(agent_list);
+	cnt = list_count(agent_list) + spool_unread;
 	if ((cnt >= (max_agent_queue / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
@@ -356,20 +433,33 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 		if (slurmdbd_conn->trigger_callbacks.dbd_fail)
 			(slurmdbd_conn->trigger_callbacks.dbd_fail)();
 	}
+	if (spool_enabled) {
+		/* The spool is only bounded by the file system */
+		if (_agent_enqueue(buffer) != SLURM_SUCCESS) {
+			error("slurmdbd: agent queue spool is full, "
+			      "discarding request");
+			free_buf(buffer);
+			if (slurmdbd_conn->trigger_callbacks.acct_full)
+				(slurmdbd_conn->trigger_callbacks.acct_full)();
+			rc = SLURM_ERROR;
+		}
+		goto end_it;
+	}
 	if (cnt == (max_agent_queue - 1))
 		cnt -= _purge_step_req();
 	if (cnt == (max_agent_queue - 1))
 		cnt -= _purge_job_start_req();
 	if (cnt < max_agent_queue) {
-		if (list_enqueue(agent_list, buffer) == NULL)
-			fatal("list_enqueue: memory allocation failure");
+		(void) _agent_enqueue(buffer);
 	} else {
 		error("slurmdbd: agent queue is full, discarding request");
+		free_buf(buffer);
 		if (slurmdbd_conn->trigger_callbacks.acct_full)
 			(slurmdbd_conn->trigger_callbacks.acct_full)();
 		rc = SLURM_ERROR;
 	}
 
+end_it:
 	slurm_cond_broadcast(&agent_cond);
 	slurm_mutex_unlock(&agent_lock);
 	return rc;
@@ -491,6 +581,116 @@ again:
 	}
 }
 
+/* Open slurmdbd_read_conn. Unlike _open_slurmdbd_conn() this connection
+ * never registers the cluster and has no trigger callbacks, it is only a
+ * second path into slurmdbd for read only requests. */
+static void _open_slurmdbd_read_conn(void)
+{
+	int rc;
+
+	slurm_persist_conn_close(slurmdbd_read_conn);
+	if (!slurmdbd_read_conn) {
+		slurmdbd_read_conn = xmalloc(sizeof(slurm_persist_conn_t));
+		slurmdbd_read_conn->flags =
+			PERSIST_FLAG_DBD | PERSIST_FLAG_RECONNECT;
+		slurmdbd_read_conn->cluster_name = xstrdup(slurmdbd_cluster);
+		slurmdbd_read_conn->rem_port =
+			slurm_get_accounting_storage_port();
+		if (!slurmdbd_read_conn->rem_port)
+			slurmdbd_read_conn->rem_port = SLURMDBD_PORT;
+	}
+	slurmdbd_read_conn->shutdown = &slurmdbd_shutdown;
+	slurmdbd_read_conn->version  = SLURM_PROTOCOL_VERSION;
+	slurmdbd_read_conn->timeout = (slurm_get_msg_timeout() + 35) * 1000;
+
+	xfree(slurmdbd_read_conn->rem_host);
+	slurmdbd_read_conn->rem_host = slurm_get_accounting_storage_host();
+	if (!slurmdbd_read_conn->rem_host)
+		slurmdbd_read_conn->rem_host = xstrdup(DEFAULT_STORAGE_HOST);
+
+	if ((rc = slurm_persist_conn_open(slurmdbd_read_conn))
+	    != SLURM_SUCCESS) {
+		xfree(slurmdbd_read_conn->rem_host);
+		if ((slurmdbd_read_conn->rem_host =
+		     slurm_get_accounting_storage_backup_host()))
+			rc = slurm_persist_conn_open(slurmdbd_read_conn);
+	}
+
+	if (rc == SLURM_SUCCESS) {
+		slurmdbd_read_conn->timeout = SLURMDBD_TIMEOUT * 1000;
+		debug("slurmdbd: opened read only connection to %s",
+		      slurmdbd_read_conn->rem_host);
+	} else {
+		debug("slurmdbd: unable to open read only connection: %m");
+		slurm_persist_conn_close(slurmdbd_read_conn);
+	}
+	errno = 0;
+}
+
+/* Requests slurmctld may send over slurmdbd_read_conn. slurmctld never reads
+ * back its own writes with these, which matters when slurmdbd delays the
+ * commit of the agent's connection (CommitDelay). DBD_GET_TRES and
+ * DBD_GET_RESVS are left out as slurmctld adds those records itself. */
+static bool _read_only_msg(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case DBD_GET_ACCOUNTS:
+	case DBD_GET_ASSOCS:
+	case DBD_GET_ASSOC_USAGE:
+	case DBD_GET_CLUSTERS:
+	case DBD_GET_CLUSTER_USAGE:
+	case DBD_GET_EVENTS:
+	case DBD_GET_FEDERATIONS:
+	case DBD_GET_JOBS_AGGR:
+	case DBD_GET_JOBS_COND:
+	case DBD_GET_PROBS:
+	case DBD_GET_QOS:
+	case DBD_GET_RES:
+	case DBD_GET_TXN:
+	case DBD_GET_USERS:
+	case DBD_GET_WCKEYS:
+	case DBD_GET_WCKEY_USAGE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Send req over conn and wait for the reply, the caller holds the lock
+ * of conn. */
+static int _send_recv_msg(slurm_persist_conn_t *conn, uint16_t rpc_version,
+			  slurmdbd_msg_t *req, slurmdbd_msg_t *resp)
+{
+	int rc;
+	Buf buffer;
+
+	if (!(buffer = pack_slurmdbd_msg(req, rpc_version)))
+		return SLURM_ERROR;
+
+	rc = slurm_persist_send_msg(conn, buffer);
+	free_buf(buffer);
+	if (rc != SLURM_SUCCESS) {
+		error("slurmdbd: Sending message type %s: %d: %m",
+		      rpc_num2string(req->msg_type), rc);
+		return rc;
+	}
+
+	buffer = slurm_persist_recv_msg(conn);
+	if (buffer == NULL) {
+		error("slurmdbd: Getting response to message type %u",
+		      req->msg_type);
+		return SLURM_ERROR;
+	}
+
+	rc = unpack_slurmdbd_msg(resp, rpc_version, buffer);
+	/* check for the rc of the start job message */
+	if (rc == SLURM_SUCCESS && resp->msg_type == DBD_ID_RC)
+		rc = ((dbd_id_rc_msg_t *)resp->data)->return_code;
+
+	free_buf(buffer);
+	return rc;
+}
+
 extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version)
 {
 	Buf buffer;
@@ -525,6 +725,7 @@ extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version)
 	case DBD_GOT_EVENTS:
 	case DBD_GOT_FEDERATIONS:
 	case DBD_GOT_JOBS:
+	case DBD_GOT_JOBS_AGGR:
 	case DBD_GOT_LIST:
 	case DBD_GOT_PROBS:
 	case DBD_GOT_RES:
@@ -566,6 +767,7 @@ extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version)
 	case DBD_GET_CLUSTERS:
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
+	case DBD_GET_JOBS_AGGR:
 	case DBD_GET_JOBS_COND:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
@@ -731,6 +933,7 @@ extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 	case DBD_GOT_EVENTS:
 	case DBD_GOT_FEDERATIONS:
 	case DBD_GOT_JOBS:
+	case DBD_GOT_JOBS_AGGR:
 	case DBD_GOT_LIST:
 	case DBD_GOT_PROBS:
 	case DBD_ADD_QOS:
@@ -773,6 +976,7 @@ extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 	case DBD_GET_CLUSTERS:
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
+	case DBD_GET_JOBS_AGGR:
 	case DBD_GET_JOBS_COND:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
@@ -973,6 +1177,8 @@ extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type)
 		return DBD_GOT_FEDERATIONS;
 	} else if (!xstrcasecmp(msg_type, "Got Jobs")) {
 		return DBD_GOT_JOBS;
+	} else if (!xstrcasecmp(msg_type, "Got Jobs Aggregate")) {
+		return DBD_GOT_JOBS_AGGR;
 	} else if (!xstrcasecmp(msg_type, "Got List")) {
 		return DBD_GOT_LIST;
 	} else if (!xstrcasecmp(msg_type, "Got Problems")) {
@@ -1035,6 +1241,8 @@ extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type)
 		return DBD_STEP_START;
 	} else if (!xstrcasecmp(msg_type, "Get Jobs Conditional")) {
 		return DBD_GET_JOBS_COND;
+	} else if (!xstrcasecmp(msg_type, "Get Jobs Aggregate")) {
+		return DBD_GET_JOBS_AGGR;
 	} else if (!xstrcasecmp(msg_type, "Get Transactions")) {
 		return DBD_GET_TXN;
 	} else if (!xstrcasecmp(msg_type, "Got Transactions")) {
@@ -1291,6 +1499,12 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Got Jobs";
 		break;
+	case DBD_GOT_JOBS_AGGR:
+		if (get_enum) {
+			return "DBD_GOT_JOBS_AGGR";
+		} else
+			return "Got Jobs Aggregate";
+		break;
 	case DBD_GOT_LIST:
 		if (get_enum) {
 			return "DBD_GOT_LIST";
@@ -1477,6 +1691,12 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Get Jobs Conditional";
 		break;
+	case DBD_GET_JOBS_AGGR:
+		if (get_enum) {
+			return "DBD_GET_JOBS_AGGR";
+		} else
+			return "Get Jobs Aggregate";
+		break;
 	case DBD_GET_TXN:
 		if (get_enum) {
 			return "DBD_GET_TXN";
@@ -1798,7 +2018,7 @@ static int _handle_mult_rc_ret(void)
 				    != SLURM_SUCCESS)
 					break;
 
-				if ((b = list_dequeue(agent_list))) {
+				if ((b = _agent_dequeue())) {
 					free_buf(b);
 				} else {
 					error("slurmdbd: DBD_GOT_MULT_MSG "
@@ -1864,7 +2084,11 @@ static void _create_agent(void)
 
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
+		agent_mem_cnt = 0;
+		/* Records saved at shutdown are older than those in the
+		 * spool, so load them first */
 		_load_dbd_state();
+		_spool_open();
 	}
 
 	if (agent_tid == 0) {
@@ -1953,6 +2177,8 @@ static void *_agent(void *x)
 		}
 
 		slurm_mutex_lock(&agent_lock);
+		if (agent_list && spool_unread)
+			_spool_refill();
 		if (agent_list && slurmdbd_conn->fd)
 			cnt = list_count(agent_list);
 		else
@@ -2046,7 +2272,7 @@ static void *_agent(void *x)
 					FREE_NULL_LIST(list_msg.my_list);
 				list_msg.my_list = NULL;
 			} else
-				buffer = (Buf) list_dequeue(agent_list);
+				buffer = _agent_dequeue();
 
 			free_buf(buffer);
 			fail_time = 0;
@@ -2079,7 +2305,9 @@ static void *_agent(void *x)
 
 	slurm_mutex_lock(&agent_lock);
 	_save_dbd_state();
+	_spool_close();
 	FREE_NULL_LIST(agent_list);
+	agent_mem_cnt = 0;
 	slurm_mutex_unlock(&agent_lock);
 	return NULL;
 }
@@ -2098,7 +2326,7 @@ static void _save_dbd_state(void)
 	fd = open(dbd_fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
 	if (fd < 0) {
 		error("slurmdbd: Creating state save file %s", dbd_fname);
-	} else if (agent_list && list_count(agent_list)) {
+	} else if (agent_list && agent_mem_cnt) {
 		char curr_ver_str[10];
 		snprintf(curr_ver_str, sizeof(curr_ver_str),
 			 "VER%d", SLURM_PROTOCOL_VERSION);
@@ -2109,7 +2337,9 @@ static void _save_dbd_state(void)
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
 
-		while ((buffer = list_dequeue(agent_list))) {
+		/* Records after the first agent_mem_cnt are in the spool */
+		while (agent_mem_cnt && (buffer = list_dequeue(agent_list))) {
+			agent_mem_cnt--;
 			/* We do not want to store registration
 			   messages.  If an admin puts in an incorrect
 			   cluster name we can get a deadlock unless
@@ -2214,8 +2444,11 @@ static void _load_dbd_state(void)
 				error("no buffer given");
 				continue;
 			}
-			if (!list_enqueue(agent_list, buffer))
-				fatal("slurmdbd: list_enqueue, no memory");
+			if (_agent_enqueue(buffer) != SLURM_SUCCESS) {
+				free_buf(buffer);
+				buffer = NULL;
+				continue;
+			}
 			recovered++;
 			buffer = NULL;
 		}
@@ -2343,6 +2576,7 @@ static int _purge_step_req(void)
 		}
 	}
 	list_iterator_destroy(iter);
+	agent_mem_cnt -= purged;	/* not called with the spool in use */
 	info("slurmdbd: purge %d step records", purged);
 	return purged;
 }
@@ -2371,10 +2605,501 @@ static int _purge_job_start_req(void)
 		}
 	}
 	list_iterator_destroy(iter);
+	agent_mem_cnt -= purged;	/* not called with the spool in use */
 	info("slurmdbd: purge %d job start records", purged);
 	return purged;
 }
 
+/* Add a record to the agent queue, in memory if no older record is in the
+ * spool and there is room, else in the spool. Consumes buffer on success. */
+static int _agent_enqueue(Buf buffer)
+{
+	if (spool_enabled &&
+	    (spool_pending || (list_count(agent_list) >= MAX_AGENT_QUEUE)))
+		return _spool_append(buffer);
+
+	if (list_enqueue(agent_list, buffer) == NULL)
+		fatal("list_enqueue: memory allocation failure");
+	agent_mem_cnt++;
+	return SLURM_SUCCESS;
+}
+
+/* Remove the record at the head of the agent queue once it has been
+ * processed by the SlurmDBD */
+static Buf _agent_dequeue(void)
+{
+	Buf buffer = (Buf) list_dequeue(agent_list);
+
+	if (!buffer)
+		return NULL;
+	if (agent_mem_cnt)
+		agent_mem_cnt--;
+	else if (spool_enabled)
+		_spool_ack();
+	return buffer;
+}
+
+/****************************************************************************
+ * On-disk spool of the agent queue
+ *
+ * Once MAX_AGENT_QUEUE records are waiting in agent_list, new records are
+ * appended to the spool instead: segment files named
+ * StateSaveLocation/dbd.spool.<first sequence number>, each of
+ * DBD_SPOOL_SEG_SIZE bytes and mapped while in use. The agent moves records
+ * back into agent_list as it drains and marks them DBD_SPOOL_DONE once the
+ * SlurmDBD has them. Segments holding only such records are removed, so
+ * the memory used stays the same however long the SlurmDBD is down.
+ *
+ * A record's magic is written last and its contents are checksummed, so a
+ * record torn by a crash is found and dropped with the ones after it when
+ * the spool is recovered. Records not marked DBD_SPOOL_DONE are sent again.
+ ****************************************************************************/
+static uint32_t _spool_cksum(const char *data, uint32_t size)
+{
+	uint32_t i, cksum = 2166136261U;	/* FNV-1a */
+
+	for (i = 0; i < size; i++) {
+		cksum ^= (uint8_t) data[i];
+		cksum *= 16777619;
+	}
+	return cksum;
+}
+
+static void _spool_map(dbd_spool_seg_t *seg)
+{
+	if (seg->map)
+		return;
+	seg->map = mmap(NULL, DBD_SPOOL_SEG_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, seg->fd, 0);
+	if (seg->map == MAP_FAILED)
+		fatal("slurmdbd: mmap(%s): %m", seg->path);
+}
+
+static void _spool_unmap(dbd_spool_seg_t *seg)
+{
+	if (!seg->map)
+		return;
+	(void) msync(seg->map, DBD_SPOOL_SEG_SIZE, MS_ASYNC);
+	(void) munmap(seg->map, DBD_SPOOL_SEG_SIZE);
+	seg->map = NULL;
+}
+
+static void _spool_free_seg(void *x)
+{
+	dbd_spool_seg_t *seg = (dbd_spool_seg_t *) x;
+
+	_spool_unmap(seg);
+	(void) close(seg->fd);
+	xfree(seg->path);
+	xfree(seg);
+}
+
+static int _find_seg_after(void *x, void *key)
+{
+	dbd_spool_seg_t *seg = (dbd_spool_seg_t *) x;
+	uint64_t *first_seq = (uint64_t *) key;
+
+	if (seg->first_seq > *first_seq)
+		return 1;
+	return 0;
+}
+
+/* Remove the head segment, all of its records have been acknowledged */
+static void _spool_delete_head(void)
+{
+	dbd_spool_seg_t *seg = (dbd_spool_seg_t *) list_pop(spool_segs);
+
+	if (spool_read_seg == seg) {
+		spool_read_seg = (dbd_spool_seg_t *) list_peek(spool_segs);
+		spool_read_off = sizeof(dbd_spool_seg_hdr_t);
+		if (spool_read_seg)
+			_spool_map(spool_read_seg);
+	}
+	if (spool_tail == seg)
+		spool_tail = NULL;
+	spool_ack_off = sizeof(dbd_spool_seg_hdr_t);
+
+	debug2("slurmdbd: removing agent queue spool %s", seg->path);
+	(void) unlink(seg->path);
+	_spool_free_seg(seg);
+}
+
+static dbd_spool_seg_t *_spool_new_seg(void)
+{
+	dbd_spool_seg_t *seg;
+	dbd_spool_seg_hdr_t *hdr;
+	char *path;
+	int fd, err;
+
+	path = xstrdup_printf("%s%020"PRIu64, spool_prefix, spool_next_seq);
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		error("slurmdbd: creating agent queue spool %s: %m", path);
+		xfree(path);
+		return NULL;
+	}
+	/* Allocate the blocks now, writing to a hole of a full file
+	 * system through the mapping would raise SIGBUS */
+	if ((err = posix_fallocate(fd, 0, DBD_SPOOL_SEG_SIZE))) {
+		error("slurmdbd: allocating agent queue spool %s: %s",
+		      path, strerror(err));
+		(void) close(fd);
+		(void) unlink(path);
+		xfree(path);
+		return NULL;
+	}
+
+	seg = xmalloc(sizeof(dbd_spool_seg_t));
+	seg->fd = fd;
+	seg->path = path;
+	seg->first_seq = spool_next_seq;
+	seg->rpc_version = SLURM_PROTOCOL_VERSION;
+	seg->write_off = sizeof(dbd_spool_seg_hdr_t);
+	_spool_map(seg);
+	hdr = (dbd_spool_seg_hdr_t *) seg->map;
+	hdr->rpc_version = seg->rpc_version;
+	hdr->first_seq = seg->first_seq;
+	hdr->magic = DBD_SPOOL_MAGIC;
+
+	list_append(spool_segs, seg);
+	if (!spool_read_seg) {
+		spool_read_seg = seg;
+		spool_read_off = sizeof(dbd_spool_seg_hdr_t);
+	}
+	if (list_count(spool_segs) == 1)
+		spool_ack_off = sizeof(dbd_spool_seg_hdr_t);
+	debug("slurmdbd: created agent queue spool %s", path);
+
+	return seg;
+}
+
+/* Stop writing to the tail segment */
+static void _spool_seal(void)
+{
+	dbd_spool_seg_t *seg = spool_tail;
+
+	spool_tail = NULL;
+	if ((seg == list_peek(spool_segs)) && (spool_ack_off >= seg->write_off))
+		_spool_delete_head();
+	else if (seg != spool_read_seg)
+		_spool_unmap(seg);
+	else
+		(void) msync(seg->map, DBD_SPOOL_SEG_SIZE, MS_ASYNC);
+}
+
+/* Append a record to the spool. Consumes buffer on success. */
+static int _spool_append(Buf buffer)
+{
+	dbd_spool_rec_hdr_t *rec;
+	uint32_t size = get_buf_offset(buffer);
+	uint32_t need = DBD_SPOOL_ALIGN(sizeof(dbd_spool_rec_hdr_t) + size);
+
+	if (need > (DBD_SPOOL_SEG_SIZE - sizeof(dbd_spool_seg_hdr_t))) {
+		error("slurmdbd: message of %u bytes too large for spool", size);
+		return SLURM_ERROR;
+	}
+	if (spool_tail && ((spool_tail->write_off + need) > DBD_SPOOL_SEG_SIZE))
+		_spool_seal();
+	if (!spool_tail && !(spool_tail = _spool_new_seg()))
+		return SLURM_ERROR;
+
+	rec = (dbd_spool_rec_hdr_t *) (spool_tail->map + spool_tail->write_off);
+	memcpy(rec + 1, get_buf_data(buffer), size);
+	rec->size = size;
+	rec->seq = spool_next_seq++;
+	rec->cksum = _spool_cksum((char *) (rec + 1), size);
+	rec->flags = 0;
+	__sync_synchronize();
+	rec->magic = DBD_SPOOL_REC_MAGIC;
+	spool_tail->write_off += need;
+	spool_unread++;
+	spool_pending++;
+
+	free_buf(buffer);
+	return SLURM_SUCCESS;
+}
+
+/* Read the next record of the spool not yet in agent_list */
+static Buf _spool_read(void)
+{
+	dbd_spool_seg_t *seg;
+	dbd_spool_rec_hdr_t *rec;
+	slurmdbd_msg_t msg;
+	uint16_t msg_type;
+	Buf buffer;
+	int rc;
+
+	while (spool_unread) {
+		seg = spool_read_seg;
+		if (spool_read_off >= seg->write_off) {
+			seg = list_find_first(spool_segs, _find_seg_after,
+					      &seg->first_seq);
+			if (!seg) {
+				error("slurmdbd: agent queue spool has %u "
+				      "records less than expected",
+				      spool_unread);
+				spool_pending -= spool_unread;
+				spool_unread = 0;
+				break;
+			}
+			_spool_map(seg);
+			spool_read_seg = seg;
+			spool_read_off = sizeof(dbd_spool_seg_hdr_t);
+			continue;
+		}
+
+		rec = (dbd_spool_rec_hdr_t *) (seg->map + spool_read_off);
+		spool_read_off += DBD_SPOOL_ALIGN(sizeof(dbd_spool_rec_hdr_t) +
+						  rec->size);
+		if (rec->flags & DBD_SPOOL_DONE)
+			continue;
+		spool_unread--;
+
+		buffer = init_buf(rec->size);
+		memcpy(get_buf_data(buffer), rec + 1, rec->size);
+		set_buf_offset(buffer, rec->size);
+
+		/* As in _save_dbd_state(), registrations are not sent again
+		 * after a restart */
+		if ((rec->seq < spool_first_seq) && (rec->size >= 2)) {
+			set_buf_offset(buffer, 0);
+			unpack16(&msg_type, buffer);
+			set_buf_offset(buffer, rec->size);
+			if (msg_type == DBD_REGISTER_CTLD) {
+				free_buf(buffer);
+				rec->flags |= DBD_SPOOL_DONE;
+				spool_pending--;
+				continue;
+			}
+		}
+		if (seg->rpc_version != SLURM_PROTOCOL_VERSION) {
+			set_buf_offset(buffer, 0);
+			rc = unpack_slurmdbd_msg(&msg, seg->rpc_version, buffer);
+			free_buf(buffer);
+			if (rc != SLURM_SUCCESS) {
+				error("slurmdbd: can not unpack spooled "
+				      "record %"PRIu64, rec->seq);
+				rec->flags |= DBD_SPOOL_DONE;
+				spool_pending--;
+				continue;
+			}
+			buffer = pack_slurmdbd_msg(&msg, SLURM_PROTOCOL_VERSION);
+		}
+		return buffer;
+	}
+
+	return NULL;
+}
+
+/* Move records from the spool to agent_list */
+static void _spool_refill(void)
+{
+	Buf buffer;
+
+	while ((list_count(agent_list) < MAX_AGENT_QUEUE) &&
+	       (buffer = _spool_read())) {
+		if (list_enqueue(agent_list, buffer) == NULL)
+			fatal("list_enqueue: memory allocation failure");
+	}
+}
+
+/* Mark the oldest spooled record not yet acknowledged as done */
+static void _spool_ack(void)
+{
+	dbd_spool_seg_t *seg;
+	dbd_spool_rec_hdr_t *rec;
+
+	while ((seg = (dbd_spool_seg_t *) list_peek(spool_segs))) {
+		if (spool_ack_off >= seg->write_off) {
+			if (seg == spool_tail)
+				break;
+			_spool_delete_head();
+			continue;
+		}
+		rec = (dbd_spool_rec_hdr_t *) (seg->map + spool_ack_off);
+		spool_ack_off += DBD_SPOOL_ALIGN(sizeof(dbd_spool_rec_hdr_t) +
+						 rec->size);
+		if (rec->flags & DBD_SPOOL_DONE)
+			continue;
+		rec->flags |= DBD_SPOOL_DONE;
+		spool_pending--;
+		if ((spool_ack_off >= seg->write_off) && (seg != spool_tail))
+			_spool_delete_head();
+		return;
+	}
+	error("slurmdbd: no spooled record to acknowledge");
+}
+
+/* Validate the records of a spool segment found at startup.
+ * RET the segment or NULL if not usable, set pending to the count of
+ * records to send again and first_off to the offset of the first one */
+static dbd_spool_seg_t *_spool_recover_seg(char *path, uint32_t *pending,
+					   uint32_t *first_off)
+{
+	dbd_spool_seg_t *seg;
+	dbd_spool_seg_hdr_t *hdr;
+	dbd_spool_rec_hdr_t *rec;
+	struct stat stat_buf;
+	uint32_t off = sizeof(dbd_spool_seg_hdr_t), left;
+	uint64_t seq;
+	int fd;
+	bool torn = false;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		error("slurmdbd: opening agent queue spool %s: %m", path);
+		return NULL;
+	}
+	if ((fstat(fd, &stat_buf) < 0) ||
+	    (stat_buf.st_size != DBD_SPOOL_SEG_SIZE)) {
+		error("slurmdbd: agent queue spool %s has a bad size, ignored",
+		      path);
+		(void) close(fd);
+		return NULL;
+	}
+
+	seg = xmalloc(sizeof(dbd_spool_seg_t));
+	seg->fd = fd;
+	seg->path = xstrdup(path);
+	_spool_map(seg);
+	hdr = (dbd_spool_seg_hdr_t *) seg->map;
+	if (hdr->magic != DBD_SPOOL_MAGIC) {
+		error("slurmdbd: agent queue spool %s has a bad header, "
+		      "ignored", path);
+		_spool_free_seg(seg);
+		return NULL;
+	}
+	seg->first_seq = hdr->first_seq;
+	seg->rpc_version = hdr->rpc_version;
+
+	*pending = 0;
+	*first_off = 0;
+	seq = seg->first_seq;
+	while ((left = DBD_SPOOL_SEG_SIZE - off) >
+	       sizeof(dbd_spool_rec_hdr_t)) {
+		rec = (dbd_spool_rec_hdr_t *) (seg->map + off);
+		if ((rec->magic != DBD_SPOOL_REC_MAGIC) || (rec->seq != seq) ||
+		    (rec->size > (left - sizeof(dbd_spool_rec_hdr_t))) ||
+		    (rec->cksum != _spool_cksum((char *) (rec + 1),
+						rec->size))) {
+			/* so that a torn record can not look valid once
+			 * written over, if this is the tail */
+			torn = (rec->magic != 0);
+			memset(rec, 0, sizeof(dbd_spool_rec_hdr_t));
+			break;
+		}
+		if (!(rec->flags & DBD_SPOOL_DONE)) {
+			if (!*pending)
+				*first_off = off;
+			(*pending)++;
+		}
+		off += DBD_SPOOL_ALIGN(sizeof(dbd_spool_rec_hdr_t) + rec->size);
+		seq++;
+	}
+	if (torn)
+		error("slurmdbd: agent queue spool %s is truncated after "
+		      "record %"PRIu64, path, seq - 1);
+	seg->write_off = off;
+	if (seq > spool_next_seq)
+		spool_next_seq = seq;
+
+	return seg;
+}
+
+static int _spool_select(const struct dirent *ent)
+{
+	if (!strncmp(ent->d_name, "dbd.spool.", 10))
+		return 1;
+	return 0;
+}
+
+/* Open the spool, recovering the records left by an earlier slurmctld */
+static void _spool_open(void)
+{
+	dbd_spool_seg_t *seg, *last = NULL;
+	struct dirent **names = NULL;
+	char *dir, *path;
+	uint32_t pending, first_off;
+	int i, cnt;
+
+	if (spool_enabled)
+		return;
+
+	dir = slurm_get_state_save_location();
+	cnt = scandir(dir, &names, _spool_select, alphasort);
+	if (cnt < 0) {
+		error("slurmdbd: scandir(%s): %m, agent queue spool disabled",
+		      dir);
+		xfree(dir);
+		return;
+	}
+
+	spool_prefix = xstrdup_printf("%s/dbd.spool.", dir);
+	spool_segs = list_create(_spool_free_seg);
+	spool_next_seq = 1;
+	spool_tail = spool_read_seg = NULL;
+	spool_unread = spool_pending = 0;
+	for (i = 0; i < cnt; i++) {
+		path = xstrdup_printf("%s/%s", dir, names[i]->d_name);
+		free(names[i]);
+		seg = _spool_recover_seg(path, &pending, &first_off);
+		if (seg && !pending) {
+			(void) unlink(path);
+			_spool_free_seg(seg);
+		} else if (seg) {
+			if (!spool_read_seg) {
+				spool_read_seg = seg;
+				spool_read_off = first_off;
+				spool_ack_off = first_off;
+			} else
+				_spool_unmap(seg);
+			list_append(spool_segs, seg);
+			spool_pending += pending;
+			last = seg;
+		}
+		xfree(path);
+	}
+	free(names);
+	xfree(dir);
+
+	/* Keep writing to the last segment if its records are current */
+	if (last && (last->rpc_version == SLURM_PROTOCOL_VERSION)) {
+		_spool_map(last);
+		spool_tail = last;
+	}
+	spool_unread = spool_pending;
+	spool_first_seq = spool_next_seq;
+	spool_enabled = true;
+	if (spool_pending)
+		verbose("slurmdbd: recovered %u pending RPCs from the spool",
+			spool_pending);
+}
+
+static void _spool_close(void)
+{
+	ListIterator itr;
+	dbd_spool_seg_t *seg;
+
+	if (!spool_enabled)
+		return;
+
+	itr = list_iterator_create(spool_segs);
+	while ((seg = list_next(itr))) {
+		if (seg->map)
+			(void) msync(seg->map, DBD_SPOOL_SEG_SIZE, MS_SYNC);
+	}
+	list_iterator_destroy(itr);
+	if (spool_pending)
+		verbose("slurmdbd: left %u pending RPCs in the spool",
+			spool_pending);
+
+	FREE_NULL_LIST(spool_segs);
+	xfree(spool_prefix);
+	spool_tail = spool_read_seg = NULL;
+	spool_unread = spool_pending = 0;
+	spool_enabled = false;
+}
+
 /****************************************************************************\
  * Free data structures
 \****************************************************************************/
@@ -2413,6 +3138,7 @@ extern void slurmdbd_free_msg(slurmdbd_msg_t *msg)
 	case DBD_GOT_EVENTS:
 	case DBD_GOT_FEDERATIONS:
 	case DBD_GOT_JOBS:
+	case DBD_GOT_JOBS_AGGR:
 	case DBD_GOT_LIST:
 	case DBD_GOT_PROBS:
 	case DBD_GOT_RES:
@@ -2448,6 +3174,7 @@ extern void slurmdbd_free_msg(slurmdbd_msg_t *msg)
 	case DBD_GET_CLUSTERS:
 	case DBD_GET_EVENTS:
 	case DBD_GET_FEDERATIONS:
+	case DBD_GET_JOBS_AGGR:
 	case DBD_GET_JOBS_COND:
 	case DBD_GET_PROBS:
 	case DBD_GET_QOS:
@@ -2586,6 +3313,9 @@ extern void slurmdbd_free_cond_msg(dbd_cond_msg_t *msg,
 		case DBD_REMOVE_FEDERATIONS:
 			my_destroy = slurmdb_destroy_federation_cond;
 			break;
+		case DBD_GET_JOBS_AGGR:
+			my_destroy = slurmdb_destroy_job_aggr_cond;
+			break;
 		case DBD_GET_JOBS_COND:
 			my_destroy = slurmdb_destroy_job_cond;
 			break;
@@ -2986,6 +3716,9 @@ extern void slurmdbd_pack_cond_msg(dbd_cond_msg_t *msg,
 	case DBD_REMOVE_FEDERATIONS:
 		my_function = slurmdb_pack_federation_cond;
 		break;
+	case DBD_GET_JOBS_AGGR:
+		my_function = slurmdb_pack_job_aggr_cond;
+		break;
 	case DBD_GET_JOBS_COND:
 		my_function = slurmdb_pack_job_cond;
 		break;
@@ -3053,6 +3786,9 @@ extern int slurmdbd_unpack_cond_msg(dbd_cond_msg_t **msg,
 	case DBD_REMOVE_FEDERATIONS:
 		my_function = slurmdb_unpack_federation_cond;
 		break;
+	case DBD_GET_JOBS_AGGR:
+		my_function = slurmdb_unpack_job_aggr_cond;
+		break;
 	case DBD_GET_JOBS_COND:
 		my_function = slurmdb_unpack_job_cond;
 		break;
@@ -3632,6 +4368,9 @@ extern void slurmdbd_pack_list_msg(dbd_list_msg_t *msg,
 	case DBD_GOT_CONFIG:
 		my_function = pack_config_key_pair;
 		break;
+	case DBD_GOT_JOBS_AGGR:
+		my_function = slurmdb_pack_job_aggr_rec;
+		break;
 	case DBD_GOT_JOBS:
 	case DBD_FIX_RUNAWAY_JOB:
 		my_function = slurmdb_pack_job_rec;
@@ -3738,6 +4477,10 @@ extern int slurmdbd_unpack_list_msg(dbd_list_msg_t **msg, uint16_t rpc_version,
 		my_function = unpack_config_key_pair;
 		my_destroy = destroy_config_key_pair;
 		break;
+	case DBD_GOT_JOBS_AGGR:
+		my_function = slurmdb_unpack_job_aggr_rec;
+		my_destroy = slurmdb_destroy_job_aggr_rec;
+		break;
 	case DBD_GOT_JOBS:
 	case DBD_FIX_RUNAWAY_JOB:
 		my_function = slurmdb_unpack_job_rec;
@@ -155,6 +155,8 @@ typedef enum {
 	DBD_GOT_FEDERATIONS,	/* Response to DBD_GET_FEDERATIONS 	*/
 	DBD_MODIFY_FEDERATIONS, /* Modify existing federation 		*/
 	DBD_REMOVE_FEDERATIONS, /* Removing existing federation 	*/
+	DBD_GET_JOBS_AGGR,	/* Get job totals grouped in the storage */
+	DBD_GOT_JOBS_AGGR,	/* Response to DBD_GET_JOBS_AGGR	*/
 
 	SLURM_PERSIST_INIT = 6500, /* So we don't use the
 				    * REQUEST_PERSIST_INIT also used here.
@@ -410,6 +412,10 @@ extern int slurm_open_slurmdbd_conn(const slurm_trigger_callbacks_t *callbacks);
 /* Close the SlurmDBD socket connection */
 extern int slurm_close_slurmdbd_conn(void);
 
+/* Return the protocol version agreed on with the SlurmDBD when the
+ * connection was opened, or 0 if there is no connection */
+extern uint16_t slurm_get_slurmdbd_conn_version(void);
+
 /* Send an RPC to the SlurmDBD. Do not wait for the reply. The RPC
  * will be queued and processed later if the SlurmDBD is not responding.
  * NOTE: slurm_open_slurmdbd_conn() must have been called with make_agent set
@@ -43,11 +43,13 @@
 #endif
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <regex.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/param.h>	/* MAXPATHLEN */
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -74,6 +76,27 @@ strong_alias(stepd_connect, slurm_stepd_connect);
 strong_alias(stepd_get_uid, slurm_stepd_get_uid);
 strong_alias(stepd_add_extern_pid, slurm_stepd_add_extern_pid);
 
+/*
+ * Step registry file layout: a header followed by STEPD_REG_RECS records.
+ * Writers hold an exclusive fcntl() lock on the file, readers a shared one.
+ * Since fcntl() locks belong to the process, reg_mutex serializes the
+ * threads of a process around them.
+ */
+#define STEPD_REG_MAGIC		0x53524701	/* "SRG" + layout version */
+#define STEPD_REG_RECS		1024
+#define STEPD_REG_SIZE		(sizeof(stepd_reg_hdr_t) + \
+				 STEPD_REG_RECS * sizeof(stepd_reg_rec_t))
+
+typedef struct {
+	uint32_t magic;
+	uint32_t rec_cnt;
+} stepd_reg_hdr_t;
+
+static pthread_mutex_t reg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int reg_fd = -1;
+static stepd_reg_hdr_t *reg_hdr = NULL;
+static stepd_reg_rec_t *reg_self = NULL;	/* slurmstepd's own record */
+
 static bool
 _slurm_authorized_user()
 {
@@ -1148,3 +1171,221 @@ rwfail:
 	return NO_VAL;
 }
 
+static stepd_reg_rec_t *_registry_recs(void)
+{
+	return (stepd_reg_rec_t *) (reg_hdr + 1);
+}
+
+static int _registry_lock(short type)
+{
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+	while (fcntl(reg_fd, F_SETLKW, &lock) < 0) {
+		if (errno != EINTR) {
+			error("%s: fcntl: %m", __func__);
+			return SLURM_ERROR;
+		}
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Open and map the registry, creating it as needed. Call with reg_mutex */
+static int _registry_map(const char *directory, const char *nodename)
+{
+	char *path = NULL;
+	struct stat stat_buf;
+	void *base;
+
+	if (reg_hdr)
+		return SLURM_SUCCESS;
+
+	xstrfmtcat(path, "%s/%s_steps.reg", directory, nodename);
+	if ((reg_fd = open(path, O_RDWR | O_CREAT, 0600)) < 0) {
+		debug("%s: open(%s): %m", __func__, path);
+		xfree(path);
+		return SLURM_ERROR;
+	}
+	fd_set_close_on_exec(reg_fd);
+
+	if (_registry_lock(F_WRLCK) != SLURM_SUCCESS)
+		goto fail;
+	if (fstat(reg_fd, &stat_buf) < 0) {
+		error("%s: fstat(%s): %m", __func__, path);
+		goto fail;
+	}
+	if ((stat_buf.st_size < STEPD_REG_SIZE) &&
+	    (ftruncate(reg_fd, STEPD_REG_SIZE) < 0)) {
+		error("%s: ftruncate(%s): %m", __func__, path);
+		goto fail;
+	}
+	base = mmap(NULL, STEPD_REG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    reg_fd, 0);
+	if (base == MAP_FAILED) {
+		error("%s: mmap(%s): %m", __func__, path);
+		goto fail;
+	}
+	reg_hdr = base;
+	if (stat_buf.st_size == 0) {
+		reg_hdr->magic = STEPD_REG_MAGIC;
+		reg_hdr->rec_cnt = STEPD_REG_RECS;
+	} else if ((reg_hdr->magic != STEPD_REG_MAGIC) ||
+		   (reg_hdr->rec_cnt != STEPD_REG_RECS)) {
+		/* Written by a different Slurm version, leave it alone */
+		debug("%s: %s has an unknown format", __func__, path);
+		munmap(base, STEPD_REG_SIZE);
+		reg_hdr = NULL;
+		goto fail;
+	}
+	(void) _registry_lock(F_UNLCK);
+	xfree(path);
+	return SLURM_SUCCESS;
+
+fail:
+	close(reg_fd);	/* also drops our lock */
+	reg_fd = -1;
+	xfree(path);
+	return SLURM_ERROR;
+}
+
+/* Return true if pid is a running slurmstepd */
+static bool _registry_pid_alive(pid_t pid)
+{
+	char path[64], comm[16];
+	int fd, len;
+
+	if (pid <= 0)
+		return false;
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int) pid);
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return false;
+	len = read(fd, comm, sizeof(comm) - 1);
+	close(fd);
+	return ((len >= 10) && !strncmp(comm, "slurmstepd", 10));
+}
+
+extern int stepd_registry_add(const char *directory, const char *nodename,
+			      uint32_t jobid, uint32_t stepid)
+{
+	stepd_reg_rec_t *recs, *rec = NULL;
+	pid_t pid = getpid();
+	int i, rc = SLURM_ERROR;
+
+	slurm_mutex_lock(&reg_mutex);
+	if ((_registry_map(directory, nodename) != SLURM_SUCCESS) ||
+	    (_registry_lock(F_WRLCK) != SLURM_SUCCESS))
+		goto fini;
+
+	recs = _registry_recs();
+	for (i = 0; i < STEPD_REG_RECS; i++) {
+		if (recs[i].jobid && (recs[i].stepd_pid == pid))
+			recs[i].jobid = 0;	/* stale, our pid was reused */
+		if (!recs[i].jobid && !rec)
+			rec = &recs[i];
+	}
+	/* Full, reclaim records left by slurmstepds which died */
+	for (i = 0; !rec && (i < STEPD_REG_RECS); i++) {
+		if (!_registry_pid_alive(recs[i].stepd_pid))
+			rec = &recs[i];
+	}
+
+	if (rec) {
+		rec->stepid = stepid;
+		rec->stepd_pid = pid;
+		rec->state = SLURMSTEPD_STEP_STARTING;
+		rec->protocol_version = SLURM_PROTOCOL_VERSION;
+		rec->cont_id = 0;
+		rec->update_time = time(NULL);
+		rec->jobid = jobid;
+		reg_self = rec;
+		rc = SLURM_SUCCESS;
+	} else
+		debug("%s: step registry full", __func__);
+	(void) _registry_lock(F_UNLCK);
+
+fini:
+	slurm_mutex_unlock(&reg_mutex);
+	return rc;
+}
+
+extern void stepd_registry_update(slurmstepd_state_t state, uint64_t cont_id)
+{
+	slurm_mutex_lock(&reg_mutex);
+	if (reg_self && (_registry_lock(F_WRLCK) == SLURM_SUCCESS)) {
+		reg_self->state = state;
+		reg_self->cont_id = cont_id;
+		reg_self->update_time = time(NULL);
+		(void) _registry_lock(F_UNLCK);
+	}
+	slurm_mutex_unlock(&reg_mutex);
+}
+
+extern void stepd_registry_remove(void)
+{
+	slurm_mutex_lock(&reg_mutex);
+	if (reg_self && (_registry_lock(F_WRLCK) == SLURM_SUCCESS)) {
+		memset(reg_self, 0, sizeof(stepd_reg_rec_t));
+		(void) _registry_lock(F_UNLCK);
+	}
+	reg_self = NULL;
+	slurm_mutex_unlock(&reg_mutex);
+}
+
+static void _free_reg_rec(void *x)
+{
+	stepd_reg_rec_t *rec = (stepd_reg_rec_t *) x;
+
+	xfree(rec);
+}
+
+extern List stepd_registry_list(const char *directory, const char *nodename,
+				uint32_t jobid)
+{
+	stepd_reg_rec_t *recs, *rec;
+	List reg = NULL;
+	int i;
+
+	slurm_mutex_lock(&reg_mutex);
+	if ((_registry_map(directory, nodename) != SLURM_SUCCESS) ||
+	    (_registry_lock(F_RDLCK) != SLURM_SUCCESS))
+		goto fini;
+
+	reg = list_create(_free_reg_rec);
+	recs = _registry_recs();
+	for (i = 0; i < STEPD_REG_RECS; i++) {
+		if (!recs[i].jobid ||
+		    ((jobid != NO_VAL) && (recs[i].jobid != jobid)) ||
+		    !_registry_pid_alive(recs[i].stepd_pid))
+			continue;
+		rec = xmalloc(sizeof(stepd_reg_rec_t));
+		memcpy(rec, &recs[i], sizeof(stepd_reg_rec_t));
+		list_append(reg, rec);
+	}
+	(void) _registry_lock(F_UNLCK);
+
+fini:
+	slurm_mutex_unlock(&reg_mutex);
+	return reg;
+}
+
+static int _find_reg_rec(void *x, void *key)
+{
+	stepd_reg_rec_t *rec = (stepd_reg_rec_t *) x;
+	step_loc_t *loc = (step_loc_t *) key;
+
+	return ((rec->jobid == loc->jobid) && (rec->stepid == loc->stepid));
+}
+
+extern stepd_reg_rec_t *stepd_registry_find(List reg, uint32_t jobid,
+					    uint32_t stepid)
+{
+	step_loc_t loc;
+
+	if (!reg)
+		return NULL;
+	loc.jobid = jobid;
+	loc.stepid = stepid;
+	return list_find_first(reg, _find_reg_rec, &loc);
+}
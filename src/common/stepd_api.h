@@ -104,6 +104,17 @@ typedef struct {
 	int             estatus;    /* exit status if exited is true*/
 } slurmstepd_task_info_t;
 
+/* A job step's record in the node's shared step registry */
+typedef struct {
+	uint32_t jobid;			/* zero if the record is unused */
+	uint32_t stepid;
+	pid_t stepd_pid;		/* process ID of the slurmstepd */
+	uint16_t state;			/* slurmstepd_state_t */
+	uint16_t protocol_version;
+	uint64_t cont_id;		/* proctrack container ID */
+	time_t update_time;		/* time of last state change */
+} stepd_reg_rec_t;
+
 typedef struct step_location {
 	uint32_t jobid;
 	uint32_t stepid;
@@ -294,4 +305,47 @@ extern uid_t stepd_get_uid(int fd, uint16_t protocol_version);
  */
 extern uint32_t stepd_get_nodeid(int fd, uint16_t protocol_version);
 
+/*
+ * The step registry is a file in "directory", shared by mmap() between slurmd
+ * and the local slurmstepds, holding one stepd_reg_rec_t per job step. It lets
+ * slurmd learn the state of its steps without connecting to every slurmstepd.
+ * Steps started by an older slurmstepd (or when the registry is full) do not
+ * appear in it, so callers must fall back to the socket API for any step
+ * missing from the registry.
+ */
+
+/*
+ * Called by slurmstepd to add its job step to the registry in state
+ * SLURMSTEPD_STEP_STARTING.
+ * Returns SLURM_SUCCESS or SLURM_ERROR if the step could not be registered.
+ */
+extern int stepd_registry_add(const char *directory, const char *nodename,
+			      uint32_t jobid, uint32_t stepid);
+
+/*
+ * Called by slurmstepd to record a state or container change for the job step
+ * it registered with stepd_registry_add().
+ */
+extern void stepd_registry_update(slurmstepd_state_t state, uint64_t cont_id);
+
+/*
+ * Called by slurmstepd to remove its job step from the registry.
+ */
+extern void stepd_registry_remove(void);
+
+/*
+ * Return a List of copies of the stepd_reg_rec_t records of running
+ * slurmstepds for the given job, or for all jobs if jobid is NO_VAL.
+ * Returns NULL if the registry can not be used. Free with FREE_NULL_LIST().
+ */
+extern List stepd_registry_list(const char *directory, const char *nodename,
+				uint32_t jobid);
+
+/*
+ * Find the record for a job step in a List from stepd_registry_list().
+ * Returns NULL if the step is not registered.
+ */
+extern stepd_reg_rec_t *stepd_registry_find(List reg, uint32_t jobid,
+					    uint32_t stepid);
+
 #endif /* _STEPD_API_H */
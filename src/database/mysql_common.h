@@ -59,6 +59,7 @@ typedef enum {
 } slurm_mysql_plugin_type_t;
 
 typedef struct {
+	void *batch;		/* statements queued by the plugin */
 	bool cluster_deleted;
 	char *cluster_name;
 	MYSQL *db_conn;
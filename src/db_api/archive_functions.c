@@ -37,11 +37,463 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "slurm/slurm.h"
 #include "slurm/slurm_errno.h"
 #include "slurm/slurmdb.h"
 
+#include "src/common/archive_cols.h"
+#include "src/common/hostlist.h"
 #include "src/common/slurm_accounting_storage.h"
+#include "src/common/slurmdb_defs.h"
+#include "src/common/slurmdbd_defs.h"
+#include "src/common/uid.h"
+#include "src/common/xstring.h"
+
+/* Columns of the job table jobs archived by column are read from */
+static char *arch_job_cols[] = {
+	"account",
+	"array_max_tasks",
+	"nodes_alloc",
+	"id_assoc",
+	"id_array_job",
+	"id_array_task",
+	"id_block",
+	"derived_ec",
+	"derived_es",
+	"exit_code",
+	"timelimit",
+	"time_eligible",
+	"time_end",
+	"id_group",
+	"id_job",
+	"kill_requid",
+	"job_name",
+	"nodelist",
+	"partition",
+	"priority",
+	"id_qos",
+	"cpus_req",
+	"mem_req",
+	"id_resv",
+	"time_start",
+	"state",
+	"time_submit",
+	"time_suspended",
+	"track_steps",
+	"id_user",
+	"wckey",
+	"id_wckey",
+	"tres_alloc",
+	"tres_req",
+};
+
+enum {
+	ARCH_JOB_ACCOUNT,
+	ARCH_JOB_ARRAY_MAX,
+	ARCH_JOB_ALLOC_NODES,
+	ARCH_JOB_ASSOCID,
+	ARCH_JOB_ARRAYJOBID,
+	ARCH_JOB_ARRAYTASKID,
+	ARCH_JOB_BLOCKID,
+	ARCH_JOB_DERIVED_EC,
+	ARCH_JOB_DERIVED_ES,
+	ARCH_JOB_EXIT_CODE,
+	ARCH_JOB_TIMELIMIT,
+	ARCH_JOB_ELIGIBLE,
+	ARCH_JOB_END,
+	ARCH_JOB_GID,
+	ARCH_JOB_JOBID,
+	ARCH_JOB_KILL_REQUID,
+	ARCH_JOB_NAME,
+	ARCH_JOB_NODELIST,
+	ARCH_JOB_PARTITION,
+	ARCH_JOB_PRIORITY,
+	ARCH_JOB_QOS,
+	ARCH_JOB_REQ_CPUS,
+	ARCH_JOB_REQ_MEM,
+	ARCH_JOB_RESVID,
+	ARCH_JOB_START,
+	ARCH_JOB_STATE,
+	ARCH_JOB_SUBMIT,
+	ARCH_JOB_SUSPENDED,
+	ARCH_JOB_TRACKSTEPS,
+	ARCH_JOB_UID,
+	ARCH_JOB_WCKEY,
+	ARCH_JOB_WCKEYID,
+	ARCH_JOB_TRESA,
+	ARCH_JOB_TRESR,
+	ARCH_JOB_COUNT
+};
+
+typedef struct {
+	int col[ARCH_JOB_COUNT];	/* archive column of each
+					 * arch_job_cols, -1 if missing */
+	char *cluster;
+	slurmdb_job_cond_t *job_cond;
+	List job_list;
+	hostlist_t used_hl;		/* job_cond->used_nodes */
+} arch_jobs_t;
+
+/* True if list is empty or holds val */
+static bool _in_list(List list, char *val)
+{
+	if (!list || !list_count(list))
+		return true;
+
+	return list_find_first(list, slurm_find_char_in_list, val) != NULL;
+}
+
+/* True if the job is one of the job_cond->step_list */
+static bool _in_step_list(List step_list, uint32_t jobid,
+			  uint32_t array_job_id, uint32_t array_task_id)
+{
+	slurmdb_selected_step_t *selected_step;
+	ListIterator itr;
+	bool found = false;
+
+	if (!step_list || !list_count(step_list))
+		return true;
+
+	itr = list_iterator_create(step_list);
+	while (!found && (selected_step = list_next(itr))) {
+		if ((selected_step->jobid != jobid) &&
+		    (selected_step->jobid != array_job_id))
+			continue;
+		if ((selected_step->array_task_id != INFINITE) &&
+		    (selected_step->array_task_id != array_task_id))
+			continue;
+		found = true;
+	}
+	list_iterator_destroy(itr);
+
+	return found;
+}
+
+/* True if val is in min-max, or is min if there is no max. Any val if
+ * min is 0. */
+static bool _in_range(uint32_t min, uint32_t max, uint32_t val)
+{
+	if (!min)
+		return true;
+	if (max)
+		return ((val >= min) && (val <= max));
+	return (val == min);
+}
+
+/* True if no used_hl is given or the job ran on one of its nodes */
+static bool _ran_on(hostlist_t used_hl, char *nodelist)
+{
+	hostlist_t hl;
+	char *host;
+	bool found = false;
+
+	if (!used_hl)
+		return true;
+	if (!nodelist[0] || !xstrcmp(nodelist, "(null)") ||
+	    !xstrcmp(nodelist, "None assigned"))
+		return false;
+
+	hl = hostlist_create(nodelist);
+	while (!found && (host = hostlist_shift(hl))) {
+		found = (hostlist_find(used_hl, host) != -1);
+		free(host);
+	}
+	hostlist_destroy(hl);
+
+	return found;
+}
+
+/* The time conditions of the database when no state is asked for, jobs
+ * eligible in the window */
+static bool _eligible_match(char **val, time_t start, time_t end)
+{
+	time_t t_eligible = slurm_atoul(val[ARCH_JOB_ELIGIBLE]);
+	time_t t_end = slurm_atoul(val[ARCH_JOB_END]);
+
+	if (end && (!t_eligible || (t_eligible >= end)))
+		return false;
+	if (start && t_end && (t_end < start))
+		return false;
+	return true;
+}
+
+/* The time conditions _state_time_string() gives the database for a job
+ * in state during the window.  Suspend records are archived apart from
+ * the jobs, so a job is taken as suspended in the window if it has been
+ * suspended at all and ran during the window. */
+static bool _state_time_match(uint32_t state, char **val, time_t start,
+			      time_t end)
+{
+	uint32_t job_state = slurm_atoul(val[ARCH_JOB_STATE]);
+	time_t t_eligible = slurm_atoul(val[ARCH_JOB_ELIGIBLE]);
+	time_t t_start = slurm_atoul(val[ARCH_JOB_START]);
+	time_t t_end = slurm_atoul(val[ARCH_JOB_END]);
+	time_t t_suspended = slurm_atoul(val[ARCH_JOB_SUSPENDED]);
+
+	if (!start && !end)
+		return (job_state == state);
+
+	switch (state & JOB_STATE_BASE) {
+	case JOB_PENDING:
+		if (!start)
+			return (t_eligible && (t_eligible < end));
+		if (!end)
+			return (t_eligible &&
+				((!t_start && !t_end) ||
+				 ((start >= t_eligible) && (start <= t_start))));
+		return ((t_eligible &&
+			 (((start >= t_eligible) && (start <= t_start)) ||
+			  ((t_eligible >= start) && (t_eligible <= end)))) ||
+			(!t_start &&
+			 (start >= t_eligible) && (start <= t_end)));
+	case JOB_SUSPENDED:
+		return (t_suspended && t_start &&
+			(t_start <= (end ? end : start)) &&
+			(!t_end || (t_end >= start)));
+	case JOB_RUNNING:
+		if (!start)
+			return (t_start && (t_start < end));
+		if (!end)
+			return (t_start &&
+				((!t_end && (job_state == JOB_RUNNING)) ||
+				 ((start >= t_start) && (start <= t_end))));
+		return (t_start &&
+			(((start >= t_start) && (start <= t_end)) ||
+			 ((t_start >= start) && (t_start <= end))));
+	default:
+		if ((job_state != state) || !t_end)
+			return false;
+		if (!start)
+			return (t_end <= end);
+		if (!end)
+			return (t_end >= start);
+		return ((t_end >= start) && (t_end <= end));
+	}
+}
+
+/* True if the job was in one of the job_cond->state_list states during
+ * the window, or eligible in it if no state is given */
+static bool _in_state_window(slurmdb_job_cond_t *job_cond, char **val)
+{
+	ListIterator itr;
+	char *object;
+	bool found = false;
+
+	if (!job_cond->state_list || !list_count(job_cond->state_list))
+		return _eligible_match(val, job_cond->usage_start,
+				       job_cond->usage_end);
+
+	itr = list_iterator_create(job_cond->state_list);
+	while (!found && (object = list_next(itr)))
+		found = _state_time_match(slurm_atoul(object), val,
+					  job_cond->usage_start,
+					  job_cond->usage_end);
+	list_iterator_destroy(itr);
+
+	return found;
+}
+
+/* Add the archived job in row to arch->job_list if it matches
+ * arch->job_cond */
+static int _arch_job_row(char **row, void *arg)
+{
+	arch_jobs_t *arch = (arch_jobs_t *)arg;
+	slurmdb_job_cond_t *job_cond = arch->job_cond;
+	slurmdb_job_rec_t *job;
+	char *val[ARCH_JOB_COUNT];
+	uint64_t alloc_cpus;
+	int i;
+
+	for (i = 0; i < ARCH_JOB_COUNT; i++)
+		val[i] = (arch->col[i] < 0) ? "" : row[arch->col[i]];
+
+	alloc_cpus = slurmdb_find_tres_count_in_string(val[ARCH_JOB_TRESA],
+						       TRES_CPU);
+	if (alloc_cpus == INFINITE64)
+		alloc_cpus = 0;
+
+	if (!_in_state_window(job_cond, val) ||
+	    !_in_range(job_cond->cpus_min, job_cond->cpus_max,
+		       (uint32_t)alloc_cpus) ||
+	    !_in_range(job_cond->nodes_min, job_cond->nodes_max,
+		       slurm_atoul(val[ARCH_JOB_ALLOC_NODES])) ||
+	    !_in_range(job_cond->timelimit_min, job_cond->timelimit_max,
+		       slurm_atoul(val[ARCH_JOB_TIMELIMIT])) ||
+	    (job_cond->exitcode &&
+	     (job_cond->exitcode != atoi(val[ARCH_JOB_EXIT_CODE]))) ||
+	    !_ran_on(arch->used_hl, val[ARCH_JOB_NODELIST]))
+		return SLURM_SUCCESS;
+
+	if (!_in_list(job_cond->userid_list, val[ARCH_JOB_UID]) ||
+	    !_in_list(job_cond->groupid_list, val[ARCH_JOB_GID]) ||
+	    !_in_list(job_cond->acct_list, val[ARCH_JOB_ACCOUNT]) ||
+	    !_in_list(job_cond->associd_list, val[ARCH_JOB_ASSOCID]) ||
+	    !_in_list(job_cond->jobname_list, val[ARCH_JOB_NAME]) ||
+	    !_in_list(job_cond->partition_list, val[ARCH_JOB_PARTITION]) ||
+	    !_in_list(job_cond->qos_list, val[ARCH_JOB_QOS]) ||
+	    !_in_list(job_cond->resvid_list, val[ARCH_JOB_RESVID]) ||
+	    !_in_list(job_cond->wckey_list, val[ARCH_JOB_WCKEY]) ||
+	    !_in_step_list(job_cond->step_list,
+			   slurm_atoul(val[ARCH_JOB_JOBID]),
+			   slurm_atoul(val[ARCH_JOB_ARRAYJOBID]),
+			   slurm_atoul(val[ARCH_JOB_ARRAYTASKID])))
+		return SLURM_SUCCESS;
+
+	job = slurmdb_create_job_rec();
+	job->account = xstrdup(val[ARCH_JOB_ACCOUNT]);
+	job->alloc_nodes = slurm_atoul(val[ARCH_JOB_ALLOC_NODES]);
+	job->array_job_id = slurm_atoul(val[ARCH_JOB_ARRAYJOBID]);
+	job->array_max_tasks = slurm_atoul(val[ARCH_JOB_ARRAY_MAX]);
+	job->array_task_id = slurm_atoul(val[ARCH_JOB_ARRAYTASKID]);
+	job->associd = slurm_atoul(val[ARCH_JOB_ASSOCID]);
+	if (val[ARCH_JOB_BLOCKID][0])
+		job->blockid = xstrdup(val[ARCH_JOB_BLOCKID]);
+	job->cluster = xstrdup(arch->cluster);
+	job->derived_ec = slurm_atoul(val[ARCH_JOB_DERIVED_EC]);
+	job->derived_es = xstrdup(val[ARCH_JOB_DERIVED_ES]);
+	job->eligible = slurm_atoul(val[ARCH_JOB_ELIGIBLE]);
+	job->end = slurm_atoul(val[ARCH_JOB_END]);
+	job->exitcode = slurm_atoul(val[ARCH_JOB_EXIT_CODE]);
+	job->gid = slurm_atoul(val[ARCH_JOB_GID]);
+	job->jobid = slurm_atoul(val[ARCH_JOB_JOBID]);
+	job->jobname = xstrdup(val[ARCH_JOB_NAME]);
+	if (val[ARCH_JOB_NODELIST][0] &&
+	    xstrcmp(val[ARCH_JOB_NODELIST], "(null)"))
+		job->nodes = xstrdup(val[ARCH_JOB_NODELIST]);
+	else
+		job->nodes = xstrdup("(unknown)");
+	job->partition = xstrdup(val[ARCH_JOB_PARTITION]);
+	job->priority = slurm_atoul(val[ARCH_JOB_PRIORITY]);
+	job->qosid = slurm_atoul(val[ARCH_JOB_QOS]);
+	job->req_cpus = slurm_atoul(val[ARCH_JOB_REQ_CPUS]);
+	job->req_gres = xstrdup("");
+	job->req_mem = slurm_atoull(val[ARCH_JOB_REQ_MEM]);
+	job->requid = slurm_atoul(val[ARCH_JOB_KILL_REQUID]);
+	job->resvid = slurm_atoul(val[ARCH_JOB_RESVID]);
+	job->show_full = 1;
+	job->start = slurm_atoul(val[ARCH_JOB_START]);
+	job->state = slurm_atoul(val[ARCH_JOB_STATE]);
+	job->submit = slurm_atoul(val[ARCH_JOB_SUBMIT]);
+	job->suspended = slurm_atoul(val[ARCH_JOB_SUSPENDED]);
+	job->timelimit = slurm_atoul(val[ARCH_JOB_TIMELIMIT]);
+	job->track_steps = slurm_atoul(val[ARCH_JOB_TRACKSTEPS]);
+	if (val[ARCH_JOB_TRESA][0])
+		job->tres_alloc_str = xstrdup(val[ARCH_JOB_TRESA]);
+	if (val[ARCH_JOB_TRESR][0])
+		job->tres_req_str = xstrdup(val[ARCH_JOB_TRESR]);
+	job->uid = slurm_atoul(val[ARCH_JOB_UID]);
+	job->user = uid_to_string((uid_t)job->uid);
+	job->wckey = xstrdup(val[ARCH_JOB_WCKEY]);
+	job->wckeyid = slurm_atoul(val[ARCH_JOB_WCKEYID]);
+
+	if (job->end && (!job->start || (job->start > job->end)))
+		job->start = job->end;
+
+	/* The suspend records are archived apart, so only the suspended
+	 * time of the whole job is known */
+	if (!job_cond->without_usage_truncation && job_cond->usage_start) {
+		if (job->start && (job->start < job_cond->usage_start))
+			job->start = job_cond->usage_start;
+		if (job_cond->usage_end &&
+		    (!job->end || (job->end > job_cond->usage_end)))
+			job->end = job_cond->usage_end;
+		if (!job->start)
+			job->start = job->end;
+		job->elapsed = job->end - job->start;
+	} else if (job->start && job->end) {
+		job->elapsed = job->end - job->start - job->suspended;
+	}
+	if ((int)job->elapsed < 0)
+		job->elapsed = 0;
+
+	list_append(arch->job_list, job);
+
+	return SLURM_SUCCESS;
+}
+
+/* Add the jobs in the archive file matching job_cond to job_list */
+static int _get_archive_jobs(char *file, slurmdb_job_cond_t *job_cond,
+			     hostlist_t used_hl, List job_list)
+{
+	archive_cols_t *cols = NULL;
+	arch_jobs_t arch;
+	Buf buffer;
+	char *data = NULL;
+	int data_read, fd, i, rc = SLURM_SUCCESS;
+	uint32_t data_size = 0, rec_cnt, tmp32;
+	uint16_t type, ver;
+	time_t buf_time;
+	List uid_list = NULL;
+
+	if ((fd = open(file, O_RDONLY)) < 0) {
+		error("Can not open archive file %s: %m", file);
+		return SLURM_ERROR;
+	}
+	data = xmalloc(BUF_SIZE);
+	while ((data_read = read(fd, data + data_size, BUF_SIZE)) != 0) {
+		if (data_read < 0) {
+			if (errno == EINTR)
+				continue;
+			error("Read error on %s: %m", file);
+			close(fd);
+			xfree(data);
+			return SLURM_ERROR;
+		}
+		data_size += data_read;
+		xrealloc(data, data_size + BUF_SIZE);
+	}
+	close(fd);
+	buffer = create_buf(data, data_size);
+
+	memset(&arch, 0, sizeof(arch_jobs_t));
+	safe_unpack16(&ver, buffer);
+	safe_unpack_time(&buf_time, buffer);
+	safe_unpack16(&type, buffer);
+	safe_unpackmem_ptr(&arch.cluster, &tmp32, buffer);
+	safe_unpack32(&rec_cnt, buffer);
+	if ((type != DBD_GOT_JOBS) || (ver > SLURM_PROTOCOL_VERSION) ||
+	    !archive_cols_packed(buffer)) {
+		error("%s is not a job archive that can be read directly, "
+		      "load it with sacctmgr archive load", file);
+		FREE_NULL_BUFFER(buffer);
+		return SLURM_ERROR;
+	}
+
+	if (!_in_list(job_cond->cluster_list, arch.cluster)) {
+		FREE_NULL_BUFFER(buffer);
+		return SLURM_SUCCESS;
+	}
+
+	if (archive_cols_unpack(&cols, buffer) != SLURM_SUCCESS)
+		goto unpack_error;
+
+	for (i = 0; i < ARCH_JOB_COUNT; i++)
+		arch.col[i] = archive_cols_find_col(cols, arch_job_cols[i]);
+	arch.job_cond = job_cond;
+	arch.job_list = job_list;
+	arch.used_hl = used_hl;
+
+	/* Skip the blocks of jobs of other users and of jobs ended before
+	 * or submitted after the window */
+	if (job_cond->userid_list && list_count(job_cond->userid_list))
+		uid_list = job_cond->userid_list;
+	rc = archive_cols_for_each(cols, job_cond->usage_start,
+				   job_cond->usage_end, uid_list,
+				   _arch_job_row, &arch);
+	archive_cols_destroy(cols);
+	FREE_NULL_BUFFER(buffer);
+
+	return rc;
+
+unpack_error:
+	error("Archive file %s is corrupt", file);
+	FREE_NULL_BUFFER(buffer);
+	return SLURM_ERROR;
+}
 
 /*
  * expire old info from the storage
@@ -61,3 +513,46 @@ extern int slurmdb_archive_load(void *db_conn,
 	return jobacct_storage_g_archive_load(db_conn, arch_rec);
 }
 
+/*
+ * get jobs from archive files without loading them, files that can not be
+ * read are reported and skipped
+ */
+extern List slurmdb_archive_get_jobs(List file_list,
+				     slurmdb_job_cond_t *job_cond)
+{
+	List job_list;
+	slurmdb_job_cond_t tmp_cond;
+	hostlist_t used_hl = NULL;
+	ListIterator itr;
+	char *file;
+
+	if (!job_cond) {
+		memset(&tmp_cond, 0, sizeof(slurmdb_job_cond_t));
+		job_cond = &tmp_cond;
+	}
+
+	/* Only the database knows the ids of the reservation names */
+	if (job_cond->resv_list && list_count(job_cond->resv_list)) {
+		error("Reservations can only be selected by id in archive "
+		      "files");
+		return NULL;
+	}
+
+	if (job_cond->used_nodes &&
+	    !(used_hl = hostlist_create(job_cond->used_nodes))) {
+		error("Invalid node list %s", job_cond->used_nodes);
+		return NULL;
+	}
+
+	job_list = list_create(slurmdb_destroy_job_rec);
+	itr = list_iterator_create(file_list);
+	while ((file = list_next(itr))) {
+		if (_get_archive_jobs(file, job_cond, used_hl, job_list) !=
+		    SLURM_SUCCESS)
+			error("Skipping archive file %s", file);
+	}
+	list_iterator_destroy(itr);
+	FREE_NULL_HOSTLIST(used_hl);
+
+	return job_list;
+}
@@ -84,6 +84,17 @@ extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond)
 	return jobacct_storage_g_get_jobs_cond(db_conn, getuid(), job_cond);
 }
 
+/*
+ * get totals of jobs from the storage, grouped in the storage
+ * returns List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed when called
+ */
+extern List slurmdb_jobs_aggregate(void *db_conn,
+				   slurmdb_job_aggr_cond_t *aggr_cond)
+{
+	return jobacct_storage_g_get_jobs_aggr(db_conn, getuid(), aggr_cond);
+}
+
 /*
  * get info from the storage
  * IN:  slurmdb_assoc_cond_t *
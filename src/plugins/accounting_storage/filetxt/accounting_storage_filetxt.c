@@ -1044,6 +1044,17 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return filetxt_jobacct_process_get_jobs(job_cond);
 }
 
+/*
+ * get totals of jobs from the storage
+ * returns List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_aggr(void *db_conn, uid_t uid,
+					    slurmdb_job_aggr_cond_t *aggr_cond)
+{
+	return NULL;
+}
+
 /*
  * expire old info from the storage
  */
@@ -49,8 +49,10 @@
 #include "as_mysql_tres.h"
 #include "as_mysql_archive.h"
 #include "as_mysql_assoc.h"
+#include "as_mysql_batch.h"
 #include "as_mysql_cluster.h"
 #include "as_mysql_convert.h"
+#include "as_mysql_partition.h"
 #include "as_mysql_federation.h"
 #include "as_mysql_fix_runaway_jobs.h"
 #include "as_mysql_job.h"
@@ -1347,6 +1349,22 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	};
 
 	char table_name[200];
+	char *ending;
+	bool partition = as_mysql_partition_enabled();
+	int rc;
+
+	/* Without the slurmdbd keep the keys of the tables as they are,
+	 * partitioned or not */
+	if (!slurmdbd_conf) {
+		if ((rc = as_mysql_partition_in_use(mysql_conn, cluster_name))
+		    == SLURM_ERROR)
+			return SLURM_ERROR;
+		partition = rc;
+	}
+
+	if (as_mysql_convert_partitions_pre_create(mysql_conn, cluster_name)
+	    != SLURM_SUCCESS)
+		return SLURM_ERROR;
 
 	if (create_cluster_assoc_table(mysql_conn, cluster_name)
 	    == SLURM_ERROR)
@@ -1409,8 +1427,13 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
 		 cluster_name, event_table);
 
+	/* event_times is for the time range queries of the rollup and
+	 * sacctmgr show events that go through all the monthly partitions. */
 	if (mysql_db_create_table(mysql_conn, table_name,
 				  event_table_fields,
+				  partition ?
+				  ", primary key (node_name(20), time_start), "
+				  "key event_times (time_start, time_end))" :
 				  ", primary key (node_name(20), time_start))")
 	    == SLURM_ERROR)
 		return SLURM_ERROR;
@@ -1418,25 +1441,33 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
 		 cluster_name, job_table);
 	/* sacct_def is the index for query's with state as time_tart is used in
-	 * these queries. sacct_def2 is for plain sacct queries. */
-	if (mysql_db_create_table(mysql_conn, table_name, job_table_fields,
-				  ", primary key (job_db_inx), "
-				  "unique index (id_job, time_submit), "
-				  "key old_tuple (id_job, "
-				  "id_assoc, time_submit), "
-				  "key rollup (time_eligible, time_end), "
-				  "key rollup2 (time_end, time_eligible), "
-				  "key nodes_alloc (nodes_alloc), "
-				  "key wckey (id_wckey), "
-				  "key qos (id_qos), "
-				  "key association (id_assoc), "
-				  "key array_job (id_array_job), "
-				  "key reserv (id_resv), "
-				  "key sacct_def (id_user, time_start, "
-				  "time_end), "
-				  "key sacct_def2 (id_user, time_end, "
-				  "time_eligible))")
-	    == SLURM_ERROR)
+	 * these queries. sacct_def2 is for plain sacct queries.  When
+	 * partitioned by month every unique key has to hold time_submit, and
+	 * sacct_state is for queries with a state but no user. */
+	ending = xstrdup_printf(", primary key (job_db_inx%s), "
+				"unique index (id_job, time_submit), "
+				"key old_tuple (id_job, "
+				"id_assoc, time_submit), "
+				"key rollup (time_eligible, time_end), "
+				"key rollup2 (time_end, time_eligible), "
+				"key nodes_alloc (nodes_alloc), "
+				"key wckey (id_wckey), "
+				"key qos (id_qos), "
+				"key association (id_assoc), "
+				"key array_job (id_array_job), "
+				"key reserv (id_resv), "
+				"key sacct_def (id_user, time_start, "
+				"time_end), "
+				"%s"
+				"key sacct_def2 (id_user, time_end, "
+				"time_eligible))",
+				partition ? ", time_submit" : "",
+				partition ? "key sacct_state (state, time_end, "
+				"time_start), " : "");
+	rc = mysql_db_create_table(mysql_conn, table_name, job_table_fields,
+				   ending);
+	xfree(ending);
+	if (rc == SLURM_ERROR)
 		return SLURM_ERROR;
 
 	snprintf(table_name, sizeof(table_name), "\"%s_%s\"",
@@ -1510,7 +1541,8 @@ extern int create_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
 	    == SLURM_ERROR)
 		return SLURM_ERROR;
 
-	return SLURM_SUCCESS;
+	return as_mysql_convert_partitions_post_create(mysql_conn,
+						       cluster_name);
 }
 
 extern int remove_cluster_tables(mysql_conn_t *mysql_conn, char *cluster_name)
@@ -2451,6 +2483,7 @@ extern int fini ( void )
 	FREE_NULL_LIST(as_mysql_total_cluster_list);
 	slurm_mutex_unlock(&as_mysql_cluster_list_lock);
 	slurm_mutex_destroy(&as_mysql_cluster_list_lock);
+	as_mysql_rollup_fini();
 	destroy_mysql_db_info(mysql_db_info);
 	xfree(mysql_db_name);
 	xfree(default_qos_str);
@@ -2503,29 +2536,42 @@ extern int acct_storage_p_close_connection(mysql_conn_t **mysql_conn)
 extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 {
 	int rc = check_connection(mysql_conn);
+	int batch_rc = SLURM_SUCCESS;
+	DEF_TIMERS;
 
 	/* always reset this here */
 	if (mysql_conn)
 		mysql_conn->cluster_deleted = 0;
 
-	if ((rc != SLURM_SUCCESS) && (rc != ESLURM_CLUSTER_DELETED))
+	if ((rc != SLURM_SUCCESS) && (rc != ESLURM_CLUSTER_DELETED)) {
+		if (mysql_conn)
+			as_mysql_batch_discard(mysql_conn);
 		return rc;
+	}
 
 	debug4("got %d commits", list_count(mysql_conn->update_list));
 
+	START_TIMER;
+	/* Anything queued is part of this transaction */
+	if (commit)
+		batch_rc = as_mysql_batch_flush(mysql_conn);
+	else
+		as_mysql_batch_discard(mysql_conn);
+
 	if (mysql_conn->rollback) {
 		if (!commit) {
 			if (mysql_db_rollback(mysql_conn))
 				error("rollback failed");
 		} else {
-			int rc = SLURM_SUCCESS;
+			int rc = batch_rc;
 			/* Handle anything here we were unable to do
 			   because of rollback issues.  i.e. Since any
 			   use of altering a tables
 			   AUTO_INCREMENT will make it so you can't
 			   rollback, save it until right at the end.
 			*/
-			if (mysql_conn->pre_commit_query) {
+			if ((rc == SLURM_SUCCESS) &&
+			    mysql_conn->pre_commit_query) {
 				if (debug_flags & DEBUG_FLAG_DB_ASSOC)
 					DB_DEBUG(mysql_conn->conn, "query\n%s",
 						 mysql_conn->pre_commit_query);
@@ -2541,6 +2587,8 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 				if (mysql_db_commit(mysql_conn))
 					error("commit failed");
 			}
+			END_TIMER;
+			as_mysql_batch_commit_time(DELTA_TIMER);
 		}
 	}
 
@@ -2611,7 +2659,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	xfree(mysql_conn->pre_commit_query);
 	list_flush(mysql_conn->update_list);
 
-	return SLURM_SUCCESS;
+	return batch_rc;
 }
 
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
@@ -3127,6 +3175,22 @@ extern List jobacct_storage_p_get_jobs_cond(mysql_conn_t *mysql_conn,
 	return job_list;
 }
 
+/*
+ * get totals of jobs from the storage
+ * returns List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_aggr(mysql_conn_t *mysql_conn,
+					    uid_t uid,
+					    slurmdb_job_aggr_cond_t *aggr_cond)
+{
+	if (check_connection(mysql_conn) != SLURM_SUCCESS)
+		return NULL;
+
+	return as_mysql_jobacct_process_get_jobs_aggr(mysql_conn, uid,
+						      aggr_cond);
+}
+
 /*
  * expire old info from the storage
  */
@@ -3186,13 +3250,19 @@ extern int acct_storage_p_reset_lft_rgt(mysql_conn_t *mysql_conn, uid_t uid,
 	return as_mysql_reset_lft_rgt(mysql_conn, uid, cluster_list);
 }
 
-extern int acct_storage_p_get_stats(void *db_conn, bool dbd)
+extern int acct_storage_p_get_stats(void *db_conn,
+				    slurmdb_stats_rec_t **stats)
 {
+	*stats = xmalloc(sizeof(slurmdb_stats_rec_t));
+	as_mysql_batch_get_stats(*stats);
+
 	return SLURM_SUCCESS;
 }
 
-extern int acct_storage_p_clear_stats(void *db_conn, bool dbd)
+extern int acct_storage_p_clear_stats(void *db_conn)
 {
+	as_mysql_batch_clear_stats();
+
 	return SLURM_SUCCESS;
 }
 
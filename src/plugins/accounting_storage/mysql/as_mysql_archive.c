@@ -43,9 +43,12 @@
 #include <unistd.h>
 
 #include "as_mysql_archive.h"
+#include "as_mysql_partition.h"
+#include "src/common/archive_cols.h"
 #include "src/common/env.h"
 #include "src/common/slurm_time.h"
 #include "src/common/slurmdbd_defs.h"
+#include "src/common/timers.h"
 
 #define SLURM_15_08_PROTOCOL_VERSION ((29 << 8) | 0) /* slurm version 15.08. */
 #define SLURM_14_11_PROTOCOL_VERSION ((28 << 8) | 0) /* slurm version 14.11. */
@@ -61,6 +64,8 @@
 
 #define MAX_PURGE_LIMIT 50000 /* Number of records that are purged at a time
 				 so that locks can be periodically released. */
+#define ARCHIVE_MAX_THREADS 4 /* Clusters archived and purged at the same
+				 time, each on its own connection. */
 #define MAX_ARCHIVE_AGE (60 * 60 * 24 * 60) /* If archive data is older than
 					       this then archive by month to
 					       handle large datasets. */
@@ -593,48 +598,6 @@ static int _unpack_local_event(local_event_t *object,
 	return SLURM_SUCCESS;
 }
 
-static void _pack_local_job(local_job_t *object,
-			    uint16_t rpc_version, Buf buffer)
-{
-	packstr(object->account, buffer);
-	packstr(object->admin_comment, buffer);
-	packstr(object->alloc_nodes, buffer);
-	packstr(object->associd, buffer);
-	packstr(object->array_jobid, buffer);
-	packstr(object->array_max_tasks, buffer);
-	packstr(object->array_taskid, buffer);
-	packstr(object->blockid, buffer);
-	packstr(object->derived_ec, buffer);
-	packstr(object->derived_es, buffer);
-	packstr(object->exit_code, buffer);
-	packstr(object->timelimit, buffer);
-	packstr(object->eligible, buffer);
-	packstr(object->end, buffer);
-	packstr(object->gid, buffer);
-	packstr(object->job_db_inx, buffer);
-	packstr(object->jobid, buffer);
-	packstr(object->kill_requid, buffer);
-	packstr(object->name, buffer);
-	packstr(object->nodelist, buffer);
-	packstr(object->node_inx, buffer);
-	packstr(object->partition, buffer);
-	packstr(object->priority, buffer);
-	packstr(object->qos, buffer);
-	packstr(object->req_cpus, buffer);
-	packstr(object->req_mem, buffer);
-	packstr(object->resvid, buffer);
-	packstr(object->start, buffer);
-	packstr(object->state, buffer);
-	packstr(object->submit, buffer);
-	packstr(object->suspended, buffer);
-	packstr(object->track_steps, buffer);
-	packstr(object->tres_alloc_str, buffer);
-	packstr(object->tres_req_str, buffer);
-	packstr(object->uid, buffer);
-	packstr(object->wckey, buffer);
-	packstr(object->wckey_id, buffer);
-}
-
 /* this needs to be allocated before calling, and since we aren't
  * doing any copying it needs to be used before destroying buffer */
 static int _unpack_local_job(local_job_t *object,
@@ -1887,13 +1850,15 @@ _load_events(uint16_t rpc_version, Buf buffer, char *cluster_name,
 	return insert;
 }
 
+/* Jobs are archived by column with time_submit, time_end and id_user indexed
+ * so sacct can read them without loading the archive */
 static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
 			      uint32_t cnt, uint32_t usage_info,
 			      time_t *period_start)
 {
 	MYSQL_ROW row;
 	Buf buffer;
-	local_job_t job;
+	archive_cols_t *arch;
 
 	buffer = init_buf(high_buffer_size);
 	pack16(SLURM_PROTOCOL_VERSION, buffer);
@@ -1902,55 +1867,80 @@ static Buf _pack_archive_jobs(MYSQL_RES *result, char *cluster_name,
 	packstr(cluster_name, buffer);
 	pack32(cnt, buffer);
 
+	arch = archive_cols_create(job_req_inx, JOB_REQ_COUNT, JOB_REQ_SUBMIT,
+				   JOB_REQ_END, JOB_REQ_UID);
 	while ((row = mysql_fetch_row(result))) {
 		if (period_start && !*period_start)
 			*period_start = slurm_atoul(row[JOB_REQ_SUBMIT]);
 
-		memset(&job, 0, sizeof(local_job_t));
-
-		job.account = row[JOB_REQ_ACCOUNT];
-		job.alloc_nodes = row[JOB_REQ_ALLOC_NODES];
-		job.associd = row[JOB_REQ_ASSOCID];
-		job.array_jobid = row[JOB_REQ_ARRAYJOBID];
-		job.array_max_tasks = row[JOB_REQ_ARRAY_MAX];
-		job.array_taskid = row[JOB_REQ_ARRAYTASKID];
-		job.blockid = row[JOB_REQ_BLOCKID];
-		job.derived_ec = row[JOB_REQ_DERIVED_EC];
-		job.derived_es = row[JOB_REQ_DERIVED_ES];
-		job.exit_code = row[JOB_REQ_EXIT_CODE];
-		job.timelimit = row[JOB_REQ_TIMELIMIT];
-		job.eligible = row[JOB_REQ_ELIGIBLE];
-		job.end = row[JOB_REQ_END];
-		job.gid = row[JOB_REQ_GID];
-		job.job_db_inx = row[JOB_REQ_DB_INX];
-		job.jobid = row[JOB_REQ_JOBID];
-		job.kill_requid = row[JOB_REQ_KILL_REQUID];
-		job.name = row[JOB_REQ_NAME];
-		job.nodelist = row[JOB_REQ_NODELIST];
-		job.node_inx = row[JOB_REQ_NODE_INX];
-		job.partition = row[JOB_REQ_PARTITION];
-		job.priority = row[JOB_REQ_PRIORITY];
-		job.qos = row[JOB_REQ_QOS];
-		job.req_cpus = row[JOB_REQ_REQ_CPUS];
-		job.req_mem = row[JOB_REQ_REQ_MEM];
-		job.resvid = row[JOB_REQ_RESVID];
-		job.start = row[JOB_REQ_START];
-		job.state = row[JOB_REQ_STATE];
-		job.submit = row[JOB_REQ_SUBMIT];
-		job.suspended = row[JOB_REQ_SUSPENDED];
-		job.track_steps = row[JOB_REQ_TRACKSTEPS];
-		job.tres_alloc_str = row[JOB_REQ_TRESA];
-		job.tres_req_str = row[JOB_REQ_TRESR];
-		job.uid = row[JOB_REQ_UID];
-		job.wckey = row[JOB_REQ_WCKEY];
-		job.wckey_id = row[JOB_REQ_WCKEYID];
-
-		_pack_local_job(&job, SLURM_PROTOCOL_VERSION, buffer);
+		archive_cols_add_row(arch, row);
 	}
+	archive_cols_pack(arch, buffer);
+	archive_cols_destroy(arch);
 
 	return buffer;
 }
 
+typedef struct {
+	int col[JOB_REQ_COUNT];	/* archive column of each job_req_inx */
+	char *insert;
+	uint32_t row_cnt;
+} load_job_cols_t;
+
+/* Add the values of a job archived by column to the insert statement */
+static int _load_job_cols_row(char **row, void *arg)
+{
+	load_job_cols_t *load = (load_job_cols_t *)arg;
+	char *val;
+	int i;
+
+	xstrcat(load->insert, load->row_cnt++ ? ", (" : "(");
+	for (i = 0; i < JOB_REQ_COUNT; i++) {
+		val = slurm_add_slash_to_quotes(
+			(load->col[i] < 0) ? "" : row[load->col[i]]);
+		xstrfmtcat(load->insert, "%s'%s'", i ? ", " : "", val);
+		xfree(val);
+	}
+	xstrcat(load->insert, ")");
+
+	return SLURM_SUCCESS;
+}
+
+/* returns sql statement from jobs archived by column or NULL on error */
+static char *_load_job_cols(Buf buffer, char *cluster_name, uint32_t rec_cnt)
+{
+	archive_cols_t *arch = NULL;
+	load_job_cols_t load;
+	char *name;
+	int i;
+
+	if ((archive_cols_unpack(&arch, buffer) != SLURM_SUCCESS) ||
+	    (archive_cols_row_cnt(arch) != rec_cnt)) {
+		error("issue unpacking");
+		archive_cols_destroy(arch);
+		return NULL;
+	}
+
+	memset(&load, 0, sizeof(load_job_cols_t));
+	xstrfmtcat(load.insert, "insert into \"%s_%s\" (", cluster_name,
+		   job_table);
+	for (i = 0; i < JOB_REQ_COUNT; i++) {
+		name = xstrdup(job_req_inx[i]);
+		xstrsubstituteall(name, "`", "");
+		load.col[i] = archive_cols_find_col(arch, name);
+		xfree(name);
+		xstrfmtcat(load.insert, "%s%s", i ? ", " : "", job_req_inx[i]);
+	}
+	xstrcat(load.insert, ") values ");
+
+	if (archive_cols_for_each(arch, 0, 0, NULL, _load_job_cols_row,
+				  &load) != SLURM_SUCCESS)
+		xfree(load.insert);
+	archive_cols_destroy(arch);
+
+	return load.insert;
+}
+
 /* returns sql statement from archived data or NULL on error */
 static char *_load_jobs(uint16_t rpc_version, Buf buffer,
 			char *cluster_name, uint32_t rec_cnt)
@@ -1959,6 +1949,9 @@ static char *_load_jobs(uint16_t rpc_version, Buf buffer,
 	local_job_t object;
 	int i = 0;
 
+	if (archive_cols_packed(buffer))
+		return _load_job_cols(buffer, cluster_name, rec_cnt);
+
 	xstrfmtcat(insert, "insert into \"%s_%s\" (%s",
 		   cluster_name, job_table, job_req_inx[0]);
 	xstrcat(format, "('%s'");
@@ -2738,7 +2731,7 @@ static uint32_t _archive_table(purge_type_t type, mysql_conn_t *mysql_conn,
 		break;
 	case PURGE_JOB:
 		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "time_submit < %ld && time_end != 0 "
+				       "time_submit <= %ld && time_end != 0 "
 				       "order by time_submit asc for update",
 				       cols, cluster_name, job_table,
 				       period_end);
@@ -2804,13 +2797,15 @@ uint32_t _get_begin_next_month(time_t start)
 	return slurm_mktime(&parts);
 }
 
-/* Get the oldest purge'able record.
+/* Get the time of the oldest purge'able record, or of the one offset
+ * records after it.
  * Returns SLURM_ERROR for mysql error, 0 no purge'able records found,
  * 1 found purgeable record.
  */
 static int _get_oldest_record(mysql_conn_t *mysql_conn, char *cluster,
 			      char *table, purge_type_t type, char *col_name,
-			      time_t period_end, time_t *record_start)
+			      time_t period_end, uint32_t offset,
+			      time_t *record_start)
 {
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -2824,24 +2819,24 @@ static int _get_oldest_record(mysql_conn_t *mysql_conn, char *cluster,
 	case PURGE_TXN:
 		query = xstrdup_printf(
 			"select %s from \"%s\" where %s <= %ld "
-			"&& cluster='%s' order by %s asc LIMIT 1",
+			"&& cluster='%s' order by %s asc LIMIT %u, 1",
 			col_name, table, col_name, period_end, cluster,
-			col_name);
+			col_name, offset);
 		break;
 	case PURGE_USAGE:
 	case PURGE_CLUSTER_USAGE:
 		query = xstrdup_printf(
 			"select %s from \"%s_%s\" where %s <= %ld "
-			"order by %s asc LIMIT 1",
+			"order by %s asc LIMIT %u, 1",
 			col_name, cluster, table, col_name, period_end,
-			col_name);
+			col_name, offset);
 		break;
 	default:
 		query = xstrdup_printf(
 			"select %s from \"%s_%s\" where %s <= %ld "
-			"&& time_end != 0 order by %s asc LIMIT 1",
+			"&& time_end != 0 order by %s asc LIMIT %u, 1",
 			col_name, cluster, table, col_name, period_end,
-			col_name);
+			col_name, offset);
 		break;
 	}
 
@@ -2864,7 +2859,81 @@ static int _get_oldest_record(mysql_conn_t *mysql_conn, char *cluster,
 	return 1; /* found one record */
 }
 
-/* Archive and purge a table.
+/* Archive and purge the records of sql_table up to chunk_end in one
+ * transaction.  *hold is set to the time in usec the records were locked.
+ *
+ * Returns the number of records purged or SLURM_ERROR on error.
+ */
+static int _archive_purge_chunk(purge_type_t purge_type, uint32_t usage_info,
+				mysql_conn_t *mysql_conn, char *cluster_name,
+				slurmdb_archive_cond_t *arch_cond,
+				uint32_t purge_attr, uint32_t archive_period,
+				char *sql_table, char *col_name,
+				time_t chunk_end, long *hold)
+{
+	int rc;
+	char *query = NULL;
+	DEF_TIMERS;
+
+	START_TIMER;
+	if (SLURMDB_PURGE_ARCHIVE_SET(purge_attr)) {
+		rc = _archive_table(purge_type, mysql_conn,
+				    cluster_name, chunk_end,
+				    arch_cond->archive_dir,
+				    archive_period,
+				    sql_table, usage_info);
+		if (!rc) /* no records archived */
+			return 0;
+		else if (rc == SLURM_ERROR)
+			return rc;
+	}
+
+	switch (purge_type) {
+	case PURGE_TXN:
+		query = xstrdup_printf(
+			"delete from \"%s\" where "
+			"%s <= %ld && cluster='%s'",
+			sql_table, col_name,
+			chunk_end, cluster_name);
+		break;
+	case PURGE_USAGE:
+	case PURGE_CLUSTER_USAGE:
+		query = xstrdup_printf(
+			"delete from \"%s_%s\" where "
+			"%s <= %ld",
+			cluster_name, sql_table, col_name,
+			chunk_end);
+		break;
+	default:
+		query = xstrdup_printf(
+			"delete from \"%s_%s\" where "
+			"%s <= %ld && time_end != 0",
+			cluster_name, sql_table, col_name,
+			chunk_end);
+		break;
+	}
+	if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+
+	rc = mysql_db_delete_affected_rows(mysql_conn, query);
+	xfree(query);
+	if (rc < 0) {
+		error("Couldn't remove old data from %s table", sql_table);
+		return SLURM_ERROR;
+	} else if (mysql_db_commit(mysql_conn)) {
+		error("Couldn't commit cluster (%s) purge", cluster_name);
+		return SLURM_ERROR;
+	}
+	END_TIMER;
+	*hold = DELTA_TIMER;
+
+	return rc;
+}
+
+/* Archive and purge a table.  Records are handled in chunks of about
+ * MAX_PURGE_LIMIT records, each written to its own archive file and purged
+ * in its own transaction, so neither the archive nor the locks on the table
+ * grow with the number of records to purge.
  *
  * Returns SLURM_ERROR on error and SLURM_SUCCESS on success.
  */
@@ -2877,9 +2946,13 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 	uint16_t type, period;
 	time_t   last_submit = time(NULL);
 	time_t   curr_end    = 0, tmp_end = 0, record_start = 0;
-	char    *query = NULL, *sql_table = NULL,
-		*col_name = NULL;
+	time_t   chunk_next  = 0;
+	char    *sql_table = NULL, *col_name = NULL;
 	uint32_t tmp_archive_period;
+	uint64_t purged      = 0;
+	int      chunks      = 0;
+	long     hold        = 0, max_hold = 0;
+	DEF_TIMERS;
 
 	switch (purge_type) {
 	case PURGE_EVENT:
@@ -2992,10 +3065,20 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 		return SLURM_ERROR;
 	}
 
+	/* Without archiving the partitioned tables drop whole months, the
+	 * chunks below only purge what is left in the months kept. */
+	if (as_mysql_partition_enabled() &&
+	    !SLURMDB_PURGE_ARCHIVE_SET(purge_attr) &&
+	    ((purge_type == PURGE_JOB) || (purge_type == PURGE_EVENT)) &&
+	    (as_mysql_partition_purge(mysql_conn, cluster_name, sql_table,
+				      curr_end) == SLURM_ERROR))
+		return SLURM_ERROR;
+
+	START_TIMER;
 	do {
 		rc = _get_oldest_record(mysql_conn, cluster_name, sql_table,
 					purge_type, col_name,
-					curr_end, &record_start);
+					curr_end, 0, &record_start);
 		if (!rc) /* no purgeable records found */
 			break;
 		else if (rc == SLURM_ERROR)
@@ -3011,72 +3094,42 @@ static int _archive_purge_table(purge_type_t purge_type, uint32_t usage_info,
 		} else
 			tmp_end = curr_end;
 
+		/* End the chunk before the record MAX_PURGE_LIMIT records
+		 * after the oldest.  Records of the same time are never split
+		 * between chunks, so if that record has the same time as the
+		 * oldest the chunk takes all records of that time. */
+		rc = _get_oldest_record(mysql_conn, cluster_name, sql_table,
+					purge_type, col_name, tmp_end,
+					MAX_PURGE_LIMIT, &chunk_next);
+		if (rc == SLURM_ERROR)
+			return rc;
+		else if (rc)
+			tmp_end = (chunk_next > record_start) ?
+				  chunk_next - 1 : chunk_next;
+
 		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
 			debug("Purging %s_%s before %ld",
 			      cluster_name, sql_table, tmp_end);
 
-		if (SLURMDB_PURGE_ARCHIVE_SET(purge_attr)) {
-			rc = _archive_table(purge_type, mysql_conn,
-					    cluster_name, tmp_end,
-					    arch_cond->archive_dir,
-					    tmp_archive_period,
-					    sql_table, usage_info);
-			if (!rc) /* no records archived */
-				continue;
-			else if (rc == SLURM_ERROR)
-				return rc;
-		}
-
-		switch (purge_type) {
-		case PURGE_TXN:
-			query = xstrdup_printf(
-				"delete from \"%s\" where "
-				"%s <= %ld && cluster='%s' LIMIT %d",
-				sql_table, col_name,
-				tmp_end, cluster_name, MAX_PURGE_LIMIT);
-			break;
-		case PURGE_USAGE:
-		case PURGE_CLUSTER_USAGE:
-			query = xstrdup_printf(
-				"delete from \"%s_%s\" where "
-				"%s <= %ld LIMIT %d",
-				cluster_name, sql_table, col_name,
-				tmp_end, MAX_PURGE_LIMIT);
-			break;
-		default:
-			query = xstrdup_printf(
-				"delete from \"%s_%s\" where "
-				"%s <= %ld && time_end != 0 LIMIT %d",
-				cluster_name, sql_table, col_name,
-				tmp_end, MAX_PURGE_LIMIT);
-			break;
-		}
-		if (debug_flags & DEBUG_FLAG_DB_ARCHIVE)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-
-		while ((rc = mysql_db_delete_affected_rows(
-				mysql_conn, query)) > 0) {
-			/* Commit here every time since this could create a huge
-			 * transaction.
-			 */
-			if (mysql_db_commit(mysql_conn)) {
-				error("Couldn't commit cluster (%s) purge",
-				      cluster_name);
-				break;
-			}
-		}
-
-		xfree(query);
-		if (rc != SLURM_SUCCESS) {
-			error("Couldn't remove old data from %s table",
-			      sql_table);
-			return SLURM_ERROR;
-		} else if (mysql_db_commit(mysql_conn)) {
-			error("Couldn't commit cluster (%s) purge",
-			      cluster_name);
-			break;
-		}
+		rc = _archive_purge_chunk(purge_type, usage_info, mysql_conn,
+					  cluster_name, arch_cond, purge_attr,
+					  tmp_archive_period, sql_table,
+					  col_name, tmp_end, &hold);
+		if (rc == SLURM_ERROR)
+			return rc;
+		purged += rc;
+		chunks++;
+		max_hold = MAX(max_hold, hold);
 	} while (tmp_end < curr_end);
+	END_TIMER;
+
+	if (purged)
+		debug("%s %"PRIu64" records from %s_%s in %d chunks: "
+		      "%ld usec, %.0f records/sec, longest lock %ld usec",
+		      SLURMDB_PURGE_ARCHIVE_SET(purge_attr) ?
+		      "Archived and purged" : "Purged",
+		      purged, cluster_name, sql_table, chunks, DELTA_TIMER,
+		      purged * 1000000.0 / MAX(DELTA_TIMER, 1), max_hold);
 
 	return SLURM_SUCCESS;
 }
@@ -3158,31 +3211,111 @@ static int _execute_archive(mysql_conn_t *mysql_conn,
 	return SLURM_SUCCESS;
 }
 
+/* Guards the failed flag shared by the archive threads */
+static pthread_mutex_t archive_failed_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool _archive_failed(bool *failed)
+{
+	bool rc;
+
+	slurm_mutex_lock(&archive_failed_lock);
+	rc = *failed;
+	slurm_mutex_unlock(&archive_failed_lock);
+
+	return rc;
+}
+
+static void _set_archive_failed(bool *failed)
+{
+	slurm_mutex_lock(&archive_failed_lock);
+	*failed = true;
+	slurm_mutex_unlock(&archive_failed_lock);
+}
+
+/* Archive clusters from cluster_list until it is empty or one fails */
+static int _execute_archive_list(mysql_conn_t *mysql_conn, List cluster_list,
+				 slurmdb_archive_cond_t *arch_cond,
+				 bool *failed)
+{
+	int rc = SLURM_SUCCESS;
+	char *cluster_name;
+
+	while (!_archive_failed(failed) &&
+	       (cluster_name = list_pop(cluster_list))) {
+		rc = _execute_archive(mysql_conn, cluster_name, arch_cond);
+		xfree(cluster_name);
+		if (rc != SLURM_SUCCESS)
+			_set_archive_failed(failed);
+	}
+
+	return rc;
+}
+
+typedef struct {
+	slurmdb_archive_cond_t *arch_cond;
+	List cluster_list;
+	bool *failed;
+	mysql_conn_t *mysql_conn;
+	int rc;
+} local_archive_t;
+
+static void *_execute_archive_thread(void *arg)
+{
+	local_archive_t *archive = (local_archive_t *)arg;
+	mysql_conn_t mysql_conn;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = archive->mysql_conn->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each thread needs it's own connection we can't use the one
+	 * sent from the parent thread. */
+	if ((archive->rc = check_connection(&mysql_conn)) == SLURM_SUCCESS)
+		archive->rc = _execute_archive_list(&mysql_conn,
+						    archive->cluster_list,
+						    archive->arch_cond,
+						    archive->failed);
+	else
+		_set_archive_failed(archive->failed);
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	return NULL;
+}
+
 extern int as_mysql_jobacct_process_archive(mysql_conn_t *mysql_conn,
 					    slurmdb_archive_cond_t *arch_cond)
 {
 	int rc = SLURM_SUCCESS;
+	int i, thread_cnt;
 	char *cluster_name = NULL;
 	List use_cluster_list;
-	bool new_cluster_list = false;
 	ListIterator itr = NULL;
+	bool failed = false;
+	local_archive_t *archives;
+	pthread_t *thread_ids;
+	pthread_attr_t thread_attr;
 
 	if (!arch_cond) {
 		error("No arch_cond was given to archive from.  returning");
 		return SLURM_ERROR;
 	}
 
+	/* execute_archive may take a long time to run, so don't keep the
+	 * as_mysql_cluster_list_lock locked the whole time, just copy the
+	 * list and work off that.  Clusters are taken off the copy as they
+	 * are archived.
+	 */
+	use_cluster_list = list_create(slurm_destroy_char);
 	if (arch_cond->job_cond && arch_cond->job_cond->cluster_list
 	    && list_count(arch_cond->job_cond->cluster_list)) {
-		use_cluster_list = arch_cond->job_cond->cluster_list;
+		itr = list_iterator_create(arch_cond->job_cond->cluster_list);
+		while ((cluster_name = list_next(itr)))
+			list_append(use_cluster_list, xstrdup(cluster_name));
+		list_iterator_destroy(itr);
 	} else {
-		/* execute_archive may take a long time to run, so
-		 * don't keep the as_mysql_cluster_list_lock locked
-		 * the whole time, just copy the list and work off
-		 * that.
-		 */
-		new_cluster_list = true;
-		use_cluster_list = list_create(slurm_destroy_char);
 		slurm_mutex_lock(&as_mysql_cluster_list_lock);
 		itr = list_iterator_create(as_mysql_cluster_list);
 		while ((cluster_name = list_next(itr)))
@@ -3191,16 +3324,37 @@ extern int as_mysql_jobacct_process_archive(mysql_conn_t *mysql_conn,
 		slurm_mutex_unlock(&as_mysql_cluster_list_lock);
 	}
 
-	itr = list_iterator_create(use_cluster_list);
-	while ((cluster_name = list_next(itr))) {
-		if ((rc = _execute_archive(mysql_conn, cluster_name, arch_cond))
-		    != SLURM_SUCCESS)
-			break;
-	}
-	list_iterator_destroy(itr);
-
-	if (new_cluster_list)
-		FREE_NULL_LIST(use_cluster_list);
+	/* The clusters' tables are independent of each other, so they are
+	 * archived and purged in parallel on their own connections.  This
+	 * connection works on the list as well.
+	 */
+	thread_cnt = MIN(list_count(use_cluster_list), ARCHIVE_MAX_THREADS);
+	archives = xmalloc(sizeof(local_archive_t) * (thread_cnt + 1));
+	thread_ids = xmalloc(sizeof(pthread_t) * (thread_cnt + 1));
+	for (i = 1; i < thread_cnt; i++) {
+		archives[i].arch_cond = arch_cond;
+		archives[i].cluster_list = use_cluster_list;
+		archives[i].failed = &failed;
+		archives[i].mysql_conn = mysql_conn;
+		slurm_attr_init(&thread_attr);
+		if (pthread_create(&thread_ids[i], &thread_attr,
+				   _execute_archive_thread, &archives[i]))
+			fatal("pthread_create: %m");
+		slurm_attr_destroy(&thread_attr);
+	}
+
+	rc = _execute_archive_list(mysql_conn, use_cluster_list, arch_cond,
+				   &failed);
+
+	for (i = 1; i < thread_cnt; i++) {
+		pthread_join(thread_ids[i], NULL);
+		if (archives[i].rc != SLURM_SUCCESS)
+			rc = archives[i].rc;
+	}
+	xfree(archives);
+	xfree(thread_ids);
+
+	FREE_NULL_LIST(use_cluster_list);
 
 	return rc;
 }
@@ -0,0 +1,307 @@
+/*****************************************************************************\
+ *  as_mysql_batch.c - multi-row statements for job step records.
+ *****************************************************************************
+ *
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "as_mysql_batch.h"
+#include "src/common/timers.h"
+
+typedef struct {
+	uint64_t job_db_inx;
+	int32_t step_id;
+} batch_key_t;
+
+typedef struct {
+	char *head;
+	batch_key_t *keys;
+	bool replace;
+	int row_cnt;
+	char **rows;
+	char *sep;
+	int size;		/* length of keys and rows */
+	char *tail;
+} batch_stmt_t;
+
+typedef struct {
+	struct timeval first;	/* when the oldest row was queued */
+	int row_cnt;
+	List stmt_list;		/* batch_stmt_t's in the order to run them */
+} batch_t;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t batch_cnt = 0;
+static uint64_t batch_rows = 0;
+static uint64_t batch_time = 0;
+static uint32_t commit_cnt = 0;
+static uint64_t commit_time = 0;
+static uint64_t commit_max_time = 0;
+
+static void _destroy_stmt(void *object)
+{
+	batch_stmt_t *stmt = (batch_stmt_t *)object;
+	int i;
+
+	if (stmt) {
+		for (i = 0; i < stmt->row_cnt; i++)
+			xfree(stmt->rows[i]);
+		xfree(stmt->rows);
+		xfree(stmt->keys);
+		xfree(stmt->head);
+		xfree(stmt->sep);
+		xfree(stmt->tail);
+		xfree(stmt);
+	}
+}
+
+static uint32_t _batch_size(void)
+{
+	if (!slurmdbd_conf || (slurmdbd_conf->batch_size <= 1))
+		return 1;
+	return slurmdbd_conf->batch_size;
+}
+
+static int _find_key(batch_stmt_t *stmt, uint64_t job_db_inx,
+		     int32_t step_id)
+{
+	int i;
+
+	for (i = 0; i < stmt->row_cnt; i++) {
+		if ((stmt->keys[i].job_db_inx == job_db_inx) &&
+		    (stmt->keys[i].step_id == step_id))
+			return i;
+	}
+	return -1;
+}
+
+static int _run_stmt(mysql_conn_t *mysql_conn, batch_stmt_t *stmt)
+{
+	char *query = NULL;
+	int i, rc;
+	DEF_TIMERS;
+
+	xstrcat(query, stmt->head);
+	for (i = 0; i < stmt->row_cnt; i++) {
+		if (i)
+			xstrcat(query, stmt->sep);
+		xstrcat(query, stmt->rows[i]);
+	}
+	xstrcat(query, stmt->tail);
+
+	if (debug_flags & DEBUG_FLAG_DB_STEP)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	START_TIMER;
+	rc = mysql_db_query(mysql_conn, query);
+	END_TIMER;
+	xfree(query);
+
+	slurm_mutex_lock(&stats_lock);
+	batch_cnt++;
+	batch_rows += stmt->row_cnt;
+	batch_time += DELTA_TIMER;
+	slurm_mutex_unlock(&stats_lock);
+
+	return rc;
+}
+
+extern int as_mysql_batch_add(mysql_conn_t *mysql_conn,
+			      const char *head, const char *sep,
+			      const char *tail, bool replace,
+			      uint64_t job_db_inx, int32_t step_id,
+			      const char *row)
+{
+	batch_t *batch;
+	batch_stmt_t *stmt = NULL, *later;
+	ListIterator itr;
+	uint32_t batch_size = _batch_size();
+	int found = -1, rc = SLURM_SUCCESS;
+	bool flush = false;
+
+	if (batch_size == 1) {
+		batch_stmt_t one = {
+			.head = (char *)head,
+			.row_cnt = 1,
+			.rows = (char **)&row,
+			.tail = (char *)tail,
+		};
+		return _run_stmt(mysql_conn, &one);
+	}
+
+	if (!(batch = mysql_conn->batch)) {
+		batch = xmalloc(sizeof(batch_t));
+		batch->stmt_list = list_create(_destroy_stmt);
+		mysql_conn->batch = batch;
+	}
+
+	/*
+	 * Find the statement this row belongs to.  If the record already has
+	 * a row queued that must be written before this one, run everything
+	 * queued first.
+	 */
+	itr = list_iterator_create(batch->stmt_list);
+	while ((later = list_next(itr))) {
+		if (!stmt) {
+			if (xstrcmp(later->head, head) ||
+			    xstrcmp(later->tail, tail))
+				continue;
+			stmt = later;
+			found = _find_key(stmt, job_db_inx, step_id);
+			if ((found >= 0) && !replace) {
+				flush = true;
+				break;
+			}
+		} else if (_find_key(later, job_db_inx, step_id) >= 0) {
+			flush = true;
+			break;
+		}
+	}
+	list_iterator_destroy(itr);
+
+	if (!flush && (found >= 0)) {
+		xfree(stmt->rows[found]);
+		stmt->rows[found] = xstrdup(row);
+		return SLURM_SUCCESS;
+	}
+
+	if (flush) {
+		if ((rc = as_mysql_batch_flush(mysql_conn)) != SLURM_SUCCESS)
+			return rc;
+		return as_mysql_batch_add(mysql_conn, head, sep, tail,
+					  replace, job_db_inx, step_id, row);
+	}
+
+	if (!stmt) {
+		stmt = xmalloc(sizeof(batch_stmt_t));
+		stmt->head = xstrdup(head);
+		stmt->keys = xmalloc(sizeof(batch_key_t) * batch_size);
+		stmt->rows = xmalloc(sizeof(char *) * batch_size);
+		stmt->sep = xstrdup(sep);
+		stmt->size = batch_size;
+		stmt->tail = xstrdup(tail);
+		list_append(batch->stmt_list, stmt);
+	}
+	stmt->keys[stmt->row_cnt].job_db_inx = job_db_inx;
+	stmt->keys[stmt->row_cnt].step_id = step_id;
+	stmt->rows[stmt->row_cnt++] = xstrdup(row);
+	if (!batch->row_cnt++)
+		gettimeofday(&batch->first, NULL);
+
+	if ((batch->row_cnt >= batch_size) || (stmt->row_cnt >= stmt->size))
+		flush = true;
+	else if (slurmdbd_conf->batch_delay) {
+		struct timeval now;
+		long age;
+
+		gettimeofday(&now, NULL);
+		age = (now.tv_sec - batch->first.tv_sec) * 1000 +
+		      (now.tv_usec - batch->first.tv_usec) / 1000;
+		if (age >= slurmdbd_conf->batch_delay)
+			flush = true;
+	}
+
+	if (flush)
+		rc = as_mysql_batch_flush(mysql_conn);
+
+	return rc;
+}
+
+extern int as_mysql_batch_flush(mysql_conn_t *mysql_conn)
+{
+	batch_t *batch = mysql_conn->batch;
+	batch_stmt_t *stmt;
+	ListIterator itr;
+	int rc = SLURM_SUCCESS, rc2;
+
+	if (!batch)
+		return SLURM_SUCCESS;
+
+	/*
+	 * Keep going after an error so the rest of the rows are not lost
+	 * when not running in a transaction.
+	 */
+	itr = list_iterator_create(batch->stmt_list);
+	while ((stmt = list_next(itr))) {
+		if ((rc2 = _run_stmt(mysql_conn, stmt)) != SLURM_SUCCESS)
+			rc = rc2;
+	}
+	list_iterator_destroy(itr);
+
+	as_mysql_batch_discard(mysql_conn);
+
+	return rc;
+}
+
+extern void as_mysql_batch_discard(mysql_conn_t *mysql_conn)
+{
+	batch_t *batch = mysql_conn->batch;
+
+	if (batch) {
+		FREE_NULL_LIST(batch->stmt_list);
+		xfree(batch);
+		mysql_conn->batch = NULL;
+	}
+}
+
+extern void as_mysql_batch_commit_time(uint64_t usec)
+{
+	slurm_mutex_lock(&stats_lock);
+	commit_cnt++;
+	commit_time += usec;
+	if (usec > commit_max_time)
+		commit_max_time = usec;
+	slurm_mutex_unlock(&stats_lock);
+}
+
+extern void as_mysql_batch_get_stats(slurmdb_stats_rec_t *stats)
+{
+	slurm_mutex_lock(&stats_lock);
+	stats->batch_cnt = batch_cnt;
+	stats->batch_rows = batch_rows;
+	stats->batch_time = batch_time;
+	stats->commit_cnt = commit_cnt;
+	stats->commit_time = commit_time;
+	stats->commit_max_time = commit_max_time;
+	slurm_mutex_unlock(&stats_lock);
+}
+
+extern void as_mysql_batch_clear_stats(void)
+{
+	slurm_mutex_lock(&stats_lock);
+	batch_cnt = 0;
+	batch_rows = 0;
+	batch_time = 0;
+	commit_cnt = 0;
+	commit_time = 0;
+	commit_max_time = 0;
+	slurm_mutex_unlock(&stats_lock);
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************\
+ *  as_mysql_batch.h - multi-row statements for job step records.
+ *****************************************************************************
+ *
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_MYSQL_BATCH_H
+#define _HAVE_MYSQL_BATCH_H
+
+#include "accounting_storage_mysql.h"
+
+/*
+ * Queue one row of a multi-row statement on mysql_conn.  Rows whose
+ * statements have the same head and tail are sent to the database together,
+ * joined with sep, when BatchSize rows are queued, when the oldest row is
+ * BatchDelay msecs old or when as_mysql_batch_flush() is called.
+ * job_db_inx and step_id identify the record the row writes so rows for the
+ * same record are written in the order they were queued.  If replace is set
+ * a queued row for the same record is replaced instead of written first.
+ * Without batching (outside of the slurmdbd or BatchSize=1) the statement is
+ * run right away.
+ * RET SLURM_SUCCESS or error code of the statements run
+ */
+extern int as_mysql_batch_add(mysql_conn_t *mysql_conn,
+			      const char *head, const char *sep,
+			      const char *tail, bool replace,
+			      uint64_t job_db_inx, int32_t step_id,
+			      const char *row);
+
+/* Run all statements queued on mysql_conn */
+extern int as_mysql_batch_flush(mysql_conn_t *mysql_conn);
+
+/* Forget all statements queued on mysql_conn */
+extern void as_mysql_batch_discard(mysql_conn_t *mysql_conn);
+
+/* Record a commit that took usec microseconds in the statistics */
+extern void as_mysql_batch_commit_time(uint64_t usec);
+
+/* Copy the batch and commit statistics into stats */
+extern void as_mysql_batch_get_stats(slurmdb_stats_rec_t *stats);
+
+extern void as_mysql_batch_clear_stats(void);
+
+#endif
@@ -37,6 +37,7 @@
 \*****************************************************************************/
 
 #include "as_mysql_convert.h"
+#include "as_mysql_partition.h"
 
 /* Any time you have to add to an existing convert update this number. */
 #define CONVERT_VERSION 2
@@ -371,3 +372,31 @@ extern int as_mysql_convert_tables_post_create(mysql_conn_t *mysql_conn)
 
 	return rc;
 }
+
+extern int as_mysql_convert_partitions_pre_create(mysql_conn_t *mysql_conn,
+						  char *cluster_name)
+{
+	/* Only the slurmdbd decides how the tables are laid out */
+	if (!slurmdbd_conf)
+		return SLURM_SUCCESS;
+
+	/* The primary key of the job table only holds time_submit when
+	 * partitioned, so the partitioning has to go before it changes. */
+	if (as_mysql_partition_enabled())
+		return SLURM_SUCCESS;
+
+	return as_mysql_unpartition_tables(mysql_conn, cluster_name);
+}
+
+extern int as_mysql_convert_partitions_post_create(mysql_conn_t *mysql_conn,
+						   char *cluster_name)
+{
+	if (!slurmdbd_conf || !as_mysql_partition_enabled())
+		return SLURM_SUCCESS;
+
+	if (as_mysql_partition_tables(mysql_conn, cluster_name)
+	    != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return as_mysql_partition_add_months(mysql_conn, cluster_name);
+}
@@ -47,4 +47,14 @@ extern int as_mysql_convert_tables_pre_create(mysql_conn_t *mysql_conn);
 /* Functions for converting tables after they are created */
 extern int as_mysql_convert_tables_post_create(mysql_conn_t *mysql_conn);
 
+/* Remove the partitioning of the cluster's tables before they are created if
+ * PartitionTables is not set */
+extern int as_mysql_convert_partitions_pre_create(mysql_conn_t *mysql_conn,
+						  char *cluster_name);
+
+/* Partition the cluster's tables after they are created if PartitionTables
+ * is set */
+extern int as_mysql_convert_partitions_post_create(mysql_conn_t *mysql_conn,
+						   char *cluster_name);
+
 #endif
@@ -35,6 +35,7 @@
 \*****************************************************************************/
 
 #include "as_mysql_fix_runaway_jobs.h"
+#include "as_mysql_rollup.h"
 #include "src/common/list.h"
 
 static int _job_sort_by_start_time(void *void1, void * void2)
@@ -71,6 +72,8 @@ static int _first_job_roll_up(mysql_conn_t *mysql_conn, time_t first_start)
 	start_tm.tm_isdst = -1;
 	month_start = slurm_mktime(&start_tm);
 
+	as_mysql_rollup_dirty(mysql_conn->cluster_name, month_start, 0);
+
 	query = xstrdup_printf("UPDATE \"%s_%s\" SET hourly_rollup = %ld, "
 			       "daily_rollup = %ld, monthly_rollup = %ld",
 			       mysql_conn->cluster_name, last_ran_table,
@@ -37,7 +37,9 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include "as_mysql_batch.h"
 #include "as_mysql_job.h"
+#include "as_mysql_rollup.h"
 #include "as_mysql_usage.h"
 #include "as_mysql_wckey.h"
 
@@ -49,6 +51,65 @@
 
 #define BUFFER_SIZE 4096
 
+/* Columns written when a step completes, the first two are the key */
+static char *step_comp_cols[] = {
+	"job_db_inx", "id_step", "time_end", "state", "kill_requid",
+	"exit_code", NULL
+};
+
+/* Columns written when a step completes with accounting data */
+static char *step_comp_acct_cols[] = {
+	"user_sec", "user_usec", "sys_sec", "sys_usec",
+	"max_disk_read", "max_disk_read_task", "max_disk_read_node",
+	"ave_disk_read",
+	"max_disk_write", "max_disk_write_task", "max_disk_write_node",
+	"ave_disk_write",
+	"max_vsize", "max_vsize_task", "max_vsize_node", "ave_vsize",
+	"max_rss", "max_rss_task", "max_rss_node", "ave_rss",
+	"max_pages", "max_pages_task", "max_pages_node", "ave_pages",
+	"min_cpu", "min_cpu_task", "min_cpu_node", "ave_cpu",
+	"act_cpufreq", "consumed_energy", NULL
+};
+
+/* Columns written on a job when one of its steps completes */
+static char *job_tres_cols[] = { "job_db_inx", "tres_alloc", NULL };
+
+/*
+ * Build the head and tail of a statement updating table from rows of
+ * values for cols and more_cols (if not NULL) joined with " union all
+ * select ".  The first key_cnt columns select the records to update.  A
+ * select returning no rows names the columns so the rows are just values.
+ */
+static void _make_update_join(mysql_conn_t *mysql_conn, char *table,
+			      int key_cnt, char **cols, char **more_cols,
+			      char **head, char **tail)
+{
+	char **col_list[2] = { cols, more_cols };
+	char *sep = "";
+	int i, j;
+
+	xstrfmtcat(*head, "update \"%s_%s\" as t inner join (select ",
+		   mysql_conn->cluster_name, table);
+	xstrcat(*tail, ") as v on ");
+	for (i = 0; i < key_cnt; i++)
+		xstrfmtcat(*tail, "%st.%s=v.%s", i ? " and " : "",
+			   cols[i], cols[i]);
+	xstrcat(*tail, " set ");
+
+	for (j = 0; (j < 2) && col_list[j]; j++) {
+		for (i = 0; col_list[j][i]; i++) {
+			xstrfmtcat(*head, "%s0 as %s", sep, col_list[j][i]);
+			sep = ", ";
+			if (!j && (i < key_cnt))
+				continue;
+			xstrfmtcat(*tail, "%st.%s=v.%s",
+				   ((j || (i > key_cnt)) ? ", " : ""),
+				   col_list[j][i], col_list[j][i]);
+		}
+	}
+	xstrcat(*head, " from dual where 0 union all select ");
+}
+
 /* Used in job functions for getting the database index based off the
  * submit time and job.  0 is returned if none is found
  */
@@ -331,6 +392,10 @@ extern int as_mysql_job_start(mysql_conn_t *mysql_conn,
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
 
+	/* Queued step records go in before anything else changes the job */
+	if ((rc = as_mysql_batch_flush(mysql_conn)) != SLURM_SUCCESS)
+		return rc;
+
 	debug2("as_mysql_slurmdb_job_start() called");
 
 	job_state = job_ptr->job_state;
@@ -442,6 +507,11 @@ extern int as_mysql_job_start(mysql_conn_t *mysql_conn,
 			      slurm_ctime2(&check_time),
 			      job_ptr->job_id, mysql_conn->cluster_name);
 
+		/* A job that already finished only changed the hours
+		 * it was around for. */
+		as_mysql_rollup_dirty(mysql_conn->cluster_name, check_time,
+				      IS_JOB_FINISHED(job_ptr) ?
+				      job_ptr->end_time : 0);
 		global_last_rollup = check_time;
 		slurm_mutex_unlock(&rollup_lock);
 
@@ -902,6 +972,10 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
 
+	/* Queued step records go in before anything else changes the job */
+	if ((rc = as_mysql_batch_flush(mysql_conn)) != SLURM_SUCCESS)
+		return rc;
+
 	debug2("as_mysql_slurmdb_job_complete() called");
 
 	if (job_ptr->resize_time)
@@ -940,6 +1014,8 @@ extern int as_mysql_job_complete(mysql_conn_t *mysql_conn,
 
 	slurm_mutex_lock(&rollup_lock);
 	if (end_time < global_last_rollup) {
+		/* The hours since it ended counted it as running */
+		as_mysql_rollup_dirty(mysql_conn->cluster_name, end_time, 0);
 		global_last_rollup = job_ptr->end_time;
 		slurm_mutex_unlock(&rollup_lock);
 
@@ -1056,7 +1132,7 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	char node_list[BUFFER_SIZE];
 	char *node_inx = NULL, *step_name = NULL;
 	time_t start_time, submit_time;
-	char *query = NULL;
+	char *head = NULL, *row = NULL;
 
 	if (!step_ptr->job_ptr->db_index
 	    && ((!step_ptr->job_ptr->details
@@ -1175,36 +1251,41 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 
 	step_name = slurm_add_slash_to_quotes(step_ptr->name);
 
-	/* we want to print a -1 for the requid so leave it a
-	   %d */
-	/* The stepid could be -2 so use %d not %u */
-	query = xstrdup_printf(
+	/* Steps starting together are written by one statement */
+	head = xstrdup_printf(
 		"insert into \"%s_%s\" (job_db_inx, id_step, time_start, "
 		"step_name, state, tres_alloc, "
 		"nodes_alloc, task_cnt, nodelist, node_inx, "
 		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov) "
-		"values (%"PRIu64", %d, %d, '%s', %d, '%s', %d, %d, "
-		"'%s', '%s', %d, %u, %u, %u) "
-		"on duplicate key update "
-		"nodes_alloc=%d, task_cnt=%d, time_end=0, state=%d, "
-		"nodelist='%s', node_inx='%s', task_dist=%d, "
-		"req_cpufreq=%u, req_cpufreq_min=%u, req_cpufreq_gov=%u,"
-		"tres_alloc='%s';",
-		mysql_conn->cluster_name, step_table,
+		"values ",
+		mysql_conn->cluster_name, step_table);
+	/* The stepid could be -2 so use %d not %u */
+	row = xstrdup_printf(
+		"(%"PRIu64", %d, %d, '%s', %d, '%s', %d, %d, "
+		"'%s', '%s', %d, %u, %u, %u)",
 		step_ptr->job_ptr->db_index,
 		step_ptr->step_id,
 		(int)start_time, step_name,
 		JOB_RUNNING, step_ptr->tres_alloc_str,
 		nodes, tasks, node_list, node_inx, task_dist,
 		step_ptr->cpu_freq_max, step_ptr->cpu_freq_min,
-		step_ptr->cpu_freq_gov, nodes, tasks, JOB_RUNNING,
-		node_list, node_inx, task_dist, step_ptr->cpu_freq_max,
-		step_ptr->cpu_freq_min, step_ptr->cpu_freq_gov,
-		step_ptr->tres_alloc_str);
-	if (debug_flags & DEBUG_FLAG_DB_STEP)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
-	xfree(query);
+		step_ptr->cpu_freq_gov);
+	rc = as_mysql_batch_add(mysql_conn, head, ", ",
+				" on duplicate key update "
+				"nodes_alloc=VALUES(nodes_alloc), "
+				"task_cnt=VALUES(task_cnt), time_end=0, "
+				"state=VALUES(state), "
+				"nodelist=VALUES(nodelist), "
+				"node_inx=VALUES(node_inx), "
+				"task_dist=VALUES(task_dist), "
+				"req_cpufreq=VALUES(req_cpufreq), "
+				"req_cpufreq_min=VALUES(req_cpufreq_min), "
+				"req_cpufreq_gov=VALUES(req_cpufreq_gov), "
+				"tres_alloc=VALUES(tres_alloc);",
+				false, step_ptr->job_ptr->db_index,
+				step_ptr->step_id, row);
+	xfree(head);
+	xfree(row);
 	xfree(step_name);
 
 	return rc;
@@ -1217,7 +1298,7 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 	uint16_t comp_status;
 	int tasks = 0;
 	struct jobacctinfo *jobacct = (struct jobacctinfo *)step_ptr->jobacct;
-	char *query = NULL;
+	char *head = NULL, *tail = NULL, *row = NULL;
 	int rc = SLURM_SUCCESS;
 	uint32_t exit_code = 0;
 	time_t submit_time;
@@ -1305,14 +1386,10 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 	}
 
 	/* The stepid could be -2 so use %d not %u */
-	query = xstrdup_printf(
-		"update \"%s_%s\" set time_end=%d, state=%u, "
-		"kill_requid=%d, exit_code=%d",
-		mysql_conn->cluster_name, step_table, (int)now,
-		comp_status,
-		step_ptr->requid,
-		exit_code);
-
+	row = xstrdup_printf("%"PRIu64", %d, %d, %u, %d, %d",
+			     step_ptr->job_ptr->db_index, step_ptr->step_id,
+			     (int)now, comp_status, step_ptr->requid,
+			     exit_code);
 
 	if (jobacct) {
 		double ave_vsize = NO_VAL, ave_rss = NO_VAL, ave_pages = NO_VAL;
@@ -1335,22 +1412,16 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 			ave_disk_write /= (double)tasks;
 		}
 
-		xstrfmtcat(query,
-			   ", user_sec=%u, user_usec=%u, "
-			   "sys_sec=%u, sys_usec=%u, "
-			   "max_disk_read=%f, max_disk_read_task=%u, "
-			   "max_disk_read_node=%u, ave_disk_read=%f, "
-			   "max_disk_write=%f, max_disk_write_task=%u, "
-			   "max_disk_write_node=%u, ave_disk_write=%f, "
-			   "max_vsize=%"PRIu64", max_vsize_task=%u, "
-			   "max_vsize_node=%u, ave_vsize=%f, "
-			   "max_rss=%"PRIu64", max_rss_task=%u, "
-			   "max_rss_node=%u, ave_rss=%f, "
-			   "max_pages=%"PRIu64", max_pages_task=%u, "
-			   "max_pages_node=%u, ave_pages=%f, "
-			   "min_cpu=%u, min_cpu_task=%u, "
-			   "min_cpu_node=%u, ave_cpu=%f, "
-			   "act_cpufreq=%u, consumed_energy=%"PRIu64"",
+		/* In the order of step_comp_acct_cols */
+		xstrfmtcat(row,
+			   ", %u, %u, %u, %u, "
+			   "%f, %u, %u, %f, "
+			   "%f, %u, %u, %f, "
+			   "%"PRIu64", %u, %u, %f, "
+			   "%"PRIu64", %u, %u, %f, "
+			   "%"PRIu64", %u, %u, %f, "
+			   "%u, %u, %u, %f, "
+			   "%u, %"PRIu64"",
 			   /* user seconds */
 			   jobacct->user_cpu_sec,
 			   /* user microseconds */
@@ -1395,29 +1466,30 @@ extern int as_mysql_step_complete(mysql_conn_t *mysql_conn,
 			   jobacct->energy.consumed_energy);
 	}
 
-	/* id_step has to be %d here to handle the -2 -1 for the batch and
-	   extern steps.  Don't change it to a %u.
-	*/
-	xstrfmtcat(query,
-		   " where job_db_inx=%"PRIu64" and id_step=%d",
-		   step_ptr->job_ptr->db_index, step_ptr->step_id);
-	if (debug_flags & DEBUG_FLAG_DB_STEP)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
-	xfree(query);
+	/* Steps completing together are written by one statement */
+	_make_update_join(mysql_conn, step_table, 2, step_comp_cols,
+			  jobacct ? step_comp_acct_cols : NULL, &head, &tail);
+	rc = as_mysql_batch_add(mysql_conn, head, " union all select ", tail,
+				false, step_ptr->job_ptr->db_index,
+				step_ptr->step_id, row);
+	xfree(head);
+	xfree(tail);
+	xfree(row);
 
 	/* set the energy for the entire job. */
 	if (step_ptr->job_ptr->tres_alloc_str) {
-		query = xstrdup_printf(
-			"update \"%s_%s\" set tres_alloc='%s' where "
-			"job_db_inx=%"PRIu64,
-			mysql_conn->cluster_name, job_table,
-			step_ptr->job_ptr->tres_alloc_str,
-			step_ptr->job_ptr->db_index);
-		if (debug_flags & DEBUG_FLAG_DB_STEP)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		rc = mysql_db_query(mysql_conn, query);
-		xfree(query);
+		_make_update_join(mysql_conn, job_table, 1, job_tres_cols,
+				  NULL, &head, &tail);
+		row = xstrdup_printf("%"PRIu64", '%s'",
+				     step_ptr->job_ptr->db_index,
+				     step_ptr->job_ptr->tres_alloc_str);
+		/* Only the last value for the job matters, not a step */
+		rc = as_mysql_batch_add(mysql_conn, head, " union all select ",
+					tail, true, step_ptr->job_ptr->db_index,
+					INT32_MIN, row);
+		xfree(head);
+		xfree(tail);
+		xfree(row);
 	}
 
 	return rc;
@@ -1435,6 +1507,10 @@ extern int as_mysql_suspend(mysql_conn_t *mysql_conn,
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
 
+	/* Queued step records go in before anything else changes the job */
+	if ((rc = as_mysql_batch_flush(mysql_conn)) != SLURM_SUCCESS)
+		return rc;
+
 	if (job_ptr->resize_time)
 		submit_time = job_ptr->resize_time;
 	else
@@ -1533,6 +1609,10 @@ extern int as_mysql_flush_jobs_on_cluster(
 	if (check_connection(mysql_conn) != SLURM_SUCCESS)
 		return ESLURM_DB_CONNECTION;
 
+	/* Queued step records go in before anything else changes the job */
+	if ((rc = as_mysql_batch_flush(mysql_conn)) != SLURM_SUCCESS)
+		return rc;
+
 	/* First we need to get the job_db_inx's and states so we can clean up
 	 * the suspend table and the step table
 	 */
@@ -43,6 +43,7 @@
 \*****************************************************************************/
 
 #include "as_mysql_jobacct_process.h"
+#include "as_mysql_partition.h"
 
 typedef struct {
 	hostlist_t hl;
@@ -364,15 +365,84 @@ static void _destroy_local_cluster(void *object)
 	}
 }
 
+/* Limit extra to the jobs of the associations of user and of the accounts
+ * they are coordinator of. visible is set false if the user has no
+ * associations on the cluster, extra is freed then. */
+static int _setup_private_limits(mysql_conn_t *mysql_conn,
+				 slurmdb_user_rec_t *user, char *cluster_name,
+				 char **extra, bool *visible)
+{
+	char *query = NULL;
+	char *prefix = "t2";
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	ListIterator itr = NULL;
+	int set = 0;
+
+	query = xstrdup_printf("select lft from \"%s_%s\" "
+			       "where user='%s'",
+			       cluster_name, assoc_table, user->name);
+	if (user->coord_accts) {
+		slurmdb_coord_rec_t *coord = NULL;
+		itr = list_iterator_create(user->coord_accts);
+		while ((coord = list_next(itr))) {
+			xstrfmtcat(query, " || acct='%s'",
+				   coord->name);
+		}
+		list_iterator_destroy(itr);
+	}
+	if (debug_flags & DEBUG_FLAG_DB_JOB)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+		xfree(query);
+		return SLURM_ERROR;
+	}
+	xfree(query);
+	while ((row = mysql_fetch_row(result))) {
+		if (set) {
+			xstrfmtcat(*extra,
+				   " || (%s between %s.lft and %s.rgt)",
+				   row[0], prefix, prefix);
+		} else {
+			set = 1;
+			if (*extra)
+				xstrfmtcat(*extra,
+					   " && ((%s between %s.lft "
+					   "and %s.rgt)",
+					   row[0], prefix, prefix);
+			else
+				xstrfmtcat(*extra,
+					   " where ((%s between %s.lft "
+					   "and %s.rgt)",
+					   row[0], prefix, prefix);
+		}
+	}
+
+	mysql_free_result(result);
+
+	if (set)
+		xstrcat(*extra, ")");
+	else {
+		xfree(*extra);
+		debug("User %s has no associations, and is not admin, "
+		      "so not returning any jobs.", user->name);
+		*visible = false;
+	}
+
+	return SLURM_SUCCESS;
+}
+
 static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     slurmdb_user_rec_t *user,
 			     slurmdb_job_cond_t *job_cond,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending, List sent_list,
+			     uint32_t after_jobid, uint32_t limit,
+			     uint32_t *last_jobid)
 {
-	char *query = NULL;
+	char *query = NULL, *page_query = NULL;
 	char *extra = xstrdup(sent_extra);
 	uint16_t private_data = slurm_get_private_data();
 	slurmdb_selected_step_t *selected_step = NULL;
@@ -385,9 +455,9 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	ListIterator itr = NULL, itr2 = NULL;
 	List local_cluster_list = NULL;
 	int set = 0;
-	char *prefix="t2";
 	int rc = SLURM_SUCCESS;
 	int last_id = -1, curr_id = -1;
+	uint32_t stop_id = 0;
 	local_cluster_t *curr_cluster = NULL;
 
 	/* This is here to make sure we are looking at only this user
@@ -395,68 +465,29 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	 * coordinator of.
 	 */
 	if (!is_admin && (private_data & PRIVATE_DATA_JOBS)) {
-		query = xstrdup_printf("select lft from \"%s_%s\" "
-				       "where user='%s'",
-				       cluster_name, assoc_table, user->name);
-		if (user->coord_accts) {
-			slurmdb_coord_rec_t *coord = NULL;
-			itr = list_iterator_create(user->coord_accts);
-			while ((coord = list_next(itr))) {
-				xstrfmtcat(query, " || acct='%s'",
-					   coord->name);
-			}
-			list_iterator_destroy(itr);
-		}
-		if (debug_flags & DEBUG_FLAG_DB_JOB)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
+		bool visible = true;
+
+		if (_setup_private_limits(mysql_conn, user, cluster_name,
+					  &extra, &visible) != SLURM_SUCCESS) {
 			xfree(extra);
-			xfree(query);
 			rc = SLURM_ERROR;
 			goto end_it;
 		}
-		xfree(query);
-		set = 0;
-		while ((row = mysql_fetch_row(result))) {
-			if (set) {
-				xstrfmtcat(extra,
-					   " || (%s between %s.lft and %s.rgt)",
-					   row[0], prefix, prefix);
-			} else {
-				set = 1;
-				if (extra)
-					xstrfmtcat(extra,
-						   " && ((%s between %s.lft "
-						   "and %s.rgt)",
-						   row[0], prefix,
-						   prefix);
-				else
-					xstrfmtcat(extra,
-						   " where ((%s between %s.lft "
-						   "and %s.rgt)",
-						   row[0], prefix,
-						   prefix);
-			}
-		}
-
-		mysql_free_result(result);
-
-		if (set)
-			xstrcat(extra, ")");
-		else {
-			xfree(extra);
-			debug("User %s has no associations, and is not admin, "
-			      "so not returning any jobs.", user->name);
-			/* This user has no valid associations, so
-			 * they will not have any jobs. */
+		/* This user has no valid associations, so
+		 * they will not have any jobs. */
+		if (!visible)
 			goto end_it;
-		}
 	}
 
 	setup_job_cluster_cond_limits(mysql_conn, job_cond,
 				      cluster_name, &extra);
 
+	/* A page starts after the last job id the page before it ended
+	 * with */
+	if (limit)
+		xstrfmtcat(extra, "%s(t1.id_job > %u)",
+			   extra ? " && " : " where ", after_jobid);
+
 	query = xstrdup_printf("select %s from \"%s_%s\" as t1 "
 			       "left join \"%s_%s\" as t2 "
 			       "on t1.id_assoc=t2.id_assoc "
@@ -480,17 +511,48 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 
 	/* Here we want to order them this way in such a way so it is
 	   easy to look for duplicates, it is also easy to sort the
-	   resized jobs.
+	   resized jobs.  Pages start after the last job id of the page
+	   before them, so the order must not be left to the group by:
+	   MySQL 8 no longer sorts by it.
 	*/
 	xstrcat(query, " group by id_job, time_submit desc");
+	if (limit)
+		xstrcat(query, " order by t1.id_job, t1.time_submit desc");
+
+page_again:
+	if (limit)
+		page_query = xstrdup_printf("%s limit %u", query, limit);
 
 	if (debug_flags & DEBUG_FLAG_DB_JOB)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+		DB_DEBUG(mysql_conn->conn, "query\n%s",
+			 page_query ? page_query : query);
+	result = mysql_db_query_ret(mysql_conn,
+				    page_query ? page_query : query, 0);
+	xfree(page_query);
+	if (!result) {
 		xfree(query);
 		rc = SLURM_ERROR;
 		goto end_it;
 	}
+
+	/* If the page is full the records of its last job id may go on
+	 * past it, so leave that id to the next page to keep them together.
+	 * A single id filling the page makes the page bigger. */
+	if (limit && (mysql_num_rows(result) >= limit)) {
+		mysql_data_seek(result, mysql_num_rows(result) - 1);
+		row = mysql_fetch_row(result);
+		stop_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		mysql_data_seek(result, 0);
+		row = mysql_fetch_row(result);
+		if (slurm_atoul(row[JOB_REQ_JOBID]) == stop_id) {
+			mysql_free_result(result);
+			stop_id = 0;
+			limit *= 2;
+			goto page_again;
+		}
+		mysql_data_seek(result, 0);
+		*last_jobid = stop_id - 1;
+	}
 	xfree(query);
 
 
@@ -517,6 +579,9 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 
 		curr_id = slurm_atoul(row[JOB_REQ_JOBID]);
 
+		if (stop_id && (curr_id == stop_id))
+			break;
+
 		if (job_cond && !job_cond->duplicates
 		    && (curr_id == last_id)
 		    && (slurm_atoul(row[JOB_REQ_STATE]) != JOB_RESIZING))
@@ -1523,6 +1588,12 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 				   "t1.time_eligible < %ld))",
 				   job_cond->usage_end);
 		}
+
+		/* Jobs are submitted before they are eligible, telling the
+		 * database so lets it skip the later monthly partitions. */
+		if (job_cond->usage_end && as_mysql_partition_enabled())
+			xstrfmtcat(*extra, " && t1.time_submit < %ld",
+				   job_cond->usage_end);
 	}
 
 	if (job_cond->wckey_list && list_count(job_cond->wckey_list)) {
@@ -1612,14 +1683,56 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
-	while ((cluster_name = list_next(itr))) {
-		int rc;
-		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
-					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
-		    != SLURM_SUCCESS)
-			error("Problem getting jobs for cluster %s",
-			      cluster_name);
+	if (job_cond && job_cond->page_size) {
+		/* Only give back a page of jobs, starting after the job the
+		 * last page ended with. Clusters are walked in the same
+		 * order every time so the cursor stays valid. */
+		uint32_t after_jobid = 0, last_jobid, limit;
+		bool started = (job_cond->page_cluster == NULL);
+
+		while ((cluster_name = list_next(itr))) {
+			if (!started) {
+				if (xstrcmp(cluster_name,
+					    job_cond->page_cluster))
+					continue;
+				started = true;
+				after_jobid = job_cond->page_jobid;
+			}
+			do {
+				last_jobid = 0;
+				limit = job_cond->page_size -
+					MIN(list_count(job_list),
+					    job_cond->page_size / 2);
+				if (_cluster_get_jobs(mysql_conn, &user,
+						      job_cond, cluster_name,
+						      tmp, tmp2, extra,
+						      is_admin, only_pending,
+						      job_list, after_jobid,
+						      limit, &last_jobid)
+				    != SLURM_SUCCESS) {
+					error("Problem getting jobs for "
+					      "cluster %s", cluster_name);
+					break;
+				}
+				after_jobid = last_jobid;
+			} while (last_jobid &&
+				 (list_count(job_list) < job_cond->page_size));
+			after_jobid = 0;
+			if (list_count(job_list) >= job_cond->page_size)
+				break;
+		}
+	} else {
+		while ((cluster_name = list_next(itr))) {
+			int rc;
+			if ((rc = _cluster_get_jobs(mysql_conn, &user,
+						    job_cond, cluster_name,
+						    tmp, tmp2, extra,
+						    is_admin, only_pending,
+						    job_list, 0, 0, NULL))
+			    != SLURM_SUCCESS)
+				error("Problem getting jobs for cluster %s",
+				      cluster_name);
+		}
 	}
 	list_iterator_destroy(itr);
 
@@ -1634,3 +1747,247 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	return job_list;
 }
+
+#define JOB_AGGR_BUCKET 86400	/* default time bucket, a day */
+
+/* if this changes you will need to edit the corresponding enum below */
+static char *job_aggr_inx[] = {
+	"user",
+	"uid",
+	"acct",
+	"part",
+	"state",
+	"bucket",
+};
+
+enum {
+	JOB_AGGR_USER,
+	JOB_AGGR_UID,
+	JOB_AGGR_ACCOUNT,
+	JOB_AGGR_PARTITION,
+	JOB_AGGR_STATE,
+	JOB_AGGR_TIME,
+	JOB_AGGR_GROUP_COUNT,
+	JOB_AGGR_JOBS = JOB_AGGR_GROUP_COUNT,
+	JOB_AGGR_CPU_ALLOC,
+	JOB_AGGR_CPU_USED,
+	JOB_AGGR_ELAPSED,
+	JOB_AGGR_TIMELIMIT,
+	JOB_AGGR_WAIT,
+	JOB_AGGR_COUNT
+};
+
+static int _cluster_get_jobs_aggr(mysql_conn_t *mysql_conn,
+				  slurmdb_user_rec_t *user,
+				  slurmdb_job_aggr_cond_t *aggr_cond,
+				  char *cluster_name, char *sent_extra,
+				  bool is_admin, List ret_list)
+{
+	char *query = NULL, *jobs_query = NULL, *group = NULL;
+	char *extra = xstrdup(sent_extra);
+	uint16_t private_data = slurm_get_private_data();
+	uint32_t group_by = aggr_cond->group_by;
+	uint32_t bucket = aggr_cond->time_bucket ?
+		aggr_cond->time_bucket : JOB_AGGR_BUCKET;
+	slurmdb_job_aggr_rec_t *aggr;
+	MYSQL_RES *result = NULL;
+	MYSQL_ROW row;
+	time_t now = time(NULL);
+	int i;
+
+	if (!is_admin && (private_data & PRIVATE_DATA_JOBS)) {
+		bool visible = true;
+
+		if (_setup_private_limits(mysql_conn, user, cluster_name,
+					  &extra, &visible) != SLURM_SUCCESS) {
+			xfree(extra);
+			return SLURM_ERROR;
+		}
+		if (!visible)
+			return SLURM_SUCCESS;
+	}
+
+	setup_job_cluster_cond_limits(mysql_conn, aggr_cond->job_cond,
+				      cluster_name, &extra);
+
+	/* Pick out the columns of every job the totals are made of, then
+	 * group those so only the totals come back. The cpus of a job are
+	 * the TRES_CPU count of its tres_alloc string. */
+	xstrfmtcat(jobs_query,
+		   "select t2.user as user, t1.id_user as uid, "
+		   "t2.acct as acct, t1.partition as part, "
+		   "(t1.state & %u) as state, "
+		   "(t1.time_submit - (t1.time_submit %% %u)) as bucket, "
+		   "if(locate(',%d=', concat(',', t1.tres_alloc)), "
+		   "cast(substring_index(substring_index("
+		   "concat(',', t1.tres_alloc), ',%d=', -1), ',', 1) "
+		   "as unsigned), 0) as cpus, "
+		   "ifnull((select sum(user_sec + sys_sec) + "
+		   "sum(user_usec + sys_usec) div 1000000 from \"%s_%s\" "
+		   "where job_db_inx=t1.job_db_inx), 0) as cpu_used, "
+		   "if(t1.time_start, greatest("
+		   "cast(if(t1.time_end, t1.time_end, %ld) as signed) - "
+		   "cast(t1.time_start as signed) - "
+		   "cast(t1.time_suspended as signed), 0), 0) as elapsed, "
+		   "if(t1.timelimit < %u, t1.timelimit * 60, 0) "
+		   "as timelimit, "
+		   "if(t1.time_start > t1.time_eligible && t1.time_eligible, "
+		   "t1.time_start - t1.time_eligible, 0) as wait "
+		   "from \"%s_%s\" as t1 left join \"%s_%s\" as t2 "
+		   "on t1.id_assoc=t2.id_assoc",
+		   JOB_STATE_BASE, bucket, TRES_CPU, TRES_CPU,
+		   cluster_name, step_table, now, NO_VAL,
+		   cluster_name, job_table, cluster_name, assoc_table);
+	if (extra) {
+		xstrcat(jobs_query, extra);
+		xfree(extra);
+	}
+
+	for (i = 0; i < JOB_AGGR_GROUP_COUNT; i++) {
+		bool grouped;
+
+		switch (i) {
+		case JOB_AGGR_USER:
+		case JOB_AGGR_UID:
+			grouped = group_by & SLURMDB_JOB_AGGR_USER;
+			break;
+		case JOB_AGGR_ACCOUNT:
+			grouped = group_by & SLURMDB_JOB_AGGR_ACCOUNT;
+			break;
+		case JOB_AGGR_PARTITION:
+			grouped = group_by & SLURMDB_JOB_AGGR_PARTITION;
+			break;
+		case JOB_AGGR_STATE:
+			grouped = group_by & SLURMDB_JOB_AGGR_STATE;
+			break;
+		default:
+			grouped = group_by & SLURMDB_JOB_AGGR_TIME;
+			break;
+		}
+		if (grouped) {
+			xstrfmtcat(group, "%s%s", group ? ", " : " group by ",
+				   job_aggr_inx[i]);
+			xstrfmtcat(extra, "%s, ", job_aggr_inx[i]);
+		} else
+			xstrcat(extra, "NULL, ");
+	}
+
+	query = xstrdup_printf("select %scount(*), sum(cpus * elapsed), "
+			       "sum(cpu_used), sum(elapsed), sum(timelimit), "
+			       "sum(wait) from (%s) as j%s",
+			       extra, jobs_query, group ? group : "");
+	xfree(jobs_query);
+	xfree(extra);
+	xfree(group);
+
+	if (debug_flags & DEBUG_FLAG_DB_JOB)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+
+	while ((row = mysql_fetch_row(result))) {
+		/* No jobs and no groups is still a row */
+		if (!slurm_atoul(row[JOB_AGGR_JOBS]))
+			continue;
+
+		aggr = xmalloc(sizeof(slurmdb_job_aggr_rec_t));
+		list_append(ret_list, aggr);
+
+		aggr->cluster = xstrdup(cluster_name);
+		aggr->account = xstrdup(row[JOB_AGGR_ACCOUNT]);
+		aggr->partition = xstrdup(row[JOB_AGGR_PARTITION]);
+		aggr->user = xstrdup(row[JOB_AGGR_USER]);
+		if (row[JOB_AGGR_UID])
+			aggr->uid = slurm_atoul(row[JOB_AGGR_UID]);
+		if (row[JOB_AGGR_STATE])
+			aggr->state = slurm_atoul(row[JOB_AGGR_STATE]);
+		if (row[JOB_AGGR_TIME])
+			aggr->time_start = slurm_atoul(row[JOB_AGGR_TIME]);
+
+		aggr->job_cnt = slurm_atoul(row[JOB_AGGR_JOBS]);
+		aggr->cpu_alloc_secs = slurm_atoull(row[JOB_AGGR_CPU_ALLOC]);
+		aggr->cpu_used_secs = slurm_atoull(row[JOB_AGGR_CPU_USED]);
+		aggr->elapsed_secs = slurm_atoull(row[JOB_AGGR_ELAPSED]);
+		aggr->timelimit_secs = slurm_atoull(row[JOB_AGGR_TIMELIMIT]);
+		aggr->wait_secs = slurm_atoull(row[JOB_AGGR_WAIT]);
+	}
+	mysql_free_result(result);
+
+	return SLURM_SUCCESS;
+}
+
+extern List as_mysql_jobacct_process_get_jobs_aggr(
+	mysql_conn_t *mysql_conn, uid_t uid,
+	slurmdb_job_aggr_cond_t *aggr_cond)
+{
+	slurmdb_job_cond_t *job_cond;
+	char *extra = NULL;
+	ListIterator itr = NULL;
+	int is_admin = 1;
+	List ret_list = NULL;
+	List use_cluster_list = as_mysql_cluster_list;
+	char *cluster_name;
+	slurmdb_user_rec_t user;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+
+	if (!aggr_cond) {
+		errno = SLURM_ERROR;
+		return NULL;
+	}
+	job_cond = aggr_cond->job_cond;
+
+	/* Jobs are only matched to nodes after they are read */
+	if (job_cond && job_cond->used_nodes) {
+		error("Job totals can't be limited to nodes");
+		errno = ESLURM_NOT_SUPPORTED;
+		return NULL;
+	}
+
+	memset(&user, 0, sizeof(slurmdb_user_rec_t));
+	user.uid = uid;
+
+	if (slurm_get_private_data() & PRIVATE_DATA_JOBS) {
+		if (!(is_admin = is_user_min_admin_level(
+			      mysql_conn, uid, SLURMDB_ADMIN_OPERATOR)))
+			is_user_any_coord(mysql_conn, &user);
+		if (!is_admin && !user.name) {
+			debug("User %u has no associations, and is not admin, "
+			      "so not returning any jobs.", user.uid);
+			return NULL;
+		}
+	}
+
+	setup_job_cond_limits(job_cond, &extra);
+
+	if (job_cond
+	    && job_cond->cluster_list && list_count(job_cond->cluster_list))
+		use_cluster_list = job_cond->cluster_list;
+	else
+		slurm_mutex_lock(&as_mysql_cluster_list_lock);
+
+	/* user.coord_accts is from the assoc_mgr */
+	assoc_mgr_lock(&locks);
+
+	ret_list = list_create(slurmdb_destroy_job_aggr_rec);
+	itr = list_iterator_create(use_cluster_list);
+	while ((cluster_name = list_next(itr))) {
+		if (_cluster_get_jobs_aggr(mysql_conn, &user, aggr_cond,
+					   cluster_name, extra, is_admin,
+					   ret_list) != SLURM_SUCCESS)
+			error("Problem getting job totals for cluster %s",
+			      cluster_name);
+	}
+	list_iterator_destroy(itr);
+
+	assoc_mgr_unlock(&locks);
+
+	if (use_cluster_list == as_mysql_cluster_list)
+		slurm_mutex_unlock(&as_mysql_cluster_list_lock);
+
+	xfree(extra);
+
+	return ret_list;
+}
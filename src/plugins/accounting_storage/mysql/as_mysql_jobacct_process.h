@@ -61,4 +61,8 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn, uid_t uid,
 					   slurmdb_job_cond_t *job_cond);
 
+extern List as_mysql_jobacct_process_get_jobs_aggr(
+	mysql_conn_t *mysql_conn, uid_t uid,
+	slurmdb_job_aggr_cond_t *aggr_cond);
+
 #endif
@@ -0,0 +1,347 @@
+/*****************************************************************************\
+ *  as_mysql_partition.c - monthly partitions of the job and event tables.
+ *****************************************************************************
+ *
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "as_mysql_partition.h"
+#include "src/common/slurm_time.h"
+
+/* Months from now partitions are created for ahead of time */
+#define PARTITION_MONTHS_AHEAD 3
+/* Most months before now a table is partitioned by, older records all go
+ * into the first partition.  Updates by job_db_inx can't be pruned by the
+ * submit time and look into every partition, so keep them few. */
+#define PARTITION_MONTHS_BACK 12
+
+/* Time column the records of sql_table are partitioned by */
+static char *_partition_col(char *sql_table)
+{
+	if (sql_table == job_table)
+		return "time_submit";
+	return "time_start";
+}
+
+/* Start of the month nmonths after the one holding when */
+static time_t _month_start(time_t when, int nmonths)
+{
+	struct tm parts;
+
+	slurm_localtime_r(&when, &parts);
+
+	parts.tm_mon += nmonths;
+	parts.tm_year += parts.tm_mon / 12;
+	parts.tm_mon %= 12;
+	if (parts.tm_mon < 0) {
+		parts.tm_year--;
+		parts.tm_mon += 12;
+	}
+	parts.tm_mday  = 1;
+	parts.tm_hour  = 0;
+	parts.tm_min   = 0;
+	parts.tm_sec   = 0;
+	parts.tm_isdst = -1;
+
+	return slurm_mktime(&parts);
+}
+
+/* Add the partition of the month starting at month_start to *parts */
+static void _add_month(char **parts, time_t month_start)
+{
+	struct tm tm;
+
+	slurm_localtime_r(&month_start, &tm);
+	xstrfmtcat(*parts, "partition p%04d%02d values less than (%ld), ",
+		   tm.tm_year + 1900, tm.tm_mon + 1,
+		   (long)_month_start(month_start, 1));
+}
+
+/* Returns SLURM_ERROR on mysql error, 1 if the table is partitioned and 0 if
+ * it is not */
+static int _is_partitioned(mysql_conn_t *mysql_conn, char *cluster_name,
+			   char *sql_table)
+{
+	char *query;
+	MYSQL_RES *result;
+	int rc;
+
+	query = xstrdup_printf("select partition_name from "
+			       "information_schema.partitions where "
+			       "table_schema=database() && "
+			       "table_name='%s_%s' && "
+			       "partition_name is not null limit 1;",
+			       cluster_name, sql_table);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+	rc = mysql_num_rows(result) ? 1 : 0;
+	mysql_free_result(result);
+
+	return rc;
+}
+
+static int _partition_table(mysql_conn_t *mysql_conn, char *cluster_name,
+			    char *sql_table)
+{
+	char *col = _partition_col(sql_table);
+	char *query, *parts = NULL;
+	MYSQL_RES *result;
+	MYSQL_ROW row;
+	time_t now = time(NULL), oldest = now, month, last;
+	int rc;
+
+	if ((rc = _is_partitioned(mysql_conn, cluster_name, sql_table)))
+		return (rc == 1) ? SLURM_SUCCESS : SLURM_ERROR;
+
+	query = xstrdup_printf("select min(%s) from \"%s_%s\" where %s;",
+			       col, cluster_name, sql_table, col);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+	if ((row = mysql_fetch_row(result)) && row[0])
+		oldest = slurm_atoul(row[0]);
+	mysql_free_result(result);
+
+	month = MAX(_month_start(oldest, 0),
+		    _month_start(now, -PARTITION_MONTHS_BACK));
+	last = _month_start(now, PARTITION_MONTHS_AHEAD);
+	for (; month <= last; month = _month_start(month, 1))
+		_add_month(&parts, month);
+
+	info("Partitioning table %s_%s by month, this may take a while",
+	     cluster_name, sql_table);
+	query = xstrdup_printf("alter table \"%s_%s\" partition by range (%s) "
+			       "(%spartition pmax values less than maxvalue);",
+			       cluster_name, sql_table, col, parts);
+	xfree(parts);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+	if (rc != SLURM_SUCCESS)
+		error("Couldn't partition table %s_%s", cluster_name,
+		      sql_table);
+
+	return rc;
+}
+
+static int _unpartition_table(mysql_conn_t *mysql_conn, char *cluster_name,
+			      char *sql_table)
+{
+	char *query;
+	int rc;
+
+	if ((rc = _is_partitioned(mysql_conn, cluster_name, sql_table)) != 1)
+		return (rc == 0) ? SLURM_SUCCESS : SLURM_ERROR;
+
+	info("Removing the partitioning of table %s_%s, "
+	     "this may take a while", cluster_name, sql_table);
+	query = xstrdup_printf("alter table \"%s_%s\" remove partitioning;",
+			       cluster_name, sql_table);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+	if (rc != SLURM_SUCCESS)
+		error("Couldn't remove the partitioning of table %s_%s",
+		      cluster_name, sql_table);
+
+	return rc;
+}
+
+static int _add_months(mysql_conn_t *mysql_conn, char *cluster_name,
+		       char *sql_table)
+{
+	char *query, *parts = NULL;
+	MYSQL_RES *result;
+	MYSQL_ROW row;
+	time_t month, last = _month_start(time(NULL), PARTITION_MONTHS_AHEAD);
+	int rc;
+
+	/* The bound of the last monthly partition is the start of the first
+	 * month without one. */
+	query = xstrdup_printf("select max(cast(partition_description "
+			       "as unsigned)) from "
+			       "information_schema.partitions where "
+			       "table_schema=database() && "
+			       "table_name='%s_%s' && "
+			       "partition_description != 'MAXVALUE';",
+			       cluster_name, sql_table);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+	if (!(row = mysql_fetch_row(result)) || !row[0]) {
+		/* not partitioned */
+		mysql_free_result(result);
+		return SLURM_SUCCESS;
+	}
+	month = slurm_atoul(row[0]);
+	mysql_free_result(result);
+
+	for (; month <= last; month = _month_start(month, 1))
+		_add_month(&parts, month);
+	if (!parts)
+		return SLURM_SUCCESS;
+
+	query = xstrdup_printf("alter table \"%s_%s\" reorganize partition "
+			       "pmax into (%spartition pmax values less than "
+			       "maxvalue);", cluster_name, sql_table, parts);
+	xfree(parts);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+	if (rc != SLURM_SUCCESS)
+		error("Couldn't add partitions to table %s_%s",
+		      cluster_name, sql_table);
+
+	return rc;
+}
+
+extern bool as_mysql_partition_enabled(void)
+{
+	return slurmdbd_conf && slurmdbd_conf->partition_tables;
+}
+
+extern int as_mysql_partition_in_use(mysql_conn_t *mysql_conn,
+				     char *cluster_name)
+{
+	return _is_partitioned(mysql_conn, cluster_name, job_table);
+}
+
+extern int as_mysql_partition_tables(mysql_conn_t *mysql_conn,
+				     char *cluster_name)
+{
+	if (_partition_table(mysql_conn, cluster_name, job_table)
+	    != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return _partition_table(mysql_conn, cluster_name, event_table);
+}
+
+extern int as_mysql_unpartition_tables(mysql_conn_t *mysql_conn,
+				       char *cluster_name)
+{
+	if (_unpartition_table(mysql_conn, cluster_name, job_table)
+	    != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return _unpartition_table(mysql_conn, cluster_name, event_table);
+}
+
+extern int as_mysql_partition_add_months(mysql_conn_t *mysql_conn,
+					 char *cluster_name)
+{
+	if (_add_months(mysql_conn, cluster_name, job_table) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	return _add_months(mysql_conn, cluster_name, event_table);
+}
+
+extern int as_mysql_partition_purge(mysql_conn_t *mysql_conn,
+				    char *cluster_name, char *sql_table,
+				    time_t purge_end)
+{
+	char *query, *drop = NULL;
+	MYSQL_RES *result, *result2;
+	MYSQL_ROW row;
+	int cnt = 0, rc;
+
+	/* Monthly partitions whose records all started before purge_end */
+	query = xstrdup_printf("select partition_name from "
+			       "information_schema.partitions where "
+			       "table_schema=database() && "
+			       "table_name='%s_%s' && "
+			       "partition_description != 'MAXVALUE' && "
+			       "cast(partition_description as unsigned) "
+			       "<= %ld order by partition_ordinal_position;",
+			       cluster_name, sql_table, (long)purge_end + 1);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	result = mysql_db_query_ret(mysql_conn, query, 0);
+	xfree(query);
+	if (!result)
+		return SLURM_ERROR;
+
+	while ((row = mysql_fetch_row(result))) {
+		/* Records still running are kept, so is their partition */
+		query = xstrdup_printf("select 1 from \"%s_%s\" "
+				       "partition (%s) where time_end = 0 "
+				       "limit 1;",
+				       cluster_name, sql_table, row[0]);
+		if (debug_flags & DEBUG_FLAG_DB_QUERY)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		result2 = mysql_db_query_ret(mysql_conn, query, 0);
+		xfree(query);
+		if (!result2) {
+			mysql_free_result(result);
+			xfree(drop);
+			return SLURM_ERROR;
+		}
+		if (!mysql_num_rows(result2)) {
+			xstrfmtcat(drop, "%s%s", drop ? ", " : "", row[0]);
+			cnt++;
+		}
+		mysql_free_result(result2);
+	}
+	mysql_free_result(result);
+
+	if (!drop)
+		return 0;
+
+	query = xstrdup_printf("alter table \"%s_%s\" drop partition %s;",
+			       cluster_name, sql_table, drop);
+	xfree(drop);
+	if (debug_flags & DEBUG_FLAG_DB_QUERY)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+	if (rc != SLURM_SUCCESS) {
+		error("Couldn't drop the purged partitions of table %s_%s",
+		      cluster_name, sql_table);
+		return SLURM_ERROR;
+	}
+	debug("Dropped %d purged partitions of table %s_%s",
+	      cnt, cluster_name, sql_table);
+
+	return cnt;
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************\
+ *  as_mysql_partition.h - monthly partitions of the job and event tables.
+ *****************************************************************************
+ *
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_MYSQL_PARTITION_H
+#define _HAVE_MYSQL_PARTITION_H
+
+#include "accounting_storage_mysql.h"
+
+/* True if the job and event tables are to be partitioned (PartitionTables) */
+extern bool as_mysql_partition_enabled(void);
+
+/*
+ * Tell if the job table of cluster_name is partitioned, for when the plugin
+ * runs without the slurmdbd and must keep the layout the slurmdbd chose.
+ * RET 1 if partitioned, 0 if not or SLURM_ERROR
+ */
+extern int as_mysql_partition_in_use(mysql_conn_t *mysql_conn,
+				     char *cluster_name);
+
+/*
+ * Partition the job and event tables of cluster_name by month if they are
+ * not partitioned yet.  Months are created from the oldest record on to a few
+ * months from now.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int as_mysql_partition_tables(mysql_conn_t *mysql_conn,
+				     char *cluster_name);
+
+/*
+ * Remove the partitioning of the job and event tables of cluster_name if
+ * they are partitioned.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int as_mysql_unpartition_tables(mysql_conn_t *mysql_conn,
+				       char *cluster_name);
+
+/*
+ * Create the partitions for the next few months of the partitioned job and
+ * event tables of cluster_name if they do not exist yet.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int as_mysql_partition_add_months(mysql_conn_t *mysql_conn,
+					 char *cluster_name);
+
+/*
+ * Drop the partitions of sql_table (job_table or event_table) of
+ * cluster_name that only hold records from before purge_end none of which
+ * are still running.
+ * RET number of partitions dropped or SLURM_ERROR
+ */
+extern int as_mysql_partition_purge(mysql_conn_t *mysql_conn,
+				    char *cluster_name, char *sql_table,
+				    time_t purge_end);
+
+#endif
@@ -55,6 +55,14 @@ enum {
 	WCKEY_TABLES
 };
 
+/* Buckets of the association and wckey usage hash tables of an hour */
+#define ID_USAGE_HASH_SIZE 1024
+
+/* A catch up of more hours than this is split between several threads,
+ * each rolling up its own hours on its own database connection. */
+#define ROLLUP_HOURS_PER_THREAD 12
+#define ROLLUP_MAX_THREADS 4
+
 typedef struct {
 	uint64_t count;
 	uint32_t id;
@@ -67,7 +75,8 @@ typedef struct {
 	uint64_t total_time;
 } local_tres_usage_t;
 
-typedef struct {
+typedef struct local_id_usage {
+	struct local_id_usage *hash_next;
 	int id;
 	List loc_tres;
 } local_id_usage_t;
@@ -88,6 +97,30 @@ typedef struct {
 	time_t start;
 } local_resv_usage_t;
 
+typedef struct {
+	time_t end; /* 0 if the record is still open */
+	time_t start;
+} local_dirty_t;
+
+typedef struct {
+	char *cluster_name;
+	int hour_cnt;
+	time_t *hours; /* start of each hour to roll up */
+	mysql_conn_t *mysql_conn;
+	time_t now;
+	int rc;
+} local_hour_rollup_t;
+
+typedef struct {
+	char *cluster_name;
+	List dirty_list; /* local_dirty_t's changed since the last rollup */
+	time_t rolled_end; /* hours rolled up by this slurmdbd */
+	time_t rolled_start;
+} local_rollup_state_t;
+
+static List rollup_state_list = NULL;
+static pthread_mutex_t rollup_state_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void _destroy_local_tres_usage(void *object)
 {
 	local_tres_usage_t *a_usage = (local_tres_usage_t *)object;
@@ -134,16 +167,57 @@ static int _find_loc_tres(void *x, void *key)
 	return 0;
 }
 
-static int _find_id_usage(void *x, void *key)
+/* Find the usage of id in hash, adding it to usage_list if it isn't there.
+ * If make_tres is set the usage is given a loc_tres list. */
+static local_id_usage_t *_get_id_usage(List usage_list,
+				       local_id_usage_t **hash,
+				       uint32_t id, bool make_tres)
+{
+	int inx = id % ID_USAGE_HASH_SIZE;
+	local_id_usage_t *usage = hash[inx];
+
+	while (usage && (usage->id != id))
+		usage = usage->hash_next;
+
+	if (!usage) {
+		usage = xmalloc(sizeof(local_id_usage_t));
+		usage->id = id;
+		usage->hash_next = hash[inx];
+		hash[inx] = usage;
+		list_append(usage_list, usage);
+	}
+
+	if (make_tres && !usage->loc_tres)
+		usage->loc_tres = list_create(_destroy_local_tres_usage);
+
+	return usage;
+}
+
+static int _find_rollup_state(void *x, void *key)
 {
-	local_id_usage_t *loc = (local_id_usage_t *)x;
-	uint32_t id = *(uint32_t *)key;
+	local_rollup_state_t *state = (local_rollup_state_t *)x;
 
-	if (loc->id == id)
+	if (!xstrcmp(state->cluster_name, (char *)key))
 		return 1;
 	return 0;
 }
 
+static void _destroy_rollup_state(void *object)
+{
+	local_rollup_state_t *state = (local_rollup_state_t *)object;
+
+	if (state) {
+		xfree(state->cluster_name);
+		FREE_NULL_LIST(state->dirty_list);
+		xfree(state);
+	}
+}
+
+static void _destroy_local_dirty(void *object)
+{
+	xfree(object);
+}
+
 static void _remove_job_tres_time_from_cluster(List c_tres, List j_tres,
 					       int seconds)
 {
@@ -894,17 +968,16 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 	return c_usage;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+/* Roll up the hours in roll on mysql_conn, the caller commits them */
+static int _rollup_hours(local_hour_rollup_t *roll, mysql_conn_t *mysql_conn)
 {
 	int rc = SLURM_SUCCESS;
 	int add_sec = 3600;
-	int i=0;
-	time_t now = time(NULL);
-	time_t curr_start = start;
-	time_t curr_end = curr_start + add_sec;
+	int h, i=0;
+	char *cluster_name = roll->cluster_name;
+	time_t now = roll->now;
+	time_t curr_start = 0;
+	time_t curr_end = 0;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
@@ -916,6 +989,10 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	List cluster_down_list = list_create(_destroy_local_cluster_usage);
 	List wckey_usage_list = list_create(_destroy_local_id_usage);
 	List resv_usage_list = list_create(_destroy_local_resv_usage);
+	local_id_usage_t **assoc_hash =
+		xmalloc(sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
+	local_id_usage_t **wckey_hash =
+		xmalloc(sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
 	uint16_t track_wckey = slurm_get_track_wckey();
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
@@ -1009,10 +1086,13 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 	c_itr = list_iterator_create(cluster_down_list);
 	w_itr = list_iterator_create(wckey_usage_list);
 	r_itr = list_iterator_create(resv_usage_list);
-	while (curr_start < end) {
+	for (h = 0; h < roll->hour_cnt; h++) {
 		int last_id = -1;
 		int last_wckeyid = -1;
 
+		curr_start = roll->hours[h];
+		curr_end = curr_start + add_sec;
+
 		if (debug_flags & DEBUG_FLAG_DB_USAGE)
 			DB_DEBUG(mysql_conn->conn,
 				 "%s curr hour is now %ld-%ld",
@@ -1234,13 +1314,13 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 			}
 
 			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
-				last_id = assoc_id;
 				/* a_usage->loc_tres is made later,
 				   don't do it here.
 				*/
+				a_usage = _get_id_usage(assoc_usage_list,
+							assoc_hash,
+							assoc_id, false);
+				last_id = assoc_id;
 			}
 
 			/* Short circuit this so so we don't get a pointer. */
@@ -1249,20 +1329,9 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 
 			/* do the wckey calculation */
 			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
-
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
-					w_usage->loc_tres = list_create(
-						_destroy_local_tres_usage);
-				}
+				w_usage = _get_id_usage(wckey_usage_list,
+							wckey_hash,
+							wckey_id, true);
 				last_wckeyid = wckey_id;
 			}
 
@@ -1474,20 +1543,10 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 					r_usage->local_assocs);
 				while ((assoc = list_next(tmp_itr))) {
 					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						last_id = associd;
-						a_usage->loc_tres = list_create(
-							_destroy_local_tres_usage);
-					}
+
+					a_usage = _get_id_usage(
+						assoc_usage_list, assoc_hash,
+						associd, true);
 
 					_add_time_tres(a_usage->loc_tres,
 						       TIME_ALLOC, loc_tres->id,
@@ -1571,8 +1630,10 @@ extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 		list_flush(cluster_down_list);
 		list_flush(wckey_usage_list);
 		list_flush(resv_usage_list);
-		curr_start = curr_end;
-		curr_end = curr_start + add_sec;
+		memset(assoc_hash, 0,
+		       sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
+		memset(wckey_hash, 0,
+		       sizeof(local_id_usage_t *) * ID_USAGE_HASH_SIZE);
 	}
 end_it:
 	xfree(query);
@@ -1596,27 +1657,271 @@ end_it:
 	FREE_NULL_LIST(cluster_down_list);
 	FREE_NULL_LIST(wckey_usage_list);
 	FREE_NULL_LIST(resv_usage_list);
+	xfree(assoc_hash);
+	xfree(wckey_hash);
 
 /* 	info("stop start %s", slurm_ctime2(&curr_start)); */
 /* 	info("stop end %s", slurm_ctime2(&curr_end)); */
 
+	if (rc != SLURM_SUCCESS) {
+		char start[25], end[25];
+		error("Couldn't roll up cluster (%s) hour %s - %s",
+		      cluster_name, slurm_ctime2_r(&curr_start, start),
+		      slurm_ctime2_r(&curr_end, end));
+	}
+
+	return rc;
+}
+
+static void *_rollup_hours_thread(void *arg)
+{
+	local_hour_rollup_t *roll = (local_hour_rollup_t *)arg;
+	mysql_conn_t mysql_conn;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = roll->mysql_conn->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each thread needs it's own connection we can't use the one
+	 * sent from the parent thread. */
+	if ((roll->rc = check_connection(&mysql_conn)) == SLURM_SUCCESS)
+		roll->rc = _rollup_hours(roll, &mysql_conn);
+
+	if (roll->rc == SLURM_SUCCESS) {
+		if (mysql_db_commit(&mysql_conn)) {
+			error("Couldn't commit cluster (%s) hour rollup",
+			      roll->cluster_name);
+			roll->rc = SLURM_ERROR;
+		}
+	} else if (mysql_db_rollback(&mysql_conn))
+		error("rollback failed");
+
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	return NULL;
+}
+
+/* Fill in hours with the start of the hours from start to end that need to
+ * be rolled up and return how many there are.
+ *
+ * An hour this slurmdbd already rolled up is only rolled up again if a late
+ * record noted with as_mysql_rollup_dirty() overlaps it.  That only holds if
+ * those records are what moved the rollup back to start, if anything else did
+ * (an admin or a runaway job fix) every hour is rolled up.
+ *
+ * The noted records are handed back in dirty_list so they can be put back if
+ * the rollup fails.
+ */
+static int _get_rollup_hours(char *cluster_name, time_t start, time_t end,
+			     bool incremental, time_t *hours, List *dirty_list)
+{
+	local_rollup_state_t *state = NULL;
+	local_dirty_t *dirty;
+	ListIterator itr = NULL;
+	time_t curr_start, min_start = 0;
+	int hour_cnt = 0, skip_cnt = 0;
+	bool skip = false;
+
+	slurm_mutex_lock(&rollup_state_lock);
+	if (incremental && rollup_state_list)
+		state = list_find_first(rollup_state_list,
+					_find_rollup_state, cluster_name);
+	if (state) {
+		*dirty_list = state->dirty_list;
+		state->dirty_list = list_create(_destroy_local_dirty);
+
+		itr = list_iterator_create(*dirty_list);
+		while ((dirty = list_next(itr))) {
+			if (!min_start || (dirty->start < min_start))
+				min_start = dirty->start;
+		}
+
+		if ((min_start >= start) && (min_start < start + 3600))
+			skip = true;
+	}
+
+	for (curr_start = start; curr_start < end; curr_start += 3600) {
+		bool roll_it = true;
+
+		if (skip && (curr_start >= state->rolled_start)
+		    && (curr_start < state->rolled_end)) {
+			roll_it = false;
+			list_iterator_reset(itr);
+			while ((dirty = list_next(itr))) {
+				if ((dirty->start < curr_start + 3600) &&
+				    (!dirty->end || (dirty->end >= curr_start))) {
+					roll_it = true;
+					break;
+				}
+			}
+		}
+
+		if (roll_it)
+			hours[hour_cnt++] = curr_start;
+		else
+			skip_cnt++;
+	}
+	if (itr)
+		list_iterator_destroy(itr);
+	slurm_mutex_unlock(&rollup_state_lock);
+
+	if (skip_cnt)
+		debug("%s: cluster %s: %d of %d hours unchanged since they "
+		      "were rolled up", __func__, cluster_name,
+		      skip_cnt, skip_cnt + hour_cnt);
+
+	return hour_cnt;
+}
+
+/* Remember which hours were rolled up for the next _get_rollup_hours() */
+static void _set_rollup_state(char *cluster_name, time_t start, time_t end,
+			      bool incremental, int rc, List dirty_list)
+{
+	local_rollup_state_t *state;
+
+	if (!incremental)
+		return;
+
+	slurm_mutex_lock(&rollup_state_lock);
+	if (!rollup_state_list)
+		rollup_state_list = list_create(_destroy_rollup_state);
+	if (!(state = list_find_first(rollup_state_list,
+				      _find_rollup_state, cluster_name))) {
+		state = xmalloc(sizeof(local_rollup_state_t));
+		state->cluster_name = xstrdup(cluster_name);
+		state->dirty_list = list_create(_destroy_local_dirty);
+		list_append(rollup_state_list, state);
+	}
+
+	if (rc != SLURM_SUCCESS) {
+		if (dirty_list)
+			list_transfer(state->dirty_list, dirty_list);
+	} else if (state->rolled_end && (start >= state->rolled_start) &&
+		   (start <= state->rolled_end)) {
+		if (end > state->rolled_end)
+			state->rolled_end = end;
+	} else {
+		state->rolled_start = start;
+		state->rolled_end = end;
+	}
+	slurm_mutex_unlock(&rollup_state_lock);
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  uint16_t archive_data,
+				  bool incremental)
+{
+	int rc = SLURM_SUCCESS;
+	int hour_cnt, i, thread_cnt, per_thread;
+	time_t *hours;
+	List dirty_list = NULL;
+	local_hour_rollup_t *rolls;
+	pthread_t *thread_ids;
+	pthread_attr_t thread_attr;
+
+	hours = xmalloc(sizeof(time_t) * ((end - start) / 3600 + 1));
+	hour_cnt = _get_rollup_hours(cluster_name, start, end, incremental,
+				     hours, &dirty_list);
+
+	/* The hours are independent of each other, so a long catch up is
+	 * split into ranges of hours rolled up on their own connections.
+	 * The first range is done here on the connection we were given.
+	 */
+	thread_cnt = hour_cnt / ROLLUP_HOURS_PER_THREAD;
+	if (thread_cnt > ROLLUP_MAX_THREADS)
+		thread_cnt = ROLLUP_MAX_THREADS;
+	else if (thread_cnt < 1)
+		thread_cnt = 1;
+	per_thread = (hour_cnt + thread_cnt - 1) / thread_cnt;
+
+	rolls = xmalloc(sizeof(local_hour_rollup_t) * thread_cnt);
+	thread_ids = xmalloc(sizeof(pthread_t) * thread_cnt);
+	for (i = 0; i < thread_cnt; i++) {
+		rolls[i].cluster_name = cluster_name;
+		rolls[i].hours = hours + (i * per_thread);
+		rolls[i].hour_cnt = MIN(per_thread, hour_cnt - i * per_thread);
+		rolls[i].mysql_conn = mysql_conn;
+		rolls[i].now = time(NULL);
+		if (!i || (rolls[i].hour_cnt <= 0))
+			continue;
+
+		if (debug_flags & DEBUG_FLAG_DB_USAGE)
+			DB_DEBUG(mysql_conn->conn,
+				 "%s rolling up %d hours from %ld in thread %d",
+				 cluster_name, rolls[i].hour_cnt,
+				 rolls[i].hours[0], i);
+		slurm_attr_init(&thread_attr);
+		if (pthread_create(&thread_ids[i], &thread_attr,
+				   _rollup_hours_thread, &rolls[i]))
+			fatal("pthread_create: %m");
+		slurm_attr_destroy(&thread_attr);
+	}
+
+	if (hour_cnt)
+		rc = _rollup_hours(&rolls[0], mysql_conn);
+
+	for (i = 1; i < thread_cnt; i++) {
+		if (rolls[i].hour_cnt <= 0)
+			continue;
+		pthread_join(thread_ids[i], NULL);
+		if (rolls[i].rc != SLURM_SUCCESS)
+			rc = rolls[i].rc;
+	}
+	xfree(rolls);
+	xfree(thread_ids);
+	xfree(hours);
+
 	/* go check to see if we archive and purge */
 
 	if (rc == SLURM_SUCCESS) {
 		if (mysql_db_commit(mysql_conn)) {
-			char start[25], end[25];
+			char start_char[25], end_char[25];
 			error("Couldn't commit cluster (%s) "
 			      "hour rollup for %s - %s",
-			      cluster_name, slurm_ctime2_r(&curr_start, start),
-			      slurm_ctime2_r(&curr_end, end));
+			      cluster_name, slurm_ctime2_r(&start, start_char),
+			      slurm_ctime2_r(&end, end_char));
 			rc = SLURM_ERROR;
 		} else
 			rc = _process_purge(mysql_conn, cluster_name,
 					    archive_data, SLURMDB_PURGE_HOURS);
 	}
 
+	_set_rollup_state(cluster_name, start, end, incremental, rc,
+			  dirty_list);
+	FREE_NULL_LIST(dirty_list);
+
 	return rc;
 }
+
+extern void as_mysql_rollup_dirty(char *cluster_name, time_t start, time_t end)
+{
+	local_rollup_state_t *state;
+	local_dirty_t *dirty;
+
+	slurm_mutex_lock(&rollup_state_lock);
+	if (rollup_state_list &&
+	    (state = list_find_first(rollup_state_list,
+				     _find_rollup_state, cluster_name)) &&
+	    (start < state->rolled_end)) {
+		dirty = xmalloc(sizeof(local_dirty_t));
+		dirty->start = start;
+		dirty->end = end;
+		list_append(state->dirty_list, dirty);
+	}
+	slurm_mutex_unlock(&rollup_state_lock);
+}
+
+extern void as_mysql_rollup_fini(void)
+{
+	slurm_mutex_lock(&rollup_state_lock);
+	FREE_NULL_LIST(rollup_state_list);
+	slurm_mutex_unlock(&rollup_state_lock);
+}
+
 extern int as_mysql_nonhour_rollup(mysql_conn_t *mysql_conn,
 				   bool run_month,
 				   char *cluster_name,
@@ -44,15 +44,24 @@
 
 #include "accounting_storage_mysql.h"
 
+/* If incremental is set hours this slurmdbd already rolled up are only
+ * rolled up again if as_mysql_rollup_dirty() was told they changed. */
 extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
 				  char *cluster_name,
 				  time_t start,
 				  time_t end,
-				  uint16_t archive_data);
+				  uint16_t archive_data,
+				  bool incremental);
 extern int as_mysql_nonhour_rollup(mysql_conn_t *mysql_conn,
 				   bool run_month,
 				   char *cluster_name,
 				   time_t start,
 				   time_t end,
 				   uint16_t archive_data);
+
+/* Note a record of cluster_name from start to end (0 if it is still open)
+ * that changed after the hours it covers were rolled up. */
+extern void as_mysql_rollup_dirty(char *cluster_name, time_t start,
+				  time_t end);
+extern void as_mysql_rollup_fini(void);
 #endif
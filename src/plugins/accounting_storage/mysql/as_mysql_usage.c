@@ -38,6 +38,7 @@
 \*****************************************************************************/
 
 #include "as_mysql_cluster.h"
+#include "as_mysql_partition.h"
 #include "as_mysql_usage.h"
 #include "as_mysql_rollup.h"
 #include "src/common/macros.h"
@@ -81,6 +82,7 @@ static void *_cluster_rollup_usage(void *arg)
 	time_t day_end;
 	time_t month_start;
 	time_t month_end;
+	bool day_rolled = false;
 	long rollup_time[ROLLUP_COUNT];
 	DEF_TIMERS;
 
@@ -296,7 +298,8 @@ static void *_cluster_rollup_usage(void *arg)
 					    local_rollup->cluster_name,
 					    hour_start,
 					    hour_end,
-					    local_rollup->archive_data);
+					    local_rollup->archive_data,
+					    !local_rollup->sent_start);
 		snprintf(timer_str, sizeof(timer_str),
 			 "hourly_rollup for %s", local_rollup->cluster_name);
 		END_TIMER3(timer_str, 5000000);
@@ -318,6 +321,7 @@ static void *_cluster_rollup_usage(void *arg)
 		rollup_time[ROLLUP_DAY] += DELTA_TIMER;
 		if (rc != SLURM_SUCCESS)
 			goto end_it;
+		day_rolled = true;
 	}
 
 	if ((month_end - month_start) > 0) {
@@ -382,6 +386,12 @@ end_it:
 			error("Couldn't commit rollup of cluster %s",
 			      local_rollup->cluster_name);
 			rc = SLURM_ERROR;
+		} else if (day_rolled && as_mysql_partition_enabled()) {
+			/* Adding partitions commits, so do it after the
+			 * rollup is in.  Failing here only hurts if it keeps
+			 * failing for months, leave the rollup be. */
+			as_mysql_partition_add_months(
+				&mysql_conn, local_rollup->cluster_name);
 		}
 	} else {
 		error("Cluster %s rollup failed", local_rollup->cluster_name);
@@ -501,6 +501,17 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return NULL;
 }
 
+/*
+ * get totals of jobs from the storage
+ * returns List of slurmdb_job_aggr_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_aggr(void *db_conn, uid_t uid,
+					    void *aggr_cond)
+{
+	return NULL;
+}
+
 /*
  * expire old info from the storage
  */
@@ -61,8 +61,10 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <math.h>
 
@@ -72,6 +74,13 @@ typedef unsigned long int	ulong;
 #endif
 
 #define MAX_PKGS        256
+#define MAX_ZONES       (MAX_PKGS * 2)
+
+#define DEFAULT_POWERCAP_DIR	"/sys/class/powercap"
+#define POWERCAP_ZONE_PREFIX	"intel-rapl:"
+
+/* Power is computed over at least this many microseconds */
+#define MIN_POWER_INTERVAL	50000
 
 #define MSR_RAPL_POWER_UNIT             0x606
 
@@ -139,6 +148,27 @@ static char hostname[MAXHOSTNAMELEN];
 
 static int nb_pkg = 0;
 
+/*
+ * A powercap zone. energy_uj only holds max_energy_range_uj worth of
+ * micro joules before going back to 0, so the deltas between readings are
+ * accumulated into a 64 bit total instead.
+ */
+typedef struct {
+	int fd;			/* energy_uj, kept open between readings */
+	uint64_t last;		/* last value read from energy_uj */
+	uint64_t max_range;	/* max_energy_range_uj */
+	uint64_t total;		/* micro joules since the counter started */
+} rapl_zone_t;
+
+static char *powercap_dir = NULL;
+static rapl_zone_t zones[MAX_ZONES];
+static int nb_zones = 0;
+
+static pthread_mutex_t sample_mutex = PTHREAD_MUTEX_INITIALIZER;
+static double sample_joules = 0.0;
+static struct timeval sample_time = {0, 0};
+static uint32_t sample_watts = 0;
+
 extern void acct_gather_energy_p_conf_set(s_p_hashtbl_t *tbl);
 
 static char *_msr_string(int which)
@@ -267,6 +297,150 @@ static void _hardware(void)
 		info("RAPL Found: %d packages", nb_pkg);
 }
 
+/* Read a decimal value from a sysfs file descriptor without reopening it */
+static int _read_uj(int fd, uint64_t *value)
+{
+	char buf[32];
+	ssize_t len;
+
+	len = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return SLURM_ERROR;
+	buf[len] = '\0';
+	*value = strtoull(buf, NULL, 10);
+
+	return SLURM_SUCCESS;
+}
+
+static int _read_zone_file(const char *zone, const char *file, char *buf,
+			   size_t size)
+{
+	char path[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", powercap_dir, zone, file);
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return SLURM_ERROR;
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len <= 0)
+		return SLURM_ERROR;
+	buf[len] = '\0';
+
+	return SLURM_SUCCESS;
+}
+
+static void _close_powercap(void)
+{
+	int i;
+
+	for (i = 0; i < nb_zones; i++) {
+		if (zones[i].fd != -1)
+			close(zones[i].fd);
+	}
+	nb_zones = 0;
+}
+
+/*
+ * Find the package and DRAM zones of the powercap interface, the same
+ * domains the MSR code reads. Core, uncore and psys zones are left out as
+ * they overlap the package zones. Top level entries of the powercap class
+ * include the subzones, e.g. intel-rapl:0 and intel-rapl:0:1.
+ * RET number of zones found
+ */
+static int _open_powercap(void)
+{
+	DIR *dir;
+	struct dirent *ent;
+	char buf[64], path[PATH_MAX];
+	rapl_zone_t *zone;
+
+	if (!(dir = opendir(powercap_dir))) {
+		if (debug_flags & DEBUG_FLAG_ENERGY)
+			info("RAPL: can't open %s: %m", powercap_dir);
+		return 0;
+	}
+
+	while ((ent = readdir(dir))) {
+		if (xstrncmp(ent->d_name, POWERCAP_ZONE_PREFIX,
+			     sizeof(POWERCAP_ZONE_PREFIX) - 1))
+			continue;
+		if (_read_zone_file(ent->d_name, "name", buf, sizeof(buf)))
+			continue;
+		if (xstrncmp(buf, "package", sizeof("package") - 1) &&
+		    xstrncmp(buf, "dram", sizeof("dram") - 1))
+			continue;
+		if (nb_zones >= MAX_ZONES) {
+			error("RAPL: more than %d powercap zones, ignoring %s",
+			      MAX_ZONES, ent->d_name);
+			continue;
+		}
+
+		zone = &zones[nb_zones];
+		if (_read_zone_file(ent->d_name, "max_energy_range_uj",
+				    buf, sizeof(buf)))
+			zone->max_range = 0;
+		else
+			zone->max_range = strtoull(buf, NULL, 10);
+
+		snprintf(path, sizeof(path), "%s/%s/energy_uj",
+			 powercap_dir, ent->d_name);
+		if ((zone->fd = open(path, O_RDONLY)) < 0) {
+			/* energy_uj is only readable by root on some kernels */
+			error("RAPL: can't open %s: %m", path);
+			continue;
+		}
+		/* Make sure it gets closed when a slurmstepd launches */
+		fd_set_close_on_exec(zone->fd);
+
+		if (_read_uj(zone->fd, &zone->last)) {
+			error("RAPL: can't read %s: %m", path);
+			close(zone->fd);
+			continue;
+		}
+		/* Start from the counter value, as the MSR code does */
+		zone->total = zone->last;
+		nb_zones++;
+
+		if (debug_flags & DEBUG_FLAG_ENERGY)
+			info("RAPL: using powercap zone %s, range %"PRIu64" uJ",
+			     ent->d_name, zone->max_range);
+	}
+	closedir(dir);
+
+	return nb_zones;
+}
+
+/* Sum the energy of all the powercap zones, in micro joules */
+static int _get_powercap_energy(uint64_t *energy)
+{
+	int i;
+	uint64_t value;
+	rapl_zone_t *zone;
+
+	*energy = 0;
+	for (i = 0; i < nb_zones; i++) {
+		zone = &zones[i];
+		if (_read_uj(zone->fd, &value)) {
+			error("%s: can't read powercap zone: %m", __func__);
+			return SLURM_ERROR;
+		}
+		if (value >= zone->last)
+			zone->total += value - zone->last;
+		else if (zone->max_range >= zone->last)
+			/* wrapped around, max_range is the last value */
+			zone->total += (zone->max_range - zone->last) +
+				       value + 1;
+		else
+			zone->total += value;
+		zone->last = value;
+		*energy += zone->total;
+	}
+
+	return SLURM_SUCCESS;
+}
+
 static bool _run_in_daemon(void)
 {
 	static bool set = false;
@@ -305,18 +479,16 @@ _send_drain_request(void)
 	}
 }
 
-static void _get_joules_task(acct_gather_energy_t *energy)
+static int _get_msr_joules(double *joules)
 {
 	int i;
 	double energy_units;
 	uint64_t result;
-	double ret;
 
 	if (pkg_fd[0] < 0) {
 		error("%s: device /dev/cpu/#/msr not opened "
 		      "energy data cannot be collected.", __func__);
-		_send_drain_request();
-		return;
+		return SLURM_ERROR;
 	}
 
 	/* MSR_RAPL_POWER_UNIT
@@ -350,21 +522,68 @@ static void _get_joules_task(acct_gather_energy_t *energy)
 	for (i = 0; i < nb_pkg; i++)
 		result += _get_package_energy(i) + _get_dram_energy(i);
 
-	ret = (double)result * energy_units;
+	*joules = (double)result * energy_units;
 
 	if (debug_flags & DEBUG_FLAG_ENERGY)
-		info("RAPL Result %"PRIu64" = %.6f Joules", result, ret);
+		info("RAPL Result %"PRIu64" = %.6f Joules", result, *joules);
 
-	if (energy->consumed_energy) {
-		time_t interval;
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Read the energy counters and update the node power. The power is
+ * computed over the time since the last reading in this process, with
+ * sub-second resolution, so that it stays meaningful when the counters are
+ * read several times per second.
+ */
+static int _sample_joules(double *joules, uint32_t *watts)
+{
+	struct timeval now;
+	uint64_t energy;
+	long usec;
+	int rc;
+
+	slurm_mutex_lock(&sample_mutex);
+	if (nb_zones) {
+		rc = _get_powercap_energy(&energy);
+		*joules = (double)energy / 1000000.0;
+	} else
+		rc = _get_msr_joules(joules);
+
+	if (rc == SLURM_SUCCESS) {
+		gettimeofday(&now, NULL);
+		usec = (now.tv_sec - sample_time.tv_sec) * 1000000 +
+			now.tv_usec - sample_time.tv_usec;
+		if (!sample_time.tv_sec) {
+			sample_joules = *joules;
+			sample_time = now;
+		} else if (usec >= MIN_POWER_INTERVAL) {
+			sample_watts = (uint32_t)((*joules - sample_joules) *
+						  1000000.0 / usec);
+			sample_joules = *joules;
+			sample_time = now;
+		}
+		*watts = sample_watts;
+	}
+	slurm_mutex_unlock(&sample_mutex);
+
+	return rc;
+}
 
+static void _get_joules_task(acct_gather_energy_t *energy)
+{
+	double ret;
+	uint32_t watts;
+
+	if (_sample_joules(&ret, &watts) != SLURM_SUCCESS) {
+		_send_drain_request();
+		return;
+	}
+
+	if (energy->consumed_energy) {
 		energy->consumed_energy =
 			(uint64_t)ret - energy->base_consumed_energy;
-		energy->current_watts =
-			(uint32_t)ret - energy->previous_consumed_energy;
-		interval = time(NULL) - energy->poll_time;
-		if (interval)	/* Prevent divide by zero */
-			energy->current_watts /= (float)interval;
+		energy->current_watts = watts;
 	} else {
 		energy->consumed_energy = 1;
 		energy->base_consumed_energy = (uint64_t)ret;
@@ -470,6 +689,8 @@ extern int fini(void)
 {
 	int i;
 
+	xfree(powercap_dir);
+
 	if (!_run_in_daemon())
 		return SLURM_SUCCESS;
 
@@ -479,6 +700,7 @@ extern int fini(void)
 			pkg_fd[i] = -1;
 		}
 	}
+	_close_powercap();
 
 	acct_gather_energy_destroy(local_energy);
 	local_energy = NULL;
@@ -555,7 +777,11 @@ extern int acct_gather_energy_p_set_data(enum acct_energy_type data_type,
 extern void acct_gather_energy_p_conf_options(s_p_options_t **full_options,
 					      int *full_options_cnt)
 {
-	return;
+	s_p_options_t options[] = {
+		{"EnergyRAPLPowercapDir", S_P_STRING},
+		{NULL} };
+
+	transfer_s_p_options(full_options, options, full_options_cnt);
 }
 
 extern void acct_gather_energy_p_conf_set(s_p_hashtbl_t *tbl)
@@ -563,6 +789,13 @@ extern void acct_gather_energy_p_conf_set(s_p_hashtbl_t *tbl)
 	int i;
 	uint64_t result;
 
+	if (tbl) {
+		xfree(powercap_dir);
+		s_p_get_string(&powercap_dir, "EnergyRAPLPowercapDir", tbl);
+	}
+	if (!powercap_dir)
+		powercap_dir = xstrdup(DEFAULT_POWERCAP_DIR);
+
 	if (!_run_in_daemon())
 		return;
 
@@ -570,12 +803,18 @@ extern void acct_gather_energy_p_conf_set(s_p_hashtbl_t *tbl)
 	if (local_energy)
 		return;
 
+	local_energy = acct_gather_energy_alloc(1);
+
+	/* The powercap interface needs no MSR access and has 64 bit sums */
+	if (_open_powercap()) {
+		debug("%s loaded, using %s", plugin_name, powercap_dir);
+		return;
+	}
+
 	_hardware();
 	for (i = 0; i < nb_pkg; i++)
 		pkg_fd[i] = _open_msr(pkg2cpu[i]);
 
-	local_energy = acct_gather_energy_alloc(1);
-
 	result = _read_msr(pkg_fd[0], MSR_RAPL_POWER_UNIT);
 	if (result == 0)
 		local_energy->current_watts = NO_VAL;
@@ -587,5 +826,14 @@ extern void acct_gather_energy_p_conf_set(s_p_hashtbl_t *tbl)
 
 extern void acct_gather_energy_p_conf_values(List *data)
 {
+	config_key_pair_t *key_pair;
+
+	xassert(*data);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("EnergyRAPLPowercapDir");
+	key_pair->value = xstrdup(powercap_dir);
+	list_append(*data, key_pair);
+
 	return;
 }
@@ -0,0 +1,491 @@
+/*****************************************************************************\
+ *  acct_gather_profile_columnar.c - slurm accounting plugin for profiling
+ *                                   into append-only columnar files.
+ *****************************************************************************
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+ *
+ *  This file is patterned after acct_gather_profile_hdf5.c.
+\*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/slurm_acct_gather_profile.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/slurmd/common/proctrack.h"
+#include "columnar_api.h"
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - a string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - a string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  SLURM uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *	<application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "jobacct" for SLURM job completion logging) and <method>
+ * is a description of how this plugin satisfies that application.  SLURM will
+ * only load job completion logging plugins if the plugin_type string has a
+ * prefix of "jobacct/".
+ *
+ * plugin_version - an unsigned 32-bit integer containing the Slurm version
+ * (major.minor.micro combined into a single number).
+ */
+const char plugin_name[] = "AcctGatherProfile columnar plugin";
+const char plugin_type[] = "acct_gather_profile/columnar";
+const uint32_t plugin_version = SLURM_VERSION_NUMBER;
+
+typedef struct {
+	char *dir;
+	uint32_t def;
+} slurm_columnar_conf_t;
+
+// Static variables ok as add function are inside a lock.
+static col_writer_t *writer = NULL;
+static slurm_columnar_conf_t columnar_conf;
+static uint64_t debug_flags = 0;
+static uint32_t g_profile_running = ACCT_GATHER_PROFILE_NOT_SET;
+static stepd_step_rec_t *g_job = NULL;
+
+static char **groups = NULL;
+static int groups_len = 0;
+
+static void _reset_slurm_profile_conf(void)
+{
+	xfree(columnar_conf.dir);
+	columnar_conf.def = ACCT_GATHER_PROFILE_NONE;
+}
+
+static uint32_t _determine_profile(void)
+{
+	uint32_t profile;
+	xassert(g_job);
+
+	if (g_profile_running != ACCT_GATHER_PROFILE_NOT_SET)
+		profile = g_profile_running;
+	else if (g_job->profile >= ACCT_GATHER_PROFILE_NONE)
+		profile = g_job->profile;
+	else
+		profile = columnar_conf.def;
+
+	return profile;
+}
+
+static int _create_directories(void)
+{
+	int rc;
+	struct stat st;
+	char   *user_dir = NULL;
+
+	xassert(g_job);
+	xassert(columnar_conf.dir);
+	/*
+	 * If profile director does not exist, try to create it.
+	 *  Otherwise, ensure path is a directory as expected, and that
+	 *  we have permission to write to it.
+	 */
+
+	if (((rc = stat(columnar_conf.dir, &st)) < 0) && (errno == ENOENT)) {
+		if (mkdir(columnar_conf.dir, 0755) < 0)
+			fatal("mkdir(%s): %m", columnar_conf.dir);
+	} else if (rc < 0)
+		fatal("Unable to stat acct_gather_profile_dir: %s: %m",
+		      columnar_conf.dir);
+	else if (!S_ISDIR(st.st_mode))
+		fatal("acct_gather_profile_dir: %s: Not a directory!",
+		      columnar_conf.dir);
+	else if (access(columnar_conf.dir, R_OK|W_OK|X_OK) < 0)
+		fatal("Incorrect permissions on acct_gather_profile_dir: %s",
+		      columnar_conf.dir);
+	chmod(columnar_conf.dir, 0755);
+
+	user_dir = xstrdup_printf("%s/%s", columnar_conf.dir,
+				  g_job->user_name);
+	if (((rc = stat(user_dir, &st)) < 0) && (errno == ENOENT)) {
+		if (mkdir(user_dir, 0700) < 0)
+			fatal("mkdir(%s): %m", user_dir);
+	}
+	chmod(user_dir, 0700);
+	if (chown(user_dir, (uid_t)g_job->uid,
+		  (gid_t)g_job->gid) < 0)
+		error("chown(%s): %m", user_dir);
+
+	xfree(user_dir);
+
+	return SLURM_SUCCESS;
+}
+
+static bool _run_in_daemon(void)
+{
+	static bool set = false;
+	static bool run = false;
+
+	if (!set) {
+		set = 1;
+		run = run_in_daemon("slurmstepd");
+	}
+
+	return run;
+}
+
+static void _free_groups(void)
+{
+	int i;
+
+	for (i = 0; i < groups_len; i++)
+		xfree(groups[i]);
+	xfree(groups);
+	groups_len = 0;
+}
+
+/*
+ * init() is called when the plugin is loaded, before any other functions
+ * are called.  Put global initialization here.
+ */
+extern int init(void)
+{
+	if (!_run_in_daemon())
+		return SLURM_SUCCESS;
+
+	debug_flags = slurm_get_debug_flags();
+
+	return SLURM_SUCCESS;
+}
+
+extern int fini(void)
+{
+	_free_groups();
+	xfree(columnar_conf.dir);
+	return SLURM_SUCCESS;
+}
+
+extern void acct_gather_profile_p_conf_options(s_p_options_t **full_options,
+					       int *full_options_cnt)
+{
+	s_p_options_t options[] = {
+		{"ProfileColumnarDir", S_P_STRING},
+		{"ProfileColumnarDefault", S_P_STRING},
+		{NULL} };
+
+	transfer_s_p_options(full_options, options, full_options_cnt);
+	return;
+}
+
+extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
+{
+	char *tmp = NULL;
+	_reset_slurm_profile_conf();
+	if (tbl) {
+		s_p_get_string(&columnar_conf.dir, "ProfileColumnarDir", tbl);
+
+		if (s_p_get_string(&tmp, "ProfileColumnarDefault", tbl)) {
+			columnar_conf.def =
+				acct_gather_profile_from_string(tmp);
+			if (columnar_conf.def == ACCT_GATHER_PROFILE_NOT_SET) {
+				fatal("ProfileColumnarDefault can not be "
+				      "set to %s, please specify a valid "
+				      "option", tmp);
+			}
+			xfree(tmp);
+		}
+	}
+
+	if (!columnar_conf.dir)
+		fatal("No ProfileColumnarDir in your acct_gather.conf file.  "
+		      "This is required to use the %s plugin", plugin_type);
+
+	debug("%s loaded", plugin_name);
+}
+
+extern void acct_gather_profile_p_get(enum acct_gather_profile_info info_type,
+				      void *data)
+{
+	uint32_t *uint32 = (uint32_t *) data;
+	char **tmp_char = (char **) data;
+
+	switch (info_type) {
+	case ACCT_GATHER_PROFILE_DIR:
+		*tmp_char = xstrdup(columnar_conf.dir);
+		break;
+	case ACCT_GATHER_PROFILE_DEFAULT:
+		*uint32 = columnar_conf.def;
+		break;
+	case ACCT_GATHER_PROFILE_RUNNING:
+		*uint32 = g_profile_running;
+		break;
+	default:
+		debug2("acct_gather_profile_p_get info_type %d invalid",
+		       info_type);
+	}
+}
+
+extern int acct_gather_profile_p_node_step_start(stepd_step_rec_t* job)
+{
+	int rc = SLURM_SUCCESS;
+	col_header_t header;
+	char *profile_file_name;
+	char *profile_str;
+
+	xassert(_run_in_daemon());
+
+	g_job = job;
+
+	xassert(columnar_conf.dir);
+
+	if (debug_flags & DEBUG_FLAG_PROFILE) {
+		profile_str = acct_gather_profile_to_string(g_job->profile);
+		info("PROFILE: option --profile=%s", profile_str);
+	}
+
+	if (g_profile_running == ACCT_GATHER_PROFILE_NOT_SET)
+		g_profile_running = _determine_profile();
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return rc;
+
+	_create_directories();
+
+	/* Use a more user friendly string "batch" rather
+	 * then 4294967294.
+	 */
+	if (g_job->stepid == NO_VAL) {
+		profile_file_name = xstrdup_printf("%s/%s/%u_%s_%s%s",
+						   columnar_conf.dir,
+						   g_job->user_name,
+						   g_job->jobid,
+						   "batch",
+						   g_job->node_name,
+						   COL_FILE_SUFFIX);
+	} else {
+		profile_file_name = xstrdup_printf(
+			"%s/%s/%u_%u_%s%s",
+			columnar_conf.dir, g_job->user_name,
+			g_job->jobid, g_job->stepid, g_job->node_name,
+			COL_FILE_SUFFIX);
+	}
+
+	if (debug_flags & DEBUG_FLAG_PROFILE) {
+		profile_str = acct_gather_profile_to_string(g_profile_running);
+		info("PROFILE: node_step_start, opt=%s file=%s",
+		     profile_str, profile_file_name);
+	}
+
+	memset(&header, 0, sizeof(col_header_t));
+	header.job_id = g_job->jobid;
+	header.step_id = g_job->stepid;
+	header.node_name = g_job->node_name;
+	header.node_id = g_job->nodeid;
+	header.ntasks = g_job->node_tasks;
+	header.cpus_per_task = g_job->cpus_per_task;
+	header.start_time = time(NULL);
+
+	writer = col_writer_open(profile_file_name, &header);
+	if (!writer) {
+		error("PROFILE: Failed to create %s: %m", profile_file_name);
+		xfree(profile_file_name);
+		return SLURM_FAILURE;
+	}
+	if (chown(profile_file_name, (uid_t)g_job->uid,
+		  (gid_t)g_job->gid) < 0)
+		error("chown(%s): %m", profile_file_name);
+	xfree(profile_file_name);
+
+	return rc;
+}
+
+extern int acct_gather_profile_p_child_forked(void)
+{
+	col_writer_abandon(writer);
+
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_profile_p_node_step_end(void)
+{
+	int rc = SLURM_SUCCESS;
+
+	xassert(_run_in_daemon());
+
+	xassert(g_profile_running != ACCT_GATHER_PROFILE_NOT_SET);
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return rc;
+
+	if (debug_flags & DEBUG_FLAG_PROFILE)
+		info("PROFILE: node_step_end (shutdown)");
+
+	/* write the samples still buffered and close the file */
+	rc = col_writer_close(writer);
+	writer = NULL;
+	_free_groups();
+
+	return rc;
+}
+
+extern int acct_gather_profile_p_task_start(uint32_t taskid)
+{
+	int rc = SLURM_SUCCESS;
+
+	xassert(_run_in_daemon());
+	xassert(g_job);
+
+	xassert(g_profile_running != ACCT_GATHER_PROFILE_NOT_SET);
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return rc;
+
+	if (debug_flags & DEBUG_FLAG_PROFILE)
+		info("PROFILE: task_start");
+
+	return rc;
+}
+
+extern int acct_gather_profile_p_task_end(pid_t taskpid)
+{
+	if (debug_flags & DEBUG_FLAG_PROFILE)
+		info("PROFILE: task_end");
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_profile_p_create_group(const char* name)
+{
+	if (!writer)
+		return SLURM_ERROR;
+
+	/* groups only exist as a part of the name of their series */
+	xrealloc(groups, (groups_len + 1) * sizeof(char *));
+	groups[groups_len] = xstrdup(name);
+
+	return groups_len++;
+}
+
+extern int acct_gather_profile_p_create_dataset(
+	const char* name, int parent, acct_gather_profile_dataset_t *dataset)
+{
+	char *series_name;
+	int id;
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return SLURM_ERROR;
+
+	if (!writer)
+		return SLURM_ERROR;
+
+	debug("acct_gather_profile_p_create_dataset %s", name);
+
+	if ((parent >= 0) && (parent < groups_len))
+		series_name = xstrdup_printf("%s/%s/%s", g_job->node_name,
+					     groups[parent], name);
+	else
+		series_name = xstrdup_printf("%s/%s", g_job->node_name, name);
+
+	id = col_writer_add_series(writer, series_name, dataset);
+	if (id < 0)
+		error("PROFILE: Impossible to create the series %s",
+		      series_name);
+	xfree(series_name);
+
+	return id;
+}
+
+extern int acct_gather_profile_p_add_sample_data(int dataset_id, void *data,
+						 time_t sample_time)
+{
+	debug("acct_gather_profile_p_add_sample_data %d", dataset_id);
+
+	if (!writer) {
+		debug("PROFILE: Trying to add data but profiling is over");
+		return SLURM_SUCCESS;
+	}
+
+	/* ensure that we have to record something */
+	xassert(_run_in_daemon());
+	xassert(g_job);
+	xassert(g_profile_running != ACCT_GATHER_PROFILE_NOT_SET);
+
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return SLURM_ERROR;
+
+	if (col_writer_append(writer, dataset_id, sample_time, data)
+	    != SLURM_SUCCESS) {
+		error("PROFILE: Impossible to add data to the series %d",
+		      dataset_id);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern void acct_gather_profile_p_conf_values(List *data)
+{
+	config_key_pair_t *key_pair;
+
+	xassert(*data);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileColumnarDir");
+	key_pair->value = xstrdup(columnar_conf.dir);
+	list_append(*data, key_pair);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileColumnarDefault");
+	key_pair->value =
+		xstrdup(acct_gather_profile_to_string(columnar_conf.def));
+	list_append(*data, key_pair);
+
+	return;
+}
+
+extern bool acct_gather_profile_p_is_active(uint32_t type)
+{
+	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
+		return false;
+	return (type == ACCT_GATHER_PROFILE_NOT_SET)
+		|| (g_profile_running & type);
+}
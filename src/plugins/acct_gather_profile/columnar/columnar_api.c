@@ -0,0 +1,1105 @@
+/****************************************************************************\
+ *  columnar_api.c
+ *****************************************************************************
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  Provide support for acct_gather_profile plugins based on append-only
+ *  columnar files.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "columnar_api.h"
+
+/* Room left in front of a record payload for its type and length */
+#define COL_REC_HDR_MAX		11
+/* Size of the buffer used to write the records of one merged file */
+#define COL_MERGE_BUF		(1024 * 1024)
+
+typedef struct {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+} col_buf_t;
+
+typedef struct {
+	const uint8_t *ptr;
+	const uint8_t *end;
+} col_cursor_t;
+
+typedef struct {
+	int nfields;
+	acct_gather_profile_field_type_t *types;
+	uint32_t count;		/* samples buffered */
+	time_t first_time;
+	time_t last_time;
+	int64_t last_delta;
+	uint64_t *prev;		/* previous value of each field */
+	col_buf_t *cols;	/* time column, then one per field */
+} col_wseries_t;
+
+struct col_writer {
+	int fd;
+	col_wseries_t *series;
+	int series_cnt;
+	col_buf_t rec;
+};
+
+typedef struct {
+	uint32_t count;
+	time_t first_time;
+	time_t last_time;
+	const uint8_t *cols;
+	const uint8_t *end;
+} col_chunk_t;
+
+typedef struct {
+	col_series_t def;
+	col_chunk_t *chunks;
+	int chunk_cnt;
+	int chunk_size;
+} col_rseries_t;
+
+struct col_reader {
+	uint8_t *map;
+	size_t size;
+	col_header_t header;
+	col_rseries_t *series;
+	int series_cnt;
+};
+
+/**********************************************************************
+ * Encoding
+ **********************************************************************/
+static void _buf_reserve(col_buf_t *buf, size_t len)
+{
+	if (buf->len + len <= buf->size)
+		return;
+	buf->size = MAX(buf->size * 2, buf->len + len + 64);
+	xrealloc_nz(buf->data, buf->size);
+}
+
+static void _buf_free(col_buf_t *buf)
+{
+	xfree(buf->data);
+	buf->len = buf->size = 0;
+}
+
+static void _put_byte(col_buf_t *buf, uint8_t val)
+{
+	_buf_reserve(buf, 1);
+	buf->data[buf->len++] = val;
+}
+
+static void _put_varint(col_buf_t *buf, uint64_t val)
+{
+	_buf_reserve(buf, 10);
+	while (val >= 0x80) {
+		buf->data[buf->len++] = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	buf->data[buf->len++] = val;
+}
+
+static int _varint_len(uint64_t val)
+{
+	int len = 1;
+
+	while (val >= 0x80) {
+		val >>= 7;
+		len++;
+	}
+	return len;
+}
+
+static inline uint64_t _zigzag(int64_t val)
+{
+	return ((uint64_t) val << 1) ^ (uint64_t) (val >> 63);
+}
+
+static inline int64_t _unzigzag(uint64_t val)
+{
+	return (int64_t) (val >> 1) ^ -(int64_t) (val & 1);
+}
+
+static void _put_bytes(col_buf_t *buf, const void *data, size_t len)
+{
+	_buf_reserve(buf, len);
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static void _put_string(col_buf_t *buf, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	_put_varint(buf, len);
+	_put_bytes(buf, str, len);
+}
+
+/* Store the XOR of a double with the previous one without its leading
+ * zero bytes, which are the sign, exponent and high mantissa bits that
+ * did not change */
+static void _put_xor(col_buf_t *buf, uint64_t xor)
+{
+	int zeros = xor ? (__builtin_clzll(xor) / 8) : 8;
+
+	_buf_reserve(buf, 9);
+	buf->data[buf->len++] = zeros;
+	for (; zeros < 8; zeros++) {
+		buf->data[buf->len++] = xor & 0xff;
+		xor >>= 8;
+	}
+}
+
+static int _get_byte(col_cursor_t *cur, uint8_t *val)
+{
+	if (cur->ptr >= cur->end)
+		return SLURM_ERROR;
+	*val = *cur->ptr++;
+	return SLURM_SUCCESS;
+}
+
+static int _get_varint(col_cursor_t *cur, uint64_t *val)
+{
+	uint64_t v = 0;
+	int shift = 0;
+	uint8_t b;
+
+	while ((cur->ptr < cur->end) && (shift < 64)) {
+		b = *cur->ptr++;
+		v |= (uint64_t) (b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*val = v;
+			return SLURM_SUCCESS;
+		}
+		shift += 7;
+	}
+	return SLURM_ERROR;
+}
+
+static int _get_uint32(col_cursor_t *cur, uint32_t *val)
+{
+	uint64_t v;
+
+	if ((_get_varint(cur, &v) != SLURM_SUCCESS) || (v > UINT32_MAX))
+		return SLURM_ERROR;
+	*val = v;
+	return SLURM_SUCCESS;
+}
+
+static int _get_string(col_cursor_t *cur, char **str)
+{
+	uint64_t len;
+
+	if ((_get_varint(cur, &len) != SLURM_SUCCESS) ||
+	    (len > (cur->end - cur->ptr)))
+		return SLURM_ERROR;
+	*str = xstrndup((const char *) cur->ptr, len);
+	cur->ptr += len;
+	return SLURM_SUCCESS;
+}
+
+static int _get_xor(col_cursor_t *cur, uint64_t *xor)
+{
+	uint64_t v = 0;
+	uint8_t zeros;
+	int i;
+
+	if ((_get_byte(cur, &zeros) != SLURM_SUCCESS) || (zeros > 8) ||
+	    ((8 - zeros) > (cur->end - cur->ptr)))
+		return SLURM_ERROR;
+	for (i = 0; i < (8 - zeros); i++)
+		v |= (uint64_t) *cur->ptr++ << (i * 8);
+	*xor = v;
+	return SLURM_SUCCESS;
+}
+
+/* Get the next complete record, return false at the end of the records
+ * or if the last one was cut short */
+static bool _next_record(col_cursor_t *cur, uint8_t *type,
+			 col_cursor_t *payload)
+{
+	col_cursor_t tmp = *cur;
+	uint64_t len;
+
+	if ((_get_byte(&tmp, type) != SLURM_SUCCESS) ||
+	    (_get_varint(&tmp, &len) != SLURM_SUCCESS) ||
+	    (len > (tmp.end - tmp.ptr)))
+		return false;
+	payload->ptr = tmp.ptr;
+	payload->end = tmp.ptr + len;
+	cur->ptr = payload->end;
+	return true;
+}
+
+static void _pack_header(col_buf_t *buf, col_header_t *header)
+{
+	_put_bytes(buf, COL_MAGIC, COL_MAGIC_LEN);
+	_put_varint(buf, COL_VERSION);
+	_put_varint(buf, header->job_id);
+	_put_varint(buf, header->step_id);
+	_put_string(buf, header->node_name);
+	_put_varint(buf, header->node_id);
+	_put_varint(buf, header->ntasks);
+	_put_varint(buf, header->cpus_per_task);
+	_put_varint(buf, header->start_time);
+}
+
+static int _unpack_header(col_cursor_t *cur, col_header_t *header)
+{
+	uint64_t version, start_time;
+
+	if (((cur->end - cur->ptr) < COL_MAGIC_LEN) ||
+	    memcmp(cur->ptr, COL_MAGIC, COL_MAGIC_LEN))
+		return SLURM_ERROR;
+	cur->ptr += COL_MAGIC_LEN;
+	if ((_get_varint(cur, &version) != SLURM_SUCCESS) ||
+	    (version != COL_VERSION)) {
+		error("%s: unsupported columnar profile version", __func__);
+		return SLURM_ERROR;
+	}
+	if ((_get_uint32(cur, &header->job_id) != SLURM_SUCCESS) ||
+	    (_get_uint32(cur, &header->step_id) != SLURM_SUCCESS) ||
+	    (_get_string(cur, &header->node_name) != SLURM_SUCCESS) ||
+	    (_get_uint32(cur, &header->node_id) != SLURM_SUCCESS) ||
+	    (_get_uint32(cur, &header->ntasks) != SLURM_SUCCESS) ||
+	    (_get_uint32(cur, &header->cpus_per_task) != SLURM_SUCCESS) ||
+	    (_get_varint(cur, &start_time) != SLURM_SUCCESS))
+		return SLURM_ERROR;
+	header->start_time = start_time;
+	return SLURM_SUCCESS;
+}
+
+static int _write_full(int fd, const void *data, size_t len, off_t offset)
+{
+	const uint8_t *ptr = data;
+	ssize_t n;
+
+	while (len > 0) {
+		if (offset < 0)
+			n = write(fd, ptr, len);
+		else
+			n = pwrite(fd, ptr, len, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return SLURM_ERROR;
+		}
+		ptr += n;
+		len -= n;
+		if (offset >= 0)
+			offset += n;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Start a record in buf, the payload is added after COL_REC_HDR_MAX bytes */
+static void _record_start(col_buf_t *buf)
+{
+	buf->len = 0;
+	_buf_reserve(buf, COL_REC_HDR_MAX);
+	buf->len = COL_REC_HDR_MAX;
+}
+
+/* Put the record type and length right in front of its payload and write
+ * it with a single call, so that readers never see half a header */
+static int _record_write(int fd, col_buf_t *buf, uint8_t type)
+{
+	uint64_t len = buf->len - COL_REC_HDR_MAX;
+	int hdr_len = 1 + _varint_len(len);
+	uint8_t *hdr = buf->data + COL_REC_HDR_MAX - hdr_len;
+
+	*hdr++ = type;
+	while (len >= 0x80) {
+		*hdr++ = (len & 0x7f) | 0x80;
+		len >>= 7;
+	}
+	*hdr = len;
+
+	return _write_full(fd, buf->data + COL_REC_HDR_MAX - hdr_len,
+			   buf->len - COL_REC_HDR_MAX + hdr_len, -1);
+}
+
+/**********************************************************************
+ * Writer
+ **********************************************************************/
+extern col_writer_t *col_writer_open(const char *path, col_header_t *header)
+{
+	col_writer_t *writer;
+	col_buf_t buf = { NULL, 0, 0 };
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return NULL;
+
+	_pack_header(&buf, header);
+	if (_write_full(fd, buf.data, buf.len, -1) != SLURM_SUCCESS) {
+		int save_errno = errno;
+		_buf_free(&buf);
+		close(fd);
+		errno = save_errno;
+		return NULL;
+	}
+	_buf_free(&buf);
+
+	writer = xmalloc(sizeof(col_writer_t));
+	writer->fd = fd;
+	return writer;
+}
+
+extern int col_writer_add_series(col_writer_t *writer, const char *name,
+				 acct_gather_profile_dataset_t *fields)
+{
+	col_wseries_t *series;
+	int i, nfields = 0;
+
+	xassert(writer);
+
+	while (fields && (fields[nfields].type != PROFILE_FIELD_NOT_SET))
+		nfields++;
+
+	_record_start(&writer->rec);
+	_put_varint(&writer->rec, writer->series_cnt);
+	_put_string(&writer->rec, name);
+	_put_varint(&writer->rec, nfields);
+	for (i = 0; i < nfields; i++) {
+		_put_byte(&writer->rec, fields[i].type);
+		_put_string(&writer->rec, fields[i].name);
+	}
+	if (_record_write(writer->fd, &writer->rec, COL_REC_SERIES)
+	    != SLURM_SUCCESS) {
+		error("%s: write of series %s failed: %m", __func__, name);
+		return SLURM_ERROR;
+	}
+
+	xrealloc(writer->series, (writer->series_cnt + 1) *
+		 sizeof(col_wseries_t));
+	series = &writer->series[writer->series_cnt];
+	series->nfields = nfields;
+	series->types = xmalloc(sizeof(acct_gather_profile_field_type_t) *
+				(nfields + 1));
+	for (i = 0; i < nfields; i++)
+		series->types[i] = fields[i].type;
+	series->prev = xmalloc(sizeof(uint64_t) * (nfields + 1));
+	series->cols = xmalloc(sizeof(col_buf_t) * (nfields + 1));
+
+	return writer->series_cnt++;
+}
+
+static int _flush_series(col_writer_t *writer, int id)
+{
+	col_wseries_t *series = &writer->series[id];
+	col_buf_t *rec = &writer->rec;
+	int i, rc;
+
+	if (!series->count)
+		return SLURM_SUCCESS;
+
+	_record_start(rec);
+	_put_varint(rec, id);
+	_put_varint(rec, series->count);
+	_put_varint(rec, series->first_time);
+	_put_varint(rec, series->last_time);
+	for (i = 0; i <= series->nfields; i++) {
+		_put_varint(rec, series->cols[i].len);
+		_put_bytes(rec, series->cols[i].data, series->cols[i].len);
+		series->cols[i].len = 0;
+	}
+	series->count = 0;
+
+	if ((rc = _record_write(writer->fd, rec, COL_REC_CHUNK))
+	    != SLURM_SUCCESS)
+		error("%s: write failed: %m", __func__);
+	return rc;
+}
+
+extern int col_writer_append(col_writer_t *writer, int id,
+			     time_t sample_time, void *data)
+{
+	col_wseries_t *series;
+	uint64_t val;
+	int64_t delta;
+	int i;
+
+	xassert(writer);
+
+	if ((id < 0) || (id >= writer->series_cnt))
+		return SLURM_ERROR;
+	series = &writer->series[id];
+
+	if (!series->count) {
+		series->first_time = sample_time;
+		series->last_delta = 0;
+		memset(series->prev, 0, sizeof(uint64_t) * series->nfields);
+	} else {
+		delta = (int64_t) sample_time - (int64_t) series->last_time;
+		_put_varint(&series->cols[0],
+			    _zigzag(delta - series->last_delta));
+		series->last_delta = delta;
+	}
+	series->last_time = sample_time;
+
+	for (i = 0; i < series->nfields; i++) {
+		memcpy(&val, (uint8_t *) data + (i * sizeof(uint64_t)),
+		       sizeof(uint64_t));
+		if (series->types[i] == PROFILE_FIELD_DOUBLE)
+			_put_xor(&series->cols[i + 1], val ^ series->prev[i]);
+		else
+			_put_varint(&series->cols[i + 1],
+				    _zigzag((int64_t) (val - series->prev[i])));
+		series->prev[i] = val;
+	}
+
+	if ((++series->count >= COL_CHUNK_SAMPLES) ||
+	    (difftime(sample_time, series->first_time) >= COL_CHUNK_SECS))
+		return _flush_series(writer, id);
+
+	return SLURM_SUCCESS;
+}
+
+extern int col_writer_flush(col_writer_t *writer)
+{
+	int i, rc = SLURM_SUCCESS;
+
+	xassert(writer);
+
+	for (i = 0; i < writer->series_cnt; i++) {
+		if (_flush_series(writer, i) != SLURM_SUCCESS)
+			rc = SLURM_ERROR;
+	}
+	return rc;
+}
+
+static void _writer_free(col_writer_t *writer)
+{
+	int i, j;
+
+	for (i = 0; i < writer->series_cnt; i++) {
+		for (j = 0; j <= writer->series[i].nfields; j++)
+			_buf_free(&writer->series[i].cols[j]);
+		xfree(writer->series[i].cols);
+		xfree(writer->series[i].prev);
+		xfree(writer->series[i].types);
+	}
+	xfree(writer->series);
+	_buf_free(&writer->rec);
+	xfree(writer);
+}
+
+extern int col_writer_close(col_writer_t *writer)
+{
+	int rc;
+
+	if (!writer)
+		return SLURM_SUCCESS;
+
+	rc = col_writer_flush(writer);
+	if (close(writer->fd) < 0) {
+		error("%s: close failed: %m", __func__);
+		rc = SLURM_ERROR;
+	}
+	_writer_free(writer);
+
+	return rc;
+}
+
+extern void col_writer_abandon(col_writer_t *writer)
+{
+	if (writer)
+		close(writer->fd);
+}
+
+/**********************************************************************
+ * Reader
+ **********************************************************************/
+static int _read_series(col_reader_t *reader, col_cursor_t *cur)
+{
+	col_series_t *def;
+	uint32_t id, nfields;
+	uint8_t type;
+	int i;
+
+	if ((_get_uint32(cur, &id) != SLURM_SUCCESS) ||
+	    (id != reader->series_cnt)) {
+		error("%s: unexpected series id", __func__);
+		return SLURM_ERROR;
+	}
+
+	xrealloc(reader->series, (reader->series_cnt + 1) *
+		 sizeof(col_rseries_t));
+	def = &reader->series[reader->series_cnt].def;
+	if ((_get_string(cur, &def->name) != SLURM_SUCCESS) ||
+	    (_get_uint32(cur, &nfields) != SLURM_SUCCESS) ||
+	    (nfields > (cur->end - cur->ptr)))
+		goto fail;
+	def->field_names = xmalloc(sizeof(char *) * (nfields + 1));
+	def->field_types = xmalloc(sizeof(acct_gather_profile_field_type_t) *
+				   (nfields + 1));
+	for (i = 0; i < nfields; i++) {
+		def->nfields++;
+		if ((_get_byte(cur, &type) != SLURM_SUCCESS) ||
+		    (_get_string(cur, &def->field_names[i]) != SLURM_SUCCESS))
+			goto fail;
+		def->field_types[i] = type;
+	}
+
+	reader->series_cnt++;
+	return SLURM_SUCCESS;
+
+fail:
+	for (i = 0; i < def->nfields; i++)
+		xfree(def->field_names[i]);
+	xfree(def->field_names);
+	xfree(def->field_types);
+	xfree(def->name);
+	memset(&reader->series[reader->series_cnt], 0, sizeof(col_rseries_t));
+	error("%s: invalid series definition", __func__);
+	return SLURM_ERROR;
+}
+
+static int _read_chunk(col_reader_t *reader, col_cursor_t *cur)
+{
+	col_rseries_t *series;
+	col_chunk_t *chunk;
+	uint32_t id, count;
+	uint64_t first, last;
+
+	if ((_get_uint32(cur, &id) != SLURM_SUCCESS) ||
+	    (id >= reader->series_cnt) ||
+	    (_get_uint32(cur, &count) != SLURM_SUCCESS) ||
+	    (_get_varint(cur, &first) != SLURM_SUCCESS) ||
+	    (_get_varint(cur, &last) != SLURM_SUCCESS)) {
+		error("%s: invalid chunk", __func__);
+		return SLURM_ERROR;
+	}
+
+	series = &reader->series[id];
+	if (series->chunk_cnt == series->chunk_size) {
+		series->chunk_size = MAX(16, series->chunk_size * 2);
+		xrealloc_nz(series->chunks,
+			    series->chunk_size * sizeof(col_chunk_t));
+	}
+	chunk = &series->chunks[series->chunk_cnt++];
+	chunk->count = count;
+	chunk->first_time = first;
+	chunk->last_time = last;
+	chunk->cols = cur->ptr;
+	chunk->end = cur->end;
+
+	return SLURM_SUCCESS;
+}
+
+extern col_reader_t *col_reader_open(const char *path)
+{
+	col_reader_t *reader;
+	col_cursor_t cur, payload;
+	struct stat st;
+	uint8_t type;
+	int fd, rc = SLURM_SUCCESS;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		error("%s: open(%s): %m", __func__, path);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0) {
+		error("%s: fstat(%s): %m", __func__, path);
+		close(fd);
+		return NULL;
+	}
+
+	reader = xmalloc(sizeof(col_reader_t));
+	reader->size = st.st_size;
+	if (reader->size)
+		reader->map = mmap(NULL, reader->size, PROT_READ, MAP_SHARED,
+				   fd, 0);
+	close(fd);
+	if (!reader->size || (reader->map == MAP_FAILED)) {
+		error("%s: unable to map %s: %m", __func__, path);
+		reader->map = NULL;
+		col_reader_close(reader);
+		return NULL;
+	}
+
+	cur.ptr = reader->map;
+	cur.end = reader->map + reader->size;
+	if (_unpack_header(&cur, &reader->header) != SLURM_SUCCESS) {
+		error("%s: %s is not a columnar profile file", __func__, path);
+		col_reader_close(reader);
+		return NULL;
+	}
+
+	/* Only the record headers are touched, the chunks are decoded on
+	 * demand by col_reader_scan() */
+	while ((rc == SLURM_SUCCESS) && _next_record(&cur, &type, &payload)) {
+		if (type == COL_REC_SERIES)
+			rc = _read_series(reader, &payload);
+		else if (type == COL_REC_CHUNK)
+			rc = _read_chunk(reader, &payload);
+		else
+			debug("%s: skipping record of unknown type %u",
+			      __func__, type);
+	}
+	if (cur.ptr != cur.end)
+		info("%s: %s: ignoring incomplete data at the end of the file",
+		     __func__, path);
+	if (rc != SLURM_SUCCESS) {
+		col_reader_close(reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+extern void col_reader_close(col_reader_t *reader)
+{
+	int i, j;
+
+	if (!reader)
+		return;
+
+	for (i = 0; i < reader->series_cnt; i++) {
+		col_series_t *def = &reader->series[i].def;
+		for (j = 0; j < def->nfields; j++)
+			xfree(def->field_names[j]);
+		xfree(def->field_names);
+		xfree(def->field_types);
+		xfree(def->name);
+		xfree(reader->series[i].chunks);
+	}
+	xfree(reader->series);
+	xfree(reader->header.node_name);
+	if (reader->map)
+		munmap(reader->map, reader->size);
+	xfree(reader);
+}
+
+extern col_header_t *col_reader_header(col_reader_t *reader)
+{
+	return &reader->header;
+}
+
+extern int col_reader_series_count(col_reader_t *reader)
+{
+	return reader->series_cnt;
+}
+
+extern col_series_t *col_reader_series(col_reader_t *reader, int series)
+{
+	if ((series < 0) || (series >= reader->series_cnt))
+		return NULL;
+	return &reader->series[series].def;
+}
+
+extern int col_reader_find_series(col_reader_t *reader, const char *name)
+{
+	int i;
+
+	for (i = 0; i < reader->series_cnt; i++) {
+		if (!xstrcmp(reader->series[i].def.name, name))
+			return i;
+	}
+	return -1;
+}
+
+/* Decode the samples of one chunk, columns are read side by side */
+static int _scan_chunk(col_series_t *def, col_chunk_t *chunk,
+		       time_t start, time_t end, col_cursor_t *cols,
+		       col_value_t *values, col_sample_f func, void *arg)
+{
+	col_cursor_t cur = { chunk->cols, chunk->end };
+	int64_t delta = 0, t = chunk->first_time;
+	uint64_t len, raw;
+	int i, f, rc;
+
+	for (i = 0; i <= def->nfields; i++) {
+		if ((_get_varint(&cur, &len) != SLURM_SUCCESS) ||
+		    (len > (cur.end - cur.ptr)))
+			goto fail;
+		cols[i].ptr = cur.ptr;
+		cols[i].end = cur.ptr + len;
+		cur.ptr += len;
+	}
+	memset(values, 0, sizeof(col_value_t) * def->nfields);
+
+	for (i = 0; i < chunk->count; i++) {
+		if (i > 0) {
+			if (_get_varint(&cols[0], &raw) != SLURM_SUCCESS)
+				goto fail;
+			delta += _unzigzag(raw);
+			t += delta;
+		}
+		for (f = 0; f < def->nfields; f++) {
+			if (def->field_types[f] == PROFILE_FIELD_DOUBLE) {
+				if (_get_xor(&cols[f + 1], &raw)
+				    != SLURM_SUCCESS)
+					goto fail;
+				values[f].u ^= raw;
+			} else {
+				if (_get_varint(&cols[f + 1], &raw)
+				    != SLURM_SUCCESS)
+					goto fail;
+				values[f].u += _unzigzag(raw);
+			}
+		}
+		if (end && (t > end))
+			return SLURM_SUCCESS;
+		if ((t >= start) &&
+		    ((rc = (func)(def, t, values, arg)) != SLURM_SUCCESS))
+			return rc;
+	}
+	return SLURM_SUCCESS;
+
+fail:
+	error("%s: corrupted chunk in series %s", __func__, def->name);
+	return SLURM_ERROR;
+}
+
+extern int col_reader_scan(col_reader_t *reader, int id,
+			   time_t start, time_t end,
+			   col_sample_f func, void *arg)
+{
+	col_rseries_t *series;
+	col_cursor_t *cols;
+	col_value_t *values;
+	int lo, hi, mid, rc = SLURM_SUCCESS;
+
+	if ((id < 0) || (id >= reader->series_cnt))
+		return SLURM_ERROR;
+	series = &reader->series[id];
+
+	/* Chunks of a series are in time order, find the first one ending
+	 * after the start of the window */
+	lo = 0;
+	hi = series->chunk_cnt;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (series->chunks[mid].last_time < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	cols = xmalloc(sizeof(col_cursor_t) * (series->def.nfields + 1));
+	values = xmalloc(sizeof(col_value_t) * (series->def.nfields + 1));
+	for (; lo < series->chunk_cnt; lo++) {
+		if (end && (series->chunks[lo].first_time > end))
+			break;
+		if ((rc = _scan_chunk(&series->def, &series->chunks[lo],
+				      start, end, cols, values, func, arg))
+		    != SLURM_SUCCESS)
+			break;
+	}
+	xfree(cols);
+	xfree(values);
+
+	return rc;
+}
+
+/**********************************************************************
+ * Merge
+ **********************************************************************/
+typedef struct {
+	char *path;
+	uint8_t *map;
+	size_t size;
+	col_header_t header;
+	const uint8_t *records;	/* first record */
+	uint32_t series_cnt;
+	uint32_t series_base;	/* id of its first series in the output */
+	size_t out_size;
+	off_t out_offset;
+	int rc;
+} col_merge_file_t;
+
+enum {
+	COL_MERGE_OPEN,		/* map the files and count their series */
+	COL_MERGE_SIZE,		/* compute the size of their output */
+	COL_MERGE_WRITE		/* write them */
+};
+
+typedef struct {
+	col_merge_file_t *files;
+	int nfiles;
+	int next;
+	int pass;
+	int fd;
+	pthread_mutex_t lock;
+} col_merge_t;
+
+static int _merge_open(col_merge_file_t *file)
+{
+	col_cursor_t cur, payload;
+	struct stat st;
+	uint8_t type;
+	int fd;
+
+	if ((fd = open(file->path, O_RDONLY | O_CLOEXEC)) < 0) {
+		error("%s: open(%s): %m", __func__, file->path);
+		return SLURM_ERROR;
+	}
+	if ((fstat(fd, &st) < 0) || !st.st_size) {
+		error("%s: %s is empty", __func__, file->path);
+		close(fd);
+		return SLURM_ERROR;
+	}
+	file->size = st.st_size;
+	file->map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (file->map == MAP_FAILED) {
+		error("%s: unable to map %s: %m", __func__, file->path);
+		file->map = NULL;
+		return SLURM_ERROR;
+	}
+	madvise(file->map, file->size, MADV_SEQUENTIAL);
+
+	cur.ptr = file->map;
+	cur.end = file->map + file->size;
+	if (_unpack_header(&cur, &file->header) != SLURM_SUCCESS) {
+		error("%s: %s is not a columnar profile file",
+		      __func__, file->path);
+		return SLURM_ERROR;
+	}
+	file->records = cur.ptr;
+
+	while (_next_record(&cur, &type, &payload)) {
+		if (type == COL_REC_SERIES)
+			file->series_cnt++;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Add the size of the record, or the record itself to out, once its series
+ * id has been renumbered */
+static int _merge_record(col_merge_file_t *file, uint8_t type,
+			 col_cursor_t *payload, col_buf_t *out, bool copy)
+{
+	uint64_t len = payload->end - payload->ptr;
+	uint32_t id = 0;
+
+	if ((type == COL_REC_SERIES) || (type == COL_REC_CHUNK)) {
+		if (_get_uint32(payload, &id) != SLURM_SUCCESS)
+			return SLURM_ERROR;
+		id += file->series_base;
+		len = (payload->end - payload->ptr) + _varint_len(id);
+	}
+
+	if (!copy) {
+		out->len += 1 + _varint_len(len) + len;
+		return SLURM_SUCCESS;
+	}
+
+	_put_byte(out, type);
+	_put_varint(out, len);
+	if ((type == COL_REC_SERIES) || (type == COL_REC_CHUNK))
+		_put_varint(out, id);
+	_put_bytes(out, payload->ptr, payload->end - payload->ptr);
+	return SLURM_SUCCESS;
+}
+
+static int _merge_file(col_merge_t *merge, col_merge_file_t *file)
+{
+	col_cursor_t cur, payload;
+	col_buf_t out = { NULL, 0, 0 };
+	off_t offset = file->out_offset;
+	bool copy = (merge->pass == COL_MERGE_WRITE);
+	uint8_t type;
+	int rc = SLURM_SUCCESS;
+
+	if (merge->pass == COL_MERGE_OPEN)
+		return _merge_open(file);
+
+	cur.ptr = file->records;
+	cur.end = file->map + file->size;
+	while ((rc == SLURM_SUCCESS) && _next_record(&cur, &type, &payload)) {
+		rc = _merge_record(file, type, &payload, &out, copy);
+		if (copy && (out.len >= COL_MERGE_BUF)) {
+			rc = _write_full(merge->fd, out.data, out.len, offset);
+			offset += out.len;
+			out.len = 0;
+		}
+	}
+	if (!copy)
+		file->out_size = out.len;
+	else if ((rc == SLURM_SUCCESS) && out.len)
+		rc = _write_full(merge->fd, out.data, out.len, offset);
+	_buf_free(&out);
+
+	if (rc != SLURM_SUCCESS)
+		error("%s: merge of %s failed: %m", __func__, file->path);
+	return rc;
+}
+
+static void *_merge_thread(void *arg)
+{
+	col_merge_t *merge = arg;
+	int i;
+
+	while (1) {
+		slurm_mutex_lock(&merge->lock);
+		i = merge->next++;
+		slurm_mutex_unlock(&merge->lock);
+		if (i >= merge->nfiles)
+			break;
+		merge->files[i].rc = _merge_file(merge, &merge->files[i]);
+	}
+	return NULL;
+}
+
+/* Run one pass over all files with the worker threads, the calling thread
+ * being one of them */
+static int _merge_pass(col_merge_t *merge, int pass, int threads)
+{
+	pthread_t *tids;
+	pthread_attr_t attr;
+	int i, started = 0;
+
+	merge->pass = pass;
+	merge->next = 0;
+
+	tids = xmalloc(sizeof(pthread_t) * threads);
+	slurm_attr_init(&attr);
+	for (i = 1; i < threads; i++) {
+		if (pthread_create(&tids[i], &attr, _merge_thread, merge)) {
+			error("%s: pthread_create: %m", __func__);
+			break;
+		}
+		started++;
+	}
+	slurm_attr_destroy(&attr);
+	_merge_thread(merge);
+	for (i = 1; i <= started; i++)
+		pthread_join(tids[i], NULL);
+	xfree(tids);
+
+	for (i = 0; i < merge->nfiles; i++) {
+		if (merge->files[i].rc != SLURM_SUCCESS)
+			return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
+extern int col_merge_files(const char *output, char **inputs, int ninputs,
+			   int threads)
+{
+	col_merge_t merge;
+	col_header_t header;
+	col_buf_t buf = { NULL, 0, 0 };
+	off_t offset;
+	int i, rc;
+
+	if (ninputs < 1)
+		return SLURM_ERROR;
+
+	memset(&merge, 0, sizeof(col_merge_t));
+	slurm_mutex_init(&merge.lock);
+	merge.nfiles = ninputs;
+	merge.fd = -1;
+	merge.files = xmalloc(sizeof(col_merge_file_t) * ninputs);
+	for (i = 0; i < ninputs; i++)
+		merge.files[i].path = inputs[i];
+	threads = MAX(1, MIN(threads, ninputs));
+
+	if ((rc = _merge_pass(&merge, COL_MERGE_OPEN, threads))
+	    != SLURM_SUCCESS)
+		goto end_it;
+
+	memset(&header, 0, sizeof(col_header_t));
+	header.job_id = merge.files[0].header.job_id;
+	header.step_id = merge.files[0].header.step_id;
+	header.cpus_per_task = merge.files[0].header.cpus_per_task;
+	header.start_time = merge.files[0].header.start_time;
+	for (i = 0; i < ninputs; i++) {
+		col_merge_file_t *file = &merge.files[i];
+		header.ntasks += file->header.ntasks;
+		header.start_time = MIN(header.start_time,
+					file->header.start_time);
+		if (i)
+			file->series_base = merge.files[i - 1].series_base +
+					    merge.files[i - 1].series_cnt;
+	}
+
+	if ((rc = _merge_pass(&merge, COL_MERGE_SIZE, threads))
+	    != SLURM_SUCCESS)
+		goto end_it;
+
+	merge.fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			0644);
+	if (merge.fd < 0) {
+		error("%s: open(%s): %m", __func__, output);
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+	_pack_header(&buf, &header);
+	if ((rc = _write_full(merge.fd, buf.data, buf.len, 0))
+	    != SLURM_SUCCESS) {
+		error("%s: write(%s): %m", __func__, output);
+		goto end_it;
+	}
+	offset = buf.len;
+	for (i = 0; i < ninputs; i++) {
+		merge.files[i].out_offset = offset;
+		offset += merge.files[i].out_size;
+	}
+
+	rc = _merge_pass(&merge, COL_MERGE_WRITE, threads);
+
+end_it:
+	if ((merge.fd >= 0) && (close(merge.fd) < 0)) {
+		error("%s: close(%s): %m", __func__, output);
+		rc = SLURM_ERROR;
+	}
+	for (i = 0; i < ninputs; i++) {
+		if (merge.files[i].map)
+			munmap(merge.files[i].map, merge.files[i].size);
+		xfree(merge.files[i].header.node_name);
+	}
+	xfree(merge.files);
+	_buf_free(&buf);
+	slurm_mutex_destroy(&merge.lock);
+
+	return rc;
+}
@@ -0,0 +1,174 @@
+/****************************************************************************\
+ *  columnar_api.h
+ *****************************************************************************
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  Provide support for acct_gather_profile plugins based on append-only
+ *  columnar files.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\****************************************************************************/
+#ifndef __ACCT_GATHER_COLUMNAR_API_H__
+#define __ACCT_GATHER_COLUMNAR_API_H__
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/common/slurm_acct_gather_profile.h"
+
+/*
+ * File layout, all integers are LEB128 varints unless noted:
+ *
+ *   header  "SLURMCOL" magic (8 bytes), version, job id, step id,
+ *           node name (length + bytes), node index, number of tasks,
+ *           CPUs per task, start time
+ *   records type (1 byte), payload length, payload
+ *
+ * COL_REC_SERIES defines a series: id, name ("<node>/<group>/<dataset>"),
+ * number of fields, then the type (1 byte) and name of each field.
+ *
+ * COL_REC_CHUNK holds up to COL_CHUNK_SAMPLES samples of one series: series
+ * id, sample count, first and last sample time, then one column per field
+ * preceded by the time column. Each column starts with its length in bytes
+ * so that readers can skip the ones they do not need. Times are stored as
+ * zigzag encoded deltas of deltas, uint64 fields as zigzag encoded deltas
+ * and doubles as the XOR with the previous value, stripped of its leading
+ * zero bytes.
+ *
+ * Records are only ever appended, a file cut short by a crash can be read
+ * up to its last complete record.
+ */
+#define COL_MAGIC		"SLURMCOL"
+#define COL_MAGIC_LEN		8
+#define COL_VERSION		1
+#define COL_FILE_SUFFIX		".pcol"
+
+#define COL_REC_SERIES		1
+#define COL_REC_CHUNK		2
+
+#define COL_CHUNK_SAMPLES	128	/* samples buffered per series */
+#define COL_CHUNK_SECS		300	/* flush older samples anyway */
+
+typedef union {
+	uint64_t u;
+	double d;
+} col_value_t;
+
+typedef struct {
+	uint32_t job_id;
+	uint32_t step_id;
+	char *node_name;	/* NULL or "" for merged files */
+	uint32_t node_id;
+	uint32_t ntasks;
+	uint32_t cpus_per_task;
+	time_t start_time;
+} col_header_t;
+
+typedef struct {
+	char *name;		/* "<node>/<group>/<dataset>" */
+	int nfields;
+	char **field_names;
+	acct_gather_profile_field_type_t *field_types;
+} col_series_t;
+
+typedef struct col_writer col_writer_t;
+typedef struct col_reader col_reader_t;
+
+/*
+ * Create (or truncate) a columnar profile file.
+ * RET the writer or NULL on error, with errno set
+ */
+extern col_writer_t *col_writer_open(const char *path, col_header_t *header);
+
+/*
+ * Define a new series. fields is terminated by a PROFILE_FIELD_NOT_SET
+ * entry, samples of the series are made of these fields in this order.
+ * RET the series id or SLURM_ERROR
+ */
+extern int col_writer_add_series(col_writer_t *writer, const char *name,
+				 acct_gather_profile_dataset_t *fields);
+
+/*
+ * Add one sample to a series. data holds the packed field values, as passed
+ * to acct_gather_profile_g_add_sample_data(). Samples are written to the
+ * file by chunks.
+ */
+extern int col_writer_append(col_writer_t *writer, int series,
+			     time_t sample_time, void *data);
+
+/* Write the buffered samples of all series */
+extern int col_writer_flush(col_writer_t *writer);
+
+/* Flush, close the file and free the writer */
+extern int col_writer_close(col_writer_t *writer);
+
+/* Close the file without flushing, for use in a forked child */
+extern void col_writer_abandon(col_writer_t *writer);
+
+/*
+ * Map a columnar profile file and index its chunks.
+ * RET the reader or NULL on error
+ */
+extern col_reader_t *col_reader_open(const char *path);
+extern void col_reader_close(col_reader_t *reader);
+
+extern col_header_t *col_reader_header(col_reader_t *reader);
+extern int col_reader_series_count(col_reader_t *reader);
+extern col_series_t *col_reader_series(col_reader_t *reader, int series);
+
+/* Return the id of the series with this name, or -1 */
+extern int col_reader_find_series(col_reader_t *reader, const char *name);
+
+/*
+ * Called for each sample by col_reader_scan(), values holds one value per
+ * field of the series. Return SLURM_SUCCESS to continue the scan.
+ */
+typedef int (*col_sample_f) (col_series_t *series, time_t sample_time,
+			     col_value_t *values, void *arg);
+
+/*
+ * Call func for every sample of a series taken between start and end
+ * (inclusive, 0 for no limit), in time order. Only the chunks overlapping
+ * the time window are decoded.
+ */
+extern int col_reader_scan(col_reader_t *reader, int series,
+			   time_t start, time_t end,
+			   col_sample_f func, void *arg);
+
+/*
+ * Merge node files into one file, using up to "threads" threads. Series
+ * names already hold the node name so the records are copied without
+ * being decoded, only their series ids are renumbered.
+ */
+extern int col_merge_files(const char *output, char **inputs, int ninputs,
+			   int threads);
+
+#endif /* __ACCT_GATHER_COLUMNAR_API_H__ */
@@ -0,0 +1,661 @@
+/*****************************************************************************\
+ *  scolutil.c - slurm profile accounting plugin for columnar files
+ *               utility program.
+ *****************************************************************************
+ *  Copyright (C) 2017 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+ *
+ *  This file is patterned after sh5util.c.
+\*****************************************************************************/
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/parse_time.h"
+#include "src/common/proc_args.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_acct_gather_profile.h"
+#include "src/common/timers.h"
+#include "src/common/uid.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "../columnar_api.h"
+
+#define SCOLUTIL_STEP_BATCH -2
+
+typedef enum {
+	SCOLUTIL_MODE_MERGE,
+	SCOLUTIL_MODE_EXTRACT,
+	SCOLUTIL_MODE_LIST,
+} scolutil_mode_t;
+
+typedef struct {
+	char *dir;
+	time_t end_time;
+	char *input;
+	int job_id;
+	bool keepfiles;
+	scolutil_mode_t mode;
+	char *node;
+	char *output;
+	char *series;
+	time_t start_time;
+	int step_id;
+	int threads;
+	char *user;
+	int verbose;
+} scolutil_opts_t;
+
+typedef struct {
+	char *file_name;
+	int step_id;
+} scolutil_file_t;
+
+typedef struct {
+	FILE *fp;
+	time_t start_time;
+} extract_args_t;
+
+static scolutil_opts_t params;
+
+static void _help_msg(void)
+{
+	printf("Usage scolutil [<OPTION>] -j <job[.stepid]>\n\n"
+	       "Valid <OPTION> values are:\n"
+	       " -L, --list           List the series of a merged or node-step file.\n"
+	       "     -i, --input      file to list (default ./job_$jobid.$stepid.pcol)\n"
+	       " -E, --extract        Extract data series into a csv file.\n"
+	       "     -i, --input      file to extract from (default ./job_$jobid.$stepid.pcol)\n"
+	       "     -N, --node       Node name to extract (default is all)\n"
+	       "     -s, --series     Name of series, as printed by --list or its last\n"
+	       "                      component: Energy | Network | Task_# ...\n"
+	       "                      (default is all)\n"
+	       "     -S, --starttime  Only extract samples taken from this time\n"
+	       "     -e, --endtime    Only extract samples taken up to this time\n"
+	       " -j, --jobs           Format is <job(.step)>. Merge this job/step.\n"
+	       "                      Each step is merged into its own file.\n"
+	       " -h, --help           Print this description of use.\n"
+	       " -o, --output         Path to a file into which to write.\n"
+	       "                      Default for merge is ./job_$jobid.$stepid.pcol\n"
+	       "                      Default for extract is ./extract_$jobid.csv\n"
+	       " -p, --profiledir     Profile directory location where node-step files exist\n"
+	       "                      default is what is set in acct_gather.conf\n"
+	       " -k, --savefiles      Don't remove node-step files after merging them\n"
+	       " -t, --threads        Number of files merged at the same time (default 8)\n"
+	       " --user               User who profiled job. (Handy for root user, defaults to \n"
+	       "                      user running this command.)\n"
+	       " --usage              Display brief usage message\n");
+}
+
+static void _init_opts(void)
+{
+	memset(&params, 0, sizeof(scolutil_opts_t));
+	params.job_id = -1;
+	params.mode = SCOLUTIL_MODE_MERGE;
+	params.step_id = -1;
+	params.threads = 8;
+}
+
+static void _free_options(void)
+{
+	xfree(params.dir);
+	xfree(params.input);
+	xfree(params.node);
+	xfree(params.output);
+	xfree(params.series);
+	xfree(params.user);
+}
+
+static void _cleanup(void)
+{
+	_free_options();
+	log_fini();
+	slurm_conf_destroy();
+	acct_gather_profile_fini();
+	acct_gather_conf_destroy();
+}
+
+static int _set_options(const int argc, char **argv)
+{
+	int option_index = 0;
+	int cc;
+	log_options_t logopt = LOG_OPTS_STDERR_ONLY;
+	char *next_str = NULL;
+	uid_t u;
+
+	static struct option long_options[] = {
+		{"endtime", required_argument, 0, 'e'},
+		{"extract", no_argument, 0, 'E'},
+		{"help", no_argument, 0, 'h'},
+		{"input", required_argument, 0, 'i'},
+		{"jobs", required_argument, 0, 'j'},
+		{"savefiles", no_argument, 0, 'k'},
+		{"list", no_argument, 0, 'L'},
+		{"node", required_argument, 0, 'N'},
+		{"output", required_argument, 0, 'o'},
+		{"profiledir", required_argument, 0, 'p'},
+		{"series", required_argument, 0, 's'},
+		{"starttime", required_argument, 0, 'S'},
+		{"threads", required_argument, 0, 't'},
+		{"usage", no_argument, 0, 'U'},
+		{"user", required_argument, 0, 'u'},
+		{"verbose", no_argument, 0, 'v'},
+		{"version", no_argument, 0, 'V'},
+		{0, 0, 0, 0}};
+
+	log_init(xbasename(argv[0]), logopt, 0, NULL);
+
+	_init_opts();
+
+	while ((cc = getopt_long(argc, argv, "e:Ehi:j:kLN:o:p:s:S:t:u:UvV",
+				 long_options, &option_index)) != EOF) {
+		switch (cc) {
+		case 'e':
+			params.end_time = parse_time(optarg, 1);
+			if (!params.end_time) {
+				error("Bad value for --endtime=\"%s\"", optarg);
+				return -1;
+			}
+			break;
+		case 'E':
+			params.mode = SCOLUTIL_MODE_EXTRACT;
+			break;
+		case 'h':
+			_help_msg();
+			return -1;
+		case 'i':
+			params.input = xstrdup(optarg);
+			break;
+		case 'j':
+			params.job_id = strtol(optarg, &next_str, 10);
+			if (next_str[0] == '.') {
+				if (!xstrcmp(next_str + 1, "batch"))
+					params.step_id = SCOLUTIL_STEP_BATCH;
+				else
+					params.step_id =
+						strtol(next_str + 1, NULL, 10);
+			}
+			break;
+		case 'k':
+			params.keepfiles = true;
+			break;
+		case 'L':
+			params.mode = SCOLUTIL_MODE_LIST;
+			break;
+		case 'N':
+			params.node = xstrdup(optarg);
+			break;
+		case 'o':
+			params.output = xstrdup(optarg);
+			break;
+		case 'p':
+			params.dir = xstrdup(optarg);
+			break;
+		case 's':
+			params.series = xstrdup(optarg);
+			break;
+		case 'S':
+			params.start_time = parse_time(optarg, 1);
+			if (!params.start_time) {
+				error("Bad value for --starttime=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			break;
+		case 't':
+			params.threads = strtol(optarg, NULL, 10);
+			if (params.threads < 1) {
+				error("Bad value for --threads=\"%s\"", optarg);
+				return -1;
+			}
+			break;
+		case 'u':
+			if (uid_from_string(optarg, &u) < 0) {
+				error("No such user --uid=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			params.user = uid_to_string(u);
+			break;
+		case 'U':
+			_help_msg();
+			return -1;
+		case 'v':
+			params.verbose++;
+			break;
+		case 'V':
+			print_slurm_version();
+			return -1;
+		case ':':
+		case '?': /* getopt() has explained it */
+			return -1;
+		}
+	}
+
+	if (params.verbose) {
+		logopt.stderr_level += params.verbose;
+		log_alter(logopt, SYSLOG_FACILITY_USER, NULL);
+	}
+
+	return 0;
+}
+
+static char *_step_str(int step_id)
+{
+	if (step_id == SCOLUTIL_STEP_BATCH)
+		return xstrdup("batch");
+	return xstrdup_printf("%d", step_id);
+}
+
+static int _check_params(void)
+{
+	char *step_str;
+
+	if ((params.mode == SCOLUTIL_MODE_MERGE) || !params.input) {
+		if (params.job_id == -1) {
+			error("JobID must be specified.");
+			return -1;
+		}
+	}
+
+	if (params.mode == SCOLUTIL_MODE_MERGE) {
+		if (params.user == NULL)
+			params.user = uid_to_string(getuid());
+		if (!params.dir)
+			acct_gather_profile_g_get(ACCT_GATHER_PROFILE_DIR,
+						  &params.dir);
+		if (!params.dir) {
+			error("Cannot read/parse acct_gather.conf");
+			return -1;
+		}
+		return 0;
+	}
+
+	if (!params.input) {
+		if (params.step_id == -1) {
+			error("A step must be given with --jobs, or a file "
+			      "with --input");
+			return -1;
+		}
+		step_str = _step_str(params.step_id);
+		params.input = xstrdup_printf("./job_%d.%s%s", params.job_id,
+					      step_str, COL_FILE_SUFFIX);
+		xfree(step_str);
+	}
+	if ((params.mode == SCOLUTIL_MODE_EXTRACT) && !params.output) {
+		if (params.job_id != -1)
+			params.output = xstrdup_printf("./extract_%d.csv",
+						       params.job_id);
+		else
+			params.output = xstrdup("./extract.csv");
+	}
+	if (params.start_time && params.end_time &&
+	    (params.start_time > params.end_time)) {
+		error("--starttime is after --endtime");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void _destroy_scolutil_file(void *arg)
+{
+	scolutil_file_t *object = (scolutil_file_t *) arg;
+
+	if (!object)
+		return;
+	xfree(object->file_name);
+	xfree(object);
+}
+
+static int _scolutil_sort_files(void *s1, void *s2)
+{
+	scolutil_file_t *rec_a = *(scolutil_file_t **) s1;
+	scolutil_file_t *rec_b = *(scolutil_file_t **) s2;
+
+	if (rec_a->step_id < rec_b->step_id)
+		return -1;
+	else if (rec_a->step_id > rec_b->step_id)
+		return 1;
+
+	return xstrcmp(rec_a->file_name, rec_b->file_name);
+}
+
+/* Merge the node files of one step, they are removed once merged unless
+ * --savefiles was given */
+static int _merge_step(int step_id, char **paths, int count)
+{
+	char *output = params.output, *step_str;
+	DEF_TIMERS;
+	int i, rc;
+
+	if (!output) {
+		step_str = _step_str(step_id);
+		output = xstrdup_printf("./job_%d.%s%s", params.job_id,
+					step_str, COL_FILE_SUFFIX);
+		xfree(step_str);
+	}
+
+	START_TIMER;
+	rc = col_merge_files(output, paths, count, params.threads);
+	END_TIMER;
+	if (rc == SLURM_SUCCESS) {
+		info("Merged %d node-step files into %s in %s",
+		     count, output, TIME_STR);
+		for (i = 0; !params.keepfiles && (i < count); i++) {
+			if (remove(paths[i]) < 0)
+				error("remove(%s): %m", paths[i]);
+		}
+	} else {
+		error("Failed to merge the node-step files into %s", output);
+		remove(output);
+	}
+
+	if (output != params.output)
+		xfree(output);
+	return rc;
+}
+
+/* Look for step and node files and merge them, one file per step */
+static int _merge_step_files(void)
+{
+	DIR *dir;
+	struct dirent *de;
+	char *step_dir = NULL, *file_name = NULL, *pos_char, *stepno;
+	char **paths = NULL;
+	int job_id, step_id, step_cnt = 0, count = 0;
+	int rc = SLURM_SUCCESS;
+	ListIterator itr;
+	List file_list = NULL;
+	scolutil_file_t *scolutil_file;
+
+	step_dir = xstrdup_printf("%s/%s", params.dir, params.user);
+
+	if (!(dir = opendir(step_dir))) {
+		error("Cannot open %s job profile directory: %m", step_dir);
+		xfree(step_dir);
+		return SLURM_ERROR;
+	}
+
+	file_list = list_create(_destroy_scolutil_file);
+	while ((de = readdir(dir))) {
+		xfree(file_name);
+		file_name = xstrdup(de->d_name);
+
+		if (file_name[0] == '.')
+			continue;
+
+		/* <jobid>_<stepid|batch>_<node>.pcol */
+		pos_char = strstr(file_name, COL_FILE_SUFFIX);
+		if (!pos_char || pos_char[strlen(COL_FILE_SUFFIX)])
+			continue;
+		*pos_char = 0;
+
+		pos_char = strchr(file_name, '_');
+		if (!pos_char)
+			continue;
+		*pos_char = 0;
+
+		job_id = strtol(file_name, NULL, 10);
+		if (job_id != params.job_id)
+			continue;
+
+		stepno = pos_char + 1;
+		pos_char = strchr(stepno, '_');
+		if (!pos_char)
+			continue;
+		*pos_char = 0;
+
+		if (!xstrcmp(stepno, "batch"))
+			step_id = SCOLUTIL_STEP_BATCH;
+		else
+			step_id = strtol(stepno, NULL, 10);
+		if ((params.step_id != -1) && (step_id != params.step_id))
+			continue;
+
+		scolutil_file = xmalloc(sizeof(scolutil_file_t));
+		scolutil_file->file_name = xstrdup_printf("%s/%s", step_dir,
+							  de->d_name);
+		scolutil_file->step_id = step_id;
+		list_append(file_list, scolutil_file);
+	}
+	closedir(dir);
+	xfree(file_name);
+	xfree(step_dir);
+
+	if (!list_count(file_list)) {
+		info("No node-step files found for jobid %d", params.job_id);
+		FREE_NULL_LIST(file_list);
+		return SLURM_SUCCESS;
+	}
+
+	/* sort the files so they are in step order */
+	list_sort(file_list, (ListCmpF) _scolutil_sort_files);
+
+	step_id = -1;
+	itr = list_iterator_create(file_list);
+	while ((scolutil_file = list_next(itr))) {
+		if (scolutil_file->step_id != step_id) {
+			step_id = scolutil_file->step_id;
+			step_cnt++;
+		}
+	}
+	if (params.output && (step_cnt > 1)) {
+		error("Job %d has %d steps, select one to use --output",
+		      params.job_id, step_cnt);
+		rc = SLURM_ERROR;
+		goto endit;
+	}
+
+	paths = xmalloc(sizeof(char *) * list_count(file_list));
+	list_iterator_reset(itr);
+	step_id = -1;
+	while ((scolutil_file = list_next(itr))) {
+		if (count && (scolutil_file->step_id != step_id)) {
+			if (_merge_step(step_id, paths, count)
+			    != SLURM_SUCCESS)
+				rc = SLURM_ERROR;
+			count = 0;
+		}
+		step_id = scolutil_file->step_id;
+		paths[count++] = scolutil_file->file_name;
+	}
+	if (count && (_merge_step(step_id, paths, count) != SLURM_SUCCESS))
+		rc = SLURM_ERROR;
+
+endit:
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(file_list);
+	xfree(paths);
+
+	return rc;
+}
+
+/* Series names are "<node>/<group>/<dataset>" or "<node>/<dataset>" */
+static bool _series_selected(col_series_t *series)
+{
+	char *name = series->name, *pos;
+	int len;
+
+	if (params.node) {
+		len = strlen(params.node);
+		if (xstrncmp(name, params.node, len) || (name[len] != '/'))
+			return false;
+	}
+	if (!params.series || !xstrcmp(name, params.series))
+		return true;
+	pos = strrchr(name, '/');
+	if (pos && !xstrcmp(pos + 1, params.series))
+		return true;
+	/* "Tasks" selects every task of the node */
+	if (!xstrcmp(params.series, "Tasks") && pos &&
+	    !xstrncmp(pos + 1, "Task_", 5))
+		return true;
+	return false;
+}
+
+static int _print_sample(col_series_t *series, time_t sample_time,
+			 col_value_t *values, void *arg)
+{
+	extract_args_t *args = (extract_args_t *) arg;
+	int i;
+
+	fprintf(args->fp, "%s,%ld,%ld", series->name, (long) sample_time,
+		(long) difftime(sample_time, args->start_time));
+	for (i = 0; i < series->nfields; i++) {
+		if (series->field_types[i] == PROFILE_FIELD_DOUBLE)
+			fprintf(args->fp, ",%lf", values[i].d);
+		else
+			fprintf(args->fp, ",%"PRIu64, values[i].u);
+	}
+	fputc('\n', args->fp);
+
+	return SLURM_SUCCESS;
+}
+
+/* Samples are decoded chunk by chunk and written right away, so memory use
+ * does not depend on the size of the series */
+static int _extract_series(void)
+{
+	col_reader_t *reader;
+	col_series_t *series;
+	extract_args_t args;
+	int i, j, cnt, printed = 0, rc = SLURM_SUCCESS;
+
+	if (!(reader = col_reader_open(params.input)))
+		return SLURM_ERROR;
+
+	if (!(args.fp = fopen(params.output, "w"))) {
+		error("Failed to open %s: %m", params.output);
+		col_reader_close(reader);
+		return SLURM_ERROR;
+	}
+	args.start_time = col_reader_header(reader)->start_time;
+
+	cnt = col_reader_series_count(reader);
+	for (i = 0; (i < cnt) && (rc == SLURM_SUCCESS); i++) {
+		series = col_reader_series(reader, i);
+		if (!_series_selected(series))
+			continue;
+		fprintf(args.fp, "Series,EpochTime,ElapsedTime");
+		for (j = 0; j < series->nfields; j++)
+			fprintf(args.fp, ",%s", series->field_names[j]);
+		fputc('\n', args.fp);
+		rc = col_reader_scan(reader, i, params.start_time,
+				     params.end_time, _print_sample, &args);
+		printed++;
+	}
+
+	if (fclose(args.fp) != 0) {
+		error("Failed to write %s: %m", params.output);
+		rc = SLURM_ERROR;
+	}
+	col_reader_close(reader);
+
+	if (!printed) {
+		info("No series selected in %s", params.input);
+		remove(params.output);
+	}
+
+	return rc;
+}
+
+static int _list_series(void)
+{
+	col_reader_t *reader;
+	col_series_t *series;
+	int i, j, cnt;
+
+	if (!(reader = col_reader_open(params.input)))
+		return SLURM_ERROR;
+
+	cnt = col_reader_series_count(reader);
+	for (i = 0; i < cnt; i++) {
+		series = col_reader_series(reader, i);
+		if (!_series_selected(series))
+			continue;
+		printf("%s:", series->name);
+		for (j = 0; j < series->nfields; j++)
+			printf(" %s", series->field_names[j]);
+		printf("\n");
+	}
+	col_reader_close(reader);
+
+	return SLURM_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	int cc;
+
+	cc = _set_options(argc, argv);
+	if (cc < 0)
+		goto ouch;
+
+	cc = _check_params();
+	if (cc < 0)
+		goto ouch;
+
+	switch (params.mode) {
+	case SCOLUTIL_MODE_MERGE:
+		cc = _merge_step_files();
+		break;
+	case SCOLUTIL_MODE_EXTRACT:
+		info("Extracting job data from %s into %s",
+		     params.input, params.output);
+		cc = _extract_series();
+		break;
+	case SCOLUTIL_MODE_LIST:
+		cc = _list_series();
+		break;
+	default:
+		error("Unknown type %d", params.mode);
+		break;
+	}
+
+ouch:
+	_cleanup();
+
+	return cc;
+}
@@ -50,15 +50,19 @@
 #endif
 
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "src/common/uid.h"
+#include "src/common/parse_time.h"
 #include "src/common/read_config.h"
 #include "src/common/proc_args.h"
 #include "src/common/xstring.h"
@@ -67,6 +71,10 @@
 #include "sh5util.h"
 
 #define MAX_PROFILE_PATH 1024
+#define MAX_MERGE_BUFFERED (256 * 1024 * 1024) /* node files read ahead */
+#define READ_BLOCK_SIZE 32768	/* bytes of records read at once */
+#define OPT_LONG_STARTTIME 0x100
+#define OPT_LONG_ENDTIME   0x101
 // #define MAX_ATTR_NAME 64
 #define MAX_GROUP_NAME 64
 // #define MAX_DATASET_NAME 64
@@ -118,8 +126,37 @@ typedef struct {
 	int job_id;
 	char *node_name;
 	int step_id;
+	void *image;		/* file content read by a merge thread */
+	size_t image_size;
+	bool read_done;
 } sh5util_file_t;
 
+/* Node files are read ahead by worker threads while the main thread copies
+ * their content, the HDF5 library itself is only called by the main thread */
+typedef struct {
+	size_t buffered;	/* bytes of images read but not merged yet */
+	pthread_cond_t cond;
+	sh5util_file_t **files;
+	int merged;		/* index of the file being merged */
+	pthread_mutex_t mutex;
+	int nfiles;
+	int next_read;		/* index of the next file to read */
+	char *step_dir;
+	bool stop;		/* the merge ended, read no more files */
+} merge_read_t;
+
+/* Read records of a table in blocks, limited to the requested time window */
+typedef struct {
+	hid_t table_id;
+	size_t rec_size;
+	hsize_t next;		/* index of the next record to read */
+	hsize_t end;		/* index past the last record to read */
+	uint8_t *buf;
+	hsize_t buf_cnt;
+	hsize_t buf_pos;
+	hsize_t block_cnt;	/* records per block */
+} table_reader_t;
+
 static FILE* output_file;
 static bool group_mode = false;
 static const char *current_step;
@@ -169,6 +206,10 @@ static void _help_msg(void)
 	       " -p, --profiledir     Profile directory location where node-step files exist\n"
 	       "		               default is what is set in acct_gather.conf\n"
 	       " -S, --savefiles      Don't remove node-step files after merging them \n"
+	       " -t, --threads        Number of threads reading node-step files when\n"
+	       "                      merging them (default 8)\n"
+	       " --starttime          Only extract samples taken from this time\n"
+	       " --endtime            Only extract samples taken up to this time\n"
 	       " --user               User who profiled job. (Handy for root user, defaults to \n"
 	       "		               user running this command.)\n"
 	       " --usage              Display brief usage message\n");
@@ -232,6 +273,7 @@ static void _destroy_sh5util_file(void *arg)
 
 	xfree(object->file_name);
 	xfree(object->node_name);
+	xfree(object->image);
 	xfree(object);
 }
 
@@ -308,6 +350,7 @@ static void _init_opts(void)
 	params.job_id = -1;
 	params.mode = SH5UTIL_MODE_MERGE;
 	params.step_id = -1;
+	params.threads = 8;
 }
 
 static int _set_options(const int argc, char **argv)
@@ -322,6 +365,7 @@ static int _set_options(const int argc, char **argv)
 		{"extract", no_argument, 0, 'E'},
 		{"item-extract", no_argument, 0, 'I'},
 		{"data", required_argument, 0, 'd'},
+		{"endtime", required_argument, 0, OPT_LONG_ENDTIME},
 		{"help", no_argument, 0, 'h'},
 		{"jobs", required_argument, 0, 'j'},
 		{"input", required_argument, 0, 'i'},
@@ -332,6 +376,8 @@ static int _set_options(const int argc, char **argv)
 		{"profiledir", required_argument, 0, 'p'},
 		{"series", required_argument, 0, 's'},
 		{"savefiles", no_argument, 0, 'S'},
+		{"starttime", required_argument, 0, OPT_LONG_STARTTIME},
+		{"threads", required_argument, 0, 't'},
 		{"usage", no_argument, 0, 'U'},
 		{"user", required_argument, 0, 'u'},
 		{"verbose", no_argument, 0, 'v'},
@@ -351,7 +397,7 @@ static int _set_options(const int argc, char **argv)
 
 	_init_opts();
 
-	while ((cc = getopt_long(argc, argv, "d:Ehi:Ij:l:LN:o:p:s:Su:UvV",
+	while ((cc = getopt_long(argc, argv, "d:Ehi:Ij:l:LN:o:p:s:St:u:UvV",
 	                         long_options, &option_index)) != EOF) {
 		switch (cc) {
 		case 'd':
@@ -408,6 +454,28 @@ static int _set_options(const int argc, char **argv)
 		case 'S':
 			params.keepfiles = 1;
 			break;
+		case OPT_LONG_STARTTIME:
+			if (!(params.start_time = parse_time(optarg, 1))) {
+				error("Bad value for --starttime=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			break;
+		case OPT_LONG_ENDTIME:
+			if (!(params.end_time = parse_time(optarg, 1))) {
+				error("Bad value for --endtime=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			break;
+		case 't':
+			params.threads = strtol(optarg, NULL, 10);
+			if (params.threads < 1) {
+				error("Bad value for --threads=\"%s\"",
+				      optarg);
+				return -1;
+			}
+			break;
 		case 'u':
 			if (uid_from_string(optarg, &u) < 0) {
 				error("No such user --uid=\"%s\"",
@@ -506,8 +574,95 @@ _check_params(void)
 	return 0;
 }
 
+/* Read a whole node-step file into memory. Return NULL on error, the file is
+ * then opened from disk by the main thread. */
+static void *_read_file_image(const char *file_name, size_t *size)
+{
+	struct stat sb;
+	char *image;
+	size_t offset = 0;
+	ssize_t len;
+	int fd;
+
+	if ((fd = open(file_name, O_RDONLY)) < 0)
+		return NULL;
+	if ((fstat(fd, &sb) < 0) || (sb.st_size <= 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	image = xmalloc_nz(sb.st_size);
+	while (offset < sb.st_size) {
+		len = read(fd, image + offset, sb.st_size - offset);
+		if (len < 0 && (errno == EINTR))
+			continue;
+		if (len <= 0) {
+			debug("Failed to read %s: %m", file_name);
+			xfree(image);
+			close(fd);
+			return NULL;
+		}
+		offset += len;
+	}
+	close(fd);
+
+	*size = offset;
+	return image;
+}
+
+static void *_merge_read_thread(void *arg)
+{
+	merge_read_t *merge = (merge_read_t *)arg;
+	sh5util_file_t *sh5util_file;
+	char *path;
+	void *image;
+	size_t size = 0;
+	int i;
+
+	slurm_mutex_lock(&merge->mutex);
+	while (!merge->stop && (merge->next_read < merge->nfiles)) {
+		i = merge->next_read++;
+		/* Do not read too far ahead, but never hold back the file
+		 * the main thread is waiting for */
+		while (!merge->stop &&
+		       (merge->buffered >= MAX_MERGE_BUFFERED) &&
+		       (i > merge->merged))
+			slurm_cond_wait(&merge->cond, &merge->mutex);
+		if (merge->stop)
+			break;
+		slurm_mutex_unlock(&merge->mutex);
+
+		sh5util_file = merge->files[i];
+		path = xstrdup_printf("%s/%s", merge->step_dir,
+				      sh5util_file->file_name);
+		image = _read_file_image(path, &size);
+		xfree(path);
+
+		slurm_mutex_lock(&merge->mutex);
+		if (image) {
+			sh5util_file->image = image;
+			sh5util_file->image_size = size;
+			merge->buffered += size;
+		}
+		sh5util_file->read_done = true;
+		slurm_cond_broadcast(&merge->cond);
+	}
+	slurm_mutex_unlock(&merge->mutex);
+
+	return NULL;
+}
+
+/* Release the image of a merged file, merge->mutex must be locked */
+static void _merge_image_free(merge_read_t *merge, sh5util_file_t *sh5util_file)
+{
+	merge->buffered -= sh5util_file->image_size;
+	sh5util_file->image_size = 0;
+	xfree(sh5util_file->image);
+}
+
 /* Copy the group "/{NodeName}" of the hdf5 file file_name into the location
- * jgid_nodes */
+ * jgid_nodes. The file is opened from its image in memory if it has been
+ * read by a merge thread. */
 static int _merge_node_step_data(char* file_name, hid_t jgid_nodes,
 				 sh5util_file_t *sh5util_file)
 {
@@ -515,7 +670,14 @@ static int _merge_node_step_data(char* file_name, hid_t jgid_nodes,
 	char *group_name = NULL;
 	int rc = SLURM_SUCCESS;
 
-	fid_nodestep = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+	if (sh5util_file->image)
+		fid_nodestep = H5LTopen_file_image(
+			sh5util_file->image, sh5util_file->image_size,
+			H5LT_FILE_IMAGE_DONT_COPY |
+			H5LT_FILE_IMAGE_DONT_RELEASE);
+	else
+		fid_nodestep = H5Fopen(file_name, H5F_ACC_RDONLY,
+				       H5P_DEFAULT);
 	if (fid_nodestep < 0) {
 		error("Failed to open %s",file_name);
 		return SLURM_ERROR;
@@ -562,11 +724,18 @@ static int _merge_step_files(void)
 	char *stepno = NULL;
 	int node_cnt = -1;
 	int last_step = -1, step_cnt = 0;
-	int job_id;
+	int i, job_id, nthreads = 0;
 	int rc = SLURM_SUCCESS;
 	ListIterator itr;
 	List file_list = NULL;
 	sh5util_file_t *sh5util_file = NULL;
+	merge_read_t merge;
+	pthread_t *read_tids = NULL;
+	pthread_attr_t attr;
+
+	memset(&merge, 0, sizeof(merge_read_t));
+	slurm_mutex_init(&merge.mutex);
+	slurm_cond_init(&merge.cond, NULL);
 
 	step_dir = xstrdup_printf("%s/%s", params.dir, params.user);
 
@@ -648,11 +817,47 @@ static int _merge_step_files(void)
 	/* sort the files so they are in step order */
 	list_sort(file_list, (ListCmpF) _sh5util_sort_files_dec);
 
-	node_cnt = 0;
+	/* start reading the files in the merge order */
+	merge.nfiles = list_count(file_list);
+	merge.files = xmalloc(sizeof(sh5util_file_t *) * merge.nfiles);
+	merge.step_dir = step_dir;
+	i = 0;
 	itr = list_iterator_create(file_list);
-	while ((sh5util_file = list_next(itr))) {
+	while ((sh5util_file = list_next(itr)))
+		merge.files[i++] = sh5util_file;
+	list_iterator_destroy(itr);
+
+	read_tids = xmalloc(sizeof(pthread_t) * params.threads);
+	slurm_attr_init(&attr);
+	for (i = 0; i < MIN(params.threads, merge.nfiles); i++) {
+		if (pthread_create(&read_tids[i], &attr, _merge_read_thread,
+				   &merge)) {
+			error("%s: pthread_create: %m", __func__);
+			break;
+		}
+		nthreads++;
+	}
+	slurm_attr_destroy(&attr);
+	if (!nthreads) {
+		/* open the files from disk */
+		for (i = 0; i < merge.nfiles; i++)
+			merge.files[i]->read_done = true;
+	}
+
+	node_cnt = 0;
+	for (i = 0; i < merge.nfiles; i++) {
+		sh5util_file = merge.files[i];
 		//info("got file of %s", sh5util_file->file_name);
 
+		slurm_mutex_lock(&merge.mutex);
+		if (i > 0)	/* done with the previous file */
+			_merge_image_free(&merge, merge.files[i - 1]);
+		merge.merged = i;
+		slurm_cond_broadcast(&merge.cond);
+		while (!sh5util_file->read_done)
+			slurm_cond_wait(&merge.cond, &merge.mutex);
+		slurm_mutex_unlock(&merge.mutex);
+
 		/* make a group for each step */
 		if (sh5util_file->step_id != last_step) {
 			last_step = sh5util_file->step_id;
@@ -706,14 +911,25 @@ static int _merge_step_files(void)
 		rc = _merge_node_step_data(
 			step_path, jgid_nodes, sh5util_file);
 		xfree(step_path);
-
 	}
-	list_iterator_destroy(itr);
 
 	put_int_attribute(fid_job, ATTR_NSTEPS, step_cnt);
 
 
 endit:
+	if (nthreads) {
+		/* stop the threads still reading, if we stopped early */
+		slurm_mutex_lock(&merge.mutex);
+		merge.stop = true;
+		slurm_cond_broadcast(&merge.cond);
+		slurm_mutex_unlock(&merge.mutex);
+		for (i = 0; i < nthreads; i++)
+			pthread_join(read_tids[i], NULL);
+	}
+	xfree(read_tids);
+	xfree(merge.files);
+	slurm_mutex_destroy(&merge.mutex);
+	slurm_cond_destroy(&merge.cond);
 	FREE_NULL_LIST(file_list);
 	xfree(file_name);
 	xfree(step_dir);
@@ -749,6 +965,115 @@ static void _table_path(table_t *t, char *path)
 	         t->step, t->node, t->group, t->name);
 }
 
+/* Return the index of the first record in [lo, hi) taken at or after when */
+static hsize_t _reader_search(table_reader_t *r, size_t time_offset,
+			      time_t when, hsize_t lo, hsize_t hi)
+{
+	hsize_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (H5PTread_packets(r->table_id, mid, 1, r->buf) < 0)
+			break;
+		if (*(uint64_t *)(r->buf + time_offset) < (uint64_t)when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Open a table to read its records taken between --starttime and --endtime.
+ * Samples are appended in time order so the bounds of the window are found
+ * with a binary search on EpochTime, without reading the whole table.
+ */
+static int _reader_open(table_reader_t *r, hid_t fid_job, const char *path)
+{
+	hid_t did, tid, n_tid;
+	hsize_t nrecords;
+	size_t time_offset = 0;
+	int idx;
+
+	memset(r, 0, sizeof(table_reader_t));
+	r->table_id = -1;
+
+	if ((did = H5Dopen(fid_job, path, H5P_DEFAULT)) < 0) {
+		error("Failed to open the table %s", path);
+		return SLURM_ERROR;
+	}
+	tid = H5Dget_type(did);
+	n_tid = H5Tget_native_type(tid, H5T_DIR_DEFAULT);
+	r->rec_size = H5Tget_size(n_tid);
+	if ((idx = H5Tget_member_index(n_tid, "EpochTime")) >= 0)
+		time_offset = H5Tget_member_offset(n_tid, (unsigned)idx);
+	H5Tclose(n_tid);
+	H5Tclose(tid);
+	H5Dclose(did);
+
+	if (!r->rec_size) {
+		error("Failed to get the record size of %s", path);
+		return SLURM_ERROR;
+	}
+	if ((idx < 0) && (params.start_time || params.end_time)) {
+		error("Table %s has no EpochTime field", path);
+		return SLURM_ERROR;
+	}
+	if ((r->table_id = H5PTopen(fid_job, path)) < 0) {
+		error("Failed to open the series %s", path);
+		return SLURM_ERROR;
+	}
+
+	r->block_cnt = MAX(1, READ_BLOCK_SIZE / r->rec_size);
+	r->buf = xmalloc(r->block_cnt * r->rec_size);
+
+	H5PTget_num_packets(r->table_id, &nrecords);
+	r->end = nrecords;
+	if (params.start_time)
+		r->next = _reader_search(r, time_offset, params.start_time,
+					 0, r->end);
+	if (params.end_time)
+		r->end = _reader_search(r, time_offset, params.end_time + 1,
+					r->next, r->end);
+
+	return SLURM_SUCCESS;
+}
+
+/* Return the next record of the table, or NULL when all have been read */
+static uint8_t *_reader_next(table_reader_t *r)
+{
+	if (r->buf_pos == r->buf_cnt) {
+		if (r->next >= r->end)
+			return NULL;
+		r->buf_cnt = MIN(r->block_cnt, r->end - r->next);
+		if (H5PTread_packets(r->table_id, r->next, r->buf_cnt,
+				     r->buf) < 0) {
+			error("Failed to read records of a series");
+			r->buf_cnt = r->buf_pos = 0;
+			r->next = r->end;
+			return NULL;
+		}
+		r->next += r->buf_cnt;
+		r->buf_pos = 0;
+	}
+
+	return r->buf + (r->buf_pos++ * r->rec_size);
+}
+
+static bool _reader_done(table_reader_t *r)
+{
+	return ((r->buf_pos == r->buf_cnt) && (r->next >= r->end));
+}
+
+static void _reader_close(table_reader_t *r)
+{
+	if (r->table_id >= 0)
+		H5PTclose(r->table_id);
+	r->table_id = -1;
+	xfree(r->buf);
+}
+
 static herr_t _collect_tables_group(hid_t g_id, const char *name,
                                     const H5L_info_t *link_info, void *op_data)
 {
@@ -881,33 +1206,31 @@ static int _tables_list(hid_t fid_job, List tables)
  * @param nb_fields Number of fields in the dataset
  * @param offsets   Offset of each field
  * @param types     Type of each field
- * @param type_size Size of of a record in the dataset
- * @param table_id  ID of the table to extract from
- * @param state     State of the current extraction
- * @param node_name Name of the node containing this table
+ * @param reader    Reader of the table to extract from
+ * @param table     Table to extract from
  * @param output    output file
  */
 static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
-                            hsize_t type_size, hid_t table_id,
+                            table_reader_t *reader,
                             table_t *table, FILE *output)
 {
-	hsize_t nrecords;
+	hsize_t nrecords = 0;
 	size_t i, j;
 	uint8_t *data;
+	uint64_t elapsed = 0;
 
 	/* allocate space for aggregate values: 4 values (min, max,
 	 * sum, avg) on 8 bytes (uint64_t/double) for each field */
 	uint64_t *agg_i;
 	double *agg_d;
 
-	data = xmalloc(type_size);
 	agg_i = xmalloc(nb_fields * 4 * sizeof(uint64_t));
 	agg_d = (double *)agg_i;
-	H5PTget_num_packets(table_id, &nrecords);
 
 	/* compute min/max/sum */
-	for (i = 0; i < nrecords; ++i) {
-		H5PTget_next(table_id, 1, data);
+	for (i = 0; (data = _reader_next(reader)); ++i) {
+		nrecords++;
+		elapsed = *(uint64_t *)data;
 		for (j = 0; j < nb_fields; ++j) {
 			if (H5Tequal(types[j], H5T_NATIVE_UINT64)) {
 				uint64_t v = *(uint64_t *)(data + offsets[j]);
@@ -947,7 +1270,7 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 		fprintf(output, ",%s", table->name);
 
 	/* elapsed time (first field in the last record) */
-	fprintf(output, ",%"PRIu64, *(uint64_t *)data);
+	fprintf(output, ",%"PRIu64, elapsed);
 
 	/* aggregate values */
 	for (j = 0; j < nb_fields; ++j) {
@@ -967,7 +1290,6 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 	}
 	fputc('\n', output);
 	xfree(agg_i);
-	xfree(data);
 }
 
 /**
@@ -991,12 +1313,14 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 	hid_t n_tid = -1;  /* native type ID */
 	hid_t m_tid = -1;  /* member type ID */
 	hid_t nm_tid = -1; /* native member ID */
-	hid_t table_id = -1;
+	table_reader_t reader;
+	uint8_t *data;
 	hsize_t nmembers;
-	hsize_t type_size;
-	hsize_t nrecords;
 	char *m_name;
 
+	reader.table_id = -1;
+	reader.buf = NULL;
+
 	_table_path(table, path);
 	debug("Extracting from table %s", path);
 
@@ -1012,8 +1336,6 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 	if ((n_tid = H5Tget_native_type(tid, H5T_DIR_DEFAULT)) < 0)
 		goto error;
 
-	type_size = H5Tget_size(n_tid);
-
 	/* get the number of members */
 	if ((nmembers = H5Tget_nmembers(tid)) == 0)
 		goto error;
@@ -1046,23 +1368,19 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 	H5Tclose(tid);
 	H5Dclose(did);
 
-	/* open the table */
-	if ((table_id = H5PTopen(fid_job, path)) < 0) {
-		error("Failed to open the series %s", params.input);
+	/* open the table, the records are read by blocks so that the
+	 * memory used does not depend on the size of the table */
+	if (_reader_open(&reader, fid_job, path) != SLURM_SUCCESS)
 		goto error;
-	}
 
 	if (level_total) {
-		_extract_totals(nb_fields, offsets, types, type_size,
-		                table_id, table, output);
+		_extract_totals(nb_fields, offsets, types, &reader,
+		                table, output);
 	} else {
 		/* Timeseries level */
-		H5PTget_num_packets(table_id, &nrecords);
-		uint8_t data[type_size];
 
 		/* print the expected fields of all the records */
-		for (i = 0; i < nrecords; ++i) {
-			H5PTget_next(table_id, 1, data);
+		while ((data = _reader_next(&reader))) {
 			fprintf(output, "%s,%s", table->step, table->node);
 			if (group_mode)
 				fprintf(output, ",%s", table->name);
@@ -1084,7 +1402,7 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 		}
 	}
 
-	H5PTclose(table_id);
+	_reader_close(&reader);
 
 	return SLURM_SUCCESS;
 
@@ -1094,7 +1412,7 @@ error:
 	if (n_tid >= 0) H5Dclose(n_tid);
 	if (tid >= 0) H5Dclose(tid);
 	if (did >= 0) H5PTclose(did);
-	if (table_id >= 0) H5PTclose(table_id);
+	_reader_close(&reader);
 	return SLURM_ERROR;
 }
 
@@ -1202,16 +1520,13 @@ error:
  * tables.
  *
  * @param nb_tables  Number of table to analyze
- * @param tables     IDs of all the tables to analyze
- * @param nb_records Number of records in each table
- * @param buf_size   Size of the largest record of the tables
+ * @param readers    Readers of all the tables to analyze
  * @param offsets    Offset of the item analyzed in each table
  * @param names      Names of the tables
  * @param nodes      Name of the node for each table
  * @param step_name  Name of the current step
  */
-static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
-				hsize_t *nb_records, size_t buf_size,
+static void _item_analysis_uint(hsize_t nb_tables, table_reader_t *readers,
 				size_t *offsets,
 				const char *names[], const char *nodes[],
 				const char *step_name)
@@ -1229,7 +1544,7 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
 	uint8_t  *buffer;
 	uint64_t et, et_max = 0;
 
-	buffer = xmalloc(buf_size);
+	memset(values, 0, sizeof(values));
 	for (;;) {
 		min_val = UINT64_MAX;
 		max_val = 0;
@@ -1238,12 +1553,10 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
 
 		/* compute aggregate values */
 		for (i = 0; i < nb_tables; ++i) {
-			if (nb_records[i] == 0)
+			/* read the value of the item in the series i */
+			if (!(buffer = _reader_next(&readers[i])))
 				continue;
-			--nb_records[i];
 			++nb_series_in_smp;
-			/* read the value of the item in the series i */
-			H5PTget_next(tables[i], 1, (void *)buffer);
 			v = *(uint64_t *)(buffer + offsets[i]);
 			values[i] = v;
 			/* compute the sum, min and max */
@@ -1294,12 +1607,11 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
 		for (i = 0; i < nb_tables; ++i) {
 			fprintf(output_file, ",%"PRIu64, values[i]);
 			/* and set their values to zero if no more values */
-			if (values[i] && nb_records[i] == 0)
+			if (values[i] && _reader_done(&readers[i]))
 				values[i] = 0;
 		}
 		fputc('\n', output_file);
 	}
-	xfree(buffer);
 
 	printf("    Step %s Maximum accumulated %s Value (%"PRIu64") occurred "
 	       "at Time=%"PRIu64", Ave Node %lf\n",
@@ -1311,8 +1623,7 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
  * tables.
  * See _item_analysis_uint for parameters description.
  */
-static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
-				  hsize_t *nb_records, size_t buf_size,
+static void _item_analysis_double(hsize_t nb_tables, table_reader_t *readers,
 				  size_t *offsets,
 				  const char *names[], const char *nodes[],
 				  const char *step_name)
@@ -1330,7 +1641,7 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 	uint8_t  *buffer;
 	uint64_t et, et_max = 0;
 
-	buffer = xmalloc(buf_size);
+	memset(values, 0, sizeof(values));
 	for (;;) {
 		min_val = UINT64_MAX;
 		max_val = 0;
@@ -1339,12 +1650,10 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 
 		/* compute aggregate values */
 		for (i = 0; i < nb_tables; ++i) {
-			if (nb_records[i] == 0)
+			/* read the value of the item in the series i */
+			if (!(buffer = _reader_next(&readers[i])))
 				continue;
-			--nb_records[i];
 			++nb_series_in_smp;
-			/* read the value of the item in the series i */
-			H5PTget_next(tables[i], 1, (void *)buffer);
 			v = *(double *)(buffer + offsets[i]);
 			values[i] = v;
 			/* compute the sum, min and max */
@@ -1358,7 +1667,7 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 				max_idx = i;
 			}
 			/* Elapsed time is always at offset 0 */
-			et = *(double *)buffer;
+			et = *(uint64_t *)buffer;
 		}
 
 		if (nb_series_in_smp == 0) /* stop if no more samples */
@@ -1383,12 +1692,11 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 		for (i = 0; i < nb_tables; ++i) {
 			fprintf(output_file, ",%lf", values[i]);
 			/* and set their values to zero if no more values */
-			if (values[i] && nb_records[i] == 0)
+			if (values[i] && _reader_done(&readers[i]))
 				values[i] = 0;
 		}
 		fputc('\n', output_file);
 	}
-	xfree(buffer);
 
 	printf("    Step %s Maximum accumulated %s Value (%lf) occurred "
 	       "at Time=%"PRIu64", Ave Node %lf\n",
@@ -1404,7 +1712,6 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 	char path[MAX_PROFILE_PATH];
 
 	size_t i, j;
-	size_t buf_size = 0;
 	char *m_name;
 
 	hid_t fid_job = *((hid_t *)op_data);
@@ -1441,15 +1748,14 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 	}
 
 	size_t nb_tables = list_count(tables);
-	hid_t tables_id[nb_tables];
+	table_reader_t readers[nb_tables];
 	size_t offsets[nb_tables];
-	hsize_t nb_records[nb_tables];
 	const char *names[nb_tables];
 	const char *nodes[nb_tables];
 
 	for (i = 0; i < nb_tables; ++i) {
-		tables_id[i] = -1;
-		nb_records[i] = 0;
+		readers[i].table_id = -1;
+		readers[i].buf = NULL;
 	}
 
 	it = list_iterator_create(tables);
@@ -1471,8 +1777,6 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 		if ((n_tid = H5Tget_native_type(tid, H5T_DIR_DEFAULT)) < 0)
 			goto error;
 
-		buf_size = MAX(buf_size, H5Tget_size(n_tid));
-
 		/* get the number of members */
 		if ((nmembers = H5Tget_nmembers(tid)) == 0)
 			goto error;
@@ -1503,8 +1807,8 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 			goto error;
 
 		if (item_type == -1) {
-			item_type = nm_tid;
-		} else if (nm_tid != item_type) {
+			item_type = H5Tcopy(nm_tid);
+		} else if (H5Tequal(nm_tid, item_type) <= 0) {
 			error("Malformed file: fields with the same name in "
 			      "tables with the same name must have the same "
 			      "types");
@@ -1517,13 +1821,11 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 		H5Tclose(n_tid);
 		H5Tclose(tid);
 		H5Dclose(did);
+		did = tid = n_tid = m_tid = nm_tid = -1;
 
 		/* open the table */
-		if ((tables_id[i] = H5PTopen(fid_job, path)) < 0) {
-			error("Failed to open the series %s", path);
+		if (_reader_open(&readers[i], fid_job, path) != SLURM_SUCCESS)
 			goto error;
-		}
-		H5PTget_num_packets(tables_id[i], &nb_records[i]);
 
 		++i;
 	}
@@ -1545,11 +1847,10 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 	list_iterator_destroy(it);
 
 	if (H5Tequal(item_type, H5T_NATIVE_UINT64)) {
-		_item_analysis_uint(nb_tables, tables_id, nb_records, buf_size,
+		_item_analysis_uint(nb_tables, readers,
 		                    offsets, names, nodes, step_name);
 	} else if (H5Tequal(item_type, H5T_NATIVE_DOUBLE)) {
-		_item_analysis_double(nb_tables, tables_id,
-				      nb_records, buf_size,
+		_item_analysis_double(nb_tables, readers,
 		                      offsets, names, nodes, step_name);
 	} else {
 		error("Unknown type");
@@ -1558,8 +1859,9 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 
 	/* clean up */
 	for (i = 0; i < nb_tables; ++i) {
-		H5PTclose(tables_id[i]);
+		_reader_close(&readers[i]);
 	}
+	H5Tclose(item_type);
 	FREE_NULL_LIST(tables);
 
 	return 0;
@@ -1570,11 +1872,10 @@ error:
 	if (n_tid >= 0) H5Tclose(n_tid);
 	if (m_tid >= 0) H5Tclose(m_tid);
 	if (nm_tid >= 0) H5Tclose(nm_tid);
+	if (item_type >= 0) H5Tclose(item_type);
 	FREE_NULL_LIST(tables);
-	for (i = 0; i < nb_tables; ++i) {
-		if (tables_id[i] >= 0)
-			H5PTclose(tables_id[i]);
-	}
+	for (i = 0; i < nb_tables; ++i)
+		_reader_close(&readers[i]);
 	return -1;
 }
 
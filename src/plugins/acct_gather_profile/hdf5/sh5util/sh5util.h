@@ -50,6 +50,7 @@ typedef enum {
 
 typedef struct {
 	char *dir;
+	time_t end_time;
 	int help;
 	char *input;
 	int job_id;
@@ -60,7 +61,9 @@ typedef struct {
 	char *output;
 	char *series;
 	char *data_item;
+	time_t start_time;
 	int step_id;
+	int threads;
 	char *user;
 	int verbose;
 } sh5util_opts_t;
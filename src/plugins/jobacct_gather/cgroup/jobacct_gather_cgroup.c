@@ -54,6 +54,8 @@
 
 #define _DEBUG 0
 
+#define NSEC_IN_SEC 1000000000
+
 /* These are defined here so when we link with something other than
  * the slurmd we will have these symbols defined.  They will get
  * overwritten when linking with the slurmd.
@@ -99,11 +101,50 @@ const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 /* Other useful declarations */
 static slurm_cgroup_conf_t slurm_cgroup_conf;
 
+/*
+ * JobAcctGatherParams=CgroupOnly: take the task usage from the task cgroups
+ * only, without looking at the processes in /proc.
+ */
+static bool cgroup_only = false;
+static bool blkio_enabled = false;
+static long hertz = 0;
+
+/* Fill rss and pages of prec from the memory.stat of a memory cgroup */
+static int _get_memory_stat(xcgroup_t *cg, jag_prec_t *prec)
+{
+	unsigned long total_rss, total_pgpgin;
+	char *memory_stat = NULL, *ptr;
+	size_t memory_stat_size = 0;
+
+	xcgroup_get_param(cg, "memory.stat", &memory_stat, &memory_stat_size);
+	if (memory_stat == NULL)
+		return SLURM_ERROR;
+
+	/* This number represents the amount of "dirty" private memory
+	   used by the cgroup.  From our experience this is slightly
+	   different than what proc presents, but is probably more
+	   accurate on what the user is actually using.
+	*/
+	if ((ptr = strstr(memory_stat, "total_rss")) &&
+	    (sscanf(ptr, "total_rss %lu", &total_rss) == 1))
+		prec->rss = total_rss / 1024; /* convert from bytes to KB */
+
+	/* total_pgmajfault is what is reported in proc, so we use
+	 * the same thing here. */
+	if ((ptr = strstr(memory_stat, "total_pgmajfault")) &&
+	    (sscanf(ptr, "total_pgmajfault %lu", &total_pgpgin) == 1))
+		prec->pages = total_pgpgin;
+
+	xfree(memory_stat);
+
+	return SLURM_SUCCESS;
+}
+
 static void _prec_extra(jag_prec_t *prec)
 {
-	unsigned long utime, stime, total_rss, total_pgpgin;
-	char *cpu_time = NULL, *memory_stat = NULL, *ptr;
-	size_t cpu_time_size = 0, memory_stat_size = 0;
+	unsigned long utime, stime;
+	char *cpu_time = NULL;
+	size_t cpu_time_size = 0;
 
 	//DEF_TIMERS;
 	//START_TIMER;
@@ -120,31 +161,12 @@ static void _prec_extra(jag_prec_t *prec)
 		prec->ssec = stime;
 	}
 
-	xcgroup_get_param(&task_memory_cg, "memory.stat",
-			  &memory_stat, &memory_stat_size);
-	if (memory_stat == NULL) {
+	if (_get_memory_stat(&task_memory_cg, prec) != SLURM_SUCCESS) {
 		debug2("%s: failed to collect memory.stat  pid %d ppid %d",
 		       __func__, prec->pid, prec->ppid);
-	} else {
-		/* This number represents the amount of "dirty" private memory
-		   used by the cgroup.  From our experience this is slightly
-		   different than what proc presents, but is probably more
-		   accurate on what the user is actually using.
-		*/
-		ptr = strstr(memory_stat, "total_rss");
-		sscanf(ptr, "total_rss %lu", &total_rss);
-		prec->rss = total_rss / 1024; /* convert from bytes to KB */
-
-		/* total_pgmajfault is what is reported in proc, so we use
-		 * the same thing here. */
-		if ((ptr = strstr(memory_stat, "total_pgmajfault"))) {
-			sscanf(ptr, "total_pgmajfault %lu", &total_pgpgin);
-			prec->pages = total_pgpgin;
-		}
 	}
 
 	xfree(cpu_time);
-	xfree(memory_stat);
 
 	/* FIXME: Enable when kernel support ready.
 	 *
@@ -183,6 +205,129 @@ static void _prec_extra(jag_prec_t *prec)
 
 }
 
+/*
+ * Sum the "Read" and "Write" bytes of all devices in
+ * blkio.throttle.io_service_bytes. These are counts of bytes read and
+ * written for physical disk I/Os only, not I/Os satisfied from cache.
+ */
+static void _get_blkio_bytes(xcgroup_t *cg, jag_prec_t *prec)
+{
+	char *blkio_bytes = NULL, *line, *save_ptr = NULL;
+	size_t blkio_bytes_size = 0;
+	uint32_t dev_major, dev_minor;
+	uint64_t bytes, tot_read = 0, tot_write = 0;
+	char op[16];
+
+	xcgroup_get_param(cg, "blkio.throttle.io_service_bytes",
+			  &blkio_bytes, &blkio_bytes_size);
+	if (!blkio_bytes)
+		return;
+
+	line = strtok_r(blkio_bytes, "\n", &save_ptr);
+	while (line) {
+		if ((sscanf(line, "%u:%u %15s %"PRIu64, &dev_major,
+			    &dev_minor, op, &bytes) == 4) &&
+		    /* skip experimental device codes */
+		    ((dev_major < 240) || (dev_major > 254))) {
+			if (!xstrcmp(op, "Read"))
+				tot_read += bytes;
+			else if (!xstrcmp(op, "Write"))
+				tot_write += bytes;
+		}
+		line = strtok_r(NULL, "\n", &save_ptr);
+	}
+	xfree(blkio_bytes);
+
+	prec->disk_read = (double)tot_read / (double)1048576;
+	prec->disk_write = (double)tot_write / (double)1048576;
+}
+
+/*
+ * Build the record of a task from its task cgroups. The counters include
+ * all the processes that ever ran in the task, even those which started
+ * and ended between two polls.
+ */
+static int _get_task_cgroup_data(uint32_t taskid, jag_prec_t *prec)
+{
+	xcgroup_t cg;
+	uint64_t usage_ns, max_usage, ticks;
+	unsigned long utime = 0, stime = 0;
+	char *cpu_time = NULL;
+	size_t cpu_time_size = 0;
+
+	if (jobacct_gather_cgroup_cpuacct_task_load(taskid, &cg) !=
+	    SLURM_SUCCESS)
+		return SLURM_ERROR;
+	if (xcgroup_get_uint64_param(&cg, "cpuacct.usage", &usage_ns) !=
+	    XCGROUP_SUCCESS) {
+		xcgroup_destroy(&cg);
+		return SLURM_ERROR;
+	}
+	/*
+	 * cpuacct.usage is in nanoseconds while the record holds clock ticks,
+	 * split it in user and system time using cpuacct.stat.
+	 */
+	ticks = usage_ns / (NSEC_IN_SEC / hertz);
+	xcgroup_get_param(&cg, "cpuacct.stat", &cpu_time, &cpu_time_size);
+	if (cpu_time &&
+	    (sscanf(cpu_time, "%*s %lu %*s %lu", &utime, &stime) == 2) &&
+	    (utime + stime)) {
+		prec->usec = (ticks * utime) / (utime + stime);
+		prec->ssec = ticks - prec->usec;
+	} else
+		prec->usec = ticks;
+	xfree(cpu_time);
+	xcgroup_destroy(&cg);
+
+	if (jobacct_gather_cgroup_memory_task_load(taskid, &cg) ==
+	    SLURM_SUCCESS) {
+		_get_memory_stat(&cg, prec);
+		if (xcgroup_get_uint64_param(&cg, "memory.max_usage_in_bytes",
+					     &max_usage) == XCGROUP_SUCCESS)
+			prec->max_rss = max_usage / 1024; /* bytes to KB */
+		xcgroup_destroy(&cg);
+	}
+
+	if (blkio_enabled &&
+	    (jobacct_gather_cgroup_blkio_task_load(taskid, &cg) ==
+	     SLURM_SUCCESS)) {
+		_get_blkio_bytes(&cg, prec);
+		xcgroup_destroy(&cg);
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* get_precs callback of the CgroupOnly mode, one record per task */
+static List _get_cgroup_precs(List task_list, bool pgid_plugin,
+			      uint64_t cont_id, jag_callbacks_t *callbacks)
+{
+	List prec_list = list_create(destroy_jag_prec);
+	struct jobacctinfo *jobacct;
+	ListIterator itr;
+	jag_prec_t *prec;
+
+	if (!task_list)
+		return prec_list;
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		prec = xmalloc(sizeof(jag_prec_t));
+		prec->pid = jobacct->pid;
+		if (_get_task_cgroup_data(jobacct->id.taskid, prec) !=
+		    SLURM_SUCCESS) {
+			debug2("%s: no cgroup data for task %u pid %d",
+			       __func__, jobacct->id.taskid, jobacct->pid);
+			xfree(prec);
+			continue;
+		}
+		list_append(prec_list, prec);
+	}
+	list_iterator_destroy(itr);
+
+	return prec_list;
+}
+
 static bool _run_in_daemon(void)
 {
 	static bool set = false;
@@ -206,8 +351,19 @@ extern int init (void)
 	   isn't needed.
 	*/
 	if (_run_in_daemon()) {
+		char *acct_params;
+
 		jag_common_init(0);
 
+		acct_params = slurm_get_jobacct_gather_params();
+		if (acct_params && strstr(acct_params, "CgroupOnly"))
+			cgroup_only = true;
+		xfree(acct_params);
+
+		hertz = sysconf(_SC_CLK_TCK);
+		if (hertz < 1)
+			hertz = 100;	/* default on many systems */
+
 		/* read cgroup configuration */
 		if (read_slurm_cgroup_conf(&slurm_cgroup_conf))
 			return SLURM_ERROR;
@@ -234,16 +390,18 @@ extern int init (void)
 			return SLURM_ERROR;
 		}
 
-		/* FIXME: Enable when kernel support ready.
-		 *
-		 * Enable blkio subsystem.
+		/*
+		 * enable blkio cgroup subsystem, only used for CgroupOnly.
+		 * Disk counters are not gathered if it is not available.
 		 */
-		/* if (jobacct_gather_cgroup_blkio_init(&slurm_cgroup_conf) */
-		/*     != SLURM_SUCCESS) { */
-		/* 	xcpuinfo_fini(); */
-		/* 	free_slurm_cgroup_conf(&slurm_cgroup_conf); */
-		/* 	return SLURM_ERROR; */
-		/* } */
+		if (cgroup_only) {
+			if (jobacct_gather_cgroup_blkio_init(&slurm_cgroup_conf)
+			    == SLURM_SUCCESS)
+				blkio_enabled = true;
+			else
+				info("%s: blkio cgroup not available, no disk "
+				     "usage will be gathered", plugin_type);
+		}
 	}
 
 	debug("%s loaded", plugin_name);
@@ -255,7 +413,8 @@ extern int fini (void)
 	if (_run_in_daemon()) {
 		jobacct_gather_cgroup_cpuacct_fini(&slurm_cgroup_conf);
 		jobacct_gather_cgroup_memory_fini(&slurm_cgroup_conf);
-		/* jobacct_gather_cgroup_blkio_fini(&slurm_cgroup_conf); */
+		if (blkio_enabled)
+			jobacct_gather_cgroup_blkio_fini(&slurm_cgroup_conf);
 		acct_gather_energy_fini();
 
 		/* unload configuration */
@@ -280,6 +439,10 @@ extern int fini (void)
  *    Any file with a name of the form "/proc/[0-9]+/stat"
  *    is a Linux-style stat entry. We disregard the data if they look
  *    wrong.
+ *
+ * With JobAcctGatherParams=CgroupOnly, /proc is not read and each task is
+ * accounted from its task cgroups, so a poll reads a few files per task
+ * whatever the number of processes.
  */
 extern void jobacct_gather_p_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id, bool profile)
@@ -290,7 +453,10 @@ extern void jobacct_gather_p_poll_data(
 	if (first) {
 		memset(&callbacks, 0, sizeof(jag_callbacks_t));
 		first = 0;
-		callbacks.prec_extra = _prec_extra;
+		if (cgroup_only)
+			callbacks.get_precs = _get_cgroup_precs;
+		else
+			callbacks.prec_extra = _prec_extra;
 	}
 
 	jag_common_poll_data(task_list, pgid_plugin, cont_id, &callbacks,
@@ -316,9 +482,10 @@ extern int jobacct_gather_p_add_task(pid_t pid, jobacct_id_t *jobacct_id)
 	    SLURM_SUCCESS)
 		return SLURM_ERROR;
 
-	/* if (jobacct_gather_cgroup_blkio_attach_task(pid, jobacct_id) != */
-	/*     SLURM_SUCCESS) */
-	/* 	return SLURM_ERROR; */
+	if (blkio_enabled &&
+	    (jobacct_gather_cgroup_blkio_attach_task(pid, jobacct_id) !=
+	     SLURM_SUCCESS))
+		return SLURM_ERROR;
 
 	return SLURM_SUCCESS;
 }
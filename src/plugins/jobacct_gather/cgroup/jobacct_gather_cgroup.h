@@ -64,15 +64,32 @@ extern int jobacct_gather_cgroup_memory_fini(
 extern int jobacct_gather_cgroup_memory_attach_task(
 	pid_t pid, jobacct_id_t *jobacct_id);
 
-/* FIXME: Enable when kernel support ready. */
- /* extern xcgroup_t task_blkio_cg; */
-/* extern int jobacct_gather_cgroup_blkio_init( */
-/* 	slurm_cgroup_conf_t *slurm_cgroup_conf); */
+/*
+ * The blkio subsystem is only used when JobAcctGatherParams=CgroupOnly.
+ */
+extern xcgroup_t task_blkio_cg;
 
-/* extern int jobacct_gather_cgroup_blkio_fini( */
-/* 	slurm_cgroup_conf_t *slurm_cgroup_conf); */
+extern int jobacct_gather_cgroup_blkio_init(
+	slurm_cgroup_conf_t *slurm_cgroup_conf);
+
+extern int jobacct_gather_cgroup_blkio_fini(
+	slurm_cgroup_conf_t *slurm_cgroup_conf);
+
+extern int jobacct_gather_cgroup_blkio_attach_task(
+	pid_t pid, jobacct_id_t *jobacct_id);
+
+/*
+ * Load the cgroup of a task of the current step in a given subsystem.
+ * Returns SLURM_ERROR if the task cgroup does not exist (yet).
+ * Release cg with xcgroup_destroy() on success.
+ */
+extern int jobacct_gather_cgroup_cpuacct_task_load(uint32_t taskid,
+						   xcgroup_t *cg);
+
+extern int jobacct_gather_cgroup_memory_task_load(uint32_t taskid,
+						  xcgroup_t *cg);
 
-/* extern int jobacct_gather_cgroup_blkio_attach_task( */
-/* 	pid_t pid, jobacct_id_t *jobacct_id); */
+extern int jobacct_gather_cgroup_blkio_task_load(uint32_t taskid,
+						 xcgroup_t *cg);
 
 extern char* jobacct_cgroup_create_slurm_cg (xcgroup_ns_t* ns);
@@ -165,6 +165,24 @@ jobacct_gather_cgroup_cpuacct_fini(slurm_cgroup_conf_t *slurm_cgroup_conf)
 	return SLURM_SUCCESS;
 }
 
+extern int
+jobacct_gather_cgroup_cpuacct_task_load(uint32_t taskid, xcgroup_t *cg)
+{
+	char buf[PATH_MAX];
+
+	if (jobstep_cgroup_path[0] == '\0')
+		return SLURM_ERROR;
+
+	if (snprintf(buf, PATH_MAX, "%s/task_%u",
+		     jobstep_cgroup_path, taskid) >= PATH_MAX)
+		return SLURM_ERROR;
+
+	if (xcgroup_load(&cpuacct_ns, cg, buf) != XCGROUP_SUCCESS)
+		return SLURM_ERROR;
+
+	return SLURM_SUCCESS;
+}
+
 extern int
 jobacct_gather_cgroup_cpuacct_attach_task(pid_t pid, jobacct_id_t *jobacct_id)
 {
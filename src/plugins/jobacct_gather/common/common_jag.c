@@ -50,6 +50,7 @@
 #include "src/common/slurm_protocol_defs.h"
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/common/slurm_acct_gather_interconnect.h"
+#include "src/common/timers.h"
 #include "src/slurmd/common/proctrack.h"
 
 #include "common_jag.h"
@@ -61,6 +62,39 @@ static int my_pagesize = 0;
 static DIR  *slash_proc = NULL;
 static int energy_profile = ENERGY_DATA_NODE_ENERGY_UP;
 static uint64_t debug_flags = 0;
+static int no_share_data = -1;
+static int use_pss = -1;
+
+/*
+ * Sampling state of the processes seen in the last poll, sorted by pid.
+ * The /proc/<pid>/stat and io files of up to JAG_PROC_FD_MAX processes stay
+ * open between polls, and the records handed to the plugins are updated in
+ * place, so a steady state poll neither allocates memory nor opens files.
+ */
+#define JAG_PROC_FD_MAX 512
+
+typedef struct {
+	pid_t      pid;
+	bool       lwp;		/* thread, not sampled */
+	int        stat_fd;	/* open /proc/<pid>/stat or -1 */
+	int        io_fd;	/* open /proc/<pid>/io or -1 */
+	jag_prec_t prec;
+} jag_proc_t;
+
+static jag_proc_t *proc_tab = NULL, *proc_tab_next = NULL;
+static int proc_tab_cnt = 0, proc_tab_size = 0;
+static int proc_fd_cnt = 0;
+static pid_t *slash_proc_pids = NULL;
+static int slash_proc_pids_size = 0;
+static char proc_buf[4096];
+
+/* Node energy of the step, and how much of it the tasks were given */
+static acct_gather_energy_t step_energy;
+static uint64_t step_energy_given = 0;
+
+/* Sampling cost, reported at debug level */
+static uint32_t sample_cnt = 0;
+static uint64_t sample_usec = 0, sample_max_usec = 0;
 
 static int _find_prec(void *x, void *key)
 {
@@ -229,41 +263,110 @@ static int _get_sys_interface_freq_line(uint32_t cpu, char *filename,
 	return 0;
 }
 
+/* Parse a decimal number at *p and skip the blanks following it */
+static inline int64_t _scan_num(char **p)
+{
+	char *s = *p;
+	int64_t val = 0;
+	bool neg = false;
+
+	if (*s == '-') {
+		neg = true;
+		s++;
+	}
+	while ((*s >= '0') && (*s <= '9'))
+		val = (val * 10) + (*s++ - '0');
+	while ((*s == ' ') || (*s == '\t') || (*s == '\n'))
+		s++;
+	*p = s;
+
+	return (neg ? -val : val);
+}
+
+/* Read a file in /proc/<pid> into buf, reusing and caching *fd when set */
+static int _read_proc_file(int *fd, pid_t pid, const char *name,
+			   char *buf, int size)
+{
+	char path[64];
+	int len, tmp_fd = -1;
+
+	if (*fd < 0) {
+		snprintf(path, sizeof(path), "/proc/%d/%s", (int) pid, name);
+		if ((tmp_fd = open(path, O_RDONLY)) < 0)
+			return 0;	/* Assume the process went away */
+		/*
+		 * Close the file on exec() of user tasks.
+		 *
+		 * NOTE: If we fork() slurmstepd after the open() above and
+		 * before the fcntl() below, then the user task may have this
+		 * extra file open, which can cause problems for
+		 * checkpoint/restart, but this should be a very rare problem
+		 * in practice.
+		 */
+		fcntl(tmp_fd, F_SETFD, FD_CLOEXEC);
+		if (proc_fd_cnt < JAG_PROC_FD_MAX) {
+			*fd = tmp_fd;
+			tmp_fd = -1;
+			proc_fd_cnt++;
+		}
+	}
+
+	/* Reading /proc files from offset zero returns fresh contents */
+	do {
+		len = pread((tmp_fd >= 0) ? tmp_fd : *fd, buf, size - 1, 0);
+	} while ((len < 0) && (errno == EINTR));
+
+	if (tmp_fd >= 0)
+		close(tmp_fd);
+	if (len <= 0)
+		return 0;
+	buf[len] = '\0';
+
+	return len;
+}
+
+static void _proc_close(jag_proc_t *proc)
+{
+	if (proc->stat_fd >= 0) {
+		close(proc->stat_fd);
+		proc_fd_cnt--;
+	}
+	if (proc->io_fd >= 0) {
+		close(proc->io_fd);
+		proc_fd_cnt--;
+	}
+	proc->stat_fd = proc->io_fd = -1;
+}
+
 static int _is_a_lwp(uint32_t pid) {
 
-	FILE		*status_fp = NULL;
-	char		proc_status_file[256];
+	int		fd = -1;
+	char		*ptr;
 	uint32_t        tgid;
-	int             rc;
 
-	if (snprintf(proc_status_file, 256, "/proc/%d/status",pid) > 256) {
-		debug("jobacct_gather_linux: unable to build proc_status "
-		      "fpath");
+	if (!_read_proc_file(&fd, pid, "status", proc_buf, sizeof(proc_buf))) {
+		debug3("jobacct_gather_linux: unable to read /proc/%u/status",
+		       pid);
 		return -1;
 	}
-	if (!(status_fp = fopen(proc_status_file, "r"))) {
-		debug3("jobacct_gather_linux: unable to open %s",
-		       proc_status_file);
-		return -1;
+	if (fd >= 0) {	/* don't keep it */
+		close(fd);
+		proc_fd_cnt--;
 	}
 
-
-	do {
-		rc = fscanf(status_fp,
-			    "Name:\t%*s\n%*[ \ta-zA-Z0-9:()]\nTgid:\t%d\n",
-			    &tgid);
-	} while (rc < 0 && errno == EINTR);
-	fclose(status_fp);
-
 	/* unable to read /proc/[pid]/status content */
-	if (rc != 1) {
+	if (!(ptr = strstr(proc_buf, "\nTgid:"))) {
 		debug3("jobacct_gather_linux: unable to read requested "
-		       "pattern in %s", proc_status_file);
+		       "pattern in /proc/%u/status", pid);
 		return -1;
 	}
+	ptr += 6;
+	while ((*ptr == ' ') || (*ptr == '\t'))
+		ptr++;
+	tgid = (uint32_t) _scan_num(&ptr);
 
 	/* if tgid differs from pid, this is a LWP (Thread POSIX) */
-	if ((uint32_t) tgid != (uint32_t) pid) {
+	if (tgid != pid) {
 		debug3("jobacct_gather_linux: pid=%d is a lightweight process",
 		       tgid);
 		return 1;
@@ -272,74 +375,64 @@ static int _is_a_lwp(uint32_t pid) {
 
 }
 
-/* _get_process_data_line() - get line of data from /proc/<pid>/stat
+/* _parse_stat() - get data from the contents of /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	buf - NUL terminated file contents
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
  * 		!=0 - data are valid
  *
- * Based upon stat2proc() from the ps command. It can handle arbitrary
- * executable file basenames for `cmd', i.e. those with embedded whitespace or
- * embedded ')'s. Such names confuse %s (see scanf(3)), so the string is split
- * and %39c is used instead. (except for embedded ')' "(%[^)]c)" would work.
+ * The command name can hold blanks and ')', so fields are counted from the
+ * last ')'. Field 3 (state) is the first one after it.
  */
-static int _get_process_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256], *tmp;
-	int num_read, nvals;
-	char cmd[40], state[1];
-	int ppid, pgrp, session, tty_nr, tpgid;
-	long unsigned flags, minflt, cminflt, majflt, cmajflt;
-	long unsigned utime, stime, starttime, vsize;
-	long int cutime, cstime, priority, nice, timeout, itrealvalue, rss;
-	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
-	int exit_signal, last_cpu;
-
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
+static int _parse_stat(char *buf, jag_prec_t *prec)
+{
+	char *ptr;
+	int field;
+	int64_t val;
 
-	tmp = strrchr(sbuf, ')');	/* split into "PID (cmd" and "<rest>" */
-	*tmp = '\0';			/* replace trailing ')' with NUL */
-	/* parse these two strings separately, skipping the leading "(". */
-	nvals = sscanf(sbuf, "%d (%39c", &prec->pid, cmd);
-	if (nvals < 2)
+	if (!(ptr = strrchr(buf, ')')) || (ptr[1] != ' '))
 		return 0;
-
-	nvals = sscanf(tmp + 2,	 /* skip space after ')' too */
-		       "%c %d %d %d %d %d "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %ld %ld %ld %ld "
-		       "%ld %ld %lu %lu %ld "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %d %d ",
-		       state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
-		       &flags, &minflt, &cminflt, &majflt, &cmajflt,
-		       &utime, &stime, &cutime, &cstime, &priority, &nice,
-		       &timeout, &itrealvalue, &starttime, &vsize, &rss,
-		       &f1, &f2, &f3, &f4, &f5 ,&f6, &f7, &f8, &f9, &f10, &f11,
-		       &f12, &f13, &exit_signal, &last_cpu);
+	ptr += 2;
+
+	/* skip the state */
+	while (*ptr && (*ptr != ' '))
+		ptr++;
+	while (*ptr == ' ')
+		ptr++;
+
+	for (field = 4; *ptr && (field <= 39); field++) {
+		val = _scan_num(&ptr);
+		switch (field) {
+		case 4:
+			prec->ppid = val;
+			break;
+		case 12:
+			prec->pages = val;		/* majflt */
+			break;
+		case 14:
+			prec->usec = val;		/* utime */
+			break;
+		case 15:
+			prec->ssec = val;		/* stime */
+			break;
+		case 23:
+			prec->vsize = val / 1024; /* convert from bytes to KB */
+			break;
+		case 24:
+			if (val < 0)
+				return 0;
+			prec->rss = val * my_pagesize;/* convert from pages to KB */
+			break;
+		case 39:
+			prec->last_cpu = val;		/* processor */
+			break;
+		}
+	}
 	/* There are some additional fields, which we do not scan or use */
-	if ((nvals < 37) || (rss < 0))
-		return 0;
 
-	/* If current pid corresponds to a Light Weight Process (Thread POSIX) */
-	/* skip it, we will only account the original process (pid==tgid) */
-	if (_is_a_lwp(prec->pid) > 0)
-		return 0;
-
-	/* Copy the values that slurm records into our data structure */
-	prec->ppid  = ppid;
-	prec->pages = majflt;
-	prec->usec  = utime;
-	prec->ssec  = stime;
-	prec->vsize = vsize / 1024; /* convert from bytes to KB */
-	prec->rss   = rss * my_pagesize;/* convert from pages to KB */
-	prec->last_cpu = last_cpu;
-	return 1;
+	return (field > 39);
 }
 
 /* _get_process_memory_line() - get line of data from /proc/<pid>/statm
@@ -401,9 +494,9 @@ static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
 	return rc;
 }
 
-/* _get_process_io_data_line() - get line of data from /proc/<pid>/io
+/* _parse_io() - get data from the contents of /proc/<pid>/io
  *
- * IN:	in - input file descriptor
+ * IN:	buf - NUL terminated file contents
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -414,24 +507,19 @@ static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
  * wrchar: <# of characters written>
  *   . . .
  */
-static int _get_process_io_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256];
-	char f1[7], f3[7];
-	int num_read, nvals;
+static int _parse_io(char *buf, jag_prec_t *prec)
+{
+	char *ptr;
 	uint64_t rchar, wchar;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
+	if (xstrncmp(buf, "rchar: ", 7))
 		return 0;
-	sbuf[num_read] = '\0';
-
-	nvals = sscanf(sbuf, "%s %"PRIu64" %s %"PRIu64"",
-		       f1, &rchar, f3, &wchar);
-	if (nvals < 4)
-		return 0;
-
-	if (_is_a_lwp(prec->pid) > 0)
+	ptr = buf + 7;
+	rchar = _scan_num(&ptr);
+	if (xstrncmp(ptr, "wchar: ", 7))
 		return 0;
+	ptr += 7;
+	wchar = _scan_num(&ptr);
 
 	/* Copy the values that slurm records into our data structure */
 	prec->disk_read = (double)rchar / (double)1048576;
@@ -440,206 +528,175 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	return 1;
 }
 
-static void _handle_stats(List prec_list, char *proc_stat_file, char *proc_io_file,
-			  char *proc_smaps_file, jag_callbacks_t *callbacks)
+static int _cmp_pid(const void *a, const void *b)
 {
-	static int no_share_data = -1;
-	static int use_pss = -1;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2;
-	jag_prec_t *prec = NULL;
+	pid_t pa = *(pid_t *) a, pb = *(pid_t *) b;
 
-	if (no_share_data == -1) {
-		char *acct_params = slurm_get_jobacct_gather_params();
-		if (acct_params && strstr(acct_params, "NoShare"))
-			no_share_data = 1;
-		else
-			no_share_data = 0;
+	return (pa < pb) ? -1 : (pa > pb);
+}
 
-		if (acct_params && strstr(acct_params, "UsePss"))
-			use_pss = 1;
-		else
-			use_pss = 0;
-		xfree(acct_params);
-	}
+/*
+ * Bring proc_tab in line with the processes to sample. Entries of
+ * processes still present keep their open files, the others are closed.
+ * IN pids - processes to sample, sorted here
+ * IN check_lwp - if set, flag threads so they can be skipped
+ */
+static void _proc_tab_update(pid_t *pids, int npids, bool check_lwp)
+{
+	jag_proc_t *tmp_tab, *proc;
+	int i = 0, j = 0, k = 0;
 
-	if (!(stat_fp = fopen(proc_stat_file, "r")))
-		return;  /* Assume the process went away */
-	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
-	 */
-	fd = fileno(stat_fp);
-	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	qsort(pids, npids, sizeof(pid_t), _cmp_pid);
 
-	prec = try_xmalloc(sizeof(jag_prec_t));
-	if (prec == NULL) {	/* Avoid killing slurmstepd on malloc failure */
-		fclose(stat_fp);
-		return;
+	if (npids > proc_tab_size) {
+		proc_tab_size = npids + 64;
+		xrealloc(proc_tab, sizeof(jag_proc_t) * proc_tab_size);
+		xrealloc(proc_tab_next, sizeof(jag_proc_t) * proc_tab_size);
 	}
-	if (!_get_process_data_line(fd, prec)) {
-		xfree(prec);
-		fclose(stat_fp);
-		return;
+
+	while ((i < proc_tab_cnt) || (j < npids)) {
+		if ((j < npids) && (j > 0) && (pids[j] == pids[j - 1])) {
+			j++;			/* duplicate */
+		} else if ((j >= npids) || ((i < proc_tab_cnt) &&
+					    (proc_tab[i].pid < pids[j]))) {
+			_proc_close(&proc_tab[i++]);	/* process is gone */
+		} else if ((i < proc_tab_cnt) && (proc_tab[i].pid == pids[j])) {
+			proc_tab_next[k++] = proc_tab[i++];
+			j++;
+		} else {
+			proc = &proc_tab_next[k++];
+			memset(proc, 0, sizeof(jag_proc_t));
+			proc->pid = pids[j++];
+			proc->stat_fd = proc->io_fd = -1;
+			proc->lwp = check_lwp && (_is_a_lwp(proc->pid) > 0);
+		}
+	}
+
+	tmp_tab = proc_tab;
+	proc_tab = proc_tab_next;
+	proc_tab_next = tmp_tab;
+	proc_tab_cnt = k;
+}
+
+/* Refresh the record of one process, return false if it can't be used */
+static bool _sample_proc(jag_proc_t *proc, jag_callbacks_t *callbacks)
+{
+	jag_prec_t *prec = &proc->prec;
+	char path[64];
+
+	if (proc->lwp)
+		return false;
+
+	memset(prec, 0, sizeof(jag_prec_t));
+	prec->pid = proc->pid;
+	if (!_read_proc_file(&proc->stat_fd, proc->pid, "stat",
+			     proc_buf, sizeof(proc_buf)) ||
+	    !_parse_stat(proc_buf, prec)) {
+		_proc_close(proc);
+		return false;
 	}
-	fclose(stat_fp);
 
 	/* Remove shared data from rss */
-	if (no_share_data)
-		_remove_share_data(proc_stat_file, prec);
+	if (no_share_data) {
+		snprintf(path, sizeof(path), "/proc/%d/stat", (int) proc->pid);
+		_remove_share_data(path, prec);
+	}
 
 	/* Use PSS instead if RSS */
 	if (use_pss) {
-		if (_get_pss(proc_smaps_file, prec) == -1) {
-			xfree(prec);
-			return;
-		}
+		snprintf(path, sizeof(path), "/proc/%d/smaps", (int) proc->pid);
+		if (_get_pss(path, prec) == -1)
+			return false;
 	}
 
-	list_append(prec_list, prec);
+	if (_read_proc_file(&proc->io_fd, proc->pid, "io",
+			    proc_buf, sizeof(proc_buf)))
+		_parse_io(proc_buf, prec);
 
-	if ((io_fp = fopen(proc_io_file, "r"))) {
-		fd2 = fileno(io_fp);
-		fcntl(fd2, F_SETFD, FD_CLOEXEC);
-		_get_process_io_data_line(fd2, prec);
-		fclose(io_fp);
-	}
 	if (callbacks->prec_extra)
 		(*(callbacks->prec_extra))(prec);
+
+	return true;
+}
+
+/* Fill slash_proc_pids with the process IDs found in /proc */
+static int _get_slash_proc_pids(void)
+{
+	struct dirent *slash_proc_entry;
+	char *iptr;
+	pid_t pid;
+	int npids = 0;
+
+	if (slash_proc) {
+		rewinddir(slash_proc);
+	} else {
+		slash_proc = opendir("/proc");
+		if (slash_proc == NULL) {
+			perror("opening /proc");
+			return 0;
+		}
+	}
+
+	while ((slash_proc_entry = readdir(slash_proc))) {
+		iptr = slash_proc_entry->d_name;
+		pid = 0;
+		while ((*iptr >= '0') && (*iptr <= '9'))
+			pid = (pid * 10) + (*iptr++ - '0');
+		if (*iptr || !pid)
+			continue;	/* not a process */
+
+		if (npids >= slash_proc_pids_size) {
+			slash_proc_pids_size += 1024;
+			xrealloc(slash_proc_pids,
+				 sizeof(pid_t) * slash_proc_pids_size);
+		}
+		slash_proc_pids[npids++] = pid;
+	}
+
+	return npids;
 }
 
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
-	List prec_list = list_create(destroy_jag_prec);
-	char	proc_stat_file[256];	/* Allow ~20x extra length */
-	char	proc_io_file[256];	/* Allow ~20x extra length */
-	char	proc_smaps_file[256];	/* Allow ~20x extra length */
-	static	int	slash_proc_open = 0;
-	int i;
+	/* Records are kept in proc_tab, the list only points to them */
+	List prec_list = list_create(NULL);
+	pid_t *pids = NULL;
+	int i, npids = 0;
+
+	if (no_share_data == -1) {
+		char *acct_params = slurm_get_jobacct_gather_params();
+		if (acct_params && strstr(acct_params, "NoShare"))
+			no_share_data = 1;
+		else
+			no_share_data = 0;
+
+		if (acct_params && strstr(acct_params, "UsePss"))
+			use_pss = 1;
+		else
+			use_pss = 0;
+		xfree(acct_params);
+	}
 
 	if (!pgid_plugin) {
-		pid_t *pids = NULL;
-		int npids = 0;
 		/* get only the processes in the proctrack container */
 		proctrack_g_get_pids(cont_id, &pids, &npids);
 		if (!npids) {
-			/* update consumed energy even if pids do not exist */
-			struct jobacctinfo *jobacct = NULL;
-			if ((jobacct = list_peek(task_list))) {
-				acct_gather_energy_g_get_data(
-					energy_profile,
-					&jobacct->energy);
-				debug2("getjoules_task energy = %"PRIu64"",
-				       jobacct->energy.consumed_energy);
-			}
-
 			debug4("no pids in this container %"PRIu64"", cont_id);
+			_proc_tab_update(NULL, 0, false);
 			goto finished;
 		}
-		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks);
-		}
+		_proc_tab_update(pids, npids, true);
 		xfree(pids);
 	} else {
-		struct dirent *slash_proc_entry;
-		char  *iptr = NULL, *optr = NULL, *optr2 = NULL;
+		/* /proc only lists thread group leaders, no LWP to skip */
+		npids = _get_slash_proc_pids();
+		_proc_tab_update(slash_proc_pids, npids, false);
+	}
 
-		if (slash_proc_open) {
-			rewinddir(slash_proc);
-		} else {
-			slash_proc=opendir("/proc");
-			if (slash_proc == NULL) {
-				perror("opening /proc");
-				goto finished;
-			}
-			slash_proc_open=1;
-		}
-		strcpy(proc_stat_file, "/proc/");
-		strcpy(proc_io_file, "/proc/");
-		strcpy(proc_smaps_file, "/proc/");
-
-		while ((slash_proc_entry = readdir(slash_proc))) {
-
-			/* Save a few cyles by simulating
-			 * strcat(statFileName, slash_proc_entry->d_name);
-			 * strcat(statFileName, "/stat");
-			 * while checking for a numeric filename (which really
-			 * should be a pid). Then do the same for the
-			 * /proc/<pid>/io file name.
-			 */
-			optr = proc_stat_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-
-			if (i == -1)
-				continue;
-			iptr = (char*)"/stat";
-
-			do {
-				*optr++ = *iptr++;
-			} while (*iptr);
-			*optr = 0;
-
-			optr2 = proc_io_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/io";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			optr2 = proc_smaps_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/smaps";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file,callbacks);
-		}
+	for (i = 0; i < proc_tab_cnt; i++) {
+		if (_sample_proc(&proc_tab[i], callbacks))
+			list_append(prec_list, &proc_tab[i].prec);
 	}
 
 finished:
@@ -770,8 +827,24 @@ extern void jag_common_init(long in_hertz)
 
 extern void jag_common_fini(void)
 {
+	int i;
+
+	if (sample_cnt) {
+		debug("%s: %u samples, average %"PRIu64" usec, "
+		      "max %"PRIu64" usec", __func__, sample_cnt,
+		      sample_usec / sample_cnt, sample_max_usec);
+	}
+
 	if (slash_proc)
 		(void) closedir(slash_proc);
+
+	for (i = 0; i < proc_tab_cnt; i++)
+		_proc_close(&proc_tab[i]);
+	proc_tab_cnt = proc_tab_size = 0;
+	xfree(proc_tab);
+	xfree(proc_tab_next);
+	xfree(slash_proc_pids);
+	slash_proc_pids_size = 0;
 }
 
 extern void destroy_jag_prec(void *object)
@@ -794,6 +867,72 @@ extern void print_jag_prec(jag_prec_t *prec)
 	info("vsize\t%"PRIu64"", prec->vsize);
 }
 
+/*
+ * Give each task its share of the node energy consumed since the last poll,
+ * in proportion to the CPU time it used since then (this_sampled_cputime,
+ * read from the task cgroups by jobacct_gather/cgroup). The energy is split
+ * evenly if no task used any. What rounding leaves goes to the last task, so
+ * the task energies add up to the node energy of the step.
+ */
+static void _share_energy(List task_list, acct_gather_energy_t *node)
+{
+	struct jobacctinfo *jobacct;
+	ListIterator itr;
+	double cpu_total = 0.0, share;
+	uint64_t energy = 0, given = 0, part;
+	int task_cnt = list_count(task_list), i = 0;
+
+	if (!task_cnt)
+		return;
+
+	if ((node->consumed_energy != NO_VAL64) &&
+	    (node->consumed_energy > step_energy_given)) {
+		energy = node->consumed_energy - step_energy_given;
+		step_energy_given = node->consumed_energy;
+	}
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		if (jobacct->this_sampled_cputime > 0.0)
+			cpu_total += jobacct->this_sampled_cputime;
+	}
+	list_iterator_reset(itr);
+	while ((jobacct = list_next(itr))) {
+		if (node->consumed_energy == NO_VAL64) {
+			jobacct->energy.consumed_energy = NO_VAL64;
+			continue;
+		}
+		if (cpu_total > 0.0)
+			share = MAX(jobacct->this_sampled_cputime, 0.0) /
+				cpu_total;
+		else
+			share = 1.0 / task_cnt;
+		if (++i == task_cnt)
+			part = energy - given;
+		else
+			part = (uint64_t) (energy * share);
+		given += part;
+
+		if (jobacct->energy.consumed_energy == NO_VAL64)
+			jobacct->energy.consumed_energy = 0;
+		jobacct->energy.consumed_energy += part;
+		jobacct->energy.current_watts =
+			(uint32_t) (node->current_watts * share);
+		jobacct->energy.poll_time = node->poll_time;
+		debug2("%s: pid %d share %.3f energy %"PRIu64, __func__,
+		       jobacct->pid, share, jobacct->energy.consumed_energy);
+	}
+	list_iterator_destroy(itr);
+}
+
+static void _update_task_energy(List task_list)
+{
+	acct_gather_energy_g_get_data(energy_profile, &step_energy);
+	debug2("getjoules_task energy = %"PRIu64,
+	       step_energy.consumed_energy);
+	_share_energy(task_list, &step_energy);
+}
+
 extern void jag_common_poll_data(
 	List task_list, bool pgid_plugin, uint64_t cont_id,
 	jag_callbacks_t *callbacks, bool profile)
@@ -806,9 +945,9 @@ extern void jag_common_poll_data(
 	struct jobacctinfo *jobacct = NULL;
 	static int processing = 0;
 	char sbuf[72];
-	int energy_counted = 0;
 	time_t ct;
 	static int no_over_memory_kill = -1;
+	DEF_TIMERS;
 
 	xassert(callbacks);
 
@@ -836,18 +975,37 @@ extern void jag_common_poll_data(
 		callbacks->get_precs = _get_precs;
 
 	ct = time(NULL);
+	START_TIMER;
 	prec_list = (*(callbacks->get_precs))(task_list, pgid_plugin, cont_id,
 					      callbacks);
-
-	if (!list_count(prec_list) || !task_list || !list_count(task_list))
+	END_TIMER;
+	sample_cnt++;
+	sample_usec += DELTA_TIMER;
+	sample_max_usec = MAX(sample_max_usec, DELTA_TIMER);
+	debug2("%s: sampled %d processes in %s",
+	       __func__, list_count(prec_list), TIME_STR);
+
+	if (!task_list || !list_count(task_list))
 		goto finished;	/* We have no business being here! */
 
+	if (!list_count(prec_list)) {
+		/* update consumed energy even if pids do not exist */
+		itr = list_iterator_create(task_list);
+		while ((jobacct = list_next(itr)))
+			jobacct->this_sampled_cputime = 0.0;
+		list_iterator_destroy(itr);
+		_update_task_energy(task_list);
+		goto finished;
+	}
+
 	itr = list_iterator_create(task_list);
 	while ((jobacct = list_next(itr))) {
 		double cpu_calc;
 		double last_total_cputime;
-		if (!(prec = list_find_first(prec_list, _find_prec, jobacct)))
+		if (!(prec = list_find_first(prec_list, _find_prec, jobacct))) {
+			jobacct->this_sampled_cputime = 0.0;
 			continue;
+		}
 
 #if _DEBUG
 		info("pid:%u ppid:%u rss:%d KB",
@@ -863,7 +1021,7 @@ extern void jag_common_poll_data(
 		cpu_calc = (double)(prec->ssec + prec->usec)/(double)hertz;
 		/* tally their usage */
 		jobacct->max_rss =
-			MAX(jobacct->max_rss, prec->rss);
+			MAX(jobacct->max_rss, MAX(prec->rss, prec->max_rss));
 		jobacct->tot_rss = prec->rss;
 		total_job_mem += prec->rss;
 		jobacct->max_vsize =
@@ -912,18 +1070,6 @@ extern void jag_common_poll_data(
 		       jobacct->max_vsize, jobacct->tot_cpu,
 		       jobacct->user_cpu_sec,
 		       jobacct->sys_cpu_sec);
-		/* get energy consumption
-		 * only once is enough since we
-		 * report per node energy consumption */
-		debug2("energycounted = %d", energy_counted);
-		if (energy_counted == 0) {
-			acct_gather_energy_g_get_data(
-				energy_profile,
-				&jobacct->energy);
-			debug2("getjoules_task energy = %"PRIu64,
-			       jobacct->energy.consumed_energy);
-			energy_counted = 1;
-		}
 		if (profile &&
 		    acct_gather_profile_g_is_active(ACCT_GATHER_PROFILE_TASK)) {
 			jobacct->cur_time = ct;
@@ -938,6 +1084,8 @@ extern void jag_common_poll_data(
 	}
 	list_iterator_destroy(itr);
 
+	_update_task_energy(task_list);
+
 	if (!no_over_memory_kill)
 		jobacct_gather_handle_mem_limit(total_job_mem, total_job_vsize);
 
@@ -52,6 +52,7 @@ typedef struct jag_prec {	/* process record */
 	pid_t	pid;
 	pid_t	ppid;
 	uint64_t rss;	/* rss */
+	uint64_t max_rss; /* peak memory usage if known by the source, or 0 */
 	int     ssec;   /* system cpu time */
 	int     usec;   /* user cpu time */
 	uint64_t vsize;	/* virtual size */
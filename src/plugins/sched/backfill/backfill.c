@@ -359,7 +359,8 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 		feature_base.op_code = FEATURE_OP_END;
 		list_append(detail_ptr->feature_list, &feature_base);
 
-		tmp_bitmap = bit_copy(*avail_bitmap);
+		tmp_bitmap = bit_scratch_alloc(bit_size(*avail_bitmap));
+		bit_copybits(tmp_bitmap, *avail_bitmap);
 		feat_iter = list_iterator_create(feature_cache);
 		while ((feat_ptr = (job_feature_t *) list_next(feat_iter))) {
 			feature_base.name = feat_ptr->name;
@@ -380,18 +381,20 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 				    ((low_start == 0) ||
 				     (low_start > job_ptr->start_time))) {
 					low_start = job_ptr->start_time;
+					FREE_NULL_BITMAP(low_bitmap);
 					low_bitmap = *avail_bitmap;
-					*avail_bitmap = NULL;
+					*avail_bitmap = bit_alloc(
+						bit_size(tmp_bitmap));
 				}
 			}
-			FREE_NULL_BITMAP(*avail_bitmap);
-			*avail_bitmap = bit_copy(tmp_bitmap);
+			bit_copybits(*avail_bitmap, tmp_bitmap);
 		}
 		list_iterator_destroy(feat_iter);
-		FREE_NULL_BITMAP(tmp_bitmap);
+		bit_scratch_free(tmp_bitmap);
 		if (low_start) {
 			job_ptr->start_time = low_start;
 			rc = SLURM_SUCCESS;
+			FREE_NULL_BITMAP(*avail_bitmap);
 			*avail_bitmap = low_bitmap;
 		} else {
 			rc = ESLURM_NODES_BUSY;
@@ -427,7 +430,8 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 		preemptee_candidates = slurm_find_preemptable_jobs(job_ptr);
 		orig_shared = job_ptr->details->share_res;
 		job_ptr->details->share_res = 0;
-		tmp_bitmap = bit_copy(*avail_bitmap);
+		tmp_bitmap = bit_scratch_alloc(bit_size(*avail_bitmap));
+		bit_copybits(tmp_bitmap, *avail_bitmap);
 
 		if (exc_core_bitmap) {
 			bit_fmt(str, (sizeof(str) - 1), exc_core_bitmap);
@@ -446,8 +450,7 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 
 		if (((rc != SLURM_SUCCESS) || (job_ptr->start_time > now)) &&
 		    (orig_shared != 0)) {
-			FREE_NULL_BITMAP(*avail_bitmap);
-			*avail_bitmap = tmp_bitmap;
+			bit_copybits(*avail_bitmap, tmp_bitmap);
 			rc = select_g_job_test(job_ptr, *avail_bitmap,
 					       min_nodes, max_nodes, req_nodes,
 					       SELECT_MODE_WILL_RUN,
@@ -455,8 +458,8 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 					       &preemptee_job_list,
 					       exc_core_bitmap);
 			FREE_NULL_LIST(preemptee_job_list);
-		} else
-			FREE_NULL_BITMAP(tmp_bitmap);
+		}
+		bit_scratch_free(tmp_bitmap);
 	}
 
 	FREE_NULL_LIST(preemptee_candidates);
@@ -1647,8 +1650,12 @@ next_task:
 		}
 
 		/* Identify nodes which are definitely off limits */
-		FREE_NULL_BITMAP(resv_bitmap);
-		resv_bitmap = bit_copy(avail_bitmap);
+		if (resv_bitmap &&
+		    (bit_size(resv_bitmap) != bit_size(avail_bitmap)))
+			FREE_NULL_BITMAP(resv_bitmap);
+		if (!resv_bitmap)
+			resv_bitmap = bit_alloc(bit_size(avail_bitmap));
+		bit_copybits(resv_bitmap, avail_bitmap);
 		bit_not(resv_bitmap);
 
 		/* this is the time consuming operation */
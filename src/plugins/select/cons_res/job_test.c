@@ -2060,9 +2060,9 @@ static int _eval_nodes_topo(struct job_record *job_ptr, bitstr_t *bitmap,
 	switches_required = xmalloc(sizeof(int)        * switch_record_cnt);
 	avail_nodes_bitmap = bit_alloc(cr_node_cnt);
 	for (i=0; i<switch_record_cnt; i++) {
-		switches_bitmap[i] = bit_copy(switch_record_table[i].
-					      node_bitmap);
-		bit_and(switches_bitmap[i], bitmap);
+		switches_bitmap[i] = bit_alloc(bit_size(bitmap));
+		bit_and_into(switches_bitmap[i],
+			     switch_record_table[i].node_bitmap, bitmap);
 		bit_or(avail_nodes_bitmap, switches_bitmap[i]);
 		switches_node_cnt[i] = bit_set_count(switches_bitmap[i]);
 		if (req_nodes_bitmap &&
@@ -2522,9 +2522,9 @@ static int _eval_nodes_dfly(struct job_record *job_ptr, bitstr_t *bitmap,
 	switches_node_use = xmalloc(sizeof(int)        * switch_record_cnt);
 	avail_nodes_bitmap = bit_alloc(cr_node_cnt);
 	for (i = 0; i < switch_record_cnt; i++) {
-		switches_bitmap[i] = bit_copy(switch_record_table[i].
-					      node_bitmap);
-		bit_and(switches_bitmap[i], bitmap);
+		switches_bitmap[i] = bit_alloc(bit_size(bitmap));
+		bit_and_into(switches_bitmap[i],
+			     switch_record_table[i].node_bitmap, bitmap);
 		bit_or(avail_nodes_bitmap, switches_bitmap[i]);
 		switches_node_cnt[i] = bit_set_count(switches_bitmap[i]);
 	}
@@ -2904,13 +2904,14 @@ static int _choose_nodes(struct job_record *job_ptr, bitstr_t *node_map,
 	    (max_nodes > job_ptr->details->num_tasks))
 		max_nodes = MAX(job_ptr->details->num_tasks, min_nodes);
 
-	origmap = bit_copy(node_map);
+	origmap = bit_scratch_alloc(bit_size(node_map));
+	bit_copybits(origmap, node_map);
 
 	ec = _eval_nodes(job_ptr, node_map, min_nodes, max_nodes, req_nodes,
 			 cr_node_cnt, cpu_cnt, cr_type, prefer_alloc_nodes);
 
 	if (ec == SLURM_SUCCESS) {
-		FREE_NULL_BITMAP(origmap);
+		bit_scratch_free(origmap);
 		return ec;
 	}
 
@@ -2940,11 +2941,11 @@ static int _choose_nodes(struct job_record *job_ptr, bitstr_t *node_map,
 				 req_nodes, cr_node_cnt, cpu_cnt, cr_type,
 				 prefer_alloc_nodes);
 		if (ec == SLURM_SUCCESS) {
-			FREE_NULL_BITMAP(origmap);
+			bit_scratch_free(origmap);
 			return ec;
 		}
 	}
-	FREE_NULL_BITMAP(origmap);
+	bit_scratch_free(origmap);
 	return ec;
 }
 
@@ -54,6 +54,7 @@
 #define OPT_LONG_NOCONVERT 0x103
 #define OPT_LONG_UNITS     0x104
 #define OPT_LONG_FEDR      0x105
+#define OPT_LONG_ARCHIVE   0x106
 
 #define JOB_HASH_SIZE 1000
 
@@ -307,6 +308,10 @@ sacct [<OPTION>]                                                            \n \
      -A, --accounts:                                                        \n\
 	           Use this comma separated list of accounts to select jobs \n\
                    to display.  By default, all accounts are selected.      \n\
+         --archive=files:                                                   \n\
+	           Read jobs from this comma separated list of job archive  \n\
+                   files written by the slurmdbd instead of the database.   \n\
+                   Archived jobs have no steps.                             \n\
      -b, --brief:                                                           \n\
 	           Equivalent to '--format=jobstep,state,error'.            \n\
      -c, --completion: Use job completion instead of accounting data.       \n\
@@ -558,6 +563,9 @@ int get_data(void)
 	if (params.opt_completion) {
 		jobs = g_slurm_jobcomp_get_jobs(job_cond);
 		return SLURM_SUCCESS;
+	} else if (params.opt_archive_list) {
+		jobs = slurmdb_archive_get_jobs(params.opt_archive_list,
+						job_cond);
 	} else {
 		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
 	}
@@ -633,6 +641,7 @@ void parse_command_line(int argc, char **argv)
                 {"allusers",       no_argument,       0,    'a'},
                 {"accounts",       required_argument, 0,    'A'},
                 {"allocations",    no_argument,       0,    'X'},
+                {"archive",        required_argument, 0,    OPT_LONG_ARCHIVE},
                 {"brief",          no_argument,       0,    'b'},
                 {"completion",     no_argument,       0,    'c'},
                 {"delimiter",      required_argument, 0,    OPT_LONG_DELIMITER},
@@ -710,6 +719,12 @@ void parse_command_line(int argc, char **argv)
 					list_create(slurm_destroy_char);
 			slurm_addto_char_list(job_cond->acct_list, optarg);
 			break;
+		case OPT_LONG_ARCHIVE:
+			if (!params.opt_archive_list)
+				params.opt_archive_list =
+					list_create(slurm_destroy_char);
+			slurm_addto_char_list(params.opt_archive_list, optarg);
+			break;
 		case 'b':
 			brief_output = true;
 			break;
@@ -1016,7 +1031,9 @@ void parse_command_line(int argc, char **argv)
 			exit(1);
 		}
 		xfree(acct_type);
-	} else {
+	} else if (!params.opt_archive_list) {
+		/* Archived jobs are read from the files, the database is only
+		 * asked for the QOS and TRES names if they are printed. */
 		slurm_acct_storage_init(params.opt_filein);
 
 		acct_type = slurm_get_accounting_storage_type();
@@ -1036,7 +1053,7 @@ void parse_command_line(int argc, char **argv)
 
 	/* specific clusters requested? */
 	if (params.opt_federation && !all_clusters && !job_cond->cluster_list &&
-	    !params.opt_local) {
+	    !params.opt_local && !params.opt_archive_list) {
 		/* Test if in federated cluster and if so, get information from
 		 * all clusters in that federation */
 		slurmdb_federation_rec_t *fed = NULL;
@@ -1407,10 +1424,12 @@ void sacct_fini(void)
 	if (params.opt_completion)
 		g_slurm_jobcomp_fini();
 	else {
-		slurmdb_connection_close(&acct_db_conn);
+		if (!params.opt_archive_list)
+			slurmdb_connection_close(&acct_db_conn);
 		slurm_acct_storage_fini();
 	}
 	xfree(params.opt_field_list);
 	xfree(params.opt_filein);
+	FREE_NULL_LIST(params.opt_archive_list);
 	slurmdb_destroy_job_cond(params.job_cond);
 }
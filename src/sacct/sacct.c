@@ -36,6 +36,7 @@
 \*****************************************************************************/
 
 #include "sacct.h"
+#include "src/common/slurmdbd_defs.h"
 
 /*
  * Globals
@@ -132,6 +133,78 @@ print_field_t fields[] = {
 
 List jobs = NULL;
 
+static uint32_t page_first_jobid = 0;
+static char *page_first_cluster = NULL;
+
+/* Only slurmdbd from this version on and a direct connection to mysql know
+ * about pages, anything else would send every job for every page. */
+static bool _storage_pages(void)
+{
+	char *acct_type = slurm_get_accounting_storage_type();
+	bool pages = false;
+
+	if (!xstrcmp(acct_type, "accounting_storage/mysql"))
+		pages = true;
+	else if (!xstrcmp(acct_type, "accounting_storage/slurmdbd") &&
+		 (slurm_get_slurmdbd_conn_version() >=
+		  SLURM_17_11_PROTOCOL_VERSION))
+		pages = true;
+	xfree(acct_type);
+
+	return pages;
+}
+
+/* Return false if the page just read does not start after the job the
+ * last page ended with, as it would be printed again. */
+static bool _page_moved(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+	slurmdb_job_rec_t *job;
+
+	if (!job_cond->page_size || !page_first_jobid || !jobs ||
+	    !(job = list_peek(jobs)))
+		return true;
+
+	if ((job->jobid == page_first_jobid) &&
+	    !xstrcmp(job->cluster, page_first_cluster))
+		return false;
+	if (!xstrcmp(job->cluster, job_cond->page_cluster) &&
+	    (job->jobid <= job_cond->page_jobid))
+		return false;
+
+	return true;
+}
+
+/* Move the job query on to the page after the jobs just printed.
+ * Return false when there is no such page. */
+static bool _next_page(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+	slurmdb_job_rec_t *job, *last_job = NULL;
+	ListIterator itr;
+
+	if (!job_cond->page_size || !jobs ||
+	    (list_count(jobs) < job_cond->page_size))
+		return false;
+
+	job = list_peek(jobs);
+	page_first_jobid = job->jobid;
+	xfree(page_first_cluster);
+	page_first_cluster = xstrdup(job->cluster);
+
+	itr = list_iterator_create(jobs);
+	while ((job = list_next(itr)))
+		last_job = job;
+	list_iterator_destroy(itr);
+
+	xfree(job_cond->page_cluster);
+	job_cond->page_cluster = xstrdup(last_job->cluster);
+	job_cond->page_jobid = last_job->jobid;
+	FREE_NULL_LIST(jobs);
+
+	return true;
+}
+
 int main(int argc, char **argv)
 {
 	enum {
@@ -158,12 +231,30 @@ int main(int argc, char **argv)
 	switch (op) {
 	case SACCT_LIST:
 		print_fields_header(print_fields_list);
-		if (get_data() == SLURM_ERROR)
-			exit(errno);
-		if (params.opt_completion)
+		if (params.opt_completion) {
+			if (get_data() == SLURM_ERROR)
+				exit(errno);
 			do_list_completion();
-		else
+			break;
+		}
+		/* Print the jobs a page at a time so the whole list is never
+		 * in memory. Federated jobs are checked for duplicates
+		 * across the whole list so they can't be paged, and archive
+		 * files are read whole. */
+		if ((!params.cluster_name || params.opt_dup) &&
+		    !params.opt_archive_list && _storage_pages())
+			params.job_cond->page_size = SACCT_PAGE_SIZE;
+		do {
+			if (get_data() == SLURM_ERROR)
+				exit(errno);
+			if (!_page_moved()) {
+				error("The database sent back jobs already "
+				      "printed, stopping");
+				break;
+			}
 			do_list();
+		} while (_next_page());
+		xfree(page_first_cluster);
 		break;
 	case SACCT_HELP:
 		do_help();
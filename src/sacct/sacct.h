@@ -71,6 +71,7 @@
 #define LONG_COMP_FIELDS "jobid,uid,jobname,partition,nnodes,nodelist,state,start,end,timelimit"
 
 #define MAX_PRINTFIELDS 100
+#define SACCT_PAGE_SIZE 10000	/* jobs asked for at a time */
 #define FORMAT_STRING_SIZE 34
 
 #define SECONDS_IN_MINUTE 60
@@ -175,6 +176,7 @@ typedef enum {
 typedef struct {
 	char *cluster_name;	/* Set if in federated cluster */
 	int opt_allocs;		/* --total */
+	List opt_archive_list;	/* --archive */
 	uint32_t convert_flags;	/* --noconvert */
 	slurmdb_job_cond_t *job_cond;
 	int opt_completion;	/* --completion */
@@ -172,6 +172,7 @@ extern int sacctmgr_list_stats(int argc, char **argv)
 	uint16_t type_id;
 	uint32_t type_ave, type_cnt, user_ave, user_cnt, user_id;
 	uint64_t roll_ave, type_time, user_time;
+	uint64_t batch_rate, commit_ave;
 	bool sort_by_ave_time = false, sort_by_total_time = false;
 	char *rollup_type;
 
@@ -196,6 +197,22 @@ extern int sacctmgr_list_stats(int argc, char **argv)
 		       buf->rollup_max_time[i], buf->rollup_time[i]);
 	}
 
+	printf("\nStorage statistics\n");
+	batch_rate = 0;
+	if (buf->batch_time)
+		batch_rate = buf->batch_rows * 1000000 / buf->batch_time;
+	printf("\t%-10s count:%-6u rows:%-10"PRIu64" rows/sec:%-8"PRIu64
+	       " total_time:%-12"PRIu64"\n",
+	       "Batches", buf->batch_cnt, buf->batch_rows, batch_rate,
+	       buf->batch_time);
+	commit_ave = buf->commit_time;
+	if (buf->commit_cnt > 1)
+		commit_ave /= buf->commit_cnt;
+	printf("\t%-10s count:%-6u ave_time:%-6"PRIu64
+	       " max_time:%-12"PRIu64" total_time:%-12"PRIu64"\n",
+	       "Commits", buf->commit_cnt, commit_ave,
+	       buf->commit_max_time, buf->commit_time);
+
 	if (argc) {
 		if (!strncasecmp(argv[0], "ave_time", 2))
 			sort_by_ave_time = true;
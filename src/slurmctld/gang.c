@@ -415,7 +415,6 @@ static int _job_fits_in_active_row(struct job_record *job_ptr,
 {
 	job_resources_t *job_res = job_ptr->job_resrcs;
 	int count;
-	bitstr_t *job_map;
 	uint16_t job_gr_type;
 
 	if ((p_ptr->active_resmap == NULL) || (p_ptr->jobs_active == 0))
@@ -429,13 +428,10 @@ static int _job_fits_in_active_row(struct job_record *job_ptr,
 	}
 
 	/* job_gr_type == GS_NODE || job_gr_type == GS_CPU */
-	job_map = bit_copy(job_res->node_bitmap);
-	bit_and(job_map, p_ptr->active_resmap);
 	/* any set bits indicate contention for the same resource */
-	count = bit_set_count(job_map);
+	count = bit_overlap(job_res->node_bitmap, p_ptr->active_resmap);
 	if (slurmctld_conf.debug_flags & DEBUG_FLAG_GANG)
 		info("gang: _job_fits_in_active_row: %d bits conflict", count);
-	FREE_NULL_BITMAP(job_map);
 	if (count == 0)
 		return 1;
 	if (job_gr_type == GS_CPU) {
@@ -1754,14 +1754,11 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 
 			if (node_set_ptr[i].weight == INFINITE) {
 				/* Node reboot required */
-				count1 = bit_set_count(node_set_ptr[i].
-						       my_bitmap);
+				if (!bit_super_set(node_set_ptr[i].my_bitmap,
+						   idle_node_bitmap))
+					nodes_busy = true;
 				bit_and(node_set_ptr[i].my_bitmap,
 					idle_node_bitmap);
-				count2 = bit_set_count(node_set_ptr[i].
-						       my_bitmap);
-				if (count1 != count2)
-					nodes_busy = true;
 			}
 
 			bit_and(node_set_ptr[i].my_bitmap, avail_node_bitmap);
@@ -1824,7 +1821,8 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 
 			/* NOTE: select_g_job_test() is destructive of
 			 * avail_bitmap, so save a backup copy */
-			backup_bitmap = bit_copy(avail_bitmap);
+			backup_bitmap = bit_scratch_alloc(node_record_count);
+			bit_copybits(backup_bitmap, avail_bitmap);
 			FREE_NULL_LIST(*preemptee_job_list);
 			if (job_ptr->details->req_node_bitmap == NULL)
 				bit_and(avail_bitmap, avail_node_bitmap);
@@ -1870,7 +1868,7 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 }
 #endif
 			if (pick_code == SLURM_SUCCESS) {
-				FREE_NULL_BITMAP(backup_bitmap);
+				bit_scratch_free(backup_bitmap);
 				if (bit_set_count(avail_bitmap) > max_nodes) {
 					/* end of tests for this feature */
 					avail_nodes = 0;
@@ -1882,8 +1880,8 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 				return SLURM_SUCCESS;
 			} else {
 				tried_sched = true;	/* test failed */
-				FREE_NULL_BITMAP(avail_bitmap);
-				avail_bitmap = backup_bitmap;
+				bit_copybits(avail_bitmap, backup_bitmap);
+				bit_scratch_free(backup_bitmap);
 			}
 		} /* for (i = 0; i < node_set_size; i++) */
 
@@ -1934,9 +1932,8 @@ _pick_best_nodes(struct node_set *node_set_ptr, int node_set_size,
 					total_bitmap)))) {
 			avail_nodes = bit_set_count(avail_bitmap);
 			if (!runable_avail && (avail_nodes >= min_nodes)) {
-				FREE_NULL_BITMAP(avail_bitmap);
-				avail_bitmap = bit_copy(total_bitmap);
-				bit_and(avail_bitmap, avail_node_bitmap);
+				bit_and_into(avail_bitmap, total_bitmap,
+					     avail_node_bitmap);
 				job_ptr->details->pn_min_memory = orig_req_mem;
 				pick_code = select_g_job_test(job_ptr,
 						avail_bitmap,
@@ -2976,7 +2973,7 @@ static bool _valid_feature_counts(struct job_record *job_ptr,
 	job_feature_t *job_feat_ptr;
 	node_feature_t *node_feat_ptr;
 	int have_count = false, last_op = FEATURE_OP_AND;
-	bitstr_t *feature_bitmap, *tmp_bitmap;
+	bitstr_t *feature_bitmap;
 	bool rc = true;
 
 	xassert(detail_ptr);
@@ -3036,13 +3033,12 @@ static bool _valid_feature_counts(struct job_record *job_ptr,
 				rc = false;
 				break;
 			}
-			tmp_bitmap = bit_copy(feature_bitmap);
-			bit_and(tmp_bitmap, node_feat_ptr->node_bitmap);
-			if (bit_set_count(tmp_bitmap) < job_feat_ptr->count)
+			if (bit_overlap(feature_bitmap,
+					node_feat_ptr->node_bitmap) <
+			    job_feat_ptr->count) {
 				rc = false;
-			FREE_NULL_BITMAP(tmp_bitmap);
-			if (!rc)
 				break;
+			}
 		}
 		list_iterator_destroy(job_feat_iter);
 		FREE_NULL_BITMAP(feature_bitmap);
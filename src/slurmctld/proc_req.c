@@ -98,6 +98,15 @@
 
 #include "src/plugins/select/bluegene/bg_enums.h"
 
+/* Close idle client persistent connections after this many msec */
+#define PERSIST_CLIENT_IDLE_TIMEOUT 300000
+/* Client persistent connections share the 100 persist_conn service threads
+ * with federation siblings.  Cap them in total so a full federation
+ * (MAX_FED_CLUSTERS) can always connect, and per user so one user can not
+ * take them all.  SlurmUser and root are only held to the total. */
+#define PERSIST_CLIENT_MAX_CONNS    32
+#define PERSIST_CLIENT_MAX_PER_UID  4
+
 static pthread_mutex_t rpc_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int rpc_type_size = 0;	/* Size of rpc_type_* arrays */
 static uint16_t *rpc_type_id = NULL;
@@ -111,9 +120,14 @@ static uint64_t *rpc_user_time = NULL;
 static pthread_mutex_t throttle_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t throttle_cond = PTHREAD_COND_INITIALIZER;
 
+static pthread_mutex_t persist_client_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uid_t persist_client_uid[PERSIST_CLIENT_MAX_CONNS];
+static int persist_client_cnt = 0;	/* Open client persistent connections */
+
 static void         _fill_ctld_conf(slurm_ctl_conf_t * build_ptr);
 static void         _kill_job_on_msg_fail(uint32_t job_id);
 static int          _is_prolog_finished(uint32_t job_id);
+static bool         _is_sibling_conn(slurm_msg_t *msg);
 static int          _make_step_cred(struct step_record *step_rec,
 				    slurm_cred_t **slurm_cred,
 				    uint16_t protocol_version);
@@ -2745,6 +2759,7 @@ static void _slurm_rpc_job_alloc_info(slurm_msg_t * msg)
 		unlock_slurmctld(job_read_lock);
 
 		slurm_msg_t_init(&response_msg);
+		response_msg.conn = msg->conn;
 		response_msg.flags = msg->flags;
 		response_msg.protocol_version = msg->protocol_version;
 		if (msg->msg_type == REQUEST_JOB_ALLOCATION_INFO_LITE) {
@@ -2875,6 +2890,7 @@ static void _slurm_rpc_job_sbcast_cred(slurm_msg_t * msg)
 		unlock_slurmctld(job_read_lock);
 
 		slurm_msg_t_init(&response_msg);
+		response_msg.conn = msg->conn;
 		response_msg.flags = msg->flags;
 		response_msg.protocol_version = msg->protocol_version;
 		response_msg.msg_type    = RESPONSE_JOB_SBCAST_CRED;
@@ -3231,6 +3247,7 @@ static void _slurm_rpc_step_layout(slurm_msg_t *msg)
 	unlock_slurmctld(job_read_lock);
 
 	slurm_msg_t_init(&response_msg);
+	response_msg.conn = msg->conn;
 	response_msg.flags = msg->flags;
 	response_msg.protocol_version = msg->protocol_version;
 	response_msg.msg_type    = RESPONSE_STEP_LAYOUT;
@@ -3411,7 +3428,7 @@ static void _slurm_rpc_update_job(slurm_msg_t * msg)
 
 	/* route msg to origin cluster if a federated job */
 	lock_slurmctld(fed_read_lock);
-	if (!error_code && !msg->conn && fed_mgr_fed_rec) {
+	if (!error_code && !_is_sibling_conn(msg) && fed_mgr_fed_rec) {
 		/* Don't send reroute if coming from a federated cluster (aka
 		 * has a msg->conn). */
 		uint32_t job_id, origin_id;
@@ -3915,6 +3932,7 @@ static void _slurm_rpc_resv_create(slurm_msg_t * msg)
 		       resv_desc_ptr->name, TIME_STR);
 		/* send reservation name */
 		slurm_msg_t_init(&response_msg);
+		response_msg.conn = msg->conn;
 		response_msg.flags = msg->flags;
 		response_msg.protocol_version = msg->protocol_version;
 		resv_resp_msg.name    = resv_desc_ptr->name;
@@ -5752,6 +5770,52 @@ static int _process_persist_conn(void *arg,
  *
  * Pack the assoc_mgr lists and return it back to the caller.
  */
+/* Reserve one of the client persistent connection slots for uid.
+ * RET false if uid or the cluster already has too many */
+static bool _persist_client_reserve(uid_t uid)
+{
+	int i, uid_cnt = 0;
+	bool rc = false;
+
+	slurm_mutex_lock(&persist_client_mutex);
+	if (persist_client_cnt >= PERSIST_CLIENT_MAX_CONNS)
+		goto fini;
+	for (i = 0; i < persist_client_cnt; i++) {
+		if (persist_client_uid[i] == uid)
+			uid_cnt++;
+	}
+	if ((uid_cnt >= PERSIST_CLIENT_MAX_PER_UID) && !validate_slurm_user(uid))
+		goto fini;
+	persist_client_uid[persist_client_cnt++] = uid;
+	rc = true;
+fini:
+	slurm_mutex_unlock(&persist_client_mutex);
+	return rc;
+}
+
+static void _persist_client_release(uid_t uid)
+{
+	int i;
+
+	slurm_mutex_lock(&persist_client_mutex);
+	for (i = 0; i < persist_client_cnt; i++) {
+		if (persist_client_uid[i] != uid)
+			continue;
+		persist_client_uid[i] = persist_client_uid[--persist_client_cnt];
+		break;
+	}
+	slurm_mutex_unlock(&persist_client_mutex);
+}
+
+static void _persist_client_fini(void *arg)
+{
+	slurm_persist_conn_t *persist_conn = arg;
+
+	_persist_client_release(g_slurm_auth_get_uid(
+					persist_conn->auth_cred,
+					slurmctld_config.auth_info));
+}
+
 static void _slurm_rpc_persist_init(slurm_msg_t *msg, connection_arg_t *arg)
 {
 	DEF_TIMERS;
@@ -5771,7 +5835,8 @@ static void _slurm_rpc_persist_init(slurm_msg_t *msg, connection_arg_t *arg)
 	if (persist_init->version > SLURM_PROTOCOL_VERSION)
 		persist_init->version = SLURM_PROTOCOL_VERSION;
 
-	if (!validate_slurm_user(uid)) {
+	if ((persist_init->persist_type != PERSIST_TYPE_CLIENT) &&
+	    !validate_slurm_user(uid)) {
 		memset(&p_tmp, 0, sizeof(slurm_persist_conn_t));
 		p_tmp.fd = arg->newsockfd;
 		p_tmp.cluster_name = persist_init->cluster_name;
@@ -5784,6 +5849,23 @@ static void _slurm_rpc_persist_init(slurm_msg_t *msg, connection_arg_t *arg)
 		goto end_it;
 	}
 
+	/* Over the limits a client init is refused rather than left waiting
+	 * for a service thread, the client then uses normal connections. */
+	if ((persist_init->persist_type == PERSIST_TYPE_CLIENT) &&
+	    !_persist_client_reserve(uid)) {
+		memset(&p_tmp, 0, sizeof(slurm_persist_conn_t));
+		p_tmp.fd = arg->newsockfd;
+		p_tmp.cluster_name = persist_init->cluster_name;
+		p_tmp.version = persist_init->version;
+		p_tmp.shutdown = &slurmctld_config.shutdown_time;
+
+		rc = SLURM_ERROR;
+		comment = xstrdup("Too many persistent connections");
+		debug("%s: refusing client persistent connection from uid=%d",
+		      __func__, uid);
+		goto end_it;
+	}
+
 	persist_conn = xmalloc(sizeof(slurm_persist_conn_t));
 
 	persist_conn->auth_cred = msg->auth_cred;
@@ -5809,6 +5891,26 @@ static void _slurm_rpc_persist_init(slurm_msg_t *msg, connection_arg_t *arg)
 	//persist_conn->timeout = 0; /* we want this to be 0 */
 
 	persist_conn->version = persist_init->version;
+
+	if (persist_init->persist_type == PERSIST_TYPE_CLIENT) {
+		/* A user command or API client that wants to send many
+		 * requests over one authenticated connection.  Requests are
+		 * handled by _process_persist_conn() as they arrive. */
+		persist_conn->flags |= PERSIST_FLAG_CLIENT |
+				       PERSIST_FLAG_ALREADY_INITED;
+		persist_conn->timeout = PERSIST_CLIENT_IDLE_TIMEOUT;
+		persist_conn->callback_fini = _persist_client_fini;
+		memcpy(&p_tmp, persist_conn, sizeof(slurm_persist_conn_t));
+		if ((rc = slurm_persist_conn_recv_thread_init(
+			     persist_conn, -1, persist_conn))
+		    != SLURM_SUCCESS) {
+			comment = xstrdup("Unable to spawn persistent connection thread");
+			_persist_client_release(uid);
+			slurm_persist_conn_destroy(persist_conn);
+		}
+		goto end_it;
+	}
+
 	memcpy(&p_tmp, persist_conn, sizeof(slurm_persist_conn_t));
 
 	if ((rc = fed_mgr_add_sibling_conn(persist_conn, &comment))
@@ -5833,12 +5935,21 @@ end_it:
 	//slurm_persist_conn_destroy(persist_conn);
 }
 
+/* Return true if msg arrived over a persistent connection from a federated
+ * sibling cluster (as opposed to a client persistent connection). */
+static bool _is_sibling_conn(slurm_msg_t *msg)
+{
+	if (!msg->conn || (msg->conn->flags & PERSIST_FLAG_CLIENT))
+		return false;
+	return true;
+}
+
 static void _slurm_rpc_sib_job_lock(uint32_t uid, slurm_msg_t *msg)
 {
 	int rc;
 	sib_msg_t *sib_msg = msg->data;
 
-	if (!msg->conn) {
+	if (!_is_sibling_conn(msg)) {
 		error("Security violation, SIB_JOB_LOCK RPC from uid=%d",
 		      uid);
 		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
@@ -5855,7 +5966,7 @@ static void _slurm_rpc_sib_job_unlock(uint32_t uid, slurm_msg_t *msg)
 	int rc;
 	sib_msg_t *sib_msg = msg->data;
 
-	if (!msg->conn) {
+	if (!_is_sibling_conn(msg)) {
 		error("Security violation, SIB_JOB_UNLOCK RPC from uid=%d",
 		      uid);
 		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
@@ -5868,7 +5979,7 @@ static void _slurm_rpc_sib_job_unlock(uint32_t uid, slurm_msg_t *msg)
 }
 
 static void _slurm_rpc_sib_msg(uint32_t uid, slurm_msg_t *msg) {
-	if (!msg->conn) {
+	if (!_is_sibling_conn(msg)) {
 		error("Security violation, SIB_SUBMISSION RPC from uid=%d",
 		      uid);
 		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
@@ -5911,7 +6022,7 @@ static void _proc_multi_msg(uint32_t rpc_uid, slurm_msg_t *msg)
 	ListIterator iter = NULL;
 	int rc;
 
-	if (!msg->conn) {
+	if (!_is_sibling_conn(msg)) {
 		error("Security violation, REQUEST_CTLD_MULT_MSG RPC from uid=%d",
 		      rpc_uid);
 		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
@@ -51,6 +51,10 @@
 //#define SLURMSTEPD_MEMCHECK 3	/* Run slurmstepd with valgrind/drd */
 //#define SLURMSTEPD_MEMCHECK 4	/* Run slurmstepd with valgrind/helgrind */
 
+/* argv[1] of a slurmstepd pre-forked by slurmd to wait for a future launch,
+ * see "slurmstepd_pool" in LaunchParameters */
+#define SLURMSTEPD_POOL_ARG "pool"
+
 typedef enum slurmd_step_tupe {
 	LAUNCH_BATCH_JOB = 0,
 	LAUNCH_TASKS,
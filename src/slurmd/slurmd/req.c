@@ -161,6 +161,7 @@ static bool _is_batch_job_finished(uint32_t job_id);
 static void _job_limits_free(void *x);
 static int  _job_limits_match(void *x, void *key);
 static bool _job_still_running(uint32_t job_id);
+static slurmstepd_state_t _step_state(step_loc_t *stepd, List reg);
 static int  _kill_all_active_steps(uint32_t jobid, int sig, bool batch);
 static void _launch_complete_add(uint32_t job_id);
 static void _launch_complete_log(char *type, uint32_t job_id);
@@ -282,6 +283,28 @@ static pthread_cond_t  file_bcast_cond  = PTHREAD_COND_INITIALIZER;
 static int fb_read_lock = 0, fb_write_wait_lock = 0, fb_write_lock = 0;
 static List file_bcast_list = NULL;
 
+/* Pre-forked slurmstepds waiting for a launch request, see
+ * "slurmstepd_pool" in LaunchParameters */
+#define STEPD_POOL_MAX 64
+typedef struct {
+	int to_stepd;		/* write end of slurmstepd's stdin */
+	int to_slurmd;		/* read end of slurmstepd's stdout */
+} stepd_pool_t;
+static pthread_mutex_t stepd_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  stepd_pool_cond  = PTHREAD_COND_INITIALIZER;
+static stepd_pool_t stepd_pool[STEPD_POOL_MAX];
+static int stepd_pool_cnt = 0;		/* ready entries in stepd_pool */
+static int stepd_pool_size = 0;		/* configured size, 0 if disabled */
+static uint32_t stepd_pool_gen = 0;	/* bumped when the pool is drained */
+static bool stepd_pool_shutdown = false;
+static pthread_t stepd_pool_thread = 0;
+
+/* slurmstepd launch latency histogram, bucket i counts launches taking less
+ * than 2^i msec, the last bucket counts everything slower */
+#define LAUNCH_HIST_CNT 12
+static uint32_t launch_hist[LAUNCH_HIST_CNT];
+static uint32_t launch_pooled = 0;	/* launches using a pooled stepd */
+
 void
 slurmd_req(slurm_msg_t *msg)
 {
@@ -724,261 +747,465 @@ rwfail:
 
 
 /*
- * Fork and exec the slurmstepd, then send the slurmstepd its
- * initialization data.  Then wait for slurmstepd to send an "ok"
- * message before returning.  When the "ok" message is received,
- * the slurmstepd has created and begun listening on its unix
- * domain socket.
+ * Fork and exec a slurmstepd which reads its initialization data from
+ * *to_stepd_fd and writes its return code to *to_slurmd_fd.  A pooled
+ * slurmstepd (pool == true) loads what it can up front and then waits for
+ * slurmd to hand it a launch request, see _stepd_pool_agent().
  *
  * Note that this code forks twice and it is the grandchild that
  * becomes the slurmstepd process, so the slurmstepd's parent process
  * will be init, not slurmd.
  */
 static int
-_forkexec_slurmstepd(uint16_t type, void *req,
-		     slurm_addr_t *cli, slurm_addr_t *self,
-		     const hostset_t step_hset, uint16_t protocol_version)
+_fork_slurmstepd(uint16_t type, void *req, bool pool,
+		 int *to_stepd_fd, int *to_slurmd_fd)
 {
 	pid_t pid;
 	int to_stepd[2] = {-1, -1};
 	int to_slurmd[2] = {-1, -1};
 
 	if (pipe(to_stepd) < 0 || pipe(to_slurmd) < 0) {
-		error("_forkexec_slurmstepd pipe failed: %m");
-		return SLURM_FAILURE;
-	}
-
-	if (_add_starting_step(type, req)) {
-		error("_forkexec_slurmstepd failed in _add_starting_step: %m");
+		error("%s: pipe failed: %m", __func__);
 		return SLURM_FAILURE;
 	}
 
 	if ((pid = fork()) < 0) {
-		error("_forkexec_slurmstepd: fork: %m");
+		error("%s: fork: %m", __func__);
 		close(to_stepd[0]);
 		close(to_stepd[1]);
 		close(to_slurmd[0]);
 		close(to_slurmd[1]);
-		_remove_starting_step(type, req);
 		return SLURM_FAILURE;
 	} else if (pid > 0) {
-		int rc = SLURM_SUCCESS;
-#if (SLURMSTEPD_MEMCHECK == 0)
-		int i;
-		time_t start_time = time(NULL);
-#endif
-		/*
-		 * Parent sends initialization data to the slurmstepd
-		 * over the to_stepd pipe, and waits for the return code
-		 * reply on the to_slurmd pipe.
-		 */
 		if (close(to_stepd[0]) < 0)
 			error("Unable to close read to_stepd in parent: %m");
 		if (close(to_slurmd[1]) < 0)
 			error("Unable to close write to_slurmd in parent: %m");
 
-		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
-						req, cli, self,
-						step_hset,
-						protocol_version)) != 0) {
-			error("Unable to init slurmstepd");
-			goto done;
-		}
-
-		/* If running under valgrind/memcheck, this pipe doesn't work
-		 * correctly so just skip it. */
-#if (SLURMSTEPD_MEMCHECK == 0)
-		i = read(to_slurmd[0], &rc, sizeof(int));
-		if (i < 0) {
-			error("%s: Can not read return code from slurmstepd "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_FAILURE;
-		} else if (i != sizeof(int)) {
-			error("%s: slurmstepd failed to send return code "
-			      "got %d: %m", __func__, i);
-			rc = SLURM_FAILURE;
-		} else {
-			int delta_time = time(NULL) - start_time;
-			int cc;
-			if (delta_time > 5) {
-				info("Warning: slurmstepd startup took %d sec, "
-				     "possible file system problem or full "
-				     "memory", delta_time);
-			}
-			if (rc != SLURM_SUCCESS)
-				error("slurmstepd return code %d", rc);
-
-			cc = SLURM_SUCCESS;
-			cc = write(to_stepd[1], &cc, sizeof(int));
-			if (cc != sizeof(int)) {
-				error("%s: failed to send ack to stepd %d: %m",
-				      __func__, cc);
-			}
-		}
-#endif
-	done:
-		if (_remove_starting_step(type, req))
-			error("Error cleaning up starting_step list");
-
 		/* Reap child */
 		if (waitpid(pid, NULL, 0) < 0)
 			error("Unable to reap slurmd child process");
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in parent: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-		return rc;
-	} else {
+
+		/* Don't leak pooled slurmstepd pipes into other children */
+		fd_set_close_on_exec(to_stepd[1]);
+		fd_set_close_on_exec(to_slurmd[0]);
+		*to_stepd_fd = to_stepd[1];
+		*to_slurmd_fd = to_slurmd[0];
+		return SLURM_SUCCESS;
+	}
+
 #if (SLURMSTEPD_MEMCHECK == 1)
-		/* memcheck test of slurmstepd, option #1 */
-		char *const argv[3] = {"memcheck",
-				       (char *)conf->stepd_loc, NULL};
+	/* memcheck test of slurmstepd, option #1 */
+	char *const argv[3] = {"memcheck",
+			       (char *)conf->stepd_loc, NULL};
 #elif (SLURMSTEPD_MEMCHECK == 2)
-		/* valgrind test of slurmstepd, option #2 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[13] = {"valgrind", "--tool=memcheck",
-					"--error-limit=no",
-					"--leak-check=summary",
-					"--show-reachable=yes",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					"--track-origins=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
+	/* valgrind test of slurmstepd, option #2 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[13] = {"valgrind", "--tool=memcheck",
+				"--error-limit=no",
+				"--leak-check=summary",
+				"--show-reachable=yes",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				"--track-origins=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
 #elif (SLURMSTEPD_MEMCHECK == 3)
-		/* valgrind/drd test of slurmstepd, option #3 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[10] = {"valgrind", "--tool=drd",
-					"--error-limit=no",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
+	/* valgrind/drd test of slurmstepd, option #3 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[10] = {"valgrind", "--tool=drd",
+				"--error-limit=no",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
 #elif (SLURMSTEPD_MEMCHECK == 4)
-		/* valgrind/helgrind test of slurmstepd, option #4 */
-		uint32_t job_id = 0, step_id = 0;
-		char log_file[256];
-		char *const argv[10] = {"valgrind", "--tool=helgrind",
-					"--error-limit=no",
-					"--max-stackframe=16777216",
-					"--num-callers=20",
-					"--child-silent-after-fork=yes",
-					log_file, (char *)conf->stepd_loc,
-					NULL};
-		if (type == LAUNCH_BATCH_JOB) {
-			job_id = ((batch_job_launch_msg_t *)req)->job_id;
-			step_id = ((batch_job_launch_msg_t *)req)->step_id;
-		} else if (type == LAUNCH_TASKS) {
-			job_id = ((launch_tasks_request_msg_t *)req)->job_id;
-			step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
-		}
-		snprintf(log_file, sizeof(log_file),
-			 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
-			 job_id, step_id);
+	/* valgrind/helgrind test of slurmstepd, option #4 */
+	uint32_t job_id = 0, step_id = 0;
+	char log_file[256];
+	char *const argv[10] = {"valgrind", "--tool=helgrind",
+				"--error-limit=no",
+				"--max-stackframe=16777216",
+				"--num-callers=20",
+				"--child-silent-after-fork=yes",
+				log_file, (char *)conf->stepd_loc,
+				NULL};
+	if (type == LAUNCH_BATCH_JOB) {
+		job_id = ((batch_job_launch_msg_t *)req)->job_id;
+		step_id = ((batch_job_launch_msg_t *)req)->step_id;
+	} else if (type == LAUNCH_TASKS) {
+		job_id = ((launch_tasks_request_msg_t *)req)->job_id;
+		step_id = ((launch_tasks_request_msg_t *)req)->job_step_id;
+	}
+	snprintf(log_file, sizeof(log_file),
+		 "--log-file=/tmp/slurmstepd_valgrind_%u.%u",
+		 job_id, step_id);
 #else
-		/* no memory checking, default */
-		char *const argv[2] = { (char *)conf->stepd_loc, NULL};
+	/* no memory checking, default */
+	char *const argv[3] = { (char *)conf->stepd_loc,
+				(pool ? SLURMSTEPD_POOL_ARG : NULL), NULL };
 #endif
-		int i;
-		int failed = 0;
-		/* inform slurmstepd about our config */
-		setenv("SLURM_CONF", conf->conffile, 1);
+	int i;
+	int failed = 0;
+	/* inform slurmstepd about our config */
+	setenv("SLURM_CONF", conf->conffile, 1);
 
-		/*
-		 * Child forks and exits
-		 */
-		if (setsid() < 0) {
-			error("_forkexec_slurmstepd: setsid: %m");
-			failed = 1;
+	/*
+	 * Child forks and exits
+	 */
+	if (setsid() < 0) {
+		error("%s: setsid: %m", __func__);
+		failed = 1;
+	}
+	if ((pid = fork()) < 0) {
+		error("%s: Unable to fork grandchild: %m", __func__);
+		failed = 2;
+	} else if (pid > 0) { /* child */
+		exit(0);
+	}
+
+	/*
+	 * Just in case we (or someone we are linking to)
+	 * opened a file and didn't do a close on exec.  This
+	 * is needed mostly to protect us against libs we link
+	 * to that don't set the flag as we should already be
+	 * setting it for those that we open.  The number 256
+	 * is an arbitrary number based off test7.9.
+	 */
+	for (i=3; i<256; i++) {
+		(void) fcntl(i, F_SETFD, FD_CLOEXEC);
+	}
+
+	/*
+	 * Grandchild exec's the slurmstepd
+	 *
+	 * If the slurmd is being shutdown/restarted before
+	 * the pipe happens the old conf->lfd could be reused
+	 * and if we close it the dup2 below will fail.
+	 */
+	if ((to_stepd[0] != conf->lfd)
+	    && (to_slurmd[1] != conf->lfd))
+		slurm_shutdown_msg_engine(conf->lfd);
+
+	if (close(to_stepd[1]) < 0)
+		error("close write to_stepd in grandchild: %m");
+	if (close(to_slurmd[0]) < 0)
+		error("close read to_slurmd in parent: %m");
+
+	(void) close(STDIN_FILENO); /* ignore return */
+	if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
+		error("dup2 over STDIN_FILENO: %m");
+		exit(1);
+	}
+	fd_set_close_on_exec(to_stepd[0]);
+	(void) close(STDOUT_FILENO); /* ignore return */
+	if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
+		error("dup2 over STDOUT_FILENO: %m");
+		exit(1);
+	}
+	fd_set_close_on_exec(to_slurmd[1]);
+	(void) close(STDERR_FILENO); /* ignore return */
+	if (dup2(devnull, STDERR_FILENO) == -1) {
+		error("dup2 /dev/null to STDERR_FILENO: %m");
+		exit(1);
+	}
+	fd_set_noclose_on_exec(STDERR_FILENO);
+	log_fini();
+	if (!failed) {
+		if (conf->chos_loc && !access(conf->chos_loc, X_OK))
+			execvp(conf->chos_loc, argv);
+		else
+			execvp(argv[0], argv);
+		error("exec of slurmstepd failed: %m");
+	}
+	exit(2);
+}
+
+/* Record the time taken for one slurmstepd launch, delta in usec */
+static void _launch_hist_add(long delta, bool pooled)
+{
+	int i;
+	long msec = delta / 1000;
+
+	for (i = 0; i < (LAUNCH_HIST_CNT - 1); i++) {
+		if (msec < (1L << i))
+			break;
+	}
+	slurm_mutex_lock(&stepd_pool_mutex);
+	launch_hist[i]++;
+	if (pooled)
+		launch_pooled++;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+/* Close the pipes of all pooled slurmstepds, which then exit.
+ * Caller must hold stepd_pool_mutex */
+static void _stepd_pool_drain(void)
+{
+	int i;
+
+	for (i = 0; i < stepd_pool_cnt; i++) {
+		(void) close(stepd_pool[i].to_stepd);
+		(void) close(stepd_pool[i].to_slurmd);
+	}
+	stepd_pool_cnt = 0;
+	stepd_pool_gen++;
+}
+
+/* Take a ready slurmstepd from the pool.
+ * RET true if one was available */
+static bool _stepd_pool_get(int *to_stepd_fd, int *to_slurmd_fd)
+{
+	bool rc = false;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	if (stepd_pool_cnt > 0) {
+		stepd_pool_cnt--;
+		*to_stepd_fd = stepd_pool[stepd_pool_cnt].to_stepd;
+		*to_slurmd_fd = stepd_pool[stepd_pool_cnt].to_slurmd;
+		slurm_cond_signal(&stepd_pool_cond);
+		rc = true;
+	}
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	return rc;
+}
+
+/* Keep stepd_pool_size slurmstepds forked and waiting for work */
+static void *_stepd_pool_agent(void *arg)
+{
+	int to_stepd, to_slurmd;
+	uint32_t gen;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	while (!stepd_pool_shutdown) {
+		if (stepd_pool_cnt >= stepd_pool_size) {
+			slurm_cond_wait(&stepd_pool_cond, &stepd_pool_mutex);
+			continue;
 		}
-		if ((pid = fork()) < 0) {
-			error("_forkexec_slurmstepd: "
-			      "Unable to fork grandchild: %m");
-			failed = 2;
-		} else if (pid > 0) { /* child */
-			exit(0);
+		gen = stepd_pool_gen;
+		slurm_mutex_unlock(&stepd_pool_mutex);
+
+		if (_fork_slurmstepd(0, NULL, true, &to_stepd, &to_slurmd)
+		    != SLURM_SUCCESS) {
+			sleep(1);	/* don't spin on fork failures */
+			slurm_mutex_lock(&stepd_pool_mutex);
+			continue;
 		}
 
-		/*
-		 * Just in case we (or someone we are linking to)
-		 * opened a file and didn't do a close on exec.  This
-		 * is needed mostly to protect us against libs we link
-		 * to that don't set the flag as we should already be
-		 * setting it for those that we open.  The number 256
-		 * is an arbitrary number based off test7.9.
-		 */
-		for (i=3; i<256; i++) {
-			(void) fcntl(i, F_SETFD, FD_CLOEXEC);
+		slurm_mutex_lock(&stepd_pool_mutex);
+		if (stepd_pool_shutdown || (gen != stepd_pool_gen) ||
+		    (stepd_pool_cnt >= stepd_pool_size)) {
+			/* Forked with an old configuration or not needed */
+			(void) close(to_stepd);
+			(void) close(to_slurmd);
+			continue;
 		}
+		stepd_pool[stepd_pool_cnt].to_stepd = to_stepd;
+		stepd_pool[stepd_pool_cnt].to_slurmd = to_slurmd;
+		stepd_pool_cnt++;
+	}
+	slurm_mutex_unlock(&stepd_pool_mutex);
 
-		/*
-		 * Grandchild exec's the slurmstepd
-		 *
-		 * If the slurmd is being shutdown/restarted before
-		 * the pipe happens the old conf->lfd could be reused
-		 * and if we close it the dup2 below will fail.
-		 */
-		if ((to_stepd[0] != conf->lfd)
-		    && (to_slurmd[1] != conf->lfd))
-			slurm_shutdown_msg_engine(conf->lfd);
-
-		if (close(to_stepd[1]) < 0)
-			error("close write to_stepd in grandchild: %m");
-		if (close(to_slurmd[0]) < 0)
-			error("close read to_slurmd in parent: %m");
-
-		(void) close(STDIN_FILENO); /* ignore return */
-		if (dup2(to_stepd[0], STDIN_FILENO) == -1) {
-			error("dup2 over STDIN_FILENO: %m");
-			exit(1);
+	return NULL;
+}
+
+/* Return the slurmstepd pool size configured in LaunchParameters */
+static int _stepd_pool_conf_size(void)
+{
+	char *launch_params, *tmp;
+	int size = 0;
+
+	launch_params = slurm_get_launch_params();
+	if ((tmp = xstrcasestr(launch_params, "slurmstepd_pool="))) {
+		size = atoi(tmp + 16);
+		if (size < 0) {
+			error("Invalid LaunchParameters slurmstepd_pool=%d",
+			      size);
+			size = 0;
+		} else if (size > STEPD_POOL_MAX) {
+			error("LaunchParameters slurmstepd_pool=%d over limit, "
+			      "using %d", size, STEPD_POOL_MAX);
+			size = STEPD_POOL_MAX;
 		}
-		fd_set_close_on_exec(to_stepd[0]);
-		(void) close(STDOUT_FILENO); /* ignore return */
-		if (dup2(to_slurmd[1], STDOUT_FILENO) == -1) {
-			error("dup2 over STDOUT_FILENO: %m");
-			exit(1);
+	}
+	xfree(launch_params);
+
+	return size;
+}
+
+extern void stepd_pool_init(void)
+{
+#if (SLURMSTEPD_MEMCHECK == 0)
+	pthread_attr_t attr;
+
+	slurm_mutex_lock(&stepd_pool_mutex);
+	stepd_pool_size = _stepd_pool_conf_size();
+	stepd_pool_shutdown = false;
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	if (stepd_pool_thread)
+		return;
+
+	slurm_attr_init(&attr);
+	if (pthread_create(&stepd_pool_thread, &attr, _stepd_pool_agent, NULL))
+		error("%s: pthread_create: %m", __func__);
+	slurm_attr_destroy(&attr);
+#endif
+}
+
+extern void stepd_pool_reconfig(void)
+{
+	slurm_mutex_lock(&stepd_pool_mutex);
+	_stepd_pool_drain();
+	stepd_pool_size = _stepd_pool_conf_size();
+	slurm_cond_signal(&stepd_pool_cond);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+}
+
+extern void stepd_pool_fini(void)
+{
+	slurm_mutex_lock(&stepd_pool_mutex);
+	stepd_pool_shutdown = true;
+	_stepd_pool_drain();
+	slurm_cond_signal(&stepd_pool_cond);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	if (stepd_pool_thread) {
+		pthread_join(stepd_pool_thread, NULL);
+		stepd_pool_thread = 0;
+	}
+}
+
+/*
+ * Start a slurmstepd, taking one from the pool if possible, then send the
+ * slurmstepd its initialization data.  Then wait for slurmstepd to send an
+ * "ok" message before returning.  When the "ok" message is received,
+ * the slurmstepd has created and begun listening on its unix
+ * domain socket.
+ */
+static int
+_forkexec_slurmstepd(uint16_t type, void *req,
+		     slurm_addr_t *cli, slurm_addr_t *self,
+		     const hostset_t step_hset, uint16_t protocol_version)
+{
+	int rc = SLURM_SUCCESS;
+	int to_stepd = -1, to_slurmd = -1;
+	bool pooled;
+#if (SLURMSTEPD_MEMCHECK == 0)
+	int i;
+	time_t start_time = time(NULL);
+#endif
+	DEF_TIMERS;
+
+	START_TIMER;
+	if (_add_starting_step(type, req)) {
+		error("_forkexec_slurmstepd failed in _add_starting_step: %m");
+		return SLURM_FAILURE;
+	}
+
+	pooled = _stepd_pool_get(&to_stepd, &to_slurmd);
+	if (!pooled &&
+	    (_fork_slurmstepd(type, req, false, &to_stepd, &to_slurmd)
+	     != SLURM_SUCCESS)) {
+		_remove_starting_step(type, req);
+		return SLURM_FAILURE;
+	}
+
+	/*
+	 * Send initialization data to the slurmstepd over the to_stepd
+	 * pipe, and wait for the return code reply on the to_slurmd pipe.
+	 */
+	rc = _send_slurmstepd_init(to_stepd, type, req, cli, self, step_hset,
+				   protocol_version);
+	if ((rc == EPIPE) && pooled) {
+		/* The pooled slurmstepd went away before we used it */
+		debug("%s: pooled slurmstepd gone, starting a new one",
+		      __func__);
+		(void) close(to_stepd);
+		(void) close(to_slurmd);
+		pooled = false;
+		if (_fork_slurmstepd(type, req, false, &to_stepd, &to_slurmd)
+		    != SLURM_SUCCESS) {
+			_remove_starting_step(type, req);
+			return SLURM_FAILURE;
 		}
-		fd_set_close_on_exec(to_slurmd[1]);
-		(void) close(STDERR_FILENO); /* ignore return */
-		if (dup2(devnull, STDERR_FILENO) == -1) {
-			error("dup2 /dev/null to STDERR_FILENO: %m");
-			exit(1);
+		rc = _send_slurmstepd_init(to_stepd, type, req, cli, self,
+					   step_hset, protocol_version);
+	}
+	if (rc != 0) {
+		error("Unable to init slurmstepd");
+		goto done;
+	}
+
+	/* If running under valgrind/memcheck, this pipe doesn't work
+	 * correctly so just skip it. */
+#if (SLURMSTEPD_MEMCHECK == 0)
+	i = read(to_slurmd, &rc, sizeof(int));
+	if (i < 0) {
+		error("%s: Can not read return code from slurmstepd "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_FAILURE;
+	} else if (i != sizeof(int)) {
+		error("%s: slurmstepd failed to send return code "
+		      "got %d: %m", __func__, i);
+		rc = SLURM_FAILURE;
+	} else {
+		int delta_time = time(NULL) - start_time;
+		int cc;
+		if (delta_time > 5) {
+			info("Warning: slurmstepd startup took %d sec, "
+			     "possible file system problem or full "
+			     "memory", delta_time);
 		}
-		fd_set_noclose_on_exec(STDERR_FILENO);
-		log_fini();
-		if (!failed) {
-			if (conf->chos_loc && !access(conf->chos_loc, X_OK))
-				execvp(conf->chos_loc, argv);
-			else
-				execvp(argv[0], argv);
-			error("exec of slurmstepd failed: %m");
+		if (rc != SLURM_SUCCESS)
+			error("slurmstepd return code %d", rc);
+
+		cc = SLURM_SUCCESS;
+		cc = write(to_stepd, &cc, sizeof(int));
+		if (cc != sizeof(int)) {
+			error("%s: failed to send ack to stepd %d: %m",
+			      __func__, cc);
 		}
-		exit(2);
 	}
+#endif
+	END_TIMER;
+	_launch_hist_add(DELTA_TIMER, pooled);
+	debug2("%s: %sslurmstepd launch took %s", __func__,
+	       pooled ? "pooled " : "", TIME_STR);
+done:
+	if (_remove_starting_step(type, req))
+		error("Error cleaning up starting_step list");
+
+	if (close(to_stepd) < 0)
+		error("close write to_stepd in parent: %m");
+	if (close(to_slurmd) < 0)
+		error("close read to_slurmd in parent: %m");
+	return rc;
 }
 
 
@@ -3347,25 +3574,17 @@ _get_step_list(void)
 	List steps;
 	ListIterator i;
 	step_loc_t *stepd;
+	List reg;
 
+	reg = stepd_registry_list(conf->spooldir, conf->node_name, NO_VAL);
 	steps = stepd_available(conf->spooldir, conf->node_name);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
-		int fd;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid,
-				   &stepd->protocol_version);
-		if (fd == -1)
-			continue;
-
-		if (stepd_state(fd, stepd->protocol_version)
-		    == SLURMSTEPD_NOT_RUNNING) {
+		if (_step_state(stepd, reg) == SLURMSTEPD_NOT_RUNNING) {
 			debug("stale domain socket for stepd %u.%u ",
 			      stepd->jobid, stepd->stepid);
-			close(fd);
 			continue;
 		}
-		close(fd);
 
 		if (step_list)
 			xstrcat(step_list, ", ");
@@ -3381,6 +3600,7 @@ _get_step_list(void)
 	}
 	list_iterator_destroy(i);
 	FREE_NULL_LIST(steps);
+	FREE_NULL_LIST(reg);
 
 	if (step_list == NULL)
 		xstrcat(step_list, "NONE");
@@ -3410,6 +3630,20 @@ _rpc_daemon_status(slurm_msg_t *msg)
 	resp->slurmd_logfile     = xstrdup(conf->logfile);
 	resp->version            = xstrdup(SLURM_VERSION_STRING);
 
+	slurm_mutex_lock(&stepd_pool_mutex);
+	resp->stepd_pool_ready   = stepd_pool_cnt;
+	resp->launch_pooled      = launch_pooled;
+	resp->launch_hist_cnt    = LAUNCH_HIST_CNT;
+	resp->launch_hist        = xmalloc(sizeof(uint32_t) * LAUNCH_HIST_CNT);
+	memcpy(resp->launch_hist, launch_hist,
+	       sizeof(uint32_t) * LAUNCH_HIST_CNT);
+	slurm_mutex_unlock(&stepd_pool_mutex);
+
+	resp->rpc_class_cnt      = SLURMD_RPC_CLASS_CNT;
+	resp->rpc_active = xmalloc(sizeof(uint32_t) * SLURMD_RPC_CLASS_CNT);
+	slurmd_rpc_class_counts(resp->rpc_active, &resp->rpc_stats_queued,
+				&resp->rpc_rejected);
+
 	slurm_msg_t_copy(&resp_msg, msg);
 	resp_msg.msg_type = RESPONSE_SLURMD_STATUS;
 	resp_msg.data     = resp;
@@ -3735,6 +3969,40 @@ _rpc_timelimit(slurm_msg_t *msg)
 	_rpc_terminate_job(msg);
 }
 
+/*
+ * Look for a pid in the step registry. It knows the slurmstepd pids and,
+ * if the proctrack plugin can map a pid to its container, the processes of
+ * every registered step.
+ * RET true and set job_id if found
+ */
+static bool _registry_pid2jid(pid_t pid, uint32_t *job_id)
+{
+	List reg;
+	ListIterator i;
+	stepd_reg_rec_t *rec;
+	uint64_t cont_id;
+	bool found = false;
+
+	if (!(reg = stepd_registry_list(conf->spooldir, conf->node_name,
+					NO_VAL)))
+		return false;
+
+	cont_id = proctrack_g_find(pid);
+	i = list_iterator_create(reg);
+	while ((rec = list_next(i))) {
+		if ((rec->stepd_pid == pid) ||
+		    (cont_id && (rec->cont_id == cont_id))) {
+			*job_id = rec->jobid;
+			found = true;
+			break;
+		}
+	}
+	list_iterator_destroy(i);
+	FREE_NULL_LIST(reg);
+
+	return found;
+}
+
 static void  _rpc_pid2jid(slurm_msg_t *msg)
 {
 	job_id_request_msg_t *req = (job_id_request_msg_t *) msg->data;
@@ -3745,32 +4013,38 @@ static void  _rpc_pid2jid(slurm_msg_t *msg)
 	ListIterator i;
 	step_loc_t *stepd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
-	i = list_iterator_create(steps);
-	while ((stepd = list_next(i))) {
-		int fd;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid,
-				   &stepd->protocol_version);
-		if (fd == -1)
-			continue;
+	if (_registry_pid2jid(req->job_pid, &resp.job_id)) {
+		slurm_msg_t_copy(&resp_msg, msg);
+		resp.return_code = SLURM_SUCCESS;
+		found = true;
+	} else {
+		steps = stepd_available(conf->spooldir, conf->node_name);
+		i = list_iterator_create(steps);
+		while ((stepd = list_next(i))) {
+			int fd;
+			fd = stepd_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid,
+					   &stepd->protocol_version);
+			if (fd == -1)
+				continue;
 
-		if (stepd_pid_in_container(
-			    fd, stepd->protocol_version,
-			    req->job_pid)
-		    || req->job_pid == stepd_daemon_pid(
-			    fd, stepd->protocol_version)) {
-			slurm_msg_t_copy(&resp_msg, msg);
-			resp.job_id = stepd->jobid;
-			resp.return_code = SLURM_SUCCESS;
-			found = true;
+			if (stepd_pid_in_container(
+				    fd, stepd->protocol_version,
+				    req->job_pid)
+			    || req->job_pid == stepd_daemon_pid(
+				    fd, stepd->protocol_version)) {
+				slurm_msg_t_copy(&resp_msg, msg);
+				resp.job_id = stepd->jobid;
+				resp.return_code = SLURM_SUCCESS;
+				found = true;
+				close(fd);
+				break;
+			}
 			close(fd);
-			break;
 		}
-		close(fd);
+		list_iterator_destroy(i);
+		FREE_NULL_LIST(steps);
 	}
-	list_iterator_destroy(i);
-	FREE_NULL_LIST(steps);
 
 	if (found) {
 		debug3("_rpc_pid2jid: pid(%u) found in %u",
@@ -4522,33 +4796,49 @@ _job_still_running(uint32_t job_id)
 	List         steps;
 	ListIterator i;
 	step_loc_t  *s     = NULL;
+	List         reg;
 
+	reg = stepd_registry_list(conf->spooldir, conf->node_name, job_id);
 	steps = stepd_available(conf->spooldir, conf->node_name);
 	i = list_iterator_create(steps);
 	while ((s = list_next(i))) {
-		if (s->jobid == job_id) {
-			int fd;
-			fd = stepd_connect(s->directory, s->nodename,
-					   s->jobid, s->stepid,
-					   &s->protocol_version);
-			if (fd == -1)
-				continue;
-
-			if (stepd_state(fd, s->protocol_version)
-			    != SLURMSTEPD_NOT_RUNNING) {
-				retval = true;
-				close(fd);
-				break;
-			}
-			close(fd);
+		if ((s->jobid == job_id) &&
+		    (_step_state(s, reg) != SLURMSTEPD_NOT_RUNNING)) {
+			retval = true;
+			break;
 		}
 	}
 	list_iterator_destroy(i);
 	FREE_NULL_LIST(steps);
+	FREE_NULL_LIST(reg);
 
 	return retval;
 }
 
+/*
+ * Return the state of a local job step. Use the step registry if the
+ * slurmstepd is found there, otherwise ask the slurmstepd.
+ */
+static slurmstepd_state_t _step_state(step_loc_t *stepd, List reg)
+{
+	stepd_reg_rec_t *rec;
+	slurmstepd_state_t state;
+	int fd;
+
+	if ((rec = stepd_registry_find(reg, stepd->jobid, stepd->stepid)))
+		return rec->state;
+
+	fd = stepd_connect(stepd->directory, stepd->nodename,
+			   stepd->jobid, stepd->stepid,
+			   &stepd->protocol_version);
+	if (fd == -1)
+		return SLURMSTEPD_NOT_RUNNING;
+	state = stepd_state(fd, stepd->protocol_version);
+	close(fd);
+
+	return state;
+}
+
 /*
  * Wait until all job steps are in SLURMSTEPD_NOT_RUNNING state.
  * This indicates that switch_g_job_postfini has completed and
@@ -4575,29 +4865,21 @@ _steps_completed_now(uint32_t jobid)
 	ListIterator i;
 	step_loc_t *stepd;
 	bool rc = true;
+	List reg;
 
+	reg = stepd_registry_list(conf->spooldir, conf->node_name, jobid);
 	steps = stepd_available(conf->spooldir, conf->node_name);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
-		if (stepd->jobid == jobid) {
-			int fd;
-			fd = stepd_connect(stepd->directory, stepd->nodename,
-					   stepd->jobid, stepd->stepid,
-					   &stepd->protocol_version);
-			if (fd == -1)
-				continue;
-
-			if (stepd_state(fd, stepd->protocol_version)
-			    != SLURMSTEPD_NOT_RUNNING) {
-				rc = false;
-				close(fd);
-				break;
-			}
-			close(fd);
+		if ((stepd->jobid == jobid) &&
+		    (_step_state(stepd, reg) != SLURMSTEPD_NOT_RUNNING)) {
+			rc = false;
+			break;
 		}
 	}
 	list_iterator_destroy(i);
 	FREE_NULL_LIST(steps);
+	FREE_NULL_LIST(reg);
 
 	return rc;
 }
@@ -57,6 +57,16 @@ extern void record_launched_jobs(void);
 void file_bcast_init(void);
 void file_bcast_purge(void);
 
+/*
+ * Maintain a pool of pre-forked slurmstepd processes waiting for launch
+ * requests, sized by "slurmstepd_pool=#" in LaunchParameters.
+ * stepd_pool_reconfig() retires pooled processes started with the old
+ * configuration.
+ */
+extern void stepd_pool_init(void);
+extern void stepd_pool_reconfig(void);
+extern void stepd_pool_fini(void);
+
 /*
  * ume_notify - Notify all jobs and steps on this node that a Uncorrectable
  *	Memory Error (UME) has occured by sending SIG_UME (to log event in
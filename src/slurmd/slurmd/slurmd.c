@@ -133,6 +133,20 @@ static int             active_threads = 0;
 static pthread_mutex_t active_mutex   = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  active_cond    = PTHREAD_COND_INITIALIZER;
 
+/*
+ * RPC priority classes. Every connection holds one of the MAX_THREADS slots
+ * while its message is read. Once the message type is known, monitoring RPCs
+ * give that slot back and run from their own small pool so that a burst of
+ * sstat or energy polling can not delay a launch, signal or ping.
+ * All protected by active_mutex.
+ */
+#define MAX_STATS_THREADS	16	/* stats RPCs processed at once */
+#define MAX_STATS_QUEUED	128	/* stats RPCs waiting, others rejected */
+static uint32_t        rpc_active[SLURMD_RPC_CLASS_CNT];
+static uint32_t        rpc_stats_queued = 0;
+static uint32_t        rpc_rejected   = 0;
+static pthread_cond_t  stats_cond     = PTHREAD_COND_INITIALIZER;
+
 static pthread_mutex_t fork_mutex     = PTHREAD_MUTEX_INITIALIZER;
 
 typedef struct connection {
@@ -186,6 +200,9 @@ static void      _process_cmdline(int ac, char **av);
 static void      _read_config(void);
 static void      _reconfigure(void);
 static void     *_registration_engine(void *arg);
+static int       _rpc_class(uint16_t msg_type);
+static int       _rpc_class_begin(int rpc_class);
+static void      _rpc_class_end(int rpc_class);
 static void      _resource_spec_fini(void);
 static int       _resource_spec_init(void);
 static int       _restore_cred_state(slurm_cred_ctx_t ctx);
@@ -359,6 +376,7 @@ main (int argc, char **argv)
 	list_install_fork_handlers();
 	slurm_conf_install_fork_handlers();
 	record_launched_jobs();
+	stepd_pool_init();
 
 	/*
 	 * Initialize any plugins
@@ -384,6 +402,7 @@ main (int argc, char **argv)
 	if (unlink(conf->pidfile) < 0)
 		error("Unable to remove pidfile `%s': %m", conf->pidfile);
 
+	stepd_pool_fini();
 	_wait_for_all_threads(120);
 	_slurmd_fini();
 	_destroy_conf();
@@ -513,19 +532,21 @@ static void
 _wait_for_all_threads(int secs)
 {
 	struct timespec ts;
-	int rc;
+	int rc, threads;
 
 	ts.tv_sec  = time(NULL);
 	ts.tv_nsec = 0;
 	ts.tv_sec += secs;
 
 	slurm_mutex_lock(&active_mutex);
-	while (active_threads > 0) {
-		verbose("waiting on %d active threads", active_threads);
+	while ((threads = active_threads +
+			  rpc_active[SLURMD_RPC_STATS] +
+			  rpc_stats_queued) > 0) {
+		verbose("waiting on %d active threads", threads);
 		rc = pthread_cond_timedwait(&active_cond, &active_mutex, &ts);
 		if (rc == ETIMEDOUT) {
 			error("Timeout waiting for completion of %d threads",
-			      active_threads);
+			      threads);
 			slurm_cond_signal(&active_cond);
 			slurm_mutex_unlock(&active_mutex);
 			return;
@@ -583,6 +604,8 @@ _service_connection(void *arg)
 	conn_t *con = (conn_t *) arg;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
 	int rc = SLURM_SUCCESS;
+	int rpc_class = SLURMD_RPC_NORMAL;
+	bool have_slot = true;
 
 	debug3("in the service_connection");
 	slurm_msg_t_init(msg);
@@ -597,8 +620,20 @@ _service_connection(void *arg)
 	}
 	debug2("got this type of message %d", msg->msg_type);
 
-	if (msg->msg_type != MESSAGE_COMPOSITE)
-		slurmd_req(msg);
+	if (msg->msg_type == MESSAGE_COMPOSITE)
+		goto cleanup;
+
+	rpc_class = _rpc_class(msg->msg_type);
+	if ((rc = _rpc_class_begin(rpc_class)) != SLURM_SUCCESS) {
+		debug("service_connection: rejecting RPC %u, too many queued",
+		      msg->msg_type);
+		slurm_send_rc_msg(msg, rc);
+		goto cleanup;
+	}
+	if (rpc_class == SLURMD_RPC_STATS)
+		have_slot = false;
+	slurmd_req(msg);
+	_rpc_class_end(rpc_class);
 
 cleanup:
 	if ((msg->conn_fd >= 0) && close(msg->conn_fd) < 0)
@@ -607,10 +642,94 @@ cleanup:
 	xfree(con->cli_addr);
 	xfree(con);
 	slurm_free_msg(msg);
-	_decrement_thd_count();
+	if (have_slot)
+		_decrement_thd_count();
 	return NULL;
 }
 
+/* Map a message type to its RPC priority class */
+static int _rpc_class(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case REQUEST_LAUNCH_PROLOG:
+	case REQUEST_BATCH_JOB_LAUNCH:
+	case REQUEST_LAUNCH_TASKS:
+	case REQUEST_SIGNAL_TASKS:
+	case REQUEST_TERMINATE_TASKS:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_SIGNAL_JOB:
+	case REQUEST_SUSPEND_INT:
+	case REQUEST_ABORT_JOB:
+	case REQUEST_TERMINATE_JOB:
+	case REQUEST_SHUTDOWN:
+	case REQUEST_RECONFIGURE:
+	case REQUEST_NODE_REGISTRATION_STATUS:
+	case REQUEST_PING:
+	case REQUEST_HEALTH_CHECK:
+		return SLURMD_RPC_URGENT;
+	case REQUEST_JOB_STEP_STAT:
+	case REQUEST_JOB_STEP_PIDS:
+	case REQUEST_ACCT_GATHER_UPDATE:
+	case REQUEST_ACCT_GATHER_ENERGY:
+		return SLURMD_RPC_STATS;
+	default:
+		return SLURMD_RPC_NORMAL;
+	}
+}
+
+/*
+ * Account for an RPC of the given class about to be processed. Stats RPCs
+ * release the connection slot taken in _handle_connection() and wait here
+ * for room in their own pool.
+ * RET SLURM_SUCCESS or EAGAIN if too many stats RPCs are already queued
+ */
+static int _rpc_class_begin(int rpc_class)
+{
+	slurm_mutex_lock(&active_mutex);
+	if (rpc_class == SLURMD_RPC_STATS) {
+		if (rpc_stats_queued >= MAX_STATS_QUEUED) {
+			rpc_rejected++;
+			slurm_mutex_unlock(&active_mutex);
+			return EAGAIN;
+		}
+		if (active_threads > 0)
+			active_threads--;
+		slurm_cond_signal(&active_cond);
+
+		rpc_stats_queued++;
+		while (rpc_active[rpc_class] >= MAX_STATS_THREADS)
+			slurm_cond_wait(&stats_cond, &active_mutex);
+		rpc_stats_queued--;
+	}
+	rpc_active[rpc_class]++;
+	slurm_mutex_unlock(&active_mutex);
+
+	return SLURM_SUCCESS;
+}
+
+static void _rpc_class_end(int rpc_class)
+{
+	slurm_mutex_lock(&active_mutex);
+	if (rpc_active[rpc_class] > 0)
+		rpc_active[rpc_class]--;
+	if (rpc_class == SLURMD_RPC_STATS) {
+		slurm_cond_signal(&stats_cond);
+		slurm_cond_signal(&active_cond);
+	}
+	slurm_mutex_unlock(&active_mutex);
+}
+
+extern void slurmd_rpc_class_counts(uint32_t *active, uint32_t *stats_queued,
+				    uint32_t *rejected)
+{
+	slurm_mutex_lock(&active_mutex);
+	memcpy(active, rpc_active, sizeof(rpc_active));
+	*stats_queued = rpc_stats_queued;
+	*rejected = rpc_rejected;
+	slurm_mutex_unlock(&active_mutex);
+}
+
 extern int
 send_registration_msg(uint32_t status, bool startup)
 {
@@ -1093,6 +1212,9 @@ _reconfigure(void)
 	 */
 	gids_cache_purge();
 
+	/* Pooled slurmstepds loaded the old configuration */
+	stepd_pool_reconfig();
+
 	/* send reconfig to each stepd so they can refresh their log
 	 * file handle
 	 */
@@ -171,6 +171,22 @@ typedef struct slurmd_config {
 
 extern slurmd_conf_t * conf;
 
+/* RPC priority classes, see _rpc_class() in slurmd.c */
+#define SLURMD_RPC_URGENT	0	/* launch, signal, terminate, ping */
+#define SLURMD_RPC_NORMAL	1	/* everything else */
+#define SLURMD_RPC_STATS	2	/* step statistics and energy polling */
+#define SLURMD_RPC_CLASS_CNT	3
+
+/*
+ * Report RPCs being processed by class. Only stats RPCs are ever queued,
+ * the other classes are processed as soon as they are read.
+ * OUT active - array of SLURMD_RPC_CLASS_CNT elements
+ * OUT stats_queued - stats RPCs waiting for a thread of their pool
+ * OUT rejected - stats RPCs refused since startup because too many queued
+ */
+extern void slurmd_rpc_class_counts(uint32_t *active, uint32_t *stats_queued,
+				    uint32_t *rejected);
+
 /* Send node registration message with status to controller
  * IN status - same values slurm error codes (for node shutdown)
  * IN startup - non-zero if slurmd just restarted
@@ -56,6 +56,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "src/common/cbuf.h"
@@ -67,6 +68,8 @@
 #include "src/common/macros.h"
 #include "src/common/net.h"
 #include "src/common/read_config.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/timers.h"
 #include "src/common/write_labelled_message.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xsignal.h"
@@ -119,6 +122,9 @@ struct client_io_info {
 
 	/* true if writing to a file, false if writing to a socket */
 	bool is_local_file;
+
+	/* when output was first held back for batching, or zero */
+	struct timeval hold_start;
 };
 
 
@@ -197,6 +203,17 @@ static void *_window_manager(void *arg);
 /**********************************************************************
  * General declarations
  **********************************************************************/
+/* Step I/O counters, logged when the IO thread exits */
+static struct {
+	uint64_t task_bytes;	/* read from tasks' stdout and stderr */
+	uint64_t client_bytes;	/* written to client sockets */
+	uint64_t client_msgs;	/* messages written to client sockets */
+	uint64_t client_writes;	/* writev() calls on client sockets */
+	uint64_t file_bytes;	/* written to local files */
+} io_stats;
+
+static int stdio_flush_msec = 0;	/* LaunchParameters=stdio_flush= */
+
 static void *_io_thr(void *);
 static int _send_io_init_msg(int sock, srun_key_t *key, stepd_step_rec_t *job);
 static void _send_eof_msg(struct task_read_info *out);
@@ -249,6 +266,53 @@ _client_readable(eio_obj_t *obj)
 	return false;
 }
 
+/*
+ * Return true to hold back the queued messages of a client for a while,
+ * so that more of them get sent in one batch. Output is held for at most
+ * stdio_flush_msec, and not at all once a full batch is queued, or if
+ * holding it would keep tasks from getting output buffers.
+ */
+static bool
+_client_hold_output(eio_obj_t *obj)
+{
+	struct client_io_info *client = (struct client_io_info *) obj->arg;
+	stepd_step_rec_t *job = client->job;
+	struct timeval now;
+	ListIterator msgs;
+	struct io_buf *msg;
+	uint32_t queued = 0;
+	int cnt = 0, held_msec;
+
+	if ((stdio_flush_msec <= 0) || obj->shutdown)
+		return false;
+	if (list_is_empty(job->free_outgoing) &&
+	    (job->outgoing_count >= STDIO_MAX_FREE_BUF))
+		return false;
+
+	msgs = list_iterator_create(client->msg_queue);
+	while ((msg = list_next(msgs))) {
+		queued += msg->length;
+		if ((++cnt >= STDIO_MAX_IOV) || (queued >= STDIO_BATCH_BYTES))
+			break;
+	}
+	list_iterator_destroy(msgs);
+	if (msg)
+		return false;	/* a full batch is ready */
+
+	gettimeofday(&now, NULL);
+	if (!client->hold_start.tv_sec)
+		client->hold_start = now;
+	held_msec = (now.tv_sec - client->hold_start.tv_sec) * 1000 +
+		    (now.tv_usec - client->hold_start.tv_usec) / 1000;
+	if (held_msec >= stdio_flush_msec)
+		return false;
+
+	eio_wakeup_after(job->eio, stdio_flush_msec - held_msec);
+	debug5("  holding %d messages for %d msec", cnt,
+	       stdio_flush_msec - held_msec);
+	return true;
+}
+
 static bool
 _client_writable(eio_obj_t *obj)
 {
@@ -286,6 +350,10 @@ _client_writable(eio_obj_t *obj)
 		debug5("  client->out.msg_queue queue length = %d",
 		       list_count(client->msg_queue));
 
+	if (client->out_msg == NULL && !list_is_empty(client->msg_queue)
+	    && _client_hold_output(obj))
+		return false;
+
 	if (client->out_msg != NULL
 	    || !list_is_empty(client->msg_queue))
 		return true;
@@ -426,14 +494,18 @@ _client_read(eio_obj_t *obj, List objs)
 }
 
 /*
- * Write outgoing packed messages to the client socket.
+ * Write outgoing packed messages to the client socket. All queued messages
+ * (up to STDIO_MAX_IOV) are sent in one writev() call.
  */
 static int
 _client_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct iovec iov[STDIO_MAX_IOV];
+	ListIterator msgs;
+	struct io_buf *msg;
+	int cnt = 0;
+	ssize_t n;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
 
@@ -457,12 +529,23 @@ _client_write(eio_obj_t *obj, List objs)
 	debug5("  client->out_remaining = %d", client->out_remaining);
 
 	/*
-	 * Write message to socket.
+	 * Gather the rest of the current message and the queued ones.
 	 */
-	buf = client->out_msg->data +
+	iov[cnt].iov_base = client->out_msg->data +
 		(client->out_msg->length - client->out_remaining);
+	iov[cnt++].iov_len = client->out_remaining;
+	msgs = list_iterator_create(client->msg_queue);
+	while ((cnt < STDIO_MAX_IOV) && (msg = list_next(msgs))) {
+		iov[cnt].iov_base = msg->data;
+		iov[cnt++].iov_len = msg->length;
+	}
+	list_iterator_destroy(msgs);
+
+	/*
+	 * Write messages to socket.
+	 */
 again:
-	if ((n = write(obj->fd, buf, client->out_remaining)) < 0) {
+	if ((n = writev(obj->fd, iov, cnt)) < 0) {
 		if (errno == EINTR) {
 			goto again;
 		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
@@ -474,17 +557,29 @@ again:
 			return SLURM_SUCCESS;
 		}
 	}
-	if (n < client->out_remaining) {
-		error("Only wrote %d of %d bytes to socket",
-		      n, client->out_remaining);
-	} else
-		debug5("Wrote %d bytes to socket", n);
-	client->out_remaining -= n;
-	if (client->out_remaining > 0)
-		return SLURM_SUCCESS;
+	debug5("Wrote %zd bytes of %d messages to socket", n, cnt);
+	io_stats.client_bytes += n;
+	io_stats.client_writes++;
 
-	_free_outgoing_msg(client->out_msg, client->job);
-	client->out_msg = NULL;
+	/*
+	 * Release the messages fully written, the last one may be partial.
+	 */
+	while (client->out_msg) {
+		if (n < client->out_remaining) {
+			client->out_remaining -= n;
+			return SLURM_SUCCESS;
+		}
+		n -= client->out_remaining;
+		io_stats.client_msgs++;
+		_free_outgoing_msg(client->out_msg, client->job);
+		client->out_msg = NULL;
+		if ((n == 0) || !(client->out_msg =
+				  list_dequeue(client->msg_queue)))
+			break;
+		client->out_remaining = client->out_msg->length;
+	}
+	if (list_is_empty(client->msg_queue))
+		client->hold_start.tv_sec = 0;
 
 	return SLURM_SUCCESS;
 }
@@ -565,6 +660,7 @@ _local_file_write(eio_obj_t *obj, List objs)
 		_free_all_outgoing_msgs(client->msg_queue, client->job);
 		return SLURM_ERROR;
 	}
+	io_stats.file_bytes += n;
 
 	client->out_remaining -= n;
 	if (client->out_remaining == 0) {
@@ -777,7 +873,8 @@ again:
 		if (rc <= 0) {  /* got eof */
 			debug5("  got eof on task");
 			out->eof = true;
-		}
+		} else
+			io_stats.task_bytes += rc;
 	}
 
 	debug5("************************ %d bytes read from task %s", rc,
@@ -918,6 +1015,43 @@ _spawn_window_manager(stepd_step_task_info_t *task, stepd_step_rec_t *job)
  * General fuctions
  **********************************************************************/
 
+/*
+ * Tasks writing their output directly often share the same file. Return a
+ * duplicate of a descriptor already opened on "name" for a previous task, or
+ * for the stdout of this task, so that the file is opened (and truncated)
+ * only once per step. The tasks then share the file offset, so their output
+ * follows one another instead of each task writing from where it opened the
+ * file. Return -1 if there is none.
+ */
+static int
+_dup_task_file(stepd_step_rec_t *job, stepd_step_task_info_t *task,
+	       const char *name)
+{
+	stepd_step_task_info_t *t;
+	int i, src_fd = -1, fd;
+
+	if ((name != task->ofname) && (task->from_stdout == -1) &&
+	    (task->stdout_fd >= 0) && !xstrcmp(task->ofname, name))
+		src_fd = task->stdout_fd;
+
+	for (i = 0; (src_fd == -1) && (i < task->id); i++) {
+		t = job->task[i];
+		if ((t->from_stdout == -1) && (t->stdout_fd >= 0) &&
+		    !xstrcmp(t->ofname, name))
+			src_fd = t->stdout_fd;
+		else if ((t->from_stderr == -1) && (t->stderr_fd >= 0) &&
+			 !xstrcmp(t->efname, name))
+			src_fd = t->stderr_fd;
+	}
+
+	if ((src_fd == -1) || ((fd = dup(src_fd)) == -1))
+		return -1;
+	fd_set_close_on_exec(fd);
+	debug5("  %s already open, using fd %d", name, fd);
+
+	return fd;
+}
+
 /*
  * This function sets the close-on-exec flag on all opened file descriptors.
  * io_dup_stdio will will remove the close-on-exec flags for just one task's
@@ -1047,10 +1181,13 @@ _init_task_stdio_fds(stepd_step_task_info_t *task, stepd_step_rec_t *job)
 		int count = 0;
 		/* open file on task's stdout */
 		debug5("  stdout file name = %s", task->ofname);
-		do {
+		task->stdout_fd = _dup_task_file(job, task, task->ofname);
+		while (task->stdout_fd == -1 && count < 10) {
 			task->stdout_fd = open(task->ofname, file_flags, 0666);
 			++count;
-		} while (task->stdout_fd == -1 && errno == EINTR && count < 10);
+			if (errno != EINTR)
+				break;
+		}
 		if (task->stdout_fd == -1) {
 			error("Could not open stdout file %s: %m",
 			      task->ofname);
@@ -1136,10 +1273,13 @@ _init_task_stdio_fds(stepd_step_task_info_t *task, stepd_step_rec_t *job)
 		int count = 0;
 		/* open file on task's stdout */
 		debug5("  stderr file name = %s", task->efname);
-		do {
+		task->stderr_fd = _dup_task_file(job, task, task->efname);
+		while (task->stderr_fd == -1 && count < 10) {
 			task->stderr_fd = open(task->efname, file_flags, 0666);
 			++count;
-		} while (task->stderr_fd == -1 && errno == EINTR && count < 10);
+			if (errno != EINTR)
+				break;
+		}
 		if (task->stderr_fd == -1) {
 			error("Could not open stderr file %s: %m",
 			      task->efname);
@@ -1183,12 +1323,36 @@ io_init_tasks_stdio(stepd_step_rec_t *job)
 	return rc;
 }
 
+/* Set stdio_flush_msec from LaunchParameters=stdio_flush=<msec> */
+static void
+_get_stdio_flush_conf(void)
+{
+	char *launch_params, *tmp;
+
+	launch_params = slurm_get_launch_params();
+	if ((tmp = xstrcasestr(launch_params, "stdio_flush="))) {
+		stdio_flush_msec = atoi(tmp + 12);
+		if (stdio_flush_msec < 0) {
+			error("Invalid LaunchParameters stdio_flush=%d",
+			      stdio_flush_msec);
+			stdio_flush_msec = 0;
+		} else if (stdio_flush_msec > STDIO_FLUSH_MAX) {
+			error("LaunchParameters stdio_flush=%d over limit, "
+			      "using %d", stdio_flush_msec, STDIO_FLUSH_MAX);
+			stdio_flush_msec = STDIO_FLUSH_MAX;
+		}
+	}
+	xfree(launch_params);
+}
+
 int
 io_thread_start(stepd_step_rec_t *job)
 {
 	pthread_attr_t attr;
 	int rc = 0, retries = 0;
 
+	_get_stdio_flush_conf();
+
 	slurm_attr_init(&attr);
 
 	while (pthread_create(&job->ioid, &attr, &_io_thr, (void *)job)) {
@@ -1478,12 +1642,28 @@ io_close_local_fds(stepd_step_rec_t *job)
 
 
 
+/* Log the step I/O counters, usec is the lifetime of the IO thread */
+static void
+_log_io_stats(long usec)
+{
+	double secs = (usec > 0) ? (usec / 1000000.0) : 1.0;
+
+	debug("IO stats: read %"PRIu64" bytes from tasks (%.0f B/s), "
+	      "wrote %"PRIu64" bytes in %"PRIu64" messages and %"PRIu64" "
+	      "writes to clients (%.0f B/s), %"PRIu64" bytes to files",
+	      io_stats.task_bytes, io_stats.task_bytes / secs,
+	      io_stats.client_bytes, io_stats.client_msgs,
+	      io_stats.client_writes, io_stats.client_bytes / secs,
+	      io_stats.file_bytes);
+}
+
 static void *
 _io_thr(void *arg)
 {
 	stepd_step_rec_t *job = (stepd_step_rec_t *) arg;
 	sigset_t set;
 	int rc;
+	DEF_TIMERS;
 
 	/* A SIGHUP signal signals a reattach to the mgr thread.  We need
 	 * to block SIGHUP from being delivered to this thread so the mgr
@@ -1495,8 +1675,11 @@ _io_thr(void *arg)
 	pthread_sigmask(SIG_BLOCK, &set, NULL);
 
 	debug("IO handler started pid=%lu", (unsigned long) getpid());
+	START_TIMER;
 	rc = eio_handle_mainloop(job->eio);
+	END_TIMER;
 	debug("IO handler exited, rc=%d", rc);
+	_log_io_stats(DELTA_TIMER);
 	return (void *)1;
 }
 
@@ -50,6 +50,15 @@
 #define STDIO_MAX_FREE_BUF 1024
 #define STDIO_MAX_MSG_CACHE 128
 
+/*
+ * Messages sent to a client are batched in a single writev() of up to
+ * STDIO_MAX_IOV messages. With LaunchParameters=stdio_flush=<msec>, small
+ * messages are held back up to that long, until STDIO_BATCH_BYTES are queued.
+ */
+#define STDIO_MAX_IOV 64
+#define STDIO_BATCH_BYTES (32 * 1024)
+#define STDIO_FLUSH_MAX 1000
+
 struct io_buf {
 	int ref_count;
 	uint32_t length;
@@ -85,6 +85,7 @@
 #include "src/common/slurm_cred.h"
 #include "src/common/slurm_jobacct_gather.h"
 #include "src/common/slurm_mpi.h"
+#include "src/common/stepd_api.h"
 #include "src/common/switch.h"
 #include "src/common/util-net.h"
 #include "src/common/xmalloc.h"
@@ -994,6 +995,7 @@ static void _set_job_state(stepd_step_rec_t *job, slurmstepd_state_t new_state)
 {
 	slurm_mutex_lock(&job->state_mutex);
 	job->state = new_state;
+	stepd_registry_update(new_state, job->cont_id);
 	slurm_cond_signal(&job->state_cond);
 	slurm_mutex_unlock(&job->state_mutex);
 }
@@ -2012,18 +2014,8 @@ _wait_for_any_task(stepd_step_rec_t *job, bool waitflag)
 			jobacctinfo_setinfo(jobacct,
 					    JOBACCT_DATA_RUSAGE, &rusage,
 					    SLURM_PROTOCOL_VERSION);
-			/* Since we currently don't track energy
-			   usage per task (only per step).  We take
-			   into account only the last poll of the last task.
-			   Odds are it is the only one with
-			   information anyway, but just to be safe we
-			   will zero out the previous value since this
-			   one will over ride it.
-			   If this ever changes in the future this logic
-			   will need to change.
-			*/
-			if (jobacct->energy.consumed_energy)
-				job->jobacct->energy.consumed_energy = 0;
+			/* Each task holds its share of the node energy,
+			   so the step energy is the sum of the tasks'. */
 			jobacctinfo_aggregate(job->jobacct, jobacct);
 			jobacctinfo_destroy(jobacct);
 		}
@@ -1738,6 +1738,13 @@ _handle_stat_jobacct(int fd, stepd_step_rec_t *job, uid_t uid)
 			num_tasks++;
 		}
 	}
+	/* Tasks hold their share of the node energy, add the shares of the
+	 * tasks already gone */
+	if (job->jobacct &&
+	    (job->jobacct->energy.consumed_energy != NO_VAL64) &&
+	    (jobacct->energy.consumed_energy != NO_VAL64))
+		jobacct->energy.consumed_energy +=
+			job->jobacct->energy.consumed_energy;
 
 	jobacctinfo_setinfo(jobacct, JOBACCT_DATA_PIPE, &fd,
 			    SLURM_PROTOCOL_VERSION);
@@ -40,16 +40,19 @@
 
 #include "config.h"
 
+#include <poll.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include "src/common/checkpoint.h"
 #include "src/common/cpu_frequency.h"
 #include "src/common/gres.h"
 #include "src/common/node_select.h"
 #include "src/common/plugstack.h"
 #include "src/common/slurm_auth.h"
+#include "src/common/slurm_cred.h"
 #include "src/common/slurm_jobacct_gather.h"
 #include "src/common/slurm_acct_gather_profile.h"
 #include "src/common/slurm_mpi.h"
@@ -85,6 +88,7 @@ static stepd_step_rec_t *_step_setup(slurm_addr_t *cli, slurm_addr_t *self,
 static void _step_cleanup(stepd_step_rec_t *job, slurm_msg_t *msg, int rc);
 #endif
 static int _process_cmdline (int argc, char **argv);
+static void _pool_wait(int sock);
 
 int slurmstepd_blocked_signals[] = {
 	SIGPIPE, 0
@@ -94,6 +98,8 @@ int slurmstepd_blocked_signals[] = {
 slurmd_conf_t * conf;
 extern char  ** environ;
 
+static bool pooled = false;	/* pre-forked by slurmd, see _pool_wait() */
+
 int
 main (int argc, char **argv)
 {
@@ -119,6 +125,9 @@ main (int argc, char **argv)
 	if (slurm_auth_init(NULL) != SLURM_SUCCESS)
 		fatal( "failed to initialize authentication plugin" );
 
+	if (pooled)
+		_pool_wait(STDIN_FILENO);
+
 	/* Receive job parameters from the slurmd */
 	_init_from_slurmd(STDIN_FILENO, argv, &cli, &self, &msg,
 			  &ngids, &gids);
@@ -144,6 +153,8 @@ main (int argc, char **argv)
 		rc = SLURM_FAILURE;
 		goto ending;
 	}
+	(void) stepd_registry_add(conf->spooldir, conf->node_name,
+				  job->jobid, job->stepid);
 
 	_send_ok_to_slurmd(STDOUT_FILENO);
 	_got_ack_from_slurmd(STDIN_FILENO);
@@ -199,6 +210,7 @@ extern int stepd_cleanup(slurm_msg_t *msg, stepd_step_rec_t *job,
 		eio_signal_shutdown(job->msg_handle);
 		pthread_join(job->msgid, NULL);
 	}
+	stepd_registry_remove();
 
 	mpi_fini();	/* Remove stale PMI2 sockets */
 #ifdef MEMORY_LEAK_DEBUG
@@ -377,9 +389,43 @@ static int _process_cmdline (int argc, char **argv)
 			exit (1);
 		exit (0);
 	}
+	if ((argc == 2) && (xstrcmp(argv[1], SLURMSTEPD_POOL_ARG) == 0))
+		pooled = true;
 	return (0);
 }
 
+/*
+ *  A pooled slurmstepd is started by slurmd ahead of any launch request.
+ *  Do the configuration parsing and plugin loading which does not depend on
+ *  the slurmd configuration now, then sleep until slurmd hands us a job on
+ *  sock.  If slurmd retires us instead (reconfigure or shutdown) it closes
+ *  the pipe and we exit quietly.
+ */
+static void _pool_wait(int sock)
+{
+	struct pollfd ufds;
+	char *ckpt_type;
+	int rc;
+
+	slurm_conf_init(NULL);
+
+	ckpt_type = slurm_get_checkpoint_type();
+	if ((switch_init(1) != SLURM_SUCCESS)		||
+	    (checkpoint_init(ckpt_type) != SLURM_SUCCESS)	||
+	    (slurm_crypto_init() != SLURM_SUCCESS))
+		exit(1);
+	xfree(ckpt_type);
+
+	ufds.fd = sock;
+	ufds.events = POLLIN;
+	while ((rc = poll(&ufds, 1, -1)) < 0) {
+		if ((errno != EINTR) && (errno != EAGAIN))
+			exit(1);
+	}
+	if (!(ufds.revents & POLLIN))
+		exit(0);
+}
+
 
 static void
 _send_ok_to_slurmd(int sock)
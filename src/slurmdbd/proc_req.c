@@ -117,6 +117,9 @@ static int   _get_config(slurmdbd_conn_t *slurmdbd_conn,
 			 persist_msg_t *msg, Buf *out_buffer, uint32_t *uid);
 static int   _get_events(slurmdbd_conn_t *slurmdbd_conn,
 			 persist_msg_t *msg, Buf *out_buffer, uint32_t *uid);
+static int   _get_jobs_aggr(slurmdbd_conn_t *slurmdbd_conn,
+			    persist_msg_t *msg, Buf *out_buffer,
+			    uint32_t *uid);
 static int   _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 			    persist_msg_t *msg, Buf *out_buffer,
 			    uint32_t *uid);
@@ -346,6 +349,10 @@ proc_req(void *conn, persist_msg_t *msg,
 		rc = _get_events(slurmdbd_conn,
 				 msg, out_buffer, uid);
 		break;
+	case DBD_GET_JOBS_AGGR:
+		rc = _get_jobs_aggr(slurmdbd_conn,
+				    msg, out_buffer, uid);
+		break;
 	case DBD_GET_JOBS_COND:
 		rc = _get_jobs_cond(slurmdbd_conn,
 				    msg, out_buffer, uid);
@@ -544,13 +551,29 @@ proc_req(void *conn, persist_msg_t *msg,
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port
-		 && !slurmdbd_conf->commit_delay) {
+		 && !slurmdbd_conf->commit_delay
+		 && !slurmdbd_conn->in_mult_msg) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
 		*/
-		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
+		int commit_rc = acct_storage_g_commit(slurmdbd_conn->db_conn,
+						      1);
+		/* Step records are only written at the commit, if that
+		 * failed make the slurmctld send them again. */
+		if ((commit_rc != SLURM_SUCCESS) && (rc == SLURM_SUCCESS) &&
+		    ((msg->msg_type == DBD_SEND_MULT_MSG) ||
+		     (msg->msg_type == DBD_STEP_COMPLETE) ||
+		     (msg->msg_type == DBD_STEP_START))) {
+			rc = commit_rc;
+			comment = "Failed to write step records";
+			error("CONN:%u %s", slurmdbd_conn->conn->fd, comment);
+			free_buf(*out_buffer);
+			*out_buffer = slurm_persist_make_rc_msg(
+				slurmdbd_conn->conn, rc, comment,
+				msg->msg_type);
+		}
 	}
 
 	END_TIMER;
@@ -1344,6 +1367,38 @@ static int _get_events(slurmdbd_conn_t *slurmdbd_conn,
 	return rc;
 }
 
+static int _get_jobs_aggr(slurmdbd_conn_t *slurmdbd_conn,
+			  persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
+{
+	dbd_cond_msg_t *cond_msg = msg->data;
+	dbd_list_msg_t list_msg = { NULL };
+	int rc = SLURM_SUCCESS;
+
+	debug2("DBD_GET_JOBS_AGGR: called");
+
+	list_msg.my_list = jobacct_storage_g_get_jobs_aggr(
+		slurmdbd_conn->db_conn, *uid, cond_msg->cond);
+
+	if (!errno) {
+		if (!list_msg.my_list)
+			list_msg.my_list = list_create(NULL);
+		*out_buffer = init_buf(1024);
+		pack16((uint16_t) DBD_GOT_JOBS_AGGR, *out_buffer);
+		slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+				       DBD_GOT_JOBS_AGGR, *out_buffer);
+	} else {
+		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+							errno,
+							slurm_strerror(errno),
+							DBD_GET_JOBS_AGGR);
+		rc = SLURM_ERROR;
+	}
+
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return rc;
+}
+
 static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 			  persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
 {
@@ -1408,6 +1463,140 @@ static int _get_probs(slurmdbd_conn_t *slurmdbd_conn,
 	return rc;
 }
 
+/* The QOS and users slurmdbd's assoc_mgr caches are kept up to date with
+ * the same update records sent to every slurmctld, so a request for all of
+ * them (as a slurmctld asks for when loading its own cache) is answered from
+ * that cache without going to the database.
+ */
+static bool _list_empty(List list)
+{
+	return (!list || !list_count(list));
+}
+
+/* Free a copy made by _get_qos_cached() or _get_users_cached(), the
+ * contents are the cache's */
+static void _destroy_cache_copy(void *object)
+{
+	xfree(object);
+}
+
+/* Pack a DBD_GOT_QOS of every QOS if cond asks for nothing more than that
+ * and the QOS are cached.  Returns true if out_buffer was set. */
+static bool _get_qos_cached(slurmdbd_conn_t *slurmdbd_conn,
+			    slurmdb_qos_cond_t *cond, Buf *out_buffer)
+{
+	dbd_list_msg_t list_msg = { NULL };
+	slurmdb_qos_rec_t *qos, *object;
+	ListIterator itr;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK,
+				   NO_LOCK, NO_LOCK, NO_LOCK };
+
+	if (cond && (!_list_empty(cond->description_list) ||
+		     !_list_empty(cond->id_list) ||
+		     !_list_empty(cond->name_list) ||
+		     cond->preempt_mode || cond->with_deleted))
+		return false;
+
+	assoc_mgr_lock(&locks);
+	if (!assoc_mgr_qos_list) {
+		assoc_mgr_unlock(&locks);
+		return false;
+	}
+	/* Shallow copies, leaving out what the database wouldn't send.  A QOS
+	 * added since the cache was loaded still has the preempt names and
+	 * empty description it was added with. */
+	list_msg.my_list = list_create(_destroy_cache_copy);
+	itr = list_iterator_create(assoc_mgr_qos_list);
+	while ((qos = list_next(itr))) {
+		object = xmalloc(sizeof(slurmdb_qos_rec_t));
+		memcpy(object, qos, sizeof(slurmdb_qos_rec_t));
+		if (object->description && !object->description[0])
+			object->description = NULL;
+		object->preempt_list = NULL;
+		list_append(list_msg.my_list, object);
+	}
+	list_iterator_destroy(itr);
+	*out_buffer = init_buf(1024);
+	pack16((uint16_t) DBD_GOT_QOS, *out_buffer);
+	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+			       DBD_GOT_QOS, *out_buffer);
+	assoc_mgr_unlock(&locks);
+
+	debug2("DBD_GET_QOS: sent %d QOS from cache",
+	       list_count(list_msg.my_list));
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return true;
+}
+
+/* Pack a DBD_GOT_USERS of every user, with or without their coordinator
+ * accounts, if user_cond asks for nothing more than that and the users are
+ * cached.  Returns true if out_buffer was set. */
+static bool _get_users_cached(slurmdbd_conn_t *slurmdbd_conn,
+			      slurmdb_user_cond_t *user_cond, Buf *out_buffer,
+			      uint32_t uid)
+{
+	dbd_list_msg_t list_msg = { NULL };
+	slurmdb_user_rec_t *user, *object;
+	ListIterator itr;
+	slurmdb_assoc_cond_t *assoc_cond = user_cond->assoc_cond;
+	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
+				   NO_LOCK, READ_LOCK, NO_LOCK };
+
+	if ((user_cond->admin_level != SLURMDB_ADMIN_NOTSET) ||
+	    user_cond->with_assocs || user_cond->with_deleted ||
+	    user_cond->with_wckeys ||
+	    !_list_empty(user_cond->def_acct_list) ||
+	    !_list_empty(user_cond->def_wckey_list))
+		return false;
+	if (assoc_cond && (!_list_empty(assoc_cond->user_list) ||
+			   assoc_cond->only_defs))
+		return false;
+
+	/* Only operators see every user when users are private */
+	if ((slurmdbd_conf->private_data & PRIVATE_DATA_USERS) &&
+	    (uid != slurmdbd_conf->slurm_user_id) && (uid != 0) &&
+	    (assoc_mgr_get_admin_level(slurmdbd_conn->db_conn, uid) <
+	     SLURMDB_ADMIN_OPERATOR))
+		return false;
+
+	assoc_mgr_lock(&locks);
+	if (!assoc_mgr_user_list) {
+		assoc_mgr_unlock(&locks);
+		return false;
+	}
+	/* Shallow copies, leaving out what the database wouldn't send */
+	list_msg.my_list = list_create(_destroy_cache_copy);
+	itr = list_iterator_create(assoc_mgr_user_list);
+	while ((user = list_next(itr))) {
+		object = xmalloc(sizeof(slurmdb_user_rec_t));
+		memcpy(object, user, sizeof(slurmdb_user_rec_t));
+		object->assoc_list = NULL;
+		/* The database only fills in the defaults when asked for
+		 * them (only_defs), and the cache doesn't follow them since
+		 * they change with the associations slurmdbd doesn't cache */
+		object->default_acct = NULL;
+		object->default_wckey = NULL;
+		object->old_name = NULL;
+		object->wckey_list = NULL;
+		if (!user_cond->with_coords)
+			object->coord_accts = NULL;
+		list_append(list_msg.my_list, object);
+	}
+	list_iterator_destroy(itr);
+	*out_buffer = init_buf(1024);
+	pack16((uint16_t) DBD_GOT_USERS, *out_buffer);
+	slurmdbd_pack_list_msg(&list_msg, slurmdbd_conn->conn->version,
+			       DBD_GOT_USERS, *out_buffer);
+	assoc_mgr_unlock(&locks);
+
+	debug2("DBD_GET_USERS: sent %d users from cache",
+	       list_count(list_msg.my_list));
+	FREE_NULL_LIST(list_msg.my_list);
+
+	return true;
+}
+
 static int _get_qos(slurmdbd_conn_t *slurmdbd_conn,
 		    persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
 {
@@ -1417,6 +1606,9 @@ static int _get_qos(slurmdbd_conn_t *slurmdbd_conn,
 
 	debug2("DBD_GET_QOS: called");
 
+	if (_get_qos_cached(slurmdbd_conn, cond_msg->cond, out_buffer))
+		return SLURM_SUCCESS;
+
 	list_msg.my_list = acct_storage_g_get_qos(slurmdbd_conn->db_conn, *uid,
 						  cond_msg->cond);
 
@@ -1588,6 +1780,9 @@ static int _get_users(slurmdbd_conn_t *slurmdbd_conn,
 		}
 	}
 
+	if (_get_users_cached(slurmdbd_conn, user_cond, out_buffer, *uid))
+		return SLURM_SUCCESS;
+
 	list_msg.my_list = acct_storage_g_get_users(slurmdbd_conn->db_conn,
 						    *uid, user_cond);
 
@@ -3296,6 +3491,8 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 
 	list_msg.my_list = list_create(slurmdbd_free_buffer);
 	/* START_TIMER; */
+	/* Commit the messages together so their records can be batched */
+	slurmdbd_conn->in_mult_msg = true;
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
 		persist_msg_t sub_msg;
@@ -3318,6 +3515,7 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 			break;
 	}
 	list_iterator_destroy(itr);
+	slurmdbd_conn->in_mult_msg = false;
 	/* END_TIMER; */
 	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
 
@@ -3478,6 +3676,7 @@ static int  _get_stats(slurmdbd_conn_t *slurmdbd_conn,
 {
 	int rc = SLURM_SUCCESS;
 	char *comment = NULL;
+	slurmdb_stats_rec_t *storage_stats = NULL;
 
 	if ((*uid != slurmdbd_conf->slurm_user_id && *uid != 0)
 	    && assoc_mgr_get_admin_level(slurmdbd_conn->db_conn, *uid)
@@ -3492,12 +3691,22 @@ static int  _get_stats(slurmdbd_conn_t *slurmdbd_conn,
 	}
 
 	info("Get stats request received from UID %u", *uid);
+	(void) acct_storage_g_get_stats(slurmdbd_conn->db_conn, &storage_stats);
 	*out_buffer = init_buf(32 * 1024);
 	pack16((uint16_t) DBD_GOT_STATS, *out_buffer);
 	slurm_mutex_lock(&rpc_mutex);
+	if (storage_stats) {
+		rpc_stats.batch_cnt = storage_stats->batch_cnt;
+		rpc_stats.batch_rows = storage_stats->batch_rows;
+		rpc_stats.batch_time = storage_stats->batch_time;
+		rpc_stats.commit_cnt = storage_stats->commit_cnt;
+		rpc_stats.commit_time = storage_stats->commit_time;
+		rpc_stats.commit_max_time = storage_stats->commit_max_time;
+	}
 	slurmdb_pack_stats_msg(&rpc_stats, slurmdbd_conn->conn->version,
 			       *out_buffer);
 	slurm_mutex_unlock(&rpc_mutex);
+	slurmdb_destroy_stats_rec(storage_stats);
 
 	return rc;
 }
@@ -3537,6 +3746,7 @@ static int  _clear_stats(slurmdbd_conn_t *slurmdbd_conn,
 		rpc_stats.rpc_user_time[i] = 0;
 	}
 	slurm_mutex_unlock(&rpc_mutex);
+	(void) acct_storage_g_clear_stats(slurmdbd_conn->db_conn);
 
 	*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
 						rc, comment, DBD_CLEAR_STATS);
@@ -90,6 +90,8 @@ static void _clear_slurmdbd_conf(void)
 		xfree(slurmdbd_conf->archive_script);
 		xfree(slurmdbd_conf->auth_info);
 		xfree(slurmdbd_conf->auth_type);
+		slurmdbd_conf->batch_delay = 0;
+		slurmdbd_conf->batch_size = DEFAULT_SLURMDBD_BATCH_SIZE;
 		slurmdbd_conf->commit_delay = 0;
 		xfree(slurmdbd_conf->dbd_addr);
 		xfree(slurmdbd_conf->dbd_backup);
@@ -99,6 +101,7 @@ static void _clear_slurmdbd_conf(void)
 		slurmdbd_conf->debug_level = 0;
 		xfree(slurmdbd_conf->default_qos);
 		xfree(slurmdbd_conf->log_file);
+		slurmdbd_conf->partition_tables = 0;
 		xfree(slurmdbd_conf->pid_file);
 		xfree(slurmdbd_conf->plugindir);
 		slurmdbd_conf->private_data = 0;
@@ -143,6 +146,8 @@ extern int read_slurmdbd_conf(void)
 		{"ArchiveUsage", S_P_BOOLEAN},
 		{"AuthInfo", S_P_STRING},
 		{"AuthType", S_P_STRING},
+		{"BatchDelay", S_P_UINT32},
+		{"BatchSize", S_P_UINT32},
 		{"CommitDelay", S_P_UINT16},
 		{"DbdAddr", S_P_STRING},
 		{"DbdBackupHost", S_P_STRING},
@@ -155,6 +160,7 @@ extern int read_slurmdbd_conf(void)
 		{"LogFile", S_P_STRING},
 		{"LogTimeFormat", S_P_STRING},
 		{"MessageTimeout", S_P_UINT16},
+		{"PartitionTables", S_P_BOOLEAN},
 		{"PidFile", S_P_STRING},
 		{"PluginDir", S_P_STRING},
 		{"PrivateData", S_P_STRING},
@@ -230,6 +236,11 @@ extern int read_slurmdbd_conf(void)
 		s_p_get_boolean(&a_usage, "ArchiveUsage", tbl);
 		s_p_get_string(&slurmdbd_conf->auth_info, "AuthInfo", tbl);
 		s_p_get_string(&slurmdbd_conf->auth_type, "AuthType", tbl);
+		s_p_get_uint32(&slurmdbd_conf->batch_delay, "BatchDelay", tbl);
+		if (s_p_get_uint32(&slurmdbd_conf->batch_size,
+				   "BatchSize", tbl) &&
+		    (slurmdbd_conf->batch_size == 0))
+			slurmdbd_conf->batch_size = 1;
 		s_p_get_uint16(&slurmdbd_conf->commit_delay,
 			       "CommitDelay", tbl);
 		s_p_get_string(&slurmdbd_conf->dbd_backup,
@@ -292,6 +303,9 @@ extern int read_slurmdbd_conf(void)
 			info("WARNING: MessageTimeout is too high for "
 			     "effective fault-tolerance");
 		}
+		if (!s_p_get_boolean((bool *)&slurmdbd_conf->partition_tables,
+				     "PartitionTables", tbl))
+			slurmdbd_conf->partition_tables = false;
 		s_p_get_string(&slurmdbd_conf->pid_file, "PidFile", tbl);
 		s_p_get_string(&slurmdbd_conf->plugindir, "PluginDir", tbl);
 
@@ -610,6 +624,8 @@ extern void log_config(void)
 	debug2("ArchiveScript     = %s", slurmdbd_conf->archive_script);
 	debug2("AuthInfo          = %s", slurmdbd_conf->auth_info);
 	debug2("AuthType          = %s", slurmdbd_conf->auth_type);
+	debug2("BatchDelay        = %u msec", slurmdbd_conf->batch_delay);
+	debug2("BatchSize         = %u", slurmdbd_conf->batch_size);
 	debug2("CommitDelay       = %u", slurmdbd_conf->commit_delay);
 	debug2("DbdAddr           = %s", slurmdbd_conf->dbd_addr);
 	debug2("DbdBackupHost     = %s", slurmdbd_conf->dbd_backup);
@@ -623,6 +639,7 @@ extern void log_config(void)
 
 	debug2("LogFile           = %s", slurmdbd_conf->log_file);
 	debug2("MessageTimeout    = %u", slurmdbd_conf->msg_timeout);
+	debug2("PartitionTables   = %u", slurmdbd_conf->partition_tables);
 	debug2("PidFile           = %s", slurmdbd_conf->pid_file);
 	debug2("PluginDir         = %s", slurmdbd_conf->plugindir);
 
@@ -773,6 +790,17 @@ extern List dump_config(void)
 	key_pair->value = xstrdup(slurmdbd_conf->auth_type);
 	list_append(my_list, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("BatchDelay");
+	key_pair->value = xstrdup_printf("%u msec",
+					 slurmdbd_conf->batch_delay);
+	list_append(my_list, key_pair);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("BatchSize");
+	key_pair->value = xstrdup_printf("%u", slurmdbd_conf->batch_size);
+	list_append(my_list, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("BOOT_TIME");
 	key_pair->value = xmalloc(128);
@@ -829,6 +857,12 @@ extern List dump_config(void)
 	key_pair->value = xstrdup_printf("%u secs", slurmdbd_conf->msg_timeout);
 	list_append(my_list, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("PartitionTables");
+	key_pair->value = xstrdup(slurmdbd_conf->partition_tables ?
+				  "Yes" : "No");
+	list_append(my_list, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("PidFile");
 	key_pair->value = xstrdup(slurmdbd_conf->pid_file);
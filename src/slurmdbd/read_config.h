@@ -50,6 +50,7 @@
 //#define DEFAULT_SLURMDBD_JOB_PURGE	12
 #define DEFAULT_SLURMDBD_PIDFILE	"/var/run/slurmdbd.pid"
 #define DEFAULT_SLURMDBD_ARCHIVE_DIR	"/tmp"
+#define DEFAULT_SLURMDBD_BATCH_SIZE	64
 //#define DEFAULT_SLURMDBD_STEP_PURGE	1
 
 /* SlurmDBD configuration parameters */
@@ -61,6 +62,10 @@ typedef struct slurm_dbd_conf {
 	char *		archive_script;	/* script to archive old data	*/
 	char *		auth_info;	/* authentication info		*/
 	char *		auth_type;	/* authentication mechanism	*/
+	uint32_t	batch_delay;	/* longest a step record waits
+					 * to be written, in msec	*/
+	uint32_t	batch_size;	/* step records written by one
+					 * statement			*/
 	uint16_t        commit_delay;   /* On busy systems delay
 					 * commits from slurmctld this
 					 * many seconds                 */
@@ -75,6 +80,8 @@ typedef struct slurm_dbd_conf {
 	char *		log_file;	/* Log file			*/
 	uint16_t        log_fmt;        /* Log file timestamt format    */
 	uint16_t        msg_timeout;    /* message timeout		*/
+	uint16_t        partition_tables; /* partition job and event
+					   * tables by month		*/
 	char *		pid_file;	/* where to store current PID	*/
 	char *		plugindir;	/* dir to look for plugins	*/
 	uint16_t        private_data;   /* restrict information         */
@@ -389,6 +389,69 @@ extern int launch_common_create_job_step(srun_job_t *job, bool use_all_cpus,
 	return SLURM_SUCCESS;
 }
 
+/*
+ * With LaunchParameters=stdio_direct, output files written for all tasks are
+ * opened by the tasks themselves, on a file system they share with srun,
+ * instead of having srun receive and write all of the output. srun creates
+ * or truncates the files here, and the tasks then open them in append mode
+ * so that no node truncates output already written by another one.
+ */
+static void _set_direct_stdio(srun_job_t *job, int file_flags)
+{
+	fname_t *fnames[2] = { job->ofname, job->efname };
+	char *launch_params;
+	bool direct;
+	int fd, i;
+
+	if (opt.labelio || opt.pty)
+		return;		/* output needs to go through srun */
+
+	launch_params = slurm_get_launch_params();
+	direct = (xstrcasestr(launch_params, "stdio_direct") != NULL);
+	xfree(launch_params);
+	if (!direct)
+		return;
+
+	/*
+	 * Per task file names are opened with the step's open mode, which is
+	 * forced to append below, leave those cases alone.
+	 */
+	for (i = 0; i < 2; i++) {
+		if (fnames[i]->type == IO_ONE)
+			return;
+		if ((fnames[i]->type == IO_PER_TASK) &&
+		    xstrcmp(fnames[i]->name, "/dev/null"))
+			return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if ((fnames[i]->type != IO_ALL) || !fnames[i]->name ||
+		    (fnames[i]->taskid != -1))
+			continue;
+		/*
+		 * The tasks open relative names in the job's working
+		 * directory, which need not be srun's (--chdir), so pass them
+		 * the same absolute path truncated here.
+		 */
+		if ((fnames[i]->name[0] != '/') && opt.cwd) {
+			char *path = xstrdup_printf("%s/%s", opt.cwd,
+						    fnames[i]->name);
+			xfree(fnames[i]->name);
+			fnames[i]->name = path;
+		}
+		if ((fd = open(fnames[i]->name, file_flags, 0644)) == -1) {
+			error("Could not open %s file: %m",
+			      i ? "stderr" : "stdout");
+			exit(error_exit);
+		}
+		close(fd);
+		debug("%s: tasks write %s directly", __func__,
+		      fnames[i]->name);
+		fnames[i]->type = IO_PER_TASK;
+		opt.open_mode = OPEN_MODE_APPEND;
+	}
+}
+
 extern void launch_common_set_stdio_fds(srun_job_t *job,
 					slurm_step_io_fds_t *cio_fds)
 {
@@ -409,6 +472,8 @@ extern void launch_common_set_stdio_fds(srun_job_t *job,
 		slurm_conf_unlock();
 	}
 
+	_set_direct_stdio(job, file_flags);
+
 	/*
 	 * create stdin file descriptor
 	 */
@@ -0,0 +1,158 @@
+/*****************************************************************************\
+ *  test12.9.prog.c - Read the records of some jobs from the database a
+ *  page at a time and compare them with the records read in one go.
+ *
+ *  Usage: test12.9.prog <page_size> <job_id>...
+ *****************************************************************************
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <slurm/slurm.h>
+#include <slurm/slurmdb.h>
+
+#define MAX_RECS 1000
+#define MAX_PAGES 100
+
+typedef struct {
+	uint32_t jobid;
+	time_t submit;
+} rec_t;
+
+/* Append the records of job_list to recs, RET the new record count */
+static int _add_recs(List job_list, rec_t *recs, int rec_cnt)
+{
+	slurmdb_job_rec_t *job;
+	ListIterator itr;
+
+	itr = slurm_list_iterator_create(job_list);
+	while ((job = slurm_list_next(itr)) && (rec_cnt < MAX_RECS)) {
+		printf("Record %u %ld\n", job->jobid, (long) job->submit);
+		recs[rec_cnt].jobid = job->jobid;
+		recs[rec_cnt].submit = job->submit;
+		rec_cnt++;
+	}
+	slurm_list_iterator_destroy(itr);
+
+	return rec_cnt;
+}
+
+static int _rec_cnt(rec_t *recs, int rec_cnt, rec_t *rec)
+{
+	int i, cnt = 0;
+
+	for (i = 0; i < rec_cnt; i++) {
+		if ((recs[i].jobid == rec->jobid) &&
+		    (recs[i].submit == rec->submit))
+			cnt++;
+	}
+
+	return cnt;
+}
+
+int main(int argc, char *argv[])
+{
+	slurmdb_job_cond_t job_cond;
+	slurmdb_selected_step_t *steps;
+	slurmdb_job_rec_t *job, *last_job = NULL;
+	ListIterator itr;
+	rec_t all[MAX_RECS], paged[MAX_RECS];
+	int all_cnt = 0, paged_cnt = 0, pages = 0, i, rc = 0;
+	char *page_cluster = NULL;
+	void *db_conn;
+	List job_list;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <page_size> <job_id>...\n", argv[0]);
+		exit(1);
+	}
+
+	if (!(db_conn = slurmdb_connection_get())) {
+		printf("FAILURE: no connection to the database\n");
+		exit(1);
+	}
+
+	memset(&job_cond, 0, sizeof(slurmdb_job_cond_t));
+	job_cond.duplicates = 1;
+	job_cond.without_usage_truncation = 1;
+	job_cond.step_list = slurm_list_create(NULL);
+	steps = calloc(argc - 2, sizeof(slurmdb_selected_step_t));
+	for (i = 0; i < (argc - 2); i++) {
+		steps[i].array_task_id = NO_VAL;
+		steps[i].jobid = atoi(argv[i + 2]);
+		steps[i].stepid = NO_VAL;
+		slurm_list_append(job_cond.step_list, &steps[i]);
+	}
+
+	if (!(job_list = slurmdb_jobs_get(db_conn, &job_cond))) {
+		printf("FAILURE: can not get the jobs\n");
+		exit(1);
+	}
+	all_cnt = _add_recs(job_list, all, all_cnt);
+	slurm_list_destroy(job_list);
+	printf("Records: %d\n", all_cnt);
+
+	job_cond.page_size = atoi(argv[1]);
+	while (pages++ < MAX_PAGES) {
+		if (!(job_list = slurmdb_jobs_get(db_conn, &job_cond))) {
+			printf("FAILURE: can not get page %d\n", pages);
+			exit(1);
+		}
+		paged_cnt = _add_recs(job_list, paged, paged_cnt);
+		if (slurm_list_count(job_list) < job_cond.page_size) {
+			slurm_list_destroy(job_list);
+			break;
+		}
+		/* The next page starts after the last job of this one */
+		itr = slurm_list_iterator_create(job_list);
+		while ((job = slurm_list_next(itr)))
+			last_job = job;
+		slurm_list_iterator_destroy(itr);
+		free(page_cluster);
+		page_cluster = strdup(last_job->cluster);
+		job_cond.page_cluster = page_cluster;
+		job_cond.page_jobid = last_job->jobid;
+		slurm_list_destroy(job_list);
+	}
+	printf("Paged records: %d in %d pages\n", paged_cnt, pages);
+
+	for (i = 0; i < all_cnt; i++) {
+		if (_rec_cnt(paged, paged_cnt, &all[i]) != 1) {
+			printf("Record %u %ld read %d times in pages\n",
+			       all[i].jobid, (long) all[i].submit,
+			       _rec_cnt(paged, paged_cnt, &all[i]));
+			rc = 1;
+		}
+	}
+	if (paged_cnt != all_cnt)
+		rc = 1;
+	if (!rc)
+		printf("Paged records match\n");
+
+	free(page_cluster);
+	free(steps);
+	slurm_list_destroy(job_cond.step_list);
+	slurmdb_connection_close(&db_conn);
+
+	return rc;
+}
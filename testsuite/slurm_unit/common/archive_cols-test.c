@@ -0,0 +1,163 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/archive_cols.h"
+#include "src/common/list.h"
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+#define ROWS 10000
+
+static char *col_names[] = { "time_submit", "time_end", "id_user",
+			     "`partition`", "job_name" };
+
+typedef struct {
+	int rows;
+	int bad;
+} scan_t;
+
+static void _make_row(int i, char **row)
+{
+	row[0] = xstrdup_printf("%d", 1000000 + (i * 10));
+	row[1] = xstrdup_printf("%d", 1000000 + (i * 10) + 5);
+	row[2] = xstrdup_printf("%d", (i < 5000) ? 100 : 200);
+	row[3] = (i % 2) ? "debug" : "batch";
+	row[4] = xstrdup_printf("job %d", i);
+}
+
+static int _check_row(char **row, void *arg)
+{
+	scan_t *scan = (scan_t *)arg;
+	char *exp[5];
+	int i = (atoi(row[0]) - 1000000) / 10, col;
+
+	_make_row(i, exp);
+	for (col = 0; col < 5; col++) {
+		if (strcmp(row[col], exp[col]))
+			scan->bad++;
+	}
+	xfree(exp[0]);
+	xfree(exp[1]);
+	xfree(exp[2]);
+	xfree(exp[4]);
+	scan->rows++;
+
+	return SLURM_SUCCESS;
+}
+
+static int _count_empty(char **row, void *arg)
+{
+	scan_t *scan = (scan_t *)arg;
+
+	if (!strcmp(row[0], "1") && !row[3][0] && !row[4][0])
+		scan->rows++;
+
+	return SLURM_SUCCESS;
+}
+
+int main (int argc, char *argv[])
+{
+	archive_cols_t *arch, *arch2 = NULL;
+	Buf buffer, buffer2;
+	List id_list;
+	char *row[5], *null_row[5] = { "1", "2", "3", NULL, NULL };
+	scan_t scan;
+	int i;
+
+	arch = archive_cols_create(col_names, 5, 0, 1, 2);
+	for (i = 0; i < ROWS; i++) {
+		_make_row(i, row);
+		archive_cols_add_row(arch, row);
+		xfree(row[0]);
+		xfree(row[1]);
+		xfree(row[2]);
+		xfree(row[4]);
+	}
+	buffer = init_buf(0);
+	archive_cols_pack(arch, buffer);
+	archive_cols_destroy(arch);
+	printf("wrote %u bytes for %d rows\n", get_buf_offset(buffer), ROWS);
+	TEST(get_buf_offset(buffer) >= (ROWS * 20), "columns are compressed");
+
+	set_buf_offset(buffer, 0);
+	TEST(!archive_cols_packed(buffer), "column archive recognized");
+	TEST(get_buf_offset(buffer), "recognized without unpacking");
+	TEST(archive_cols_unpack(&arch, buffer) != SLURM_SUCCESS, "unpack");
+	TEST(archive_cols_row_cnt(arch) != ROWS, "row count");
+	TEST(archive_cols_find_col(arch, "partition") != 3,
+	     "backquotes dropped from column names");
+	TEST(archive_cols_find_col(arch, "nothing") != -1, "unknown column");
+
+	memset(&scan, 0, sizeof(scan));
+	archive_cols_for_each(arch, 0, 0, NULL, _check_row, &scan);
+	TEST((scan.rows != ROWS) || scan.bad, "all rows read back");
+
+	/* Only the block holding these times is decoded */
+	memset(&scan, 0, sizeof(scan));
+	archive_cols_for_each(arch, 1000000 + 10, 1000000 + 20, NULL,
+			      _check_row, &scan);
+	TEST((scan.rows != ARCHIVE_COLS_BLOCK_ROWS) || scan.bad,
+	     "time range skips blocks");
+
+	memset(&scan, 0, sizeof(scan));
+	archive_cols_for_each(arch, 2000000, 0, NULL, _check_row, &scan);
+	TEST(scan.rows, "time range after all rows");
+
+	id_list = list_create(NULL);
+	list_append(id_list, "200");
+	memset(&scan, 0, sizeof(scan));
+	archive_cols_for_each(arch, 0, 0, id_list, _check_row, &scan);
+	TEST((scan.rows != (ROWS - ARCHIVE_COLS_BLOCK_ROWS)) || scan.bad,
+	     "id list skips blocks");
+	list_destroy(id_list);
+	archive_cols_destroy(arch);
+
+	/* A truncated buffer is refused */
+	buffer2 = create_buf(xmalloc(get_buf_offset(buffer) / 2),
+			     get_buf_offset(buffer) / 2);
+	memcpy(get_buf_data(buffer2), get_buf_data(buffer),
+	       get_buf_offset(buffer) / 2);
+	TEST(archive_cols_unpack(&arch2, buffer2) == SLURM_SUCCESS,
+	     "truncated archive refused");
+	TEST(arch2 != NULL, "no archive left of a truncated one");
+	free_buf(buffer2);
+
+	/* Jobs packed one by one start with the account string */
+	buffer2 = init_buf(0);
+	packstr("account", buffer2);
+	set_buf_offset(buffer2, 0);
+	TEST(archive_cols_packed(buffer2), "row archive not taken for columns");
+	free_buf(buffer2);
+	free_buf(buffer);
+
+	arch = archive_cols_create(col_names, 5, 0, 1, 2);
+	archive_cols_add_row(arch, null_row);
+	buffer = init_buf(0);
+	archive_cols_pack(arch, buffer);
+	archive_cols_destroy(arch);
+	set_buf_offset(buffer, 0);
+	archive_cols_unpack(&arch, buffer);
+	memset(&scan, 0, sizeof(scan));
+	archive_cols_for_each(arch, 0, 0, NULL, _count_empty, &scan);
+	TEST(scan.rows != 1, "NULL values read back as \"\"");
+	archive_cols_destroy(arch);
+	free_buf(buffer);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,236 @@
+/* Test of sacct --archive: jobs read from a column archive file must be
+ * selected by time window and state as the database selects them (see
+ * _state_time_string() and the eligible window of the mysql plugin), and
+ * files that are not column archives must be skipped.
+ */
+#include "src/db_api/archive_functions.c"
+
+/* dejagnu.h defines its own wait(), sys/wait.h comes with slurm.h */
+#define wait dejagnu_wait
+#include <testsuite/dejagnu.h>
+#undef wait
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+#define S 1000		/* window start */
+#define E 2000		/* window end */
+
+typedef struct {
+	char *jobid;
+	char *submit;
+	char *eligible;
+	char *start;
+	char *end;
+	char *state;
+	char *suspended;
+} test_job_t;
+
+/* Job 1 ended before the window, job 5 was eligible after it, job 6 still
+ * runs, job 7 was cancelled while held (never eligible) */
+static test_job_t test_jobs[] = {
+	{ "1", "400", "500", "600", "900", "3", "0" },		/* COMPLETE */
+	{ "2", "400", "500", "1500", "2500", "3", "0" },	/* COMPLETE */
+	{ "3", "400", "1200", "0", "0", "0", "0" },		/* PENDING */
+	{ "4", "400", "500", "800", "1800", "5", "50" },	/* FAILED */
+	{ "5", "2050", "2100", "2200", "2300", "3", "0" },	/* COMPLETE */
+	{ "6", "400", "500", "700", "0", "1", "100" },		/* RUNNING */
+	{ "7", "400", "0", "0", "1500", "4", "0" },		/* CANCELLED */
+	{ "8", "400", "1000", "1100", "1900", "3", "0" },	/* COMPLETE */
+};
+#define TEST_JOB_CNT (sizeof(test_jobs) / sizeof(test_job_t))
+
+static char *tmp_dir = NULL;
+
+static char *_write_archive(char *name, bool columns)
+{
+	char *path = xstrdup_printf("%s/%s", tmp_dir, name);
+	char *row[ARCH_JOB_COUNT];
+	archive_cols_t *arch;
+	Buf buffer;
+	int fd, i, j;
+
+	buffer = init_buf(BUF_SIZE);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(time(NULL), buffer);
+	pack16(DBD_GOT_JOBS, buffer);
+	packstr("test", buffer);
+	pack32(TEST_JOB_CNT, buffer);
+
+	if (columns) {
+		arch = archive_cols_create(arch_job_cols, ARCH_JOB_COUNT,
+					   ARCH_JOB_SUBMIT, ARCH_JOB_END,
+					   ARCH_JOB_UID);
+		for (i = 0; i < TEST_JOB_CNT; i++) {
+			for (j = 0; j < ARCH_JOB_COUNT; j++)
+				row[j] = "";
+			row[ARCH_JOB_JOBID] = test_jobs[i].jobid;
+			row[ARCH_JOB_SUBMIT] = test_jobs[i].submit;
+			row[ARCH_JOB_ELIGIBLE] = test_jobs[i].eligible;
+			row[ARCH_JOB_START] = test_jobs[i].start;
+			row[ARCH_JOB_END] = test_jobs[i].end;
+			row[ARCH_JOB_STATE] = test_jobs[i].state;
+			row[ARCH_JOB_SUSPENDED] = test_jobs[i].suspended;
+			row[ARCH_JOB_UID] = "0";
+			archive_cols_add_row(arch, row);
+		}
+		archive_cols_pack(arch, buffer);
+		archive_cols_destroy(arch);
+	} else {
+		/* Jobs packed a row at a time, as before the column format */
+		for (i = 0; i < TEST_JOB_CNT; i++) {
+			for (j = 0; j < ARCH_JOB_COUNT; j++)
+				packstr(test_jobs[i].jobid, buffer);
+		}
+	}
+
+	fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+	if ((fd < 0) ||
+	    (write(fd, get_buf_data(buffer), get_buf_offset(buffer)) !=
+	     get_buf_offset(buffer)))
+		perror(path);
+	if (fd >= 0)
+		close(fd);
+	free_buf(buffer);
+
+	return path;
+}
+
+static int _sort_jobid(void *x, void *y)
+{
+	slurmdb_job_rec_t *job1 = *(slurmdb_job_rec_t **)x;
+	slurmdb_job_rec_t *job2 = *(slurmdb_job_rec_t **)y;
+
+	return (int)job1->jobid - (int)job2->jobid;
+}
+
+/* The ids of the jobs of file_list selected by start, end and states, a
+ * comma separated list of job states */
+static char *_get_jobids(List file_list, time_t start, time_t end,
+			 char *states)
+{
+	slurmdb_job_cond_t job_cond;
+	slurmdb_job_rec_t *job;
+	List job_list;
+	ListIterator itr;
+	char *jobids = NULL;
+
+	memset(&job_cond, 0, sizeof(slurmdb_job_cond_t));
+	job_cond.usage_start = start;
+	job_cond.usage_end = end;
+	if (states) {
+		job_cond.state_list = list_create(slurm_destroy_char);
+		slurm_addto_char_list(job_cond.state_list, states);
+	}
+
+	if (!(job_list = slurmdb_archive_get_jobs(file_list, &job_cond)))
+		return xstrdup("error");
+	list_sort(job_list, _sort_jobid);
+	itr = list_iterator_create(job_list);
+	while ((job = list_next(itr)))
+		xstrfmtcat(jobids, "%s%u", jobids ? "," : "", job->jobid);
+	list_iterator_destroy(itr);
+	FREE_NULL_LIST(job_list);
+	FREE_NULL_LIST(job_cond.state_list);
+
+	return jobids ? jobids : xstrdup("");
+}
+
+static void _test_jobids(List file_list, time_t start, time_t end,
+			 char *states, char *expected, char *msg)
+{
+	char *jobids = _get_jobids(file_list, start, end, states);
+
+	if (xstrcmp(jobids, expected))
+		printf("got jobs \"%s\" instead of \"%s\"\n", jobids, expected);
+	TEST(xstrcmp(jobids, expected), msg);
+	xfree(jobids);
+}
+
+int main(int argc, char *argv[])
+{
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	char tmpl[] = "/tmp/archive_jobs-test.XXXXXX";
+	char pending[8], running[8], suspended[8], complete[8], failures[8];
+	char *states;
+	char *col_file, *row_file, *missing_file;
+	List file_list;
+
+	log_opts.stderr_level = LOG_LEVEL_QUIET;
+	log_init("archive_jobs-test", log_opts, 0, NULL);
+
+	if (!(tmp_dir = mkdtemp(tmpl))) {
+		perror("mkdtemp");
+		return 1;
+	}
+	snprintf(pending, sizeof(pending), "%d", JOB_PENDING);
+	snprintf(running, sizeof(running), "%d", JOB_RUNNING);
+	snprintf(suspended, sizeof(suspended), "%d", JOB_SUSPENDED);
+	snprintf(complete, sizeof(complete), "%d", JOB_COMPLETE);
+	snprintf(failures, sizeof(failures), "%d", JOB_FAILED);
+
+	col_file = _write_archive("col_job_table_archive", true);
+	row_file = _write_archive("row_job_table_archive", false);
+	missing_file = xstrdup_printf("%s/missing_job_table_archive", tmp_dir);
+	file_list = list_create(NULL);
+	list_append(file_list, col_file);
+
+	/* Jobs eligible during the window */
+	_test_jobids(file_list, S, E, NULL, "2,3,4,6,8",
+		     "eligible in window");
+	_test_jobids(file_list, S, 0, NULL, "2,3,4,5,6,7,8",
+		     "eligible after start");
+	_test_jobids(file_list, 0, E, NULL, "1,2,3,4,6,8",
+		     "eligible before end");
+	_test_jobids(file_list, 0, 0, NULL, "1,2,3,4,5,6,7,8",
+		     "no window");
+
+	/* Jobs in a state during the window */
+	_test_jobids(file_list, S, E, pending, "2,3,7,8", "pending in window");
+	_test_jobids(file_list, S, 0, pending, "2,3,8",
+		     "pending after start");
+	_test_jobids(file_list, 0, E, pending, "1,2,3,4,6,8",
+		     "pending before end");
+	_test_jobids(file_list, S, E, running, "2,4,8", "running in window");
+	_test_jobids(file_list, S, 0, running, "4,6", "running after start");
+	_test_jobids(file_list, 0, E, running, "1,2,4,6,8",
+		     "running before end");
+	_test_jobids(file_list, S, E, suspended, "4,6",
+		     "suspended in window");
+	_test_jobids(file_list, S, 0, suspended, "4,6",
+		     "suspended after start");
+	_test_jobids(file_list, S, E, complete, "8", "completed in window");
+	_test_jobids(file_list, S, 0, complete, "2,5,8",
+		     "completed after start");
+	_test_jobids(file_list, 0, E, complete, "1,8", "completed before end");
+	_test_jobids(file_list, 0, 0, complete, "1,2,5,8",
+		     "completed, no window");
+	_test_jobids(file_list, S, E, failures, "4", "failed in window");
+	states = xstrdup_printf("%s,%s", pending, failures);
+	_test_jobids(file_list, S, E, states, "2,3,4,7,8",
+		     "pending or failed in window");
+	xfree(states);
+
+	/* Row format archives can only be loaded into the database */
+	list_append(file_list, row_file);
+	list_append(file_list, missing_file);
+	_test_jobids(file_list, S, E, NULL, "2,3,4,6,8",
+		     "unreadable archives skipped");
+
+	FREE_NULL_LIST(file_list);
+	unlink(col_file);
+	unlink(row_file);
+	rmdir(tmp_dir);
+	xfree(col_file);
+	xfree(row_file);
+	xfree(missing_file);
+
+	totals();
+	return failed;
+}
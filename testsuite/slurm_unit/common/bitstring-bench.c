@@ -0,0 +1,105 @@
+/* Microbenchmark of src/common/bitstring.c on core sized bitmaps
+ *
+ * Usage: bitstring-bench [nbits [iterations]]
+ *
+ * Prints the time per call of the bitmap operations used by the scheduler,
+ * for each word kernel level the CPU supports.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <src/common/bitstring.h>
+
+#define BENCH(_name, _call) do {					\
+	struct timeval tv1, tv2;					\
+	double usec;							\
+	int i;								\
+									\
+	gettimeofday(&tv1, NULL);					\
+	for (i = 0; i < iters; i++)					\
+		sink += (int64_t) (_call);				\
+	gettimeofday(&tv2, NULL);					\
+	usec = (tv2.tv_sec - tv1.tv_sec) * 1000000.0 +			\
+	       (tv2.tv_usec - tv1.tv_usec);				\
+	printf("  %-18s %10.1f ns\n", _name, usec * 1000.0 / iters);	\
+} while (0)
+
+static const char *level_names[] = { "portable", "sse4.2", "avx2" };
+
+static volatile int64_t sink;
+
+/* What callers did before bit_overlap and bit_and_into */
+static int _copy_and_count(bitstr_t *b1, bitstr_t *b2)
+{
+	bitstr_t *tmp = bit_copy(b1);
+	int count;
+
+	bit_and(tmp, b2);
+	count = bit_set_count(tmp);
+	bit_free(tmp);
+	return count;
+}
+
+int
+main(int argc, char *argv[])
+{
+	bitoff_t nbits = 100000, bit, last;
+	int iters = 20000, level;
+	bitstr_t *dense, *sparse, *full, *work;
+
+	if (argc > 1)
+		nbits = atoi(argv[1]);
+	if (argc > 2)
+		iters = atoi(argv[2]);
+	if ((nbits < 2) || (iters < 1)) {
+		fprintf(stderr, "Usage: %s [nbits [iterations]]\n", argv[0]);
+		exit(1);
+	}
+
+	/* allocated cores: about half, in runs as left by jobs */
+	dense = bit_alloc(nbits);
+	srandom(1);
+	for (bit = 0; bit < nbits; bit += 1 + random() % 64) {
+		last = bit + random() % 64;
+		if (random() % 2)
+			bit_nset(dense, bit, (last < nbits) ? last : nbits - 1);
+	}
+	/* a single free core at the end, the worst case for searches */
+	sparse = bit_alloc(nbits);
+	bit_set(sparse, nbits - 1);
+	full = bit_alloc(nbits);
+	bit_set_all(full);
+	bit_clear(full, nbits - 1);
+	work = bit_copy(dense);
+
+	printf("%"PRId64" bits, %d iterations\n", (int64_t) nbits, iters);
+	for (level = BIT_SIMD_NONE; level <= BIT_SIMD_AVX2; level++) {
+		if (bit_simd_select(level) != level)
+			break;
+		printf("%s:\n", level_names[level]);
+		BENCH("bit_set_count", bit_set_count(dense));
+		BENCH("bit_overlap", bit_overlap(dense, full));
+		BENCH("bit_super_set", bit_super_set(dense, full));
+		BENCH("bit_ffs", bit_ffs(sparse));
+		BENCH("bit_ffc", bit_ffc(full));
+		BENCH("bit_nffs", bit_nffs(sparse, 1));
+		BENCH("bit_nffc", bit_nffc(dense, 64));
+		BENCH("bit_and", (bit_and(work, full), 0));
+		BENCH("bit_and_not", (bit_and_not(work, sparse), 0));
+		BENCH("bit_or", (bit_or(work, dense), 0));
+		BENCH("bit_not", (bit_not(work), 0));
+		BENCH("copy+and+count", _copy_and_count(dense, full));
+		BENCH("bit_and_into", (bit_and_into(work, dense, full), 0));
+		BENCH("bit_and_not_count", bit_and_not_count(dense, sparse));
+		BENCH("scratch alloc", (bit_scratch_free(
+					bit_scratch_alloc(nbits)), 0));
+	}
+
+	bit_free(dense);
+	bit_free(sparse);
+	bit_free(full);
+	bit_free(work);
+	return 0;
+}
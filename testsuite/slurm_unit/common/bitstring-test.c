@@ -21,6 +21,80 @@
 } while (0)
 
 
+/*
+ * Check the word kernels against bit by bit results, on a bitmap with
+ * about (100 - percent)% of its bits set
+ */
+static int
+check_kernels(bitoff_t nbits, int percent)
+{
+	bitstr_t *b1 = bit_alloc(nbits), *b2 = bit_alloc(nbits);
+	bitstr_t *b3 = bit_alloc(nbits);
+	bitoff_t bit, first_set = -1, first_clear = -1;
+	int32_t set = 0, both = 0, run = 0, run_start = -1, n = 3;
+	int super = 1, ok = 1;
+
+	for (bit = 0; bit < nbits; bit++) {
+		if ((random() % 1000) < (percent * 10))
+			bit_set(b1, bit);
+		if ((random() % 2) || bit_test(b1, bit))
+			bit_set(b2, bit);
+	}
+	bit_not(b1);		/* also sets the bits after nbits */
+	for (bit = 0; bit < nbits; bit++) {
+		if (bit_test(b1, bit)) {
+			set++;
+			if (first_set == -1)
+				first_set = bit;
+			if (bit_test(b2, bit))
+				both++;
+			else
+				super = 0;
+			run = 0;
+		} else {
+			if (first_clear == -1)
+				first_clear = bit;
+			if ((++run >= n) && (run_start == -1))
+				run_start = bit - n + 1;
+		}
+	}
+
+	ok &= (bit_set_count(b1) == set);
+	ok &= (bit_overlap(b1, b2) == both);
+	ok &= (bit_super_set(b1, b2) == super);
+	ok &= (bit_ffs(b1) == first_set);
+	ok &= (bit_ffc(b1) == first_clear);
+	if (n < nbits)
+		ok &= (bit_nffc(b1, n) == run_start);
+
+	bit_copybits(b3, b1);
+	bit_and(b3, b2);
+	ok &= (bit_set_count(b3) == both);
+	bit_copybits(b3, b1);
+	bit_and_not(b3, b2);
+	ok &= (bit_set_count(b3) == set - both);
+	bit_copybits(b3, b1);
+	bit_or(b3, b2);
+	ok &= (bit_set_count(b3) == bit_set_count(b2) + set - both);
+	bit_not(b3);
+	ok &= (bit_set_count(b3) == nbits - bit_set_count(b2) - set + both);
+	ok &= (bit_nffs(b1, 1) == first_set);
+
+	ok &= (bit_and_not_count(b1, b2) == set - both);
+	bit_and_into(b3, b1, b2);
+	ok &= (bit_set_count(b3) == both);
+	bit_and_not_into(b3, b1, b2);
+	ok &= (bit_set_count(b3) == set - both);
+	bit_copybits(b3, b1);
+	bit_and_into(b3, b3, b2);
+	ok &= (bit_set_count(b3) == both);
+
+	bit_free(b1);
+	bit_free(b2);
+	bit_free(b3);
+	return ok;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -202,6 +276,44 @@ main(int argc, char *argv[])
 		TEST(bit_equal(bs, bs2), "bitstring");
 	}
 
+	note("Testing scratch bitmaps");
+	{
+		bitstr_t *bs = bit_scratch_alloc(1000), *bs2;
+
+		TEST(bit_size(bs) == 1000, "scratch");
+		bit_scratch_free(bs);
+		bs2 = bit_scratch_alloc(1000);
+		TEST(bs2 == bs, "scratch reused");
+		bs = bit_scratch_alloc(1000);
+		TEST((bs != bs2) && (bit_size(bs) == 1000), "scratch");
+		bit_scratch_free(bs);
+		bit_scratch_free(bs2);
+		bs = bit_scratch_alloc(64);
+		TEST(bit_size(bs) == 64, "scratch size");
+		bit_scratch_free(bs);
+	}
+
+	note("Testing word kernels");
+	{
+		bitoff_t sizes[] = { 1, 63, 64, 65, 130, 1000, 100003 };
+		int percents[] = { 0, 1, 75, 99, 100 };
+		int i, j, level, ok;
+
+		for (level = BIT_SIMD_NONE; level <= BIT_SIMD_AVX2; level++) {
+			if (bit_simd_select(level) != level)
+				break;
+			ok = 1;
+			for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+				for (j = 0; j < 5; j++) {
+					ok &= check_kernels(sizes[i],
+							    percents[j]);
+				}
+			}
+			TEST(ok, "bitstring kernels");
+		}
+		bit_simd_select(BIT_SIMD_AVX2);
+	}
+
 	totals();
 	return failed;
 }
@@ -0,0 +1,256 @@
+/* Compare the columnar profile file format with the HDF5 packet tables
+ * written by the acct_gather_profile/hdf5 plugin
+ *
+ * Usage: columnar-bench [samples [directory]]
+ *
+ * Writes one series of task like samples in both formats, then prints the
+ * write time and file size per sample, the time to read every sample back
+ * and the time to read a 100 sample window from the middle of the series.
+ * HDF5 tables use the plugin settings (chunks of 10 packets, no
+ * compression) and the window is found with a binary search on the time,
+ * as sh5util does.
+ */
+#ifdef WITH_HDF5
+/* Before the Slurm headers, which disable the deprecated HDF5 API */
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/xstring.h"
+#include "src/plugins/acct_gather_profile/columnar/columnar_api.h"
+
+#define START_TIME 1500000000
+#define FREQ 30
+#define WINDOW 100
+
+typedef struct {
+	uint64_t time;
+	uint64_t cpu_freq;
+	double cpu_util;
+	uint64_t rss;
+} sample_t;
+
+static acct_gather_profile_dataset_t fields[] = {
+	{ "CPUFrequency", PROFILE_FIELD_UINT64 },
+	{ "CPUUtilization", PROFILE_FIELD_DOUBLE },
+	{ "RSS", PROFILE_FIELD_UINT64 },
+	{ NULL, PROFILE_FIELD_NOT_SET }
+};
+
+static volatile double sink;
+
+static double _now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void _make_sample(long i, sample_t *s)
+{
+	s->time = START_TIME + i * FREQ;
+	s->cpu_freq = 2400000 + (i % 3) * 100000;
+	s->cpu_util = 90.0 + (i % 17) * 0.5;
+	s->rss = 1048576 + (i % 100) * 4096;
+}
+
+static void _report(const char *format, const char *name, double secs,
+		    long samples, off_t size)
+{
+	printf("%-8s %-12s %10.1f ns/sample", format, name,
+	       secs * 1000000000.0 / samples);
+	if (size)
+		printf(" %8.2f bytes/sample", (double) size / samples);
+	printf("\n");
+}
+
+static int _col_sum(col_series_t *series, time_t sample_time,
+		    col_value_t *values, void *arg)
+{
+	long *cnt = (long *) arg;
+
+	sink += values[1].d;
+	(*cnt)++;
+	return SLURM_SUCCESS;
+}
+
+static int _bench_columnar(const char *dir, long samples)
+{
+	char *path = xstrdup_printf("%s/bench%s", dir, COL_FILE_SUFFIX);
+	col_header_t header;
+	col_writer_t *writer;
+	col_reader_t *reader;
+	struct stat st;
+	sample_t s;
+	double t0;
+	long i, cnt;
+	int id, rc = SLURM_ERROR;
+
+	memset(&header, 0, sizeof(col_header_t));
+	header.job_id = 1;
+	header.node_name = "n0";
+	header.ntasks = 1;
+	header.start_time = START_TIME;
+
+	t0 = _now();
+	if (!(writer = col_writer_open(path, &header)))
+		goto end;
+	id = col_writer_add_series(writer, "n0/Tasks/0", fields);
+	for (i = 0; i < samples; i++) {
+		_make_sample(i, &s);
+		col_writer_append(writer, id, s.time, &s.cpu_freq);
+	}
+	if (col_writer_close(writer) != SLURM_SUCCESS)
+		goto end;
+	stat(path, &st);
+	_report("columnar", "write", _now() - t0, samples, st.st_size);
+
+	t0 = _now();
+	cnt = 0;
+	if (!(reader = col_reader_open(path)))
+		goto end;
+	col_reader_scan(reader, 0, 0, 0, _col_sum, &cnt);
+	_report("columnar", "full read", _now() - t0, cnt, 0);
+
+	t0 = _now();
+	cnt = 0;
+	col_reader_scan(reader, 0, START_TIME + (samples / 2) * FREQ,
+			START_TIME + (samples / 2 + WINDOW - 1) * FREQ,
+			_col_sum, &cnt);
+	printf("%-8s %-12s %10.1f us for %ld samples\n", "columnar", "window",
+	       (_now() - t0) * 1000000.0, cnt);
+	col_reader_close(reader);
+	rc = SLURM_SUCCESS;
+end:
+	unlink(path);
+	xfree(path);
+	return rc;
+}
+
+#ifdef WITH_HDF5
+static hsize_t _h5_search(hid_t table, uint64_t when, hsize_t lo, hsize_t hi)
+{
+	sample_t s;
+	hsize_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (H5PTread_packets(table, mid, 1, &s) < 0)
+			break;
+		if (s.time < when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int _bench_hdf5(const char *dir, long samples)
+{
+	char *path = xstrdup_printf("%s/bench.h5", dir);
+	hid_t file, type, table;
+	hsize_t first, last, nrecords;
+	sample_t s, *buf;
+	struct stat st;
+	double t0;
+	long i;
+
+	type = H5Tcreate(H5T_COMPOUND, sizeof(sample_t));
+	H5Tinsert(type, "EpochTime", HOFFSET(sample_t, time),
+		  H5T_NATIVE_UINT64);
+	H5Tinsert(type, "CPUFrequency", HOFFSET(sample_t, cpu_freq),
+		  H5T_NATIVE_UINT64);
+	H5Tinsert(type, "CPUUtilization", HOFFSET(sample_t, cpu_util),
+		  H5T_NATIVE_DOUBLE);
+	H5Tinsert(type, "RSS", HOFFSET(sample_t, rss), H5T_NATIVE_UINT64);
+
+	t0 = _now();
+	file = H5Fcreate(path, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file < 0) {
+		H5Tclose(type);
+		xfree(path);
+		return SLURM_ERROR;
+	}
+	/* HDF5_CHUNK_SIZE and HDF5_COMPRESS of hdf5_api.c */
+	table = H5PTcreate_fl(file, "Tasks", type, 10, -1);
+	for (i = 0; i < samples; i++) {
+		_make_sample(i, &s);
+		H5PTappend(table, 1, &s);
+	}
+	H5PTclose(table);
+	H5Fclose(file);
+	stat(path, &st);
+	_report("hdf5", "write", _now() - t0, samples, st.st_size);
+
+	t0 = _now();
+	file = H5Fopen(path, H5F_ACC_RDONLY, H5P_DEFAULT);
+	table = H5PTopen(file, "Tasks");
+	H5PTget_num_packets(table, &nrecords);
+	buf = malloc(sizeof(sample_t) * nrecords);
+	H5PTread_packets(table, 0, nrecords, buf);
+	for (i = 0; i < nrecords; i++)
+		sink += buf[i].cpu_util;
+	_report("hdf5", "full read", _now() - t0, nrecords, 0);
+
+	t0 = _now();
+	first = _h5_search(table, START_TIME + (samples / 2) * FREQ,
+			   0, nrecords);
+	last = _h5_search(table, START_TIME + (samples / 2 + WINDOW) * FREQ,
+			  first, nrecords);
+	H5PTread_packets(table, first, last - first, buf);
+	for (i = 0; i < last - first; i++)
+		sink += buf[i].cpu_util;
+	printf("%-8s %-12s %10.1f us for %ld samples\n", "hdf5", "window",
+	       (_now() - t0) * 1000000.0, (long) (last - first));
+
+	free(buf);
+	H5PTclose(table);
+	H5Fclose(file);
+	H5Tclose(type);
+	unlink(path);
+	xfree(path);
+	return SLURM_SUCCESS;
+}
+#endif
+
+int
+main(int argc, char *argv[])
+{
+	long samples = 100000;
+	char *dir = "/tmp";
+
+	if (argc > 1)
+		samples = atol(argv[1]);
+	if (argc > 2)
+		dir = argv[2];
+	if (samples < 2 * WINDOW) {
+		fprintf(stderr, "Usage: %s [samples [directory]]\n", argv[0]);
+		exit(1);
+	}
+
+	printf("%ld samples, 3 fields, every %d seconds\n", samples, FREQ);
+	if (_bench_columnar(dir, samples) != SLURM_SUCCESS) {
+		perror("columnar");
+		exit(1);
+	}
+#ifdef WITH_HDF5
+	if (_bench_hdf5(dir, samples) != SLURM_SUCCESS) {
+		fprintf(stderr, "hdf5: cannot create the file\n");
+		exit(1);
+	}
+#else
+	printf("hdf5 not available\n");
+#endif
+	return 0;
+}
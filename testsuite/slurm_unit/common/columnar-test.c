@@ -0,0 +1,442 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/log.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/plugins/acct_gather_profile/columnar/columnar_api.h"
+
+/* dejagnu.h defines its own wait(), sys/wait.h comes with the plugin API */
+#define wait dejagnu_wait
+#include <testsuite/dejagnu.h>
+#undef wait
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+#define SAMPLES 1000
+#define START_TIME 1500000000
+#define NODES 3
+
+static acct_gather_profile_dataset_t mixed_fields[] = {
+	{ "Counter", PROFILE_FIELD_UINT64 },
+	{ "Any", PROFILE_FIELD_UINT64 },
+	{ "Value", PROFILE_FIELD_DOUBLE },
+	{ NULL, PROFILE_FIELD_NOT_SET }
+};
+
+static acct_gather_profile_dataset_t double_fields[] = {
+	{ "Power", PROFILE_FIELD_DOUBLE },
+	{ NULL, PROFILE_FIELD_NOT_SET }
+};
+
+typedef struct {
+	int node;
+	int series;		/* 0 mixed fields, 1 doubles only */
+	int samples;
+	int bad;
+	time_t last_time;
+} scan_t;
+
+static char *tmp_dir = NULL;
+
+/* Irregular sample times: repeated times, small steps and gaps longer
+ * than COL_CHUNK_SECS, so the delta of delta time encoding is exercised
+ * in both directions and chunks get flushed early */
+static time_t _sample_time(int i)
+{
+	time_t t = START_TIME + (i * 10);
+
+	if (i % 7 == 3)
+		t -= 10;	/* same time as the previous sample */
+	if (i > 500)
+		t += 3600;
+	if (i > 800)
+		t += (i - 800) * 400;
+	return t;
+}
+
+/* Values stressing the zigzag delta and XOR encodings: counters going
+ * up, values jumping between 0 and UINT64_MAX, and doubles of every sign
+ * and magnitude including infinities and NaN */
+static void _sample_values(int node, int series, int i, uint64_t *data)
+{
+	double d;
+
+	if (series == 1) {
+		d = (i % 5) ? (i * 1.5 + node) : -0.0;
+		memcpy(&data[0], &d, sizeof(double));
+		return;
+	}
+
+	data[0] = (uint64_t) i * 4096 + node;
+	switch (i % 4) {
+	case 0:
+		data[1] = 0;
+		break;
+	case 1:
+		data[1] = UINT64_MAX;
+		break;
+	case 2:
+		data[1] = (uint64_t) 1 << 63;
+		break;
+	default:
+		data[1] = i;
+	}
+	switch (i % 6) {
+	case 0:
+		d = i * 0.1 + node;
+		break;
+	case 1:
+		d = -1e300;
+		break;
+	case 2:
+		d = INFINITY;
+		break;
+	case 3:
+		d = NAN;
+		break;
+	case 4:
+		d = 5e-324;	/* smallest denormal */
+		break;
+	default:
+		d = i * 0.1 + node;	/* unchanged from two samples ago */
+	}
+	memcpy(&data[2], &d, sizeof(double));
+}
+
+static char *_node_file(int node)
+{
+	return xstrdup_printf("%s/node%d%s", tmp_dir, node, COL_FILE_SUFFIX);
+}
+
+static int _write_node_file(char *path, int node, int samples)
+{
+	col_header_t header;
+	col_writer_t *writer;
+	char *name;
+	uint64_t data[3];
+	int i, mixed, doubles, rc = SLURM_SUCCESS;
+
+	memset(&header, 0, sizeof(col_header_t));
+	header.job_id = 42;
+	header.step_id = 1;
+	header.node_name = xstrdup_printf("n%d", node);
+	header.node_id = node;
+	header.ntasks = node + 1;
+	header.cpus_per_task = 2;
+	header.start_time = START_TIME + 100 - node;
+
+	if (!(writer = col_writer_open(path, &header))) {
+		xfree(header.node_name);
+		return SLURM_ERROR;
+	}
+	name = xstrdup_printf("n%d/Tasks/0", node);
+	mixed = col_writer_add_series(writer, name, mixed_fields);
+	xfree(name);
+	name = xstrdup_printf("n%d/Energy", node);
+	doubles = col_writer_add_series(writer, name, double_fields);
+	xfree(name);
+	if ((mixed < 0) || (doubles < 0))
+		rc = SLURM_ERROR;
+
+	/* The series are interleaved in the file */
+	for (i = 0; (i < samples) && (rc == SLURM_SUCCESS); i++) {
+		_sample_values(node, 0, i, data);
+		rc = col_writer_append(writer, mixed, _sample_time(i), data);
+		if ((rc == SLURM_SUCCESS) && (i % 2 == 0)) {
+			_sample_values(node, 1, i / 2, data);
+			rc = col_writer_append(writer, doubles,
+					       _sample_time(i / 2), data);
+		}
+	}
+	if (col_writer_close(writer) != SLURM_SUCCESS)
+		rc = SLURM_ERROR;
+	xfree(header.node_name);
+
+	return rc;
+}
+
+static int _check_sample(col_series_t *series, time_t sample_time,
+			 col_value_t *values, void *arg)
+{
+	scan_t *scan = (scan_t *) arg;
+	uint64_t exp[3];
+	int i = scan->samples;
+
+	/* the scan may start anywhere, find the index from the time */
+	if (!scan->samples) {
+		while ((i < SAMPLES) && (_sample_time(i) < sample_time))
+			i++;
+		scan->samples = i;
+	}
+	if ((i >= SAMPLES) || (sample_time != _sample_time(i)) ||
+	    (sample_time < scan->last_time)) {
+		scan->bad++;
+	} else {
+		_sample_values(scan->node, scan->series, i, exp);
+		if (memcmp(values, exp, sizeof(uint64_t) * series->nfields))
+			scan->bad++;
+	}
+	scan->last_time = sample_time;
+	scan->samples++;
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Scan a series between start and end, RET the index following the last
+ * sample read (the sample count for a whole scan) or -1 if any was bad
+ */
+static int _scan(col_reader_t *reader, int id, int node, int series,
+		 time_t start, time_t end)
+{
+	scan_t scan;
+
+	memset(&scan, 0, sizeof(scan_t));
+	scan.node = node;
+	scan.series = series;
+	if (col_reader_scan(reader, id, start, end, _check_sample, &scan) !=
+	    SLURM_SUCCESS)
+		return -1;
+	if (scan.bad)
+		return -1;
+	return scan.samples;
+}
+
+static void _test_round_trip(void)
+{
+	char *path = _node_file(0);
+	col_reader_t *reader;
+	col_series_t *series;
+	col_header_t *header;
+	int id, cnt;
+	time_t start, end;
+
+	TEST(_write_node_file(path, 0, SAMPLES) != SLURM_SUCCESS,
+	     "write node file");
+	reader = col_reader_open(path);
+	TEST(!reader, "open node file");
+	if (!reader) {
+		xfree(path);
+		return;
+	}
+
+	header = col_reader_header(reader);
+	TEST((header->job_id != 42) || (header->step_id != 1) ||
+	     xstrcmp(header->node_name, "n0") || (header->ntasks != 1) ||
+	     (header->cpus_per_task != 2) ||
+	     (header->start_time != START_TIME + 100),
+	     "header read back");
+	TEST(col_reader_series_count(reader) != 2, "series count");
+
+	id = col_reader_find_series(reader, "n0/Tasks/0");
+	series = (id < 0) ? NULL : col_reader_series(reader, id);
+	TEST(!series || (series->nfields != 3) ||
+	     xstrcmp(series->field_names[2], "Value") ||
+	     (series->field_types[0] != PROFILE_FIELD_UINT64) ||
+	     (series->field_types[2] != PROFILE_FIELD_DOUBLE),
+	     "series definition read back");
+	TEST(col_reader_find_series(reader, "n1/Tasks/0") != -1,
+	     "unknown series");
+
+	TEST(_scan(reader, id, 0, 0, 0, 0) != SAMPLES,
+	     "uint64 and double columns read back");
+	id = col_reader_find_series(reader, "n0/Energy");
+	TEST(_scan(reader, id, 0, 1, 0, 0) != SAMPLES / 2,
+	     "double only series read back");
+
+	/* A window in the middle and one after a gap */
+	id = col_reader_find_series(reader, "n0/Tasks/0");
+	start = _sample_time(300);
+	end = _sample_time(399);
+	cnt = _scan(reader, id, 0, 0, start, end);
+	TEST(cnt != 400, "time window read back");
+	start = _sample_time(850);
+	end = _sample_time(860);
+	cnt = _scan(reader, id, 0, 0, start, end);
+	TEST(cnt != 861, "time window after gaps read back");
+	cnt = _scan(reader, id, 0, 0, _sample_time(SAMPLES - 1) + 1, 0);
+	TEST(cnt != 0, "time window after the last sample");
+
+	col_reader_close(reader);
+	unlink(path);
+	xfree(path);
+}
+
+static int _copy_prefix(char *data, size_t len, char *path)
+{
+	FILE *fp = fopen(path, "w");
+	int rc = SLURM_SUCCESS;
+
+	if (!fp)
+		return SLURM_ERROR;
+	if (len && (fwrite(data, 1, len, fp) != len))
+		rc = SLURM_ERROR;
+	if (fclose(fp))
+		rc = SLURM_ERROR;
+	return rc;
+}
+
+/* A file cut at every possible byte must read back a prefix of its
+ * samples, as if the node crashed while writing it */
+static void _test_truncated(void)
+{
+	char *path = _node_file(1), *cut = NULL, *data;
+	col_reader_t *reader;
+	struct stat st;
+	FILE *fp;
+	size_t len;
+	int id, cnt, last_cnt = 0, bad = 0, opened = 0;
+
+	if (_write_node_file(path, 1, 300) != SLURM_SUCCESS ||
+	    stat(path, &st) || !(fp = fopen(path, "r"))) {
+		fail("write file to truncate");
+		xfree(path);
+		return;
+	}
+	data = xmalloc(st.st_size);
+	if (fread(data, 1, st.st_size, fp) != st.st_size)
+		bad++;
+	fclose(fp);
+
+	cut = xstrdup_printf("%s/cut%s", tmp_dir, COL_FILE_SUFFIX);
+	for (len = 0; len <= st.st_size; len++) {
+		if (_copy_prefix(data, len, cut) != SLURM_SUCCESS) {
+			bad++;
+			break;
+		}
+		if (!(reader = col_reader_open(cut)))
+			continue;
+		opened++;
+		cnt = 0;
+		id = col_reader_find_series(reader, "n1/Tasks/0");
+		if (id >= 0)
+			cnt = _scan(reader, id, 1, 0, 0, 0);
+		/* no sample may be lost once it was complete */
+		if ((cnt < 0) || (cnt < last_cnt))
+			bad++;
+		last_cnt = cnt;
+		col_reader_close(reader);
+	}
+	TEST(bad, "truncated files read a prefix of the samples");
+	TEST(!opened || (last_cnt != 300), "complete file read whole");
+
+	/* Blocks allocated but never written read back as zeros */
+	data = xrealloc(data, st.st_size + 4096);
+	memset(data + st.st_size, 0, 4096);
+	if (_copy_prefix(data, st.st_size + 4096, cut) != SLURM_SUCCESS)
+		fail("write zero filled file");
+	reader = col_reader_open(cut);
+	cnt = -1;
+	if (reader) {
+		id = col_reader_find_series(reader, "n1/Tasks/0");
+		cnt = _scan(reader, id, 1, 0, 0, 0);
+		col_reader_close(reader);
+	}
+	TEST(cnt != 300, "zero filled end of file ignored");
+
+	/* Not a profile file */
+	memcpy(data, "SLURMCOX", COL_MAGIC_LEN);
+	if (_copy_prefix(data, st.st_size, cut) != SLURM_SUCCESS)
+		fail("write bad magic file");
+	reader = col_reader_open(cut);
+	TEST(reader != NULL, "bad magic refused");
+	col_reader_close(reader);
+
+	unlink(cut);
+	unlink(path);
+	xfree(cut);
+	xfree(data);
+	xfree(path);
+}
+
+static void _test_merge(void)
+{
+	char *files[NODES], *merged, name[64];
+	col_reader_t *reader;
+	col_header_t *header;
+	int node, id, bad = 0;
+
+	for (node = 0; node < NODES; node++) {
+		files[node] = _node_file(node);
+		if (_write_node_file(files[node], node, SAMPLES) !=
+		    SLURM_SUCCESS)
+			bad++;
+	}
+	TEST(bad, "write node files to merge");
+
+	merged = xstrdup_printf("%s/merged%s", tmp_dir, COL_FILE_SUFFIX);
+	TEST(col_merge_files(merged, files, NODES, 2) != SLURM_SUCCESS,
+	     "merge node files");
+	reader = col_reader_open(merged);
+	TEST(!reader, "open merged file");
+	if (reader) {
+		header = col_reader_header(reader);
+		TEST((header->job_id != 42) ||
+		     (header->node_name && header->node_name[0]) ||
+		     (header->ntasks != 6) ||
+		     (header->start_time != START_TIME + 100 - (NODES - 1)),
+		     "merged header");
+		TEST(col_reader_series_count(reader) != 2 * NODES,
+		     "merged series count");
+		for (node = 0; node < NODES; node++) {
+			snprintf(name, sizeof(name), "n%d/Tasks/0", node);
+			id = col_reader_find_series(reader, name);
+			if ((id < 0) ||
+			    (_scan(reader, id, node, 0, 0, 0) !=
+			     SAMPLES))
+				bad++;
+			snprintf(name, sizeof(name), "n%d/Energy", node);
+			id = col_reader_find_series(reader, name);
+			if ((id < 0) ||
+			    (_scan(reader, id, node, 1, 0, 0) !=
+			     SAMPLES / 2))
+				bad++;
+		}
+		TEST(bad, "merged samples read back");
+		col_reader_close(reader);
+	}
+
+	unlink(merged);
+	xfree(merged);
+	for (node = 0; node < NODES; node++) {
+		unlink(files[node]);
+		xfree(files[node]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	log_options_t log_opts = LOG_OPTS_STDERR_ONLY;
+	char tmpl[] = "/tmp/columnar-test.XXXXXX";
+
+	if (!(tmp_dir = mkdtemp(tmpl))) {
+		perror("mkdtemp");
+		return 1;
+	}
+	/* the reader reports every truncated file */
+	log_opts.stderr_level = LOG_LEVEL_QUIET;
+	log_init("columnar-test", log_opts, 0, NULL);
+
+	_test_round_trip();
+	_test_truncated();
+	_test_merge();
+
+	rmdir(tmp_dir);
+	totals();
+	return failed;
+}
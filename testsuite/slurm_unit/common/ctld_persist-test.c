@@ -0,0 +1,243 @@
+/* Test of the persistent client connection to slurmctld against a fake
+ * slurmctld: requests get their answer over the connection, and a request
+ * whose answer is lost is not sent again over a new connection.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "slurm/slurm.h"
+#include "slurm/slurm_errno.h"
+
+#include "src/common/fd.h"
+#include "src/common/log.h"
+#include "src/common/slurm_auth.h"
+#include "src/common/slurm_persist_conn.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+/* dejagnu.h defines its own wait(), sys/wait.h comes with slurm.h */
+#define wait dejagnu_wait
+#include <testsuite/dejagnu.h>
+#undef wait
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+static int listen_fd = -1;
+static time_t shutdown_time = 0;
+
+/* Counted and set by the fake slurmctld, read once the client is done */
+static pthread_mutex_t ctld_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int conn_cnt = 0;	/* connections accepted */
+static int persist_cnt = 0;	/* persistent connections accepted */
+static int req_cnt = 0;		/* requests received */
+static bool drop_next = false;	/* close instead of answering */
+
+/* Answer requests on a persistent connection until the client closes it
+ * or the answer is to be dropped */
+static void _serve_persist(int fd, persist_init_req_msg_t *init)
+{
+	slurm_persist_conn_t persist_conn;
+	persist_msg_t persist_msg;
+	slurm_msg_t msg;
+	Buf buffer;
+	bool drop;
+
+	/* As slurmctld does, writes check the connection with a read */
+	fd_set_nonblocking(fd);
+	memset(&persist_conn, 0, sizeof(slurm_persist_conn_t));
+	persist_conn.fd = fd;
+	persist_conn.flags = PERSIST_FLAG_CLIENT | PERSIST_FLAG_ALREADY_INITED;
+	persist_conn.shutdown = &shutdown_time;
+	persist_conn.version = MIN(init->version, SLURM_PROTOCOL_VERSION);
+
+	buffer = slurm_persist_make_rc_msg(&persist_conn, SLURM_SUCCESS, NULL,
+					   persist_conn.version);
+	slurm_persist_send_msg(&persist_conn, buffer);
+	free_buf(buffer);
+
+	while ((buffer = slurm_persist_recv_msg(&persist_conn))) {
+		memset(&persist_msg, 0, sizeof(persist_msg_t));
+		slurm_persist_msg_unpack(&persist_conn, &persist_msg, buffer);
+		free_buf(buffer);
+
+		slurm_mutex_lock(&ctld_mutex);
+		req_cnt++;
+		drop = drop_next;
+		drop_next = false;
+		slurm_mutex_unlock(&ctld_mutex);
+
+		if (!drop) {
+			slurm_msg_t_init(&msg);
+			msg.conn = &persist_conn;
+			msg.conn_fd = fd;
+			msg.msg_type = persist_msg.msg_type;
+			msg.protocol_version = persist_conn.version;
+			slurm_send_rc_msg(&msg, SLURM_SUCCESS);
+		}
+		slurm_free_msg_data(persist_msg.msg_type, persist_msg.data);
+		if (drop)
+			break;
+	}
+	g_slurm_auth_destroy(persist_conn.auth_cred);
+}
+
+static void *_fake_ctld(void *arg)
+{
+	slurm_msg_t msg;
+	int fd;
+
+	while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+		slurm_msg_t_init(&msg);
+		slurm_mutex_lock(&ctld_mutex);
+		conn_cnt++;
+		slurm_mutex_unlock(&ctld_mutex);
+
+		if (slurm_receive_msg(fd, &msg, 0) != SLURM_SUCCESS) {
+			close(fd);
+			continue;
+		}
+		if (msg.msg_type == REQUEST_PERSIST_INIT) {
+			slurm_mutex_lock(&ctld_mutex);
+			persist_cnt++;
+			slurm_mutex_unlock(&ctld_mutex);
+			_serve_persist(fd, msg.data);
+		} else {
+			slurm_mutex_lock(&ctld_mutex);
+			req_cnt++;
+			slurm_mutex_unlock(&ctld_mutex);
+			slurm_send_rc_msg(&msg, SLURM_SUCCESS);
+		}
+		slurm_free_msg_members(&msg);
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static int _ping(void)
+{
+	slurm_msg_t req;
+	int rc = SLURM_ERROR;
+
+	slurm_msg_t_init(&req);
+	req.msg_type = REQUEST_PING;
+	if (slurm_send_recv_controller_rc_msg(&req, &rc, NULL) < 0)
+		return SLURM_ERROR;
+
+	return rc;
+}
+
+static void _counts(int *conns, int *persists, int *reqs)
+{
+	slurm_mutex_lock(&ctld_mutex);
+	*conns = conn_cnt;
+	*persists = persist_cnt;
+	*reqs = req_cnt;
+	slurm_mutex_unlock(&ctld_mutex);
+}
+
+int main(int argc, char *argv[])
+{
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	char tmpl[] = "/tmp/ctld_persist-test.XXXXXX";
+	char *tmp_dir, *conf_file;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	pthread_attr_t attr;
+	pthread_t ctld_thread;
+	FILE *fp;
+	int conns, persists, reqs;
+
+	log_opts.stderr_level = LOG_LEVEL_QUIET;
+	log_init("ctld_persist-test", log_opts, 0, NULL);
+
+	if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) ||
+	    listen(listen_fd, 8)) {
+		perror("bind");
+		return 1;
+	}
+
+	if (!(tmp_dir = mkdtemp(tmpl))) {
+		perror("mkdtemp");
+		return 1;
+	}
+	conf_file = xstrdup_printf("%s/slurm.conf", tmp_dir);
+	if (!(fp = fopen(conf_file, "w"))) {
+		perror("fopen");
+		return 1;
+	}
+	fprintf(fp, "ClusterName=test\n"
+		"ControlMachine=localhost\n"
+		"ControlAddr=127.0.0.1\n"
+		"SlurmctldPort=%u\n"
+		"AuthType=auth/none\n"
+		"PluginDir=%s\n"
+		"MessageTimeout=5\n"
+		"NodeName=n1\n"
+		"PartitionName=debug Nodes=n1\n",
+		ntohs(addr.sin_port), AUTH_PLUGIN_DIR);
+	fclose(fp);
+	setenv("SLURM_CONF", conf_file, 1);
+
+	slurm_attr_init(&attr);
+	if (pthread_create(&ctld_thread, &attr, _fake_ctld, NULL)) {
+		perror("pthread_create");
+		return 1;
+	}
+	slurm_attr_destroy(&attr);
+
+	TEST(slurm_ctld_persist_conn_open() != SLURM_SUCCESS,
+	     "persistent connection opened");
+	TEST(_ping() != SLURM_SUCCESS, "request answered");
+	TEST(_ping() != SLURM_SUCCESS, "second request answered");
+	_counts(&conns, &persists, &reqs);
+	TEST((conns != 1) || (persists != 1) || (reqs != 2),
+	     "requests sent over one connection");
+
+	/* The answer is lost after slurmctld got the request */
+	slurm_mutex_lock(&ctld_mutex);
+	drop_next = true;
+	slurm_mutex_unlock(&ctld_mutex);
+	TEST(_ping() == SLURM_SUCCESS, "lost answer reported");
+	_counts(&conns, &persists, &reqs);
+	TEST((conns != 1) || (reqs != 3), "request with lost answer not resent");
+
+	TEST(_ping() != SLURM_SUCCESS, "request answered after a lost answer");
+	_counts(&conns, &persists, &reqs);
+	TEST((conns != 2) || (persists != 2) || (reqs != 4),
+	     "persistent connection reopened");
+
+	slurm_ctld_persist_conn_close();
+	shutdown(listen_fd, SHUT_RDWR);
+	close(listen_fd);
+	pthread_join(ctld_thread, NULL);
+
+	unlink(conf_file);
+	rmdir(tmp_dir);
+	xfree(conf_file);
+
+	totals();
+	return failed;
+}
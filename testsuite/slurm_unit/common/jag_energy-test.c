@@ -0,0 +1,110 @@
+/* Test of how jobacct_gather hands out the node energy of a step to its
+ * tasks. The common code is built in to reach its energy split.
+ */
+#include "src/plugins/jobacct_gather/common/common_jag.c"
+
+/* dejagnu.h defines its own wait(), sys/wait.h comes with the plugin */
+#define wait dejagnu_wait
+#include <testsuite/dejagnu.h>
+#undef wait
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+#define TASK_CNT 3
+
+/* Only the poll reads processes, not the energy split */
+extern int proctrack_g_get_pids(uint64_t cont_id, pid_t **pids, int *npids)
+{
+	*pids = NULL;
+	*npids = 0;
+	return SLURM_SUCCESS;
+}
+
+static struct jobacctinfo tasks[TASK_CNT];
+
+static int _find_task(void *x, void *key)
+{
+	return (x == key);
+}
+
+static void _share(List task_list, uint64_t consumed, uint32_t watts,
+		   double cpu0, double cpu1, double cpu2)
+{
+	acct_gather_energy_t node;
+
+	memset(&node, 0, sizeof(acct_gather_energy_t));
+	node.consumed_energy = consumed;
+	node.current_watts = watts;
+	tasks[0].this_sampled_cputime = cpu0;
+	tasks[1].this_sampled_cputime = cpu1;
+	tasks[2].this_sampled_cputime = cpu2;
+	_share_energy(task_list, &node);
+}
+
+static bool _energy(uint64_t e0, uint64_t e1, uint64_t e2)
+{
+	return ((tasks[0].energy.consumed_energy == e0) &&
+		(tasks[1].energy.consumed_energy == e1) &&
+		(tasks[2].energy.consumed_energy == e2));
+}
+
+int main(int argc, char *argv[])
+{
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	List task_list;
+	int i;
+
+	log_opts.stderr_level = LOG_LEVEL_QUIET;
+	log_init("jag_energy-test", log_opts, 0, NULL);
+
+	task_list = list_create(NULL);
+	for (i = 0; i < TASK_CNT; i++) {
+		memset(&tasks[i], 0, sizeof(struct jobacctinfo));
+		tasks[i].pid = 100 + i;
+		list_append(task_list, &tasks[i]);
+	}
+
+	_share(task_list, 100, 200, 1.0, 3.0, 0.0);
+	TEST(!_energy(25, 75, 0), "energy split by CPU time");
+	TEST((tasks[0].energy.current_watts != 50) ||
+	     (tasks[1].energy.current_watts != 150) ||
+	     (tasks[2].energy.current_watts != 0),
+	     "power split by CPU time");
+
+	_share(task_list, 110, 0, 0.0, 0.0, 0.0);
+	TEST(!_energy(28, 78, 4), "energy split evenly without CPU time");
+
+	_share(task_list, 120, 0, 1.0, 1.0, 1.0);
+	TEST(!_energy(31, 81, 8), "rounding left to the last task");
+
+	_share(task_list, 120, 0, 1.0, 0.0, 0.0);
+	TEST(!_energy(31, 81, 8), "no energy, nothing given");
+
+	_share(task_list, 150, 0, -1.0, 2.0, 0.0);
+	TEST(!_energy(31, 111, 8), "negative CPU time ignored");
+	TEST(tasks[0].energy.consumed_energy + tasks[1].energy.consumed_energy +
+	     tasks[2].energy.consumed_energy != 150,
+	     "task energies add up to the node energy");
+
+	/* A task gone keeps its share, the others get what comes next */
+	list_delete_all(task_list, _find_task, &tasks[0]);
+	_share(task_list, 160, 0, 1.0, 1.0, 1.0);
+	TEST(!_energy(31, 116, 13), "energy split among the remaining tasks");
+
+	_share(task_list, NO_VAL64, 0, 1.0, 1.0, 1.0);
+	TEST((tasks[1].energy.consumed_energy != NO_VAL64) ||
+	     (tasks[2].energy.consumed_energy != NO_VAL64),
+	     "no energy reading passed on");
+
+	FREE_NULL_LIST(task_list);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,129 @@
+/* Test of the powercap backend of acct_gather_energy/rapl on a fake
+ * /sys/class/powercap tree. The plugin is built in so that its counters
+ * can be checked to the micro joule.
+ */
+#include "src/plugins/acct_gather_energy/rapl/acct_gather_energy_rapl.c"
+
+/* dejagnu.h defines its own wait(), sys/wait.h comes with the plugin */
+#define wait dejagnu_wait
+#include <testsuite/dejagnu.h>
+#undef wait
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );			\
+	else					\
+		pass( _msg );			\
+} while (0)
+
+#define MAX_RANGE "999999999\n"
+
+extern char *slurm_prog_name;
+
+static char *tmp_dir = NULL;
+
+static void _write_file(const char *zone, const char *file, const char *value)
+{
+	char *path = xstrdup_printf("%s/%s/%s", tmp_dir, zone, file);
+	FILE *fp;
+
+	if (!(fp = fopen(path, "w")) || (fputs(value, fp) < 0) || fclose(fp))
+		fail("write fake powercap file");
+	xfree(path);
+}
+
+static void _make_zone(const char *zone, const char *name, const char *uj)
+{
+	char *path = xstrdup_printf("%s/%s", tmp_dir, zone);
+
+	mkdir(path, 0755);
+	xfree(path);
+	_write_file(zone, "name", name);
+	_write_file(zone, "energy_uj", uj);
+	_write_file(zone, "max_energy_range_uj", MAX_RANGE);
+}
+
+static void _remove_zone(const char *zone)
+{
+	char *path;
+
+	path = xstrdup_printf("%s/%s/name", tmp_dir, zone);
+	unlink(path);
+	xfree(path);
+	path = xstrdup_printf("%s/%s/energy_uj", tmp_dir, zone);
+	unlink(path);
+	xfree(path);
+	path = xstrdup_printf("%s/%s/max_energy_range_uj", tmp_dir, zone);
+	unlink(path);
+	xfree(path);
+	path = xstrdup_printf("%s/%s", tmp_dir, zone);
+	rmdir(path);
+	xfree(path);
+}
+
+static char *zone_names[] = {
+	"intel-rapl:0", "intel-rapl:0:0", "intel-rapl:0:1", "intel-rapl:1",
+	"intel-rapl:2", "intel-rapl-mmio:0", NULL
+};
+
+int main(int argc, char *argv[])
+{
+	char tmpl[] = "/tmp/rapl-test.XXXXXX";
+	acct_gather_energy_t energy;
+	uint64_t uj = 0;
+	int i;
+
+	if (!(tmp_dir = mkdtemp(tmpl))) {
+		perror("mkdtemp");
+		return 1;
+	}
+	/* Only the package and DRAM zones are summed, core, psys and the
+	 * mmio interface to the same counters are not */
+	_make_zone("intel-rapl:0", "package-0\n", "999000000\n");
+	_make_zone("intel-rapl:0:0", "core\n", "5\n");
+	_make_zone("intel-rapl:0:1", "dram\n", "1000000\n");
+	_make_zone("intel-rapl:1", "package-1\n", "2000000\n");
+	_make_zone("intel-rapl:2", "psys\n", "7\n");
+	_make_zone("intel-rapl-mmio:0", "package-0\n", "7\n");
+
+	/* init() would read slurm.conf for the debug flags only */
+	slurm_prog_name = "slurmd";
+	powercap_dir = xstrdup(tmp_dir);
+	acct_gather_energy_p_conf_set(NULL);
+	TEST(nb_zones != 3, "package and dram zones found");
+
+	TEST(_get_powercap_energy(&uj) || (uj != 1002000000),
+	     "energy read from the zones");
+	memset(&energy, 0, sizeof(acct_gather_energy_t));
+	_get_joules_task(&energy);
+	TEST(energy.base_consumed_energy != 1002, "base energy");
+
+	/* 999000000 to max_range is 999999 uJ, then 0 to 4000000 */
+	_write_file("intel-rapl:0", "energy_uj", "4000000\n");
+	_write_file("intel-rapl:1", "energy_uj", "3000000\n");
+	TEST(_get_powercap_energy(&uj) || (uj != 1008000000),
+	     "counter wrapping between two readings");
+	TEST(_get_powercap_energy(&uj) || (uj != 1008000000),
+	     "counters not moving");
+
+	/* Wrap exactly onto 0 */
+	_write_file("intel-rapl:1", "energy_uj", MAX_RANGE);
+	TEST(_get_powercap_energy(&uj) || (uj != 2004999999),
+	     "counter at max_range");
+	_write_file("intel-rapl:1", "energy_uj", "0\n");
+	TEST(_get_powercap_energy(&uj) || (uj != 2005000000),
+	     "counter wrapping to 0");
+
+	_get_joules_task(&energy);
+	TEST(energy.consumed_energy != 2005 - 1002, "consumed energy");
+
+	fini();
+	for (i = 0; zone_names[i]; i++)
+		_remove_zone(zone_names[i]);
+	rmdir(tmp_dir);
+
+	totals();
+	return failed;
+}
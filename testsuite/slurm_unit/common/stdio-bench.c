@@ -0,0 +1,268 @@
+/* Compare task output written straight to a shared file, as slurmstepd sets
+ * it up when tasks share an output file it opens, with output copied from
+ * the task pipes in MAX_MSG_LEN reads
+ *
+ * Usage: stdio-bench [tasks [MB per task [write size [directory]]]]
+ *
+ * Each task is a child process writing its share in writes of the given
+ * size.  The modes are:
+ * direct: the tasks write to one open file, as dup()ed by slurmstepd
+ * stepd:  the tasks write to pipes, copied to the file by one process as
+ *         slurmstepd does for a file it writes itself (--label)
+ * srun:   as stepd, but each read is sent with its I/O header over a socket
+ *         and written by a thread at the other end, as srun does, without
+ *         the network in between
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/io_hdr.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+static int tasks = 8;
+static long task_bytes = 64 * 1024 * 1024;
+static int write_size = 4096;
+
+static double _now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int _write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int _read_all(int fd, char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		if ((n = read(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Write this task's output to fd and exit */
+static void _task(int id, int fd)
+{
+	char *buf = xmalloc(write_size);
+	long done;
+
+	memset(buf, 'a' + (id % 26), write_size - 1);
+	buf[write_size - 1] = '\n';
+	for (done = 0; done < task_bytes; done += write_size) {
+		if (_write_all(fd, buf, write_size))
+			_exit(1);
+	}
+	_exit(0);
+}
+
+static int _wait_tasks(void)
+{
+	int i, status, rc = 0;
+
+	for (i = 0; i < tasks; i++) {
+		if ((wait(&status) < 0) || !WIFEXITED(status) ||
+		    WEXITSTATUS(status))
+			rc = -1;
+	}
+	return rc;
+}
+
+static int _bench_direct(int file_fd)
+{
+	int i;
+
+	for (i = 0; i < tasks; i++) {
+		if (fork() == 0)
+			_task(i, file_fd);
+	}
+	return _wait_tasks();
+}
+
+/* Read what srun would get from the node and write it to the file */
+static void *_srun_writer(void *arg)
+{
+	int *fds = arg;
+	char *buf = xmalloc(MAX_MSG_LEN);
+	io_hdr_t hdr;
+
+	while (io_hdr_read_fd(fds[0], &hdr) > 0) {
+		if ((hdr.length > MAX_MSG_LEN) ||
+		    _read_all(fds[0], buf, hdr.length) ||
+		    _write_all(fds[1], buf, hdr.length))
+			break;
+	}
+	xfree(buf);
+	return NULL;
+}
+
+static int _bench_pipes(int file_fd, bool forward)
+{
+	struct pollfd *pfds = xmalloc(sizeof(struct pollfd) * tasks);
+	char *buf = xmalloc(MAX_MSG_LEN + io_hdr_packed_size());
+	int hdr_size = io_hdr_packed_size();
+	int i, open_cnt = tasks, out_fd = file_fd;
+	int sock[2], writer_fds[2];
+	pthread_t writer;
+	io_hdr_t hdr;
+	Buf hdr_buf;
+	ssize_t n;
+
+	if (forward) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock))
+			return -1;
+		writer_fds[0] = sock[1];
+		writer_fds[1] = file_fd;
+		pthread_create(&writer, NULL, _srun_writer, writer_fds);
+		out_fd = sock[0];
+	}
+
+	for (i = 0; i < tasks; i++) {
+		int pout[2];
+
+		if (pipe(pout))
+			return -1;
+		if (fork() == 0) {
+			close(pout[0]);
+			_task(i, pout[1]);
+		}
+		close(pout[1]);
+		pfds[i].fd = pout[0];
+		pfds[i].events = POLLIN;
+	}
+
+	memset(&hdr, 0, sizeof(io_hdr_t));
+	hdr.type = SLURM_IO_STDOUT;
+	while (open_cnt && (poll(pfds, tasks, -1) >= 0)) {
+		for (i = 0; i < tasks; i++) {
+			if ((pfds[i].fd < 0) || !pfds[i].revents)
+				continue;
+			n = read(pfds[i].fd, buf + hdr_size, MAX_MSG_LEN);
+			if (n <= 0) {
+				close(pfds[i].fd);
+				pfds[i].fd = -1;
+				open_cnt--;
+				continue;
+			}
+			if (!forward) {
+				_write_all(out_fd, buf + hdr_size, n);
+				continue;
+			}
+			hdr.gtaskid = hdr.ltaskid = i;
+			hdr.length = n;
+			hdr_buf = create_buf(buf, hdr_size);
+			io_hdr_pack(&hdr, hdr_buf);
+			hdr_buf->head = NULL;
+			free_buf(hdr_buf);
+			_write_all(out_fd, buf, hdr_size + n);
+		}
+	}
+
+	if (forward) {
+		close(sock[0]);
+		pthread_join(writer, NULL);
+		close(sock[1]);
+	}
+	xfree(pfds);
+	xfree(buf);
+	return _wait_tasks();
+}
+
+static int _bench(const char *dir, const char *mode)
+{
+	char *path = xstrdup_printf("%s/stdio-bench.out", dir);
+	struct stat st;
+	double t0, secs;
+	int fd, rc;
+
+	if ((fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0600)) < 0) {
+		perror(path);
+		xfree(path);
+		return -1;
+	}
+
+	t0 = _now();
+	if (!strcmp(mode, "direct"))
+		rc = _bench_direct(fd);
+	else
+		rc = _bench_pipes(fd, !strcmp(mode, "srun"));
+	secs = _now() - t0;
+	fstat(fd, &st);
+	close(fd);
+	unlink(path);
+	xfree(path);
+
+	if (rc || (st.st_size != (off_t) tasks * task_bytes)) {
+		fprintf(stderr, "%s: wrote %ld bytes, not %ld\n", mode,
+			(long) st.st_size, (long) tasks * task_bytes);
+		return -1;
+	}
+	printf("%-8s %10.1f MB/s %8.3f s\n", mode,
+	       st.st_size / secs / (1024 * 1024), secs);
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char *dir = "/tmp";
+
+	if (argc > 1)
+		tasks = atoi(argv[1]);
+	if (argc > 2)
+		task_bytes = atol(argv[2]) * 1024 * 1024;
+	if (argc > 3)
+		write_size = atoi(argv[3]);
+	if (argc > 4)
+		dir = argv[4];
+	if ((tasks < 1) || (task_bytes < 1) || (write_size < 1)) {
+		fprintf(stderr, "Usage: %s [tasks [MB per task [write size "
+			"[directory]]]]\n", argv[0]);
+		exit(1);
+	}
+	task_bytes -= task_bytes % write_size;
+
+	printf("%d tasks, %ld bytes each in %d byte writes\n",
+	       tasks, task_bytes, write_size);
+	if (_bench(dir, "direct") || _bench(dir, "stepd") ||
+	    _bench(dir, "srun"))
+		exit(1);
+	return 0;
+}